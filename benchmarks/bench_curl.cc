@@ -0,0 +1,40 @@
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "h5s3/private/curl.h"
+#include "loopback.h"
+
+namespace curl = h5s3::curl;
+
+void session_get(benchmark::State& state) {
+    std::size_t body_size = state.range(0);
+    h5s3::testing::loopback_server server(body_size);
+    std::string url = "http://" + server.address() + "/bucket/key";
+    std::vector<curl::header> headers = {{"host", "localhost"}};
+    std::vector<char> buffer(body_size);
+
+    curl::session session;
+    for (auto _ : state) {
+        h5s3::utils::out_buffer out(buffer.data(), buffer.size());
+        benchmark::DoNotOptimize(session.get(url, headers, out));
+    }
+    state.SetBytesProcessed(state.iterations() * body_size);
+}
+BENCHMARK(session_get)->Arg(0)->Arg(4 << 10)->Arg(2 << 20)->UseRealTime();
+
+void session_put(benchmark::State& state) {
+    std::size_t body_size = state.range(0);
+    h5s3::testing::loopback_server server(0);
+    std::string url = "http://" + server.address() + "/bucket/key";
+    std::vector<curl::header> headers = {{"host", "localhost"}};
+    std::string body(body_size, 'X');
+
+    curl::session session;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(session.put(url, headers, body));
+    }
+    state.SetBytesProcessed(state.iterations() * body_size);
+}
+BENCHMARK(session_put)->Arg(0)->Arg(4 << 10)->Arg(2 << 20)->UseRealTime();
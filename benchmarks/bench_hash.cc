@@ -0,0 +1,36 @@
+#include <string>
+
+#include "benchmark/benchmark.h"
+
+#include "h5s3/private/hash.h"
+
+namespace hash = h5s3::hash;
+
+void sha256_hexdigest(benchmark::State& state) {
+    std::string data(state.range(0), 'X');
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(hash::sha256_hexdigest(data));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(sha256_hexdigest)->Arg(0)->Arg(64)->Arg(4 << 10)->Arg(2 << 20);
+
+void hmac_sha256(benchmark::State& state) {
+    std::string data(state.range(0), 'X');
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(hash::hmac_sha256("key", data));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(hmac_sha256)->Arg(0)->Arg(64)->Arg(4 << 10);
+
+void to_hex(benchmark::State& state) {
+    hash::sha256 digest;
+    for (std::size_t ix = 0; ix < digest.size(); ++ix) {
+        digest[ix] = static_cast<unsigned char>(ix * 7);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(hash::to_hex(digest));
+    }
+}
+BENCHMARK(to_hex);
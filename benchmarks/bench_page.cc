@@ -0,0 +1,85 @@
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "h5s3/private/memory_kv_store.h"
+#include "h5s3/private/page.h"
+
+namespace page = h5s3::page;
+using table = page::table<h5s3::memory_driver::memory_kv_store>;
+
+namespace {
+/** Whether a benchmark should be served out of the page cache.
+ */
+enum class cache {
+    hit,
+    miss,
+};
+
+/** The page sizes and request sizes to run each page table benchmark over.
+ */
+void page_and_request_sizes(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"page_size", "request_size"});
+    b->ArgsProduct({{4 << 10, 64 << 10, 2 << 20}, {64, 4 << 10, 64 << 10}});
+}
+
+/** Build a table whose cache either holds every page we will touch or only a
+    single page.
+ */
+table make_table(std::size_t page_size, cache c) {
+    std::size_t page_cache_size = (c == cache::hit) ? 64 : 1;
+    return table(h5s3::memory_driver::memory_kv_store(page_size), page_cache_size);
+}
+
+/** The address of the `n`th request. When the cache only holds one page,
+    alternating between two pages makes every access a miss.
+ */
+std::size_t address(std::size_t n, std::size_t page_size) {
+    return (n % 2) * page_size * 2;
+}
+}  // namespace
+
+template<cache c>
+void page_table_read(benchmark::State& state) {
+    std::size_t page_size = state.range(0);
+    std::size_t request_size = state.range(1);
+    table t = make_table(page_size, c);
+    std::vector<char> buffer(request_size);
+
+    // warm the cache so that the hit benchmark never goes to the store
+    for (std::size_t n = 0; n < 2; ++n) {
+        h5s3::utils::out_buffer out(buffer.data(), buffer.size());
+        t.read(address(n, page_size), out);
+    }
+
+    std::size_t n = 0;
+    for (auto _ : state) {
+        h5s3::utils::out_buffer out(buffer.data(), buffer.size());
+        t.read(address(n++, page_size), out);
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    state.SetBytesProcessed(state.iterations() * request_size);
+}
+BENCHMARK_TEMPLATE(page_table_read, cache::hit)->Apply(page_and_request_sizes);
+BENCHMARK_TEMPLATE(page_table_read, cache::miss)->Apply(page_and_request_sizes);
+
+template<cache c>
+void page_table_write(benchmark::State& state) {
+    std::size_t page_size = state.range(0);
+    std::size_t request_size = state.range(1);
+    table t = make_table(page_size, c);
+    std::string data(request_size, 'X');
+
+    for (std::size_t n = 0; n < 2; ++n) {
+        t.write(address(n, page_size), data);
+    }
+
+    std::size_t n = 0;
+    for (auto _ : state) {
+        t.write(address(n++, page_size), data);
+    }
+    state.SetBytesProcessed(state.iterations() * request_size);
+}
+BENCHMARK_TEMPLATE(page_table_write, cache::hit)->Apply(page_and_request_sizes);
+BENCHMARK_TEMPLATE(page_table_write, cache::miss)->Apply(page_and_request_sizes);
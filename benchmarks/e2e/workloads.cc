@@ -0,0 +1,659 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "hdf5.h"
+
+#include "h5s3/private/s3_driver.h"
+#include "minio.h"
+
+/** End-to-end benchmarks which run representative hdf5 workloads through the
+    s3 driver against a local minio server.
+
+    Each benchmark reports:
+
+    - `bytes_per_second`: The logical bytes read or written through hdf5.
+    - `gets` / `puts`: The number of requests made to minio per iteration.
+    - `bytes_read` / `bytes_written`: The bytes moved to and from minio per
+      iteration.
+    - `p50_us` / `p99_us`: The latency of the workload's unit operation, for
+      example one chunk read or one group visit.
+ */
+namespace {
+std::unique_ptr<minio> MINIO;
+
+/** Process-wide request counts, summed over the stats of every
+    `counting_kv_store`, so that each read and write path counts the requests
+    it actually makes.
+ */
+class request_counts {
+public:
+    struct totals {
+        std::size_t gets = 0;
+        std::size_t puts = 0;
+        std::size_t bytes_read = 0;
+        std::size_t bytes_written = 0;
+    };
+
+private:
+    std::mutex m_mutex;
+    std::set<const h5s3::stats::store_counters*> m_open;
+    totals m_closed;
+    totals m_reset;
+
+    static void add(totals& t, const h5s3::stats::store_counters& counters) {
+        t.gets += counters.gets.load();
+        t.puts += counters.puts.load();
+        t.bytes_read += counters.bytes_read.load();
+        t.bytes_written += counters.bytes_written.load();
+    }
+
+    totals total() const {
+        totals t = m_closed;
+        for (const h5s3::stats::store_counters* counters : m_open) {
+            add(t, *counters);
+        }
+        return t;
+    }
+
+public:
+    /** Start counting a store's requests.
+     */
+    void open(const h5s3::stats::store_counters& counters) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_open.insert(&counters);
+    }
+
+    /** Stop counting a store's requests.
+
+        @param counters The store's counters.
+        @param moved Was the store moved from? Its requests are then counted
+               by the store it was moved to.
+     */
+    void close(const h5s3::stats::store_counters& counters, bool moved) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_open.erase(&counters) && !moved) {
+            add(m_closed, counters);
+        }
+    }
+
+    /** Count from zero again.
+     */
+    void reset() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_reset = total();
+    }
+
+    /** The requests made since the last `reset`.
+     */
+    totals since_reset() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        totals t = total();
+        t.gets -= m_reset.gets;
+        t.puts -= m_reset.puts;
+        t.bytes_read -= m_reset.bytes_read;
+        t.bytes_written -= m_reset.bytes_written;
+        return t;
+    }
+} COUNTS;
+
+/** A kv-store which forwards to `s3_kv_store` while counting the requests
+    made. Every optional capability of `s3_kv_store` is forwarded, so the
+    driver takes the same paths as it would without the counting.
+ */
+class counting_kv_store {
+private:
+    h5s3::s3_driver::s3_kv_store m_store;
+    bool m_moved = false;
+
+    explicit counting_kv_store(h5s3::s3_driver::s3_kv_store&& store)
+        : m_store(std::move(store)) {
+        COUNTS.open(m_store.stats());
+    }
+
+public:
+    static constexpr const char* name = "h5s3-bench";
+
+    counting_kv_store(counting_kv_store&& mvfrom) noexcept
+        : m_store(std::move(mvfrom.m_store)) {
+        COUNTS.open(m_store.stats());
+        COUNTS.close(mvfrom.m_store.stats(), true);
+        mvfrom.m_moved = true;
+    }
+
+    ~counting_kv_store() {
+        COUNTS.close(m_store.stats(), m_moved);
+    }
+
+    static counting_kv_store from_params(const std::string_view& uri,
+                                         unsigned int flags,
+                                         std::size_t page_size,
+                                         const char* access_key,
+                                         const char* secret_key,
+                                         const char* region,
+                                         const char* host,
+                                         bool use_tls,
+                                         std::size_t pages_per_object,
+                                         std::size_t key_prefixes,
+                                         const char* buckets,
+                                         const char* endpoints,
+                                         bool content_addressed,
+                                         bool log_structured) {
+        return counting_kv_store(
+            h5s3::s3_driver::s3_kv_store::from_params(uri,
+                                                      flags,
+                                                      page_size,
+                                                      access_key,
+                                                      secret_key,
+                                                      region,
+                                                      host,
+                                                      use_tls,
+                                                      pages_per_object,
+                                                      key_prefixes,
+                                                      buckets,
+                                                      endpoints,
+                                                      content_addressed,
+                                                      log_structured));
+    }
+
+    std::size_t page_size() const {
+        return m_store.page_size();
+    }
+
+    h5s3::page::id max_page() const {
+        return m_store.max_page();
+    }
+
+    void max_page(h5s3::page::id max_page) {
+        m_store.max_page(max_page);
+    }
+
+    std::size_t allocated_pages() const {
+        return m_store.allocated_pages();
+    }
+
+    const h5s3::stats::store_counters& stats() const {
+        return m_store.stats();
+    }
+
+    const std::vector<h5s3::page::id>& hot_pages() const {
+        return m_store.hot_pages();
+    }
+
+    void hot_pages(std::vector<h5s3::page::id> pages) {
+        m_store.hot_pages(std::move(pages));
+    }
+
+    std::string cache_key() const {
+        return m_store.cache_key();
+    }
+
+    void read(h5s3::page::id page_id, h5s3::utils::out_buffer& out) const {
+        m_store.read(page_id, out);
+    }
+
+    void read(h5s3::page::id first, std::vector<h5s3::utils::out_buffer>& pages) const {
+        m_store.read(first, pages);
+    }
+
+    void read(std::vector<h5s3::page::page_run>& runs,
+              std::size_t concurrency,
+              h5s3::io::priority level) const {
+        m_store.read(runs, concurrency, level);
+    }
+
+    h5s3::async::future<void> async_read(h5s3::page::id page_id,
+                                         h5s3::utils::out_buffer out,
+                                         h5s3::io::priority level) const {
+        return m_store.async_read(page_id, out, level);
+    }
+
+    bool revalidate(h5s3::page::id page_id, h5s3::utils::out_buffer& out) const {
+        return m_store.revalidate(page_id, out);
+    }
+
+    void refresh() {
+        m_store.refresh();
+    }
+
+    void write(h5s3::page::id page_id, const std::string_view& data) {
+        m_store.write(page_id, data);
+    }
+
+    void write(h5s3::page::id page_id,
+               const std::string_view& data,
+               std::size_t begin,
+               std::size_t end) {
+        m_store.write(page_id, data, begin, end);
+    }
+
+    void flush() {
+        m_store.flush();
+    }
+};
+
+// the driver picks its read and write paths by these, so a capability which
+// is not forwarded would benchmark a different path than the plain driver
+using h5s3::s3_driver::s3_kv_store;
+static_assert(h5s3::page::has_multi_page_read_v<counting_kv_store> ==
+              h5s3::page::has_multi_page_read_v<s3_kv_store>);
+static_assert(h5s3::page::has_hot_pages_v<counting_kv_store> ==
+              h5s3::page::has_hot_pages_v<s3_kv_store>);
+static_assert(h5s3::page::has_revalidate_v<counting_kv_store> ==
+              h5s3::page::has_revalidate_v<s3_kv_store>);
+static_assert(h5s3::page::has_cache_key_v<counting_kv_store> ==
+              h5s3::page::has_cache_key_v<s3_kv_store>);
+static_assert(h5s3::page::has_batch_read_v<counting_kv_store> ==
+              h5s3::page::has_batch_read_v<s3_kv_store>);
+static_assert(h5s3::page::has_async_read_v<counting_kv_store> ==
+              h5s3::page::has_async_read_v<s3_kv_store>);
+static_assert(h5s3::page::has_range_write_v<counting_kv_store> ==
+              h5s3::page::has_range_write_v<s3_kv_store>);
+
+using driver = h5s3::driver::kv_driver<counting_kv_store>;
+
+/** Records the latency of each unit operation of a workload.
+ */
+class latency_recorder {
+private:
+    std::vector<double> m_samples_us;
+
+public:
+    template<typename F>
+    void time(F&& f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - start;
+        m_samples_us.push_back(elapsed.count());
+    }
+
+    double percentile(double p) {
+        if (m_samples_us.empty()) {
+            return 0;
+        }
+        std::size_t ix = std::min(m_samples_us.size() - 1,
+                                  static_cast<std::size_t>(p * m_samples_us.size()));
+        std::nth_element(m_samples_us.begin(),
+                         m_samples_us.begin() + ix,
+                         m_samples_us.end());
+        return m_samples_us[ix];
+    }
+};
+
+/** Throw if an hdf5 call failed.
+ */
+template<typename T>
+T check(T result) {
+    if (result < 0) {
+        throw std::runtime_error("hdf5 call failed");
+    }
+    return result;
+}
+
+hid_t make_fapl(std::size_t page_size) {
+    hid_t fapl = check(H5Pcreate(H5P_FILE_ACCESS));
+    check(driver::set_fapl(fapl,
+                           page_size,
+                           0,
+                           MINIO->access_key().data(),
+                           MINIO->secret_key().data(),
+                           MINIO->region().data(),
+                           MINIO->address().data(),
+                           false,
+                           0,
+                           0,
+                           static_cast<const char*>(nullptr),
+                           static_cast<const char*>(nullptr),
+                           false,
+                           false));
+    return fapl;
+}
+
+std::string uri(const std::string& name, std::size_t page_size) {
+    return "s3://" + MINIO->bucket() + "/" + name + "-" + std::to_string(page_size);
+}
+
+hid_t create_file(const std::string& name, std::size_t page_size) {
+    hid_t fapl = make_fapl(page_size);
+    hid_t file = check(
+        H5Fcreate(uri(name, page_size).data(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl));
+    H5Pclose(fapl);
+    return file;
+}
+
+hid_t open_file(const std::string& name, std::size_t page_size, unsigned int flags) {
+    hid_t fapl = make_fapl(page_size);
+    hid_t file = check(H5Fopen(uri(name, page_size).data(), flags, fapl));
+    H5Pclose(fapl);
+    return file;
+}
+
+/** Report the request counts and latency percentiles collected while running
+    a benchmark.
+ */
+void report(benchmark::State& state,
+            latency_recorder& latencies,
+            std::size_t logical_bytes) {
+    state.SetBytesProcessed(logical_bytes);
+    auto avg = benchmark::Counter::kAvgIterations;
+    request_counts::totals counts = COUNTS.since_reset();
+    state.counters["gets"] = benchmark::Counter(counts.gets, avg);
+    state.counters["puts"] = benchmark::Counter(counts.puts, avg);
+    state.counters["bytes_read"] = benchmark::Counter(counts.bytes_read, avg);
+    state.counters["bytes_written"] = benchmark::Counter(counts.bytes_written, avg);
+    state.counters["p50_us"] = latencies.percentile(0.5);
+    state.counters["p99_us"] = latencies.percentile(0.99);
+}
+
+constexpr hsize_t chunk_rows = 128 * 1024;  // 1 MiB of doubles per chunk
+constexpr hsize_t dataset_chunks = 32;
+
+/** Write the dataset used by the scan and random read workloads.
+ */
+void write_chunked_dataset(const std::string& name, std::size_t page_size) {
+    hid_t file = create_file(name, page_size);
+
+    hsize_t dims[] = {chunk_rows * dataset_chunks};
+    hsize_t chunk[] = {chunk_rows};
+    hid_t space = check(H5Screate_simple(1, dims, nullptr));
+    hid_t dcpl = check(H5Pcreate(H5P_DATASET_CREATE));
+    check(H5Pset_chunk(dcpl, 1, chunk));
+    hid_t dataset = check(H5Dcreate2(
+        file, "data", H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, dcpl, H5P_DEFAULT));
+
+    std::vector<double> data(dims[0]);
+    std::iota(data.begin(), data.end(), 0.0);
+    check(H5Dwrite(
+        dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data.data()));
+
+    H5Dclose(dataset);
+    H5Pclose(dcpl);
+    H5Sclose(space);
+    check(H5Fclose(file));
+}
+
+/** Read the chunk at `chunk_ix` out of `dataset` into `out`.
+ */
+void read_chunk(hid_t dataset, hsize_t chunk_ix, std::vector<double>& out) {
+    hid_t file_space = check(H5Dget_space(dataset));
+    hsize_t start[] = {chunk_ix * chunk_rows};
+    hsize_t count[] = {chunk_rows};
+    check(H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, nullptr, count, nullptr));
+    hid_t mem_space = check(H5Screate_simple(1, count, nullptr));
+    check(H5Dread(
+        dataset, H5T_NATIVE_DOUBLE, mem_space, file_space, H5P_DEFAULT, out.data()));
+    H5Sclose(mem_space);
+    H5Sclose(file_space);
+}
+
+void sequential_scan(benchmark::State& state) {
+    std::size_t page_size = state.range(0);
+    write_chunked_dataset("sequential_scan", page_size);
+    COUNTS.reset();
+
+    latency_recorder latencies;
+    std::vector<double> out(chunk_rows);
+    for (auto _ : state) {
+        hid_t file = open_file("sequential_scan", page_size, H5F_ACC_RDONLY);
+        hid_t dataset = check(H5Dopen2(file, "data", H5P_DEFAULT));
+        for (hsize_t chunk_ix = 0; chunk_ix < dataset_chunks; ++chunk_ix) {
+            latencies.time([&] { read_chunk(dataset, chunk_ix, out); });
+        }
+        H5Dclose(dataset);
+        H5Fclose(file);
+    }
+    report(state,
+           latencies,
+           state.iterations() * dataset_chunks * chunk_rows * sizeof(double));
+}
+
+void random_chunk_reads(benchmark::State& state) {
+    std::size_t page_size = state.range(0);
+    write_chunked_dataset("random_chunk_reads", page_size);
+    COUNTS.reset();
+
+    constexpr std::size_t reads_per_iteration = 16;
+    std::mt19937_64 rand(1234);
+    std::uniform_int_distribution<hsize_t> chunk_dist(0, dataset_chunks - 1);
+
+    latency_recorder latencies;
+    std::vector<double> out(chunk_rows);
+    for (auto _ : state) {
+        hid_t file = open_file("random_chunk_reads", page_size, H5F_ACC_RDONLY);
+        hid_t dataset = check(H5Dopen2(file, "data", H5P_DEFAULT));
+        for (std::size_t n = 0; n < reads_per_iteration; ++n) {
+            hsize_t chunk_ix = chunk_dist(rand);
+            latencies.time([&] { read_chunk(dataset, chunk_ix, out); });
+        }
+        H5Dclose(dataset);
+        H5Fclose(file);
+    }
+    report(state,
+           latencies,
+           state.iterations() * reads_per_iteration * chunk_rows * sizeof(double));
+}
+
+constexpr std::size_t group_depth = 16;
+constexpr std::size_t group_fanout = 4;
+constexpr std::size_t attributes_per_group = 8;
+
+void group_traversal(benchmark::State& state) {
+    std::size_t page_size = state.range(0);
+
+    {
+        hid_t file = create_file("group_traversal", page_size);
+        hid_t scalar = check(H5Screate(H5S_SCALAR));
+        std::vector<hid_t> parents = {file};
+        for (std::size_t depth = 0; depth < group_depth; ++depth) {
+            std::vector<hid_t> children;
+            for (std::size_t n = 0; n < group_fanout; ++n) {
+                std::string name = "g" + std::to_string(n);
+                hid_t group = check(H5Gcreate2(
+                    parents.front(), name.data(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT));
+                for (std::size_t a = 0; a < attributes_per_group; ++a) {
+                    std::string attr_name = "a" + std::to_string(a);
+                    double value = a;
+                    hid_t attr = check(H5Acreate2(group,
+                                                  attr_name.data(),
+                                                  H5T_NATIVE_DOUBLE,
+                                                  scalar,
+                                                  H5P_DEFAULT,
+                                                  H5P_DEFAULT));
+                    check(H5Awrite(attr, H5T_NATIVE_DOUBLE, &value));
+                    H5Aclose(attr);
+                }
+                children.push_back(group);
+            }
+            for (hid_t parent : parents) {
+                if (parent != file) {
+                    H5Gclose(parent);
+                }
+            }
+            parents = std::move(children);
+        }
+        for (hid_t parent : parents) {
+            H5Gclose(parent);
+        }
+        H5Sclose(scalar);
+        check(H5Fclose(file));
+    }
+    COUNTS.reset();
+
+    latency_recorder latencies;
+    for (auto _ : state) {
+        hid_t file = open_file("group_traversal", page_size, H5F_ACC_RDONLY);
+        hid_t parent = file;
+        for (std::size_t depth = 0; depth < group_depth; ++depth) {
+            for (std::size_t n = group_fanout; n > 0; --n) {
+                std::string name = "g" + std::to_string(n - 1);
+                hid_t group;
+                latencies.time([&] {
+                    group = check(H5Gopen2(parent, name.data(), H5P_DEFAULT));
+                    for (std::size_t a = 0; a < attributes_per_group; ++a) {
+                        std::string attr_name = "a" + std::to_string(a);
+                        double value;
+                        hid_t attr = check(H5Aopen(group, attr_name.data(), H5P_DEFAULT));
+                        check(H5Aread(attr, H5T_NATIVE_DOUBLE, &value));
+                        H5Aclose(attr);
+                    }
+                });
+                // descend through "g0", which is visited last
+                if (n > 1) {
+                    H5Gclose(group);
+                }
+                else {
+                    if (parent != file) {
+                        H5Gclose(parent);
+                    }
+                    parent = group;
+                }
+            }
+        }
+        H5Gclose(parent);
+        H5Fclose(file);
+    }
+    report(state,
+           latencies,
+           state.iterations() * group_depth * group_fanout * attributes_per_group *
+               sizeof(double));
+}
+
+void bulk_append(benchmark::State& state) {
+    std::size_t page_size = state.range(0);
+    COUNTS.reset();
+
+    constexpr hsize_t rows_per_append = 32 * 1024;  // 256 KiB of doubles
+    constexpr std::size_t appends_per_iteration = 32;
+    std::vector<double> data(rows_per_append, 1.0);
+
+    latency_recorder latencies;
+    for (auto _ : state) {
+        hid_t file = create_file("bulk_append", page_size);
+
+        hsize_t dims[] = {0};
+        hsize_t max_dims[] = {H5S_UNLIMITED};
+        hsize_t chunk[] = {rows_per_append};
+        hid_t space = check(H5Screate_simple(1, dims, max_dims));
+        hid_t dcpl = check(H5Pcreate(H5P_DATASET_CREATE));
+        check(H5Pset_chunk(dcpl, 1, chunk));
+        hid_t dataset = check(H5Dcreate2(
+            file, "data", H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, dcpl, H5P_DEFAULT));
+
+        for (std::size_t n = 0; n < appends_per_iteration; ++n) {
+            latencies.time([&] {
+                hsize_t start[] = {n * rows_per_append};
+                hsize_t new_dims[] = {(n + 1) * rows_per_append};
+                check(H5Dset_extent(dataset, new_dims));
+                hid_t file_space = check(H5Dget_space(dataset));
+                check(H5Sselect_hyperslab(
+                    file_space, H5S_SELECT_SET, start, nullptr, chunk, nullptr));
+                hid_t mem_space = check(H5Screate_simple(1, chunk, nullptr));
+                check(H5Dwrite(dataset,
+                               H5T_NATIVE_DOUBLE,
+                               mem_space,
+                               file_space,
+                               H5P_DEFAULT,
+                               data.data()));
+                H5Sclose(mem_space);
+                H5Sclose(file_space);
+            });
+        }
+
+        H5Dclose(dataset);
+        H5Pclose(dcpl);
+        H5Sclose(space);
+        check(H5Fflush(file, H5F_SCOPE_GLOBAL));
+        H5Fclose(file);
+    }
+    report(state,
+           latencies,
+           state.iterations() * appends_per_iteration * rows_per_append *
+               sizeof(double));
+}
+
+void many_small_files(benchmark::State& state) {
+    std::size_t page_size = state.range(0);
+    constexpr std::size_t file_count = 32;
+    constexpr hsize_t rows = 16;
+
+    auto name = [](std::size_t n) { return "many_small_files/" + std::to_string(n); };
+
+    for (std::size_t n = 0; n < file_count; ++n) {
+        hid_t file = create_file(name(n), page_size);
+        hsize_t dims[] = {rows};
+        hid_t space = check(H5Screate_simple(1, dims, nullptr));
+        hid_t dataset = check(H5Dcreate2(file,
+                                         "data",
+                                         H5T_NATIVE_DOUBLE,
+                                         space,
+                                         H5P_DEFAULT,
+                                         H5P_DEFAULT,
+                                         H5P_DEFAULT));
+        std::vector<double> data(rows, n);
+        check(H5Dwrite(
+            dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data.data()));
+        H5Dclose(dataset);
+        H5Sclose(space);
+        check(H5Fclose(file));
+    }
+    COUNTS.reset();
+
+    latency_recorder latencies;
+    std::vector<double> out(rows);
+    for (auto _ : state) {
+        for (std::size_t n = 0; n < file_count; ++n) {
+            latencies.time([&] {
+                hid_t file = open_file(name(n), page_size, H5F_ACC_RDONLY);
+                hid_t dataset = check(H5Dopen2(file, "data", H5P_DEFAULT));
+                check(H5Dread(dataset,
+                              H5T_NATIVE_DOUBLE,
+                              H5S_ALL,
+                              H5S_ALL,
+                              H5P_DEFAULT,
+                              out.data()));
+                H5Dclose(dataset);
+                H5Fclose(file);
+            });
+        }
+    }
+    report(state, latencies, state.iterations() * file_count * rows * sizeof(double));
+}
+
+/** Run each workload with a small and the default page size.
+ */
+void page_sizes(benchmark::internal::Benchmark* b) {
+    b->ArgName("page_size");
+    b->Arg(256 * 1024);
+    b->Arg(2 * 1024 * 1024);
+    b->UseRealTime();
+    b->Unit(benchmark::kMillisecond);
+}
+}  // namespace
+
+template<>
+H5FD_class_t driver::m_class{};
+
+BENCHMARK(sequential_scan)->Apply(page_sizes);
+BENCHMARK(random_chunk_reads)->Apply(page_sizes);
+BENCHMARK(group_traversal)->Apply(page_sizes);
+BENCHMARK(bulk_append)->Apply(page_sizes);
+BENCHMARK(many_small_files)->Apply(page_sizes);
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+
+    MINIO = std::make_unique<minio>();
+    benchmark::RunSpecifiedBenchmarks();
+    MINIO.reset();
+    return 0;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace h5s3::testing {
+
+/** A minimal HTTP/1.1 server bound to the loopback interface.
+
+    Every request is answered with a `200 OK` and a body of `body_size` bytes.
+    Request bodies (for PUT) are read and discarded. Connections are kept
+    alive so that the cost measured is the cost of our request path and not
+    the cost of the TCP handshake.
+
+    This exists to benchmark `curl::session` without depending on the
+    network or on a real S3 implementation.
+ */
+class loopback_server {
+private:
+    int m_listen_fd;
+    std::uint16_t m_port;
+    std::string m_response;
+    std::atomic<bool> m_running;
+    std::thread m_accept_thread;
+    std::mutex m_connections_mutex;
+    std::vector<int> m_connection_fds;
+    std::vector<std::thread> m_connection_threads;
+
+    /** Read a single request off of `fd`, returning false if the peer closed
+        the connection.
+     */
+    static bool consume_request(int fd, std::string& pending) {
+        std::size_t header_end;
+        while ((header_end = pending.find("\r\n\r\n")) == std::string::npos) {
+            char buf[4096];
+            ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                return false;
+            }
+            pending.append(buf, n);
+        }
+
+        std::size_t content_length = 0;
+        std::string_view headers(pending.data(), header_end);
+        for (std::string_view name : {"Content-Length:", "content-length:"}) {
+            auto ix = headers.find(name);
+            if (ix != std::string_view::npos) {
+                content_length = std::stoul(std::string(headers.substr(ix + name.size())));
+                break;
+            }
+        }
+
+        std::size_t request_size = header_end + 4 + content_length;
+        while (pending.size() < request_size) {
+            char buf[65536];
+            ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                return false;
+            }
+            pending.append(buf, n);
+        }
+        pending.erase(0, request_size);
+        return true;
+    }
+
+    void serve(int fd) {
+        std::string pending;
+        while (m_running && consume_request(fd, pending)) {
+            std::size_t sent = 0;
+            while (sent < m_response.size()) {
+                ssize_t n = ::send(fd,
+                                   m_response.data() + sent,
+                                   m_response.size() - sent,
+                                   MSG_NOSIGNAL);
+                if (n <= 0) {
+                    return;
+                }
+                sent += n;
+            }
+        }
+    }
+
+    void accept_loop() {
+        while (m_running) {
+            int fd = ::accept(m_listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                continue;
+            }
+            std::lock_guard<std::mutex> guard(m_connections_mutex);
+            m_connection_fds.push_back(fd);
+            m_connection_threads.emplace_back([this, fd] { serve(fd); });
+        }
+    }
+
+public:
+    explicit loopback_server(std::size_t body_size)
+        : m_listen_fd(::socket(AF_INET, SOCK_STREAM, 0)), m_running(true) {
+        if (m_listen_fd < 0) {
+            throw std::runtime_error(std::strerror(errno));
+        }
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t addr_len = sizeof(addr);
+        if (::bind(m_listen_fd, reinterpret_cast<sockaddr*>(&addr), addr_len) ||
+            ::listen(m_listen_fd, 64) ||
+            ::getsockname(m_listen_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len)) {
+            ::close(m_listen_fd);
+            throw std::runtime_error(std::strerror(errno));
+        }
+        m_port = ntohs(addr.sin_port);
+
+        m_response = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body_size) +
+                     "\r\n\r\n" + std::string(body_size, 'X');
+
+        m_accept_thread = std::thread([this] { accept_loop(); });
+    }
+
+    loopback_server(const loopback_server&) = delete;
+    loopback_server& operator=(const loopback_server&) = delete;
+
+    ~loopback_server() {
+        m_running = false;
+        ::shutdown(m_listen_fd, SHUT_RDWR);
+        m_accept_thread.join();
+        ::close(m_listen_fd);
+
+        for (int fd : m_connection_fds) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+        for (auto& thread : m_connection_threads) {
+            thread.join();
+        }
+        for (int fd : m_connection_fds) {
+            ::close(fd);
+        }
+    }
+
+    /** The `host:port` address to send requests to.
+     */
+    std::string address() const {
+        return "127.0.0.1:" + std::to_string(m_port);
+    }
+};
+}  // namespace h5s3::testing
@@ -1,6 +1,18 @@
 import h5py
 
-from ._h5s3 import set_fapl as _set_fapl
+from h5py._hl import selections as _selections
+
+from ._h5s3 import (
+    prefetch as _prefetch,
+    refresh as _refresh,
+    resize_cache as _resize_cache,
+    set_fapl as _set_fapl,
+    set_page_cache_bytes as _set_page_cache_bytes,
+    set_shared_cache_bytes as _set_shared_cache_bytes,
+    shared_cache_bytes as _shared_cache_bytes,
+    stats as _stats,
+    watch_memory_pressure as _watch_memory_pressure,
+)
 
 
 def set_fapl(plist,
@@ -10,7 +22,14 @@ def set_fapl(plist,
              page_size=0,
              page_cache_size=0,
              host='s3.amazonaws.com',
-             use_tls=True):
+             use_tls=True,
+             pages_per_object=0,
+             page_cache_bytes=0,
+             key_prefixes=0,
+             buckets=None,
+             endpoints=None,
+             content_addressed=False,
+             log_structured=False):
 
     """Set the fapl for the h5s3 driver.
 
@@ -25,11 +44,46 @@ def set_fapl(plist,
     page_size : int, optional
         The size of a data page.
     page_cache_size : int, optional
-        The number of pages to cache in memory.
+        The number of pages to cache in memory. Pass 0 to use
+        ``page_cache_bytes`` instead.
     host : str, optional
         The host for the aws API to ues.
     use_tls : bool, optional
         Connect to the aws API with TLS.
+    pages_per_object : int, optional
+        The number of consecutive pages to store in each s3 object. Pass 0
+        for the default of 1 or to read the value out of an existing file.
+        Storing many small pages per object keeps the cache granularity fine
+        while reading adjacent pages with a single request.
+    page_cache_bytes : int, optional
+        The memory budget of the page cache in bytes, used when
+        ``page_cache_size`` is 0. Pass 0 for the default, which is the
+        ``H5S3_PAGE_CACHE_BYTES`` environment variable if it is set, or a
+        quarter of the container's cgroup memory limit, capped at 4GB.
+    key_prefixes : int, optional
+        The number of hashed key prefixes to spread the s3 objects over, so
+        that requests are not limited by the request rate of a single
+        prefix. Pass 0 to store every object under the file's path or to
+        read the value out of an existing file.
+    buckets : list[str], optional
+        The buckets to spread the s3 objects over. The file's ``.meta``
+        object is always stored in the bucket of the url. Pass None to use
+        the url's bucket or to read the value out of an existing file.
+    endpoints : list[str] or 'dns', optional
+        The addresses, ``address[:port]``, to spread the requests to ``host``
+        over, or ``'dns'`` to use every address ``host`` resolves to. Each
+        request goes to the healthy address with the fewest outstanding
+        requests. The addresses are shared by every file using ``host``.
+    content_addressed : bool, optional
+        Name each s3 object by the sha256 of its contents, so that objects
+        shared by many files or versions of a file are uploaded and stored
+        once. Only needs to be passed when creating a file; the value is
+        read out of an existing file.
+    log_structured : bool, optional
+        Append the bytes of each flush which changed to a few log objects,
+        instead of rewriting the s3 object of every dirty page. The log is
+        folded back into the pages' objects once it grows large. A file
+        stays log-structured once it has been written this way.
 
     Notes
     -----
@@ -42,6 +96,31 @@ def set_fapl(plist,
     if page_cache_size < 0:
         raise ValueError('page_cache_size must be >= 0: %s' % page_cache_size)
 
+    if pages_per_object < 0:
+        raise ValueError(
+            'pages_per_object must be >= 0: %s' % pages_per_object,
+        )
+
+    if page_cache_bytes < 0:
+        raise ValueError(
+            'page_cache_bytes must be >= 0: %s' % page_cache_bytes,
+        )
+
+    if key_prefixes < 0:
+        raise ValueError('key_prefixes must be >= 0: %s' % key_prefixes)
+
+    if buckets is not None:
+        buckets = list(buckets)
+        if not buckets or any(not b or ',' in b for b in buckets):
+            raise ValueError('invalid bucket list: %r' % (buckets,))
+        buckets = ','.join(buckets)
+
+    if endpoints is not None and endpoints != 'dns':
+        endpoints = list(endpoints)
+        if not endpoints or any(not e or ',' in e for e in endpoints):
+            raise ValueError('invalid endpoint list: %r' % (endpoints,))
+        endpoints = ','.join(endpoints)
+
     _set_fapl(
         plist.id,
         page_size,
@@ -51,7 +130,204 @@ def set_fapl(plist,
         aws_region,
         host,
         use_tls,
+        pages_per_object,
+        key_prefixes,
+        buckets,
+        endpoints,
+        bool(content_addressed),
+        bool(log_structured),
     )
+    if page_cache_bytes:
+        _set_page_cache_bytes(plist.id, page_cache_bytes)
+
+
+def stats(file):
+    """Read the runtime statistics for a file opened with the h5s3 driver.
+
+    Parameters
+    ----------
+    file : h5py.File
+        The open file.
+
+    Returns
+    -------
+    stats : dict
+        A dict with the following keys:
+
+        hits, misses : int
+            The page cache hits and misses.
+        evictions : int
+            The number of pages evicted from the page cache.
+        writebacks : int
+            The number of dirty pages written back to s3.
+        unchanged_writebacks : int
+            The number of dirty pages which were not written back because
+            their bytes had not changed.
+        prefetches : int
+            The number of pages loaded by :func:`h5s3.prefetch`.
+        gets, puts : int
+            The number of GET and PUT requests made to s3.
+        bytes_read, bytes_written : int
+            The number of bytes moved to and from s3.
+        not_found : int
+            The number of GET requests which returned 404.
+        not_modified : int
+            The number of conditional GET requests made by
+            :func:`h5s3.refresh` which found the page unchanged.
+        get_latency, put_latency : dict
+            Latency histograms for the requests. Each has the keys
+            ``count``, ``sum_ns``, ``p50_ns``, ``p99_ns``, ``max_ns``, and
+            ``buckets``, a list of ``(lower_bound_ns, count)`` pairs.
+
+    Notes
+    -----
+    Statistics are kept per open file and reset when the file is closed.
+    """
+    return _stats(file.id.id)
+
+
+def prefetch(dataset, selection=Ellipsis):
+    """Load the pages which hold a selection of a dataset into the page
+    cache before reading it.
+
+    The chunks which intersect the selection are found in the dataset's chunk
+    index and fetched from s3 in parallel, so reading a scattered selection
+    afterwards does not pay one round trip per chunk.
+
+    Parameters
+    ----------
+    dataset : h5py.Dataset
+        A dataset in a file opened with the h5s3 driver.
+    selection : index, optional
+        The selection that will be read, using the same indexing as
+        ``dataset[selection]``. Defaults to the whole dataset.
+
+    Returns
+    -------
+    loaded : int
+        The number of pages loaded. Pages which were already cached are not
+        counted, and at most ``page_cache_size`` pages are loaded.
+
+    Examples
+    --------
+    >>> h5s3.prefetch(dataset, np.s_[::10, 100:200])
+    >>> data = dataset[::10, 100:200]
+    """
+    if not isinstance(selection, tuple):
+        selection = (selection,)
+    space = _selections.select(dataset.shape, selection, dataset)
+    return _prefetch(dataset.id.id, space.id.id)
+
+
+def refresh(file):
+    """Pick up changes which another writer made to a file without closing
+    it.
+
+    Every page in the page cache is revalidated with a conditional GET. Pages
+    which have not changed cost a request with no body, and only the pages
+    which changed are read again.
+
+    Parameters
+    ----------
+    file : h5py.File
+        A file opened with the h5s3 driver. The file must not have unflushed
+        writes.
+
+    Returns
+    -------
+    reloaded : int
+        The number of cached pages which changed.
+
+    Notes
+    -----
+    hdf5 keeps its own cache of object metadata and chunks. Call
+    :meth:`h5py.Dataset.refresh` on datasets which may have changed after
+    refreshing the file.
+
+    Examples
+    --------
+    >>> h5s3.refresh(file)
+    >>> file['dataset'].refresh()
+    >>> data = file['dataset'][:]
+    """
+    return _refresh(file.id.id)
+
+
+def resize_cache(file, page_cache_bytes):
+    """Change the memory budget of the page cache of an open file.
+
+    Parameters
+    ----------
+    file : h5py.File
+        A file opened with the h5s3 driver.
+    page_cache_bytes : int
+        The new budget in bytes. If the cache holds more than this, the least
+        recently used pages are evicted, dirty pages are written back to s3,
+        and their memory is returned to the system. At least one page is
+        always cached.
+    """
+    if page_cache_bytes < 0:
+        raise ValueError(
+            'page_cache_bytes must be >= 0: %s' % page_cache_bytes,
+        )
+    _resize_cache(file.id.id, page_cache_bytes)
+
+
+def watch_memory_pressure(stall_ms=150, window_ms=2000):
+    """Shrink page caches when the system or container is under memory
+    pressure.
+
+    A pressure stall information (PSI) trigger is registered, and each time
+    it fires every open file drops up to half of its cached pages, keeping the
+    ones with unwritten changes. The watch lasts until the process exits.
+
+    Parameters
+    ----------
+    stall_ms : int, optional
+        The time that tasks must be stalled waiting for memory within one
+        window for the trigger to fire.
+    window_ms : int, optional
+        The length of the window.
+
+    Returns
+    -------
+    watching : bool
+        False if the kernel does not support pressure triggers or they could
+        not be opened.
+    """
+    return _watch_memory_pressure(stall_ms * 1000, window_ms * 1000)
+
+
+def set_shared_cache_bytes(budget):
+    """Share one page cache budget across every file opened afterwards.
+
+    When a file needs memory for a page and the budget is spent, the coldest
+    page of any open file is evicted: pages which have only been read once go
+    first, then the least recently used. Files opened read-only with the same
+    url also share their cached pages. The budget starts as the value of the
+    ``H5S3_SHARED_CACHE_BYTES`` environment variable.
+
+    Parameters
+    ----------
+    budget : int
+        The budget in bytes for all files together. Pass 0 to give each file
+        opened afterwards its own budget again.
+    """
+    if budget < 0:
+        raise ValueError('budget must be >= 0: %s' % budget)
+    _set_shared_cache_bytes(budget)
+
+
+def shared_cache_bytes():
+    """The bytes of page memory held by the files which share a budget.
+
+    Returns
+    -------
+    cached_bytes : int
+        The bytes cached across the files opened while a shared budget was
+        set.
+    """
+    return _shared_cache_bytes()
 
 
 def register():
@@ -1,8 +1,24 @@
 #include <Python.h>
 
+#include <set>
+#include <string>
+
 #include "h5s3/private/s3_driver.h"
 
 namespace {
+/** Keep a string alive for the life of the process. The file access property
+    list only holds a pointer to each string parameter, and the lists of
+    buckets and endpoints are built by `h5s3.set_fapl`, so nothing else owns
+    them.
+ */
+const char* intern(const char* s) {
+    if (!s) {
+        return nullptr;
+    }
+    static std::set<std::string> strings;
+    return strings.emplace(s).first->c_str();
+}
+
 PyObject* set_fapl(PyObject*, PyObject* args) {
     PyObject* id_ob;
     PyObject* page_size_ob;
@@ -12,9 +28,15 @@ PyObject* set_fapl(PyObject*, PyObject* args) {
     const char* region;
     const char* host;
     int use_tls;
+    PyObject* pages_per_object_ob;
+    PyObject* key_prefixes_ob;
+    const char* buckets;
+    const char* endpoints;
+    int content_addressed;
+    int log_structured;
 
     if (!PyArg_ParseTuple(args,
-                          "O!O!O!ssssp:set_fapl",
+                          "O!O!O!sssspO!O!zzpp:set_fapl",
                           &PyLong_Type,
                           &id_ob,
                           &PyLong_Type,
@@ -25,7 +47,15 @@ PyObject* set_fapl(PyObject*, PyObject* args) {
                           &secret_key,
                           &region,
                           &host,
-                          &use_tls)) {
+                          &use_tls,
+                          &PyLong_Type,
+                          &pages_per_object_ob,
+                          &PyLong_Type,
+                          &key_prefixes_ob,
+                          &buckets,
+                          &endpoints,
+                          &content_addressed,
+                          &log_structured)) {
         return nullptr;
     }
 
@@ -44,6 +74,16 @@ PyObject* set_fapl(PyObject*, PyObject* args) {
         return nullptr;
     }
 
+    std::size_t pages_per_object = PyLong_AsSize_t(pages_per_object_ob);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
+    std::size_t key_prefixes = PyLong_AsSize_t(key_prefixes_ob);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
     using driver = h5s3::s3_driver::s3_driver;
     if (driver::set_fapl(id,
                          page_size,
@@ -52,7 +92,13 @@ PyObject* set_fapl(PyObject*, PyObject* args) {
                          secret_key,
                          region,
                          host,
-                         use_tls)) {
+                         use_tls,
+                         pages_per_object,
+                         key_prefixes,
+                         intern(buckets),
+                         intern(endpoints),
+                         static_cast<bool>(content_addressed),
+                         static_cast<bool>(log_structured))) {
         PyErr_SetString(PyExc_ValueError, "failed to set the driver");
         return nullptr;
     }
@@ -60,8 +106,239 @@ PyObject* set_fapl(PyObject*, PyObject* args) {
     Py_RETURN_NONE;
 }
 
+PyObject* set_page_cache_bytes(PyObject*, PyObject* args) {
+    PyObject* id_ob;
+    PyObject* bytes_ob;
+
+    if (!PyArg_ParseTuple(args,
+                          "O!O!:set_page_cache_bytes",
+                          &PyLong_Type,
+                          &id_ob,
+                          &PyLong_Type,
+                          &bytes_ob)) {
+        return nullptr;
+    }
+
+    hid_t id = PyLong_AsLong(id_ob);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
+    std::size_t bytes = PyLong_AsSize_t(bytes_ob);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
+    if (h5s3::s3_driver::s3_driver::set_page_cache_bytes(id, bytes)) {
+        PyErr_SetString(PyExc_ValueError, "failed to set the page cache budget");
+        return nullptr;
+    }
+
+    Py_RETURN_NONE;
+}
+
+/** Convert a latency histogram into a Python dict.
+ */
+PyObject* histogram_to_dict(const h5s3::stats::histogram::snapshot& h) {
+    auto buckets = h.buckets();
+    PyObject* buckets_ob = PyList_New(buckets.size());
+    if (!buckets_ob) {
+        return nullptr;
+    }
+    for (std::size_t ix = 0; ix < buckets.size(); ++ix) {
+        auto [lower_bound, count] = buckets[ix];
+        PyObject* bucket = Py_BuildValue("(KK)", lower_bound, count);
+        if (!bucket) {
+            Py_DECREF(buckets_ob);
+            return nullptr;
+        }
+        PyList_SET_ITEM(buckets_ob, ix, bucket);
+    }
+
+    return Py_BuildValue("{sKsKsKsKsKsN}",
+                         "count",
+                         h.count(),
+                         "sum_ns",
+                         h.sum(),
+                         "p50_ns",
+                         h.percentile(0.5),
+                         "p99_ns",
+                         h.percentile(0.99),
+                         "max_ns",
+                         h.percentile(1),
+                         "buckets",
+                         buckets_ob);
+}
+
+PyObject* stats(PyObject*, PyObject* id_ob) {
+    hid_t id = PyLong_AsLong(id_ob);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
+    h5s3::stats::snapshot s;
+    if (h5s3::s3_driver::s3_driver::stats(id, s)) {
+        PyErr_SetString(PyExc_ValueError, "file does not use the h5s3 driver");
+        return nullptr;
+    }
+
+    PyObject* get_latency = histogram_to_dict(s.get_latency);
+    if (!get_latency) {
+        return nullptr;
+    }
+    PyObject* put_latency = histogram_to_dict(s.put_latency);
+    if (!put_latency) {
+        Py_DECREF(get_latency);
+        return nullptr;
+    }
+
+    return Py_BuildValue("{sKsKsKsKsKsKsKsKsKsKsKsKsNsN}",
+                         "hits",
+                         s.hits,
+                         "misses",
+                         s.misses,
+                         "evictions",
+                         s.evictions,
+                         "writebacks",
+                         s.writebacks,
+                         "unchanged_writebacks",
+                         s.unchanged_writebacks,
+                         "prefetches",
+                         s.prefetches,
+                         "gets",
+                         s.gets,
+                         "puts",
+                         s.puts,
+                         "bytes_read",
+                         s.bytes_read,
+                         "bytes_written",
+                         s.bytes_written,
+                         "not_found",
+                         s.not_found,
+                         "not_modified",
+                         s.not_modified,
+                         "get_latency",
+                         get_latency,
+                         "put_latency",
+                         put_latency);
+}
+
+PyObject* prefetch(PyObject*, PyObject* args) {
+    PyObject* dataset_id_ob;
+    PyObject* space_id_ob;
+
+    if (!PyArg_ParseTuple(args,
+                          "O!O!:prefetch",
+                          &PyLong_Type,
+                          &dataset_id_ob,
+                          &PyLong_Type,
+                          &space_id_ob)) {
+        return nullptr;
+    }
+
+    hid_t dataset_id = PyLong_AsLong(dataset_id_ob);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
+    hid_t space_id = PyLong_AsLong(space_id_ob);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
+    std::size_t loaded;
+    if (h5s3::s3_driver::s3_driver::prefetch(dataset_id, space_id, &loaded)) {
+        PyErr_SetString(PyExc_ValueError, "failed to prefetch the selection");
+        return nullptr;
+    }
+
+    return PyLong_FromSize_t(loaded);
+}
+
+PyObject* refresh(PyObject*, PyObject* id_ob) {
+    hid_t id = PyLong_AsLong(id_ob);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
+    std::size_t reloaded;
+    if (h5s3::s3_driver::s3_driver::refresh(id, &reloaded)) {
+        PyErr_SetString(PyExc_ValueError, "failed to refresh the file");
+        return nullptr;
+    }
+
+    return PyLong_FromSize_t(reloaded);
+}
+
+PyObject* resize_cache(PyObject*, PyObject* args) {
+    PyObject* id_ob;
+    PyObject* bytes_ob;
+
+    if (!PyArg_ParseTuple(args,
+                          "O!O!:resize_cache",
+                          &PyLong_Type,
+                          &id_ob,
+                          &PyLong_Type,
+                          &bytes_ob)) {
+        return nullptr;
+    }
+
+    hid_t id = PyLong_AsLong(id_ob);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
+    std::size_t bytes = PyLong_AsSize_t(bytes_ob);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
+    if (h5s3::s3_driver::s3_driver::resize_cache(id, bytes)) {
+        PyErr_SetString(PyExc_ValueError, "failed to resize the page cache");
+        return nullptr;
+    }
+
+    Py_RETURN_NONE;
+}
+
+PyObject* watch_memory_pressure(PyObject*, PyObject* args) {
+    unsigned long long stall_us;
+    unsigned long long window_us;
+
+    if (!PyArg_ParseTuple(args, "KK:watch_memory_pressure", &stall_us, &window_us)) {
+        return nullptr;
+    }
+
+    return PyBool_FromLong(h5s3::memory::watch_pressure(stall_us, window_us));
+}
+
+PyObject* set_shared_cache_bytes(PyObject*, PyObject* bytes_ob) {
+    std::size_t bytes = PyLong_AsSize_t(bytes_ob);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
+    h5s3::page::cache_manager::global().budget(bytes);
+    Py_RETURN_NONE;
+}
+
+PyObject* shared_cache_bytes(PyObject*, PyObject*) {
+    return PyLong_FromSize_t(h5s3::page::cache_manager::global().cached_bytes());
+}
+
 PyMethodDef module_methods[] = {
     {"set_fapl", (PyCFunction) set_fapl, METH_VARARGS, nullptr},
+    {"set_page_cache_bytes", (PyCFunction) set_page_cache_bytes, METH_VARARGS, nullptr},
+    {"stats", (PyCFunction) stats, METH_O, nullptr},
+    {"prefetch", (PyCFunction) prefetch, METH_VARARGS, nullptr},
+    {"refresh", (PyCFunction) refresh, METH_O, nullptr},
+    {"resize_cache", (PyCFunction) resize_cache, METH_VARARGS, nullptr},
+    {"set_shared_cache_bytes", (PyCFunction) set_shared_cache_bytes, METH_O, nullptr},
+    {"shared_cache_bytes", (PyCFunction) shared_cache_bytes, METH_NOARGS, nullptr},
+    {"watch_memory_pressure",
+     (PyCFunction) watch_memory_pressure,
+     METH_VARARGS,
+     nullptr},
     {nullptr, nullptr, 0, nullptr},
 };
 
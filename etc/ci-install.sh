@@ -7,6 +7,21 @@ elif [ -n "$CLANG" ];then
     export CXX="clang++" CC="clang"
 fi
 
+if [ -n "$HDF5_VERSION" ];then
+    HDF5_PREFIX="$HOME/hdf5-$HDF5_VERSION"
+    if [ ! -d "$HDF5_PREFIX" ];then
+        HDF5_MINOR="${HDF5_VERSION%.*}"
+        curl -sSL "https://support.hdfgroup.org/ftp/HDF5/releases/hdf5-$HDF5_MINOR/hdf5-$HDF5_VERSION/src/hdf5-$HDF5_VERSION.tar.gz" | tar xz
+        (cd "hdf5-$HDF5_VERSION" &&
+             ./configure --prefix="$HDF5_PREFIX" --disable-fortran --disable-tests &&
+             make -j8 install)
+    fi
+    export HDF5_DIR="$HDF5_PREFIX"
+    export HDF5_INCLUDE_PATH="$HDF5_PREFIX/include"
+    export HDF5_LIBRARY_PATH="$HDF5_PREFIX/lib"
+    export LD_LIBRARY_PATH="$HDF5_PREFIX/lib:$LD_LIBRARY_PATH"
+fi
+
 ${PYTHON} -m venv venv
 source venv/bin/activate
 ${PYTHON} -m pip install git+https://github.com/h5s3/h5py.git
@@ -1,16 +1,40 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
 #include <limits>
+#include <memory>
+#include <string>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
+#include <unistd.h>
+
+#include "H5public.h"
+
+#include "H5Dpublic.h"
 #include "H5Epublic.h"
 #include "H5FDpublic.h"
+#if H5_VERSION_GE(1, 13, 0)
+#include "H5FDdevelop.h"
+#endif
+#include "H5Fpublic.h"
 #include "H5Ipublic.h"
 #include "H5Ppublic.h"
+#include "H5Spublic.h"
+#include "H5Tpublic.h"
 
+#include "h5s3/private/cache_manager.h"
 #include "h5s3/private/error.h"
+#include "h5s3/private/memory.h"
 #include "h5s3/private/out_buffer.h"
 #include "h5s3/private/page.h"
+#include "h5s3/private/stats.h"
+#include "h5s3/private/trace.h"
 #include "h5s3/private/utils.h"
 
 namespace h5s3::driver {
@@ -28,6 +52,8 @@ struct inner_kv_store_params<
     struct type {
         std::size_t page_size;
         std::size_t page_cache_size;
+        // the page cache budget in bytes, used when `page_cache_size` is 0
+        std::size_t page_cache_bytes = 0;
         std::tuple<std::remove_cv_t<std::remove_reference_t<Args>>...> extra;
 
         type(std::size_t page_size, std::size_t page_cache_size, Args... extra)
@@ -38,6 +64,149 @@ struct inner_kv_store_params<
 template<typename kv_store>
 using kv_store_params =
     typename inner_kv_store_params<decltype(kv_store::from_params)>::type;
+
+/** Closes an hdf5 id when it goes out of scope.
+ */
+class owned_id {
+private:
+    hid_t m_id;
+    herr_t (*m_close)(hid_t);
+
+public:
+    owned_id(hid_t id, herr_t (*close)(hid_t)) : m_id(id), m_close(close) {
+        if (m_id < 0) {
+            throw std::runtime_error("hdf5 call failed");
+        }
+    }
+
+    owned_id(const owned_id&) = delete;
+
+    ~owned_id() {
+        m_close(m_id);
+    }
+
+    hid_t get() const {
+        return m_id;
+    }
+};
+
+/** Find the extents of a dataset's storage which hold a selection.
+
+    @param dataset_id The dataset.
+    @param file_space_id The selection in the dataset's dataspace, or
+           `H5S_ALL` for the whole dataset.
+    @param max_extents Stop after this many extents have been found.
+    @return The `(address, size)` of each chunk which intersects the
+            selection, or of the span of a contiguous dataset which holds it.
+            Chunks which have not been allocated are skipped.
+ */
+inline std::vector<std::pair<haddr_t, hsize_t>>
+selected_extents(hid_t dataset_id, hid_t file_space_id, std::size_t max_extents) {
+    std::vector<std::pair<haddr_t, hsize_t>> out;
+
+    owned_id space(file_space_id == H5S_ALL ? H5Dget_space(dataset_id)
+                                            : H5Scopy(file_space_id),
+                   H5Sclose);
+    if (H5Sget_select_npoints(space.get()) <= 0) {
+        return out;
+    }
+
+    int rank = H5Sget_simple_extent_ndims(space.get());
+    if (rank < 0) {
+        throw std::runtime_error("failed to get the rank of the dataspace");
+    }
+    std::vector<hsize_t> dims(rank);
+    std::vector<hsize_t> start(rank);
+    std::vector<hsize_t> end(rank);
+    if (H5Sget_simple_extent_dims(space.get(), dims.data(), nullptr) < 0 ||
+        H5Sget_select_bounds(space.get(), start.data(), end.data()) < 0) {
+        throw std::runtime_error("failed to get the bounds of the selection");
+    }
+
+    owned_id dcpl(H5Dget_create_plist(dataset_id), H5Pclose);
+    H5D_layout_t layout = H5Pget_layout(dcpl.get());
+
+    if (layout == H5D_CONTIGUOUS) {
+        haddr_t addr = H5Dget_offset(dataset_id);
+        if (addr == HADDR_UNDEF) {
+            return out;
+        }
+        owned_id type(H5Dget_type(dataset_id), H5Tclose);
+        std::size_t element_size = H5Tget_size(type.get());
+
+        // the row-major span from the first to the last selected element
+        hsize_t first = 0;
+        hsize_t last = 0;
+        for (int ix = 0; ix < rank; ++ix) {
+            first = first * dims[ix] + start[ix];
+            last = last * dims[ix] + end[ix];
+        }
+        out.emplace_back(addr + first * element_size,
+                         (last - first + 1) * element_size);
+        return out;
+    }
+    if (layout != H5D_CHUNKED) {
+        // compact data lives in the object header
+        return out;
+    }
+
+#if H5_VERSION_GE(1, 10, 5)
+    std::vector<hsize_t> chunk(rank);
+    if (H5Pget_chunk(dcpl.get(), rank, chunk.data()) != rank) {
+        throw std::runtime_error("failed to get the chunk shape");
+    }
+
+    // walk the chunks in the bounding box of the selection
+    std::vector<hsize_t> offset(rank);
+    std::vector<hsize_t> block_end(rank);
+    for (int ix = 0; ix < rank; ++ix) {
+        offset[ix] = start[ix] / chunk[ix] * chunk[ix];
+    }
+    while (out.size() < max_extents) {
+        for (int ix = 0; ix < rank; ++ix) {
+            block_end[ix] = std::min(offset[ix] + chunk[ix], dims[ix]) - 1;
+        }
+
+        bool selected = true;
+#if H5_VERSION_GE(1, 10, 7)
+        htri_t intersects =
+            H5Sselect_intersect_block(space.get(), offset.data(), block_end.data());
+        if (intersects < 0) {
+            throw std::runtime_error("failed to intersect the selection");
+        }
+        selected = intersects;
+#endif
+        if (selected) {
+            unsigned int filter_mask;
+            haddr_t addr;
+            hsize_t size;
+            if (H5Dget_chunk_info_by_coord(
+                    dataset_id, offset.data(), &filter_mask, &addr, &size) < 0) {
+                throw std::runtime_error("failed to get chunk info");
+            }
+            if (addr != HADDR_UNDEF) {
+                out.emplace_back(addr, size);
+            }
+        }
+
+        // advance to the next chunk, last dimension fastest
+        int ix = rank - 1;
+        for (; ix >= 0; --ix) {
+            offset[ix] += chunk[ix];
+            if (offset[ix] <= end[ix]) {
+                break;
+            }
+            offset[ix] = start[ix] / chunk[ix] * chunk[ix];
+        }
+        if (ix < 0) {
+            break;
+        }
+    }
+#else
+    throw std::runtime_error("prefetching chunked datasets requires hdf5 >= 1.10.5");
+#endif
+    return out;
+}
 }  // namespace detail
 
 /** Key-value driver for hdf5.
@@ -59,16 +228,21 @@ private:
     /** The hdf5 file information. This must be the first member.
      */
     H5FD_t m_public;
-    page_table m_page_table;
+    // read-only opens of the same data may share a page table
+    std::shared_ptr<page_table> m_page_table;
     haddr_t m_eoa;
 
-    kv_driver(page_table&& table) : m_page_table(std::move(table)), m_eoa(0) {}
+    kv_driver(std::shared_ptr<page_table>&& table)
+        : m_page_table(std::move(table)), m_eoa(0) {}
 
     /** Initialize the driver's hdf5 class. This function is idempotent.
 
         @return The hdf5 driver class id.
      */
     static hid_t initialize() {
+#if H5_VERSION_GE(1, 13, 0)
+        m_class.version = H5FD_CLASS_VERSION;
+#endif
         m_class.name = kv_store::name;
         m_class.maxaddr = std::numeric_limits<std::size_t>::max() - 1;
         m_class.fc_degree = H5F_CLOSE_WEAK;
@@ -85,6 +259,11 @@ private:
         m_class.write = write;
         m_class.flush = flush;
         m_class.truncate = truncate;
+        m_class.get_handle = get_handle;
+#if H5_VERSION_GE(1, 14, 0)
+        m_class.read_vector = read_vector;
+        m_class.write_vector = write_vector;
+#endif
 
         H5FD_mem_t fl_map[] = H5FD_FLMAP_SINGLE;
         std::memcpy(m_class.fl_map, fl_map, sizeof(fl_map) / sizeof(H5FD_mem_t));
@@ -92,6 +271,59 @@ private:
         return H5FDregister(&m_class);
     }
 
+    /** Start tracing page accesses for a newly opened file if the
+        `H5S3_TRACE_DIR` environment variable is set.
+
+        The trace is written to `$H5S3_TRACE_DIR/<name>.<pid>.<n>.trace` where
+        `name` is the file name with '/' replaced by '_' and `n` counts the
+        files opened by this process.
+
+        @param table The page table of the file being opened.
+        @param name The name passed to H5Fcreate or H5Fopen.
+     */
+    static void maybe_trace(page_table& table, const char* name) {
+        const char* trace_dir = std::getenv("H5S3_TRACE_DIR");
+        if (!trace_dir || !*trace_dir) {
+            return;
+        }
+
+        static std::atomic<std::size_t> trace_count(0);
+
+        std::string leaf(name);
+        for (char& c : leaf) {
+            if (c == '/' || c == ':') {
+                c = '_';
+            }
+        }
+
+        std::stringstream path;
+        path << trace_dir << '/' << leaf << '.' << getpid() << '.' << trace_count++
+             << ".trace";
+        table.trace(
+            std::make_unique<trace::writer>(path.str(), table.store().page_size()));
+    }
+
+    /** Start counting metadata page accesses so that the hot set can be
+        recorded when the file is flushed, and fetch the hot set recorded the
+        last time the file was written.
+
+        @param table The page table of the file being opened.
+     */
+    static void warm_start(page_table& table) {
+        if constexpr (page::has_hot_pages_v<kv_store>) {
+            table.track_hot_pages(1u << H5FD_MEM_SUPER | 1u << H5FD_MEM_BTREE |
+                                  1u << H5FD_MEM_GHEAP | 1u << H5FD_MEM_LHEAP |
+                                  1u << H5FD_MEM_OHDR);
+            try {
+                table.prefetch(table.store().hot_pages());
+            }
+            catch (const std::exception&) {
+                // The warm start is only an optimization; pages which failed
+                // to load are read on demand.
+            }
+        }
+    }
+
     /** Open an hdf5 file using this driver.
 
         @param name The name passed to H5Fcreate or H5Fopen.
@@ -121,14 +353,41 @@ private:
         try {
             auto store = std::apply(kv_store::from_params, std::move(store_params));
 
+            page::cache_manager& manager = page::cache_manager::global();
+            std::size_t shared_budget = manager.budget();
+
             std::size_t page_cache_size = params->page_cache_size;
             if (page_cache_size == 0) {
-                using utils::operator""_GB;
+                std::size_t bytes = params->page_cache_bytes;
+                if (bytes == 0) {
+                    bytes = shared_budget ? shared_budget : memory::default_cache_bytes();
+                }
+                page_cache_size = std::max<std::size_t>(bytes / store.page_size(), 1);
+            }
+
+            std::shared_ptr<page_table> table;
+            bool created = true;
+            std::function<std::shared_ptr<page_table>()> make = [&] {
+                return std::make_shared<page_table>(std::move(store), page_cache_size);
+            };
+            if constexpr (page::has_cache_key_v<kv_store>) {
+                if (shared_budget && !(flags & H5F_ACC_RDWR)) {
+                    std::string key = std::string(kv_store::name) + ':' + store.cache_key();
+                    std::tie(table, created) = manager.shared<page_table>(key, make);
+                }
+            }
+            if (!table) {
+                table = make();
+            }
 
-                page_cache_size = 4_GB / store.page_size();
+            if (created) {
+                if (shared_budget) {
+                    table->attach(manager);
+                }
+                maybe_trace(*table, name);
+                warm_start(*table);
             }
-            page_table t(std::move(store), page_cache_size);
-            kv_driver* f = new kv_driver(std::move(t));
+            kv_driver* f = new kv_driver(std::move(table));
             return reinterpret_cast<H5FD_t*>(f);
         }
         catch (const std::exception& e) {
@@ -201,23 +460,28 @@ private:
     static haddr_t get_eof(const H5FD_t* file) noexcept {
 #endif
         const kv_driver& d = *reinterpret_cast<const kv_driver*>(file);
-        return std::max(d.m_eoa, d.m_page_table.eof());
+        return std::max(d.m_eoa, d.m_page_table->eof());
     }
 
     /** Read data out of an hdf5 file.
 
         @param file The file to read from.
+        @param type The kind of hdf5 data being read.
         @param addr The starting address of the read.
         @param size The size of the read
         @param buf The output buffer.
         @return zero on success, non-zero on failure.
      */
-    static herr_t
-    read(H5FD_t* file, H5FD_mem_t, hid_t, haddr_t addr, size_t size, void* buf) noexcept {
-        const auto& table = reinterpret_cast<kv_driver*>(file)->m_page_table;
+    static herr_t read(H5FD_t* file,
+                       H5FD_mem_t type,
+                       hid_t,
+                       haddr_t addr,
+                       size_t size,
+                       void* buf) noexcept {
+        const auto& table = *reinterpret_cast<kv_driver*>(file)->m_page_table;
         utils::out_buffer out{reinterpret_cast<char*>(buf), size};
         try {
-            table.read(addr, out);
+            table.read(addr, out, type);
         }
         catch (const std::exception& e) {
             error::raise(__FILE__,
@@ -235,21 +499,73 @@ private:
     /** Write data to an hdf5 file.
 
         @param file The file to write to.
+        @param type The kind of hdf5 data being written.
         @param addr The starting address of the write.
         @param size The size of the write.
         @param buf The buffer to copy from.
         @return zero on success, non-zero on failure.
     */
     static herr_t write(H5FD_t* file,
-                        H5FD_mem_t,
+                        H5FD_mem_t type,
                         hid_t,
                         haddr_t addr,
                         size_t size,
                         const void* buf) noexcept {
-        auto& table = reinterpret_cast<kv_driver*>(file)->m_page_table;
+        auto& table = *reinterpret_cast<kv_driver*>(file)->m_page_table;
         const std::string_view view(reinterpret_cast<const char*>(buf), size);
         try {
-            table.write(addr, view);
+            table.write(addr, view, type);
+        }
+        catch (const std::exception& e) {
+            error::raise(__FILE__,
+                         __PRETTY_FUNCTION__,
+                         __LINE__,
+                         H5E_IO,
+                         H5E_READERROR,
+                         e.what());
+            return -1;
+        }
+
+        return 0;
+    }
+
+#if H5_VERSION_GE(1, 14, 0)
+    /** Read many ranges out of an hdf5 file at once.
+
+        Every page touched by the reads is fetched in parallel through
+        `page::table::read_vector`. Selection I/O is not implemented; hdf5
+        translates selection reads into calls to this.
+
+        @param file The file to read from.
+        @param count The number of reads.
+        @param types The kind of hdf5 data being read by each read.
+        @param addrs The starting address of each read.
+        @param sizes The size of each read.
+        @param bufs The output buffer of each read.
+        @return zero on success, non-zero on failure.
+     */
+    static herr_t read_vector(H5FD_t* file,
+                              hid_t,
+                              std::uint32_t count,
+                              H5FD_mem_t types[],
+                              haddr_t addrs[],
+                              size_t sizes[],
+                              void* bufs[]) noexcept {
+        const auto& table = *reinterpret_cast<kv_driver*>(file)->m_page_table;
+        try {
+            auto reads = page::expand_vector<page::vector_read>(
+                count,
+                types,
+                H5FD_MEM_NOLIST,
+                addrs,
+                sizes,
+                bufs,
+                [](haddr_t addr, std::size_t size, void* buf, H5FD_mem_t type) {
+                    return page::vector_read{addr,
+                                             {reinterpret_cast<char*>(buf), size},
+                                             static_cast<std::uint8_t>(type)};
+                });
+            table.read_vector(reads);
         }
         catch (const std::exception& e) {
             error::raise(__FILE__,
@@ -264,6 +580,54 @@ private:
         return 0;
     }
 
+    /** Write many ranges to an hdf5 file at once.
+
+        @param file The file to write to.
+        @param count The number of writes.
+        @param types The kind of hdf5 data being written by each write.
+        @param addrs The starting address of each write.
+        @param sizes The size of each write.
+        @param bufs The buffer to copy from for each write.
+        @return zero on success, non-zero on failure.
+     */
+    static herr_t write_vector(H5FD_t* file,
+                               hid_t,
+                               std::uint32_t count,
+                               H5FD_mem_t types[],
+                               haddr_t addrs[],
+                               size_t sizes[],
+                               const void* bufs[]) noexcept {
+        auto& table = *reinterpret_cast<kv_driver*>(file)->m_page_table;
+        try {
+            auto writes = page::expand_vector<page::vector_write>(
+                count,
+                types,
+                H5FD_MEM_NOLIST,
+                addrs,
+                sizes,
+                bufs,
+                [](haddr_t addr, std::size_t size, const void* buf, H5FD_mem_t type) {
+                    return page::vector_write{
+                        addr,
+                        std::string_view(reinterpret_cast<const char*>(buf), size),
+                        static_cast<std::uint8_t>(type)};
+                });
+            table.write_vector(writes);
+        }
+        catch (const std::exception& e) {
+            error::raise(__FILE__,
+                         __PRETTY_FUNCTION__,
+                         __LINE__,
+                         H5E_IO,
+                         H5E_WRITEERROR,
+                         e.what());
+            return -1;
+        }
+
+        return 0;
+    }
+#endif
+
     /** Flush data to an hdf5 file.
 
         @param file The file to flush.
@@ -276,7 +640,7 @@ private:
 #endif
     {
         try {
-            reinterpret_cast<kv_driver*>(file)->m_page_table.flush();
+            reinterpret_cast<kv_driver*>(file)->m_page_table->flush();
         }
         catch (const std::exception& e) {
             error::raise(__FILE__,
@@ -298,7 +662,7 @@ private:
     static herr_t truncate(H5FD_t* file, hid_t, hbool_t) noexcept {
         kv_driver& d = *reinterpret_cast<kv_driver*>(file);
         try {
-            d.m_page_table.truncate(d.m_eoa);
+            d.m_page_table->truncate(d.m_eoa);
         }
         catch (const std::exception& e) {
             error::raise(__FILE__,
@@ -313,7 +677,207 @@ private:
         return 0;
     }
 
+    /** Get the driver's handle for an hdf5 file. This is the `kv_driver`
+        itself.
+
+        @param file The file to get the handle of.
+        @param file_handle The output pointer to write the handle to.
+        @return zero on success, non-zero on failure.
+     */
+    static herr_t get_handle(H5FD_t* file, hid_t, void** file_handle) noexcept {
+        *file_handle = file;
+        return 0;
+    }
+
+    /** Look up the driver for an open hdf5 file.
+
+        @param file_id The id of an open hdf5 file.
+        @return The driver, or `nullptr` if `file_id` is not a file which uses
+                this driver. If `nullptr` is returned, an hdf5 exception has
+                been raised.
+     */
+    static kv_driver* from_file_id(hid_t file_id) noexcept {
+        hid_t fapl_id = H5Fget_access_plist(file_id);
+        if (fapl_id < 0) {
+            return nullptr;
+        }
+
+        // Compare the registered class's callbacks to ours; the class is
+        // registered once per call to `set_fapl`, so the driver ids may
+        // differ.
+        auto cls = reinterpret_cast<const H5FD_class_t*>(
+            H5Iobject_verify(H5Pget_driver(fapl_id), H5I_VFL));
+        void* handle = nullptr;
+        if (nullptr == cls || cls->open != open ||
+            H5Fget_vfd_handle(file_id, fapl_id, &handle) < 0) {
+            H5Pclose(fapl_id);
+            error::raise(__FILE__,
+                         __PRETTY_FUNCTION__,
+                         __LINE__,
+                         H5E_FILE,
+                         H5E_BADVALUE,
+                         "file does not use the ",
+                         kv_store::name,
+                         " driver");
+            return nullptr;
+        }
+
+        H5Pclose(fapl_id);
+        return reinterpret_cast<kv_driver*>(handle);
+    }
+
 public:
+    /** Read the runtime statistics for an open file.
+
+        @param file_id The id of an open hdf5 file which uses this driver.
+        @param out The snapshot to write the statistics into.
+        @return 0 on success, -1 on failure.
+     */
+    static herr_t stats(hid_t file_id, stats::snapshot& out) {
+        kv_driver* d = from_file_id(file_id);
+        if (!d) {
+            return -1;
+        }
+
+        const page_table& table = *d->m_page_table;
+        out = stats::snapshot(table.stats(), table.store().stats());
+        return 0;
+    }
+
+    /** Load the pages which hold a selection of a dataset into the page
+        cache before hdf5 reads them.
+
+        The chunks which intersect the selection are looked up in the
+        dataset's chunk index and their pages are fetched in parallel, so a
+        scattered hyperslab costs one round of requests instead of one round
+        trip per chunk. At most `page_cache_size` pages are loaded.
+
+        @param dataset_id The dataset to prefetch, which must be in a file
+               opened with this driver.
+        @param file_space_id The selection in the dataset's dataspace, or
+               `H5S_ALL` for the whole dataset.
+        @param loaded If not null, the number of pages loaded is written here.
+        @return 0 on success, -1 on failure.
+     */
+    static herr_t
+    prefetch(hid_t dataset_id, hid_t file_space_id, std::size_t* loaded = nullptr) {
+        hid_t file_id = H5Iget_file_id(dataset_id);
+        if (file_id < 0) {
+            return -1;
+        }
+        kv_driver* d = from_file_id(file_id);
+        H5Fclose(file_id);
+        if (!d) {
+            return -1;
+        }
+
+        try {
+            page_table& table = *d->m_page_table;
+            std::size_t page_size = table.store().page_size();
+            std::size_t max_pages = table.page_cache_size();
+
+            std::vector<page::id> pages;
+            for (const auto& [addr, size] :
+                 detail::selected_extents(dataset_id, file_space_id, max_pages)) {
+                if (!size) {
+                    continue;
+                }
+                page::id last = (addr + size - 1) / page_size;
+                for (page::id page_id = addr / page_size;
+                     page_id <= last && pages.size() < max_pages;
+                     ++page_id) {
+                    pages.push_back(page_id);
+                }
+            }
+
+            std::size_t count = table.prefetch(std::move(pages));
+            if (loaded) {
+                *loaded = count;
+            }
+        }
+        catch (const std::exception& e) {
+            error::raise(__FILE__,
+                         __PRETTY_FUNCTION__,
+                         __LINE__,
+                         H5E_IO,
+                         H5E_READERROR,
+                         e.what());
+            return -1;
+        }
+
+        return 0;
+    }
+
+    /** Pick up changes which another writer made to an open file, without
+        closing it and discarding the page cache.
+
+        The cached pages are revalidated with the kv_store and only the pages
+        which changed are read again. hdf5 keeps its own caches of metadata
+        and chunks, so datasets which may have changed should also be
+        refreshed with `H5Drefresh` afterwards.
+
+        @param file_id The id of an open hdf5 file which uses this driver.
+        @param reloaded If not null, the number of pages which changed is
+               written here.
+        @return 0 on success, -1 on failure.
+     */
+    static herr_t refresh(hid_t file_id, std::size_t* reloaded = nullptr) {
+        kv_driver* d = from_file_id(file_id);
+        if (!d) {
+            return -1;
+        }
+
+        try {
+            std::size_t count = d->m_page_table->refresh();
+            if (reloaded) {
+                *reloaded = count;
+            }
+        }
+        catch (const std::exception& e) {
+            error::raise(__FILE__,
+                         __PRETTY_FUNCTION__,
+                         __LINE__,
+                         H5E_IO,
+                         H5E_READERROR,
+                         e.what());
+            return -1;
+        }
+
+        return 0;
+    }
+
+    /** Change the page cache budget of an open file. If the cache holds more
+        than the new budget, the least recently used pages are evicted and
+        their memory is given back to the system.
+
+        @param file_id The id of an open hdf5 file which uses this driver.
+        @param page_cache_bytes The new budget in bytes. At least one page is
+               always cached.
+        @return 0 on success, -1 on failure.
+     */
+    static herr_t resize_cache(hid_t file_id, std::size_t page_cache_bytes) {
+        kv_driver* d = from_file_id(file_id);
+        if (!d) {
+            return -1;
+        }
+
+        try {
+            page_table& table = *d->m_page_table;
+            table.resize(page_cache_bytes / table.store().page_size());
+        }
+        catch (const std::exception& e) {
+            error::raise(__FILE__,
+                         __PRETTY_FUNCTION__,
+                         __LINE__,
+                         H5E_IO,
+                         H5E_WRITEERROR,
+                         e.what());
+            return -1;
+        }
+
+        return 0;
+    }
+
     /** Set the parameters on the file access property list.
 
         @param fapl_id The id of the file access property list to modify.
@@ -340,5 +904,36 @@ public:
         // H5Pset_driver copies the params structure
         return H5Pset_driver(fapl_id, driver_id, &params);
     }
+
+    /** Set the page cache budget in bytes on a file access property list
+        which was set up with `set_fapl`. The budget is only used if
+        `page_cache_size` was 0; without one, the budget comes from
+        `memory::default_cache_bytes`.
+
+        @param fapl_id The id of the file access property list to modify.
+        @param page_cache_bytes The budget in bytes.
+        @return 0 on success, -1 on failure.
+     */
+    static herr_t set_page_cache_bytes(hid_t fapl_id, std::size_t page_cache_bytes) {
+        hid_t driver_id = H5Pget_driver(fapl_id);
+        auto cls = reinterpret_cast<const H5FD_class_t*>(
+            H5Iobject_verify(driver_id, H5I_VFL));
+        auto params = reinterpret_cast<const params_struct*>(H5Pget_driver_info(fapl_id));
+        if (nullptr == cls || cls->open != open || nullptr == params) {
+            error::raise(__FILE__,
+                         __PRETTY_FUNCTION__,
+                         __LINE__,
+                         H5E_PLIST,
+                         H5E_BADVALUE,
+                         "file access property list does not use the ",
+                         kv_store::name,
+                         " driver");
+            return -1;
+        }
+
+        params_struct copy(*params);
+        copy.page_cache_bytes = page_cache_bytes;
+        return H5Pset_driver(fapl_id, driver_id, &copy);
+    }
 };
 }  // namespace h5s3::driver
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace h5s3::page {
+
+/** Hands out fixed size page buffers carved out of large anonymous memory
+    mappings.
+
+    Buffers are not initialized, so growing a cache does not touch memory
+    before it is filled. Each buffer is aligned to, and a multiple of,
+    `alignment` bytes so that it may be used for `O_DIRECT` I/O. Mappings are
+    made as buffers are needed and are advised to use transparent huge pages,
+    which cuts TLB misses when copying in and out of large pages. Released
+    buffers are reused before new ones are carved out. The memory of
+    released buffers can be handed back to the system with `trim`, but the
+    address space is only unmapped when the arena is destroyed.
+ */
+class buffer_arena {
+private:
+    class mapping_deleter {
+    public:
+        std::size_t size;
+
+        void operator()(char* ptr) const;
+    };
+    using mapping = std::unique_ptr<char, mapping_deleter>;
+
+    std::size_t m_buffer_size;
+    std::size_t m_buffers_per_mapping;
+    bool m_huge_pages;
+    std::vector<mapping> m_mappings;
+    // the number of buffers carved out of the newest mapping
+    std::size_t m_used;
+    std::vector<char*> m_free;
+    // the first `m_trimmed` buffers of `m_free` have been given back to the
+    // system
+    std::size_t m_trimmed;
+
+    void add_mapping();
+
+public:
+    /** The alignment of every buffer.
+     */
+    static constexpr std::size_t alignment = 4096;
+
+    /** The size of a transparent huge page.
+     */
+    static constexpr std::size_t huge_page_size = 2 << 20;
+
+    /** The target size of each mapping.
+     */
+    static constexpr std::size_t mapping_size = 64 << 20;
+
+    /** @param buffer_size The size of each buffer. This is rounded up to a
+               multiple of `alignment`.
+        @param max_buffers The most buffers which will be live at once. This
+               bounds the size of the mappings for small caches.
+        @param huge_pages Advise the kernel to back mappings with
+               transparent huge pages.
+     */
+    buffer_arena(std::size_t buffer_size, std::size_t max_buffers, bool huge_pages = true);
+
+    buffer_arena(buffer_arena&&) noexcept = default;
+    buffer_arena& operator=(buffer_arena&&) noexcept = default;
+
+    /** The size of each buffer, after rounding.
+     */
+    std::size_t buffer_size() const {
+        return m_buffer_size;
+    }
+
+    /** The number of bytes of address space mapped.
+     */
+    std::size_t mapped_bytes() const {
+        return m_mappings.size() * m_buffers_per_mapping * m_buffer_size;
+    }
+
+    /** Get an uninitialized buffer of `buffer_size()` bytes.
+     */
+    char* allocate();
+
+    /** Return a buffer from `allocate` to the arena to be reused.
+     */
+    void release(char* buffer);
+
+    /** Give the memory of the released buffers back to the system. The
+        buffers stay in the arena and are faulted back in when reused.
+
+        @return The number of bytes given back.
+     */
+    std::size_t trim();
+};
+}  // namespace h5s3::page
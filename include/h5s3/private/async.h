@@ -0,0 +1,344 @@
+#pragma once
+
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define H5S3_HAS_COROUTINES 1
+#else
+#define H5S3_HAS_COROUTINES 0
+#endif
+
+#include "h5s3/private/io.h"
+
+namespace h5s3::async {
+
+template<typename T>
+class future;
+
+namespace detail {
+// `future<void>` holds a `std::monostate`
+template<typename T>
+using stored_t = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+template<typename T>
+struct state {
+    std::mutex mutex;
+    std::condition_variable ready_cv;
+    bool ready = false;
+    std::optional<stored_t<T>> value;
+    std::exception_ptr error;
+    std::function<void()> continuation;
+};
+}  // namespace detail
+
+/** The producing side of a `future`.
+ */
+template<typename T>
+class promise {
+private:
+    std::shared_ptr<detail::state<T>> m_state;
+
+    template<typename F>
+    void complete(F&& fill) const {
+        std::function<void()> continuation;
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            assert(!m_state->ready);
+            fill(*m_state);
+            m_state->ready = true;
+            continuation = std::move(m_state->continuation);
+        }
+        m_state->ready_cv.notify_all();
+        if (continuation) {
+            continuation();
+        }
+    }
+
+public:
+    promise() : m_state(std::make_shared<detail::state<T>>()) {}
+
+    /** The future which receives the result. Every call returns a handle to
+        the same result.
+     */
+    future<T> get_future() const {
+        return future<T>(m_state);
+    }
+
+    /** Complete the future with a value. This runs the future's
+        continuation, if any, on the calling thread.
+
+        @param args The arguments to construct the value from, or nothing for
+               `promise<void>`.
+     */
+    template<typename... Args>
+    void set_value(Args&&... args) const {
+        complete([&](detail::state<T>& s) {
+            s.value.emplace(std::forward<Args>(args)...);
+        });
+    }
+
+    /** Complete the future with an error. This runs the future's
+        continuation, if any, on the calling thread.
+
+        @param error The exception to rethrow from `future::get`.
+     */
+    void set_error(std::exception_ptr error) const {
+        complete([&](detail::state<T>& s) { s.error = std::move(error); });
+    }
+};
+
+/** The result of an operation which completes later, usually on the thread
+    of `curl::event_loop`.
+
+    A future may be waited on with `get`, chained with `then`, or, when the
+    compiler supports coroutines, awaited with `co_await`. Continuations run
+    on the thread which completes the future, so they must be short and must
+    not block; use `then` to hand results to a caller which is waiting, or
+    `co_await schedule(...)` to move a coroutine onto an I/O worker.
+ */
+template<typename T>
+class future {
+private:
+    std::shared_ptr<detail::state<T>> m_state;
+
+    friend class promise<T>;
+
+    explicit future(std::shared_ptr<detail::state<T>> state)
+        : m_state(std::move(state)) {}
+
+public:
+    using value_type = T;
+
+    /** An invalid future, which may be assigned to.
+     */
+    future() = default;
+
+    /** Does this future refer to a result?
+     */
+    bool valid() const {
+        return static_cast<bool>(m_state);
+    }
+
+    /** Has the result been set?
+     */
+    bool ready() const {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        return m_state->ready;
+    }
+
+    /** Block until the result has been set.
+     */
+    void wait() const {
+        std::unique_lock<std::mutex> lock(m_state->mutex);
+        m_state->ready_cv.wait(lock, [&] { return m_state->ready; });
+    }
+
+    /** Block until the result has been set and return it, or rethrow the
+        error. The value is moved out, so only one caller may `get` it.
+     */
+    T get() const {
+        wait();
+        if (m_state->error) {
+            std::rethrow_exception(m_state->error);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*m_state->value);
+        }
+    }
+
+    /** Call `f` once the result has been set, on the thread which sets it,
+        or on this thread if it is already set. A future has at most one
+        continuation.
+
+        @param f The function to call. It must not throw.
+     */
+    void on_ready(std::function<void()> f) const {
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            if (!m_state->ready) {
+                assert(!m_state->continuation);
+                m_state->continuation = std::move(f);
+                return;
+            }
+        }
+        f();
+    }
+
+    /** Chain a function to run on this future's result.
+
+        @param f The function to call with this future once it is ready. It
+               may `get` the result, and its return value or exception
+               completes the returned future.
+        @return The future of `f`'s result.
+     */
+    template<typename F>
+    auto then(F f) const -> future<std::invoke_result_t<F, future<T>>> {
+        using result = std::invoke_result_t<F, future<T>>;
+        promise<result> next;
+        on_ready([self = *this, next, f = std::move(f)]() mutable {
+            try {
+                if constexpr (std::is_void_v<result>) {
+                    f(std::move(self));
+                    next.set_value();
+                }
+                else {
+                    next.set_value(f(std::move(self)));
+                }
+            }
+            catch (...) {
+                next.set_error(std::current_exception());
+            }
+        });
+        return next.get_future();
+    }
+};
+
+/** A future which already holds a value.
+ */
+template<typename T>
+future<std::decay_t<T>> make_ready(T&& value) {
+    promise<std::decay_t<T>> p;
+    p.set_value(std::forward<T>(value));
+    return p.get_future();
+}
+
+/** A `future<void>` which is already complete.
+ */
+inline future<void> make_ready() {
+    promise<void> p;
+    p.set_value();
+    return p.get_future();
+}
+
+/** A future which already holds an error.
+ */
+template<typename T>
+future<T> make_error(std::exception_ptr error) {
+    promise<T> p;
+    p.set_error(std::move(error));
+    return p.get_future();
+}
+
+/** Run `start(ix)` for every `ix` in `[0, count)`, keeping at most
+    `concurrency` of the returned futures outstanding at once. Each
+    completion starts the next operation, so no thread waits on them.
+
+    @param count The number of operations.
+    @param concurrency The most operations to have outstanding at once.
+    @param start Start an operation. It is called from the calling thread
+           and from the threads which complete the operations.
+    @return A future which completes once every operation has, with the first
+            error if any failed.
+ */
+future<void> for_each(std::size_t count,
+                      std::size_t concurrency,
+                      std::function<future<void>(std::size_t)> start);
+
+#if H5S3_HAS_COROUTINES
+namespace detail {
+template<typename T>
+struct coroutine_promise_base {
+    promise<T> result;
+
+    void return_value(T value) {
+        result.set_value(std::move(value));
+    }
+};
+
+template<>
+struct coroutine_promise_base<void> {
+    promise<void> result;
+
+    void return_void() {
+        result.set_value();
+    }
+};
+
+template<typename T>
+struct coroutine_promise : coroutine_promise_base<T> {
+    future<T> get_return_object() {
+        return this->result.get_future();
+    }
+
+    // coroutines start eagerly and free their frame when they finish
+    std::suspend_never initial_suspend() noexcept {
+        return {};
+    }
+
+    std::suspend_never final_suspend() noexcept {
+        return {};
+    }
+
+    void unhandled_exception() {
+        this->result.set_error(std::current_exception());
+    }
+};
+}  // namespace detail
+
+/** Suspend a coroutine until `f` is ready. The coroutine resumes on the
+    thread which completes `f`.
+ */
+template<typename T>
+auto operator co_await(future<T> f) {
+    struct awaiter {
+        future<T> f;
+
+        bool await_ready() const {
+            return f.ready();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            f.on_ready([handle] { handle.resume(); });
+        }
+
+        T await_resume() {
+            return f.get();
+        }
+    };
+    return awaiter{std::move(f)};
+}
+
+/** Awaiting the result resumes the coroutine on a worker of `io`. Use this
+    before doing work which should not run on the event loop's thread.
+ */
+inline auto schedule(io::service& io, io::priority p) {
+    struct awaiter {
+        io::service& io;
+        io::priority p;
+
+        bool await_ready() const {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            io.submit(p, [handle] { handle.resume(); });
+        }
+
+        void await_resume() {}
+    };
+    return awaiter{io, p};
+}
+#endif
+}  // namespace h5s3::async
+
+#if H5S3_HAS_COROUTINES
+namespace std {
+/** Functions returning `h5s3::async::future<T>` may be coroutines.
+ */
+template<typename T, typename... Args>
+struct coroutine_traits<h5s3::async::future<T>, Args...> {
+    using promise_type = h5s3::async::detail::coroutine_promise<T>;
+};
+}  // namespace std
+#endif
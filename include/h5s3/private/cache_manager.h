@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace h5s3::page {
+
+/** The view of a page table which the `cache_manager` uses to enforce a
+    shared budget.
+ */
+class managed_table {
+public:
+    /** How cold the least recently used page of a table is. Pages which have
+        only been used once are colder than every page which has been reused,
+        and otherwise the page used longest ago is the coldest.
+     */
+    struct coldness {
+        bool reused;
+        std::uint64_t last_used;
+
+        bool operator<(const coldness& other) const {
+            return reused != other.reused ? !reused
+                                          : last_used < other.last_used;
+        }
+    };
+
+    virtual ~managed_table() = default;
+
+    /** The coldness of the least recently used page, or `std::nullopt` if
+        the table holds no pages.
+     */
+    virtual std::optional<coldness> coldest() const = 0;
+
+    /** The bytes of page memory held by the table.
+     */
+    virtual std::size_t cached_bytes() const = 0;
+
+    /** Evict the least recently used page, writing it back if it is dirty,
+        and give its memory back to the system.
+     */
+    virtual void evict_coldest() = 0;
+};
+
+/** Enforces one memory budget across the page tables of every open file and
+    lets read-only opens of the same file share a page table.
+
+    When a page table attached to the manager needs memory for a new page and
+    the budget is spent, the coldest page across all of the attached tables
+    is evicted. With a budget of 0, the manager is disabled: tables are not
+    attached and files do not share pages.
+ */
+class cache_manager {
+private:
+    mutable std::mutex m_mutex;
+    std::size_t m_budget;
+    std::vector<managed_table*> m_tables;
+    std::unordered_map<std::string, std::weak_ptr<void>> m_shared;
+
+    static std::atomic<std::uint64_t> m_clock;
+
+    // these must be called with `m_mutex` held
+    std::size_t used_bytes() const;
+    managed_table* coldest_table() const;
+
+public:
+    explicit cache_manager(std::size_t budget = 0) : m_budget(budget) {}
+
+    cache_manager(const cache_manager&) = delete;
+
+    /** The manager used by every file opened with an h5s3 driver. Its budget
+        starts as the value of the `H5S3_SHARED_CACHE_BYTES` environment
+        variable, or 0 if that is not set.
+     */
+    static cache_manager& global();
+
+    /** Advance the process-wide clock used to order page accesses.
+
+        @return The new time.
+     */
+    static std::uint64_t tick() {
+        return m_clock.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    /** The total budget in bytes, or 0 if the manager is disabled.
+     */
+    std::size_t budget() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_budget;
+    }
+
+    /** Set the total budget in bytes. Pass 0 to disable the manager for
+        files opened later; files which are already open stay attached. If
+        the attached tables hold more than a smaller budget, the coldest pages
+        are evicted.
+     */
+    void budget(std::size_t bytes);
+
+    /** The bytes of page memory held by the attached tables.
+     */
+    std::size_t cached_bytes() const;
+
+    /** Attach a table to the manager. The table must not move while it is
+        attached.
+     */
+    void attach(managed_table& table);
+
+    /** Detach a table from the manager.
+     */
+    void detach(managed_table& table);
+
+    /** Make room in the budget for a new page.
+
+        Pages are evicted from the coldest of the other attached tables until
+        `bytes` more fit in the budget.
+
+        @param requester The table which needs the memory.
+        @param bytes The bytes needed.
+        @return true if the memory may be allocated. false if `requester`
+                itself holds the coldest page, or a page could not be
+                written back, in which case the requester should reuse one
+                of its own pages instead.
+     */
+    bool reserve(const managed_table& requester, std::size_t bytes);
+
+    /** Look up an object shared under a key, creating it if there is no live
+        one. `make` is called with the manager locked, so it must not call
+        back into the manager.
+
+        @param key The key identifying the object.
+        @param make Called to create the object if there is no live one.
+        @return The shared object, and whether it was created.
+     */
+    template<typename T>
+    std::pair<std::shared_ptr<T>, bool>
+    shared(const std::string& key, const std::function<std::shared_ptr<T>()>& make) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_shared.begin(); it != m_shared.end();) {
+            it = it->second.expired() ? m_shared.erase(it) : std::next(it);
+        }
+
+        auto search = m_shared.find(key);
+        if (search != m_shared.end()) {
+            if (auto existing = search->second.lock()) {
+                return {std::static_pointer_cast<T>(existing), false};
+            }
+        }
+
+        std::shared_ptr<T> out = make();
+        m_shared[key] = out;
+        return {out, true};
+    }
+};
+}  // namespace h5s3::page
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace h5s3::cache_sim {
+
+/** A contiguous read or write of the address space of a file.
+ */
+struct access {
+    std::uint64_t addr;
+    std::uint64_t size;
+    bool write;
+};
+
+/** The page eviction policy to simulate.
+ */
+enum class policy {
+    /** Evict the least recently used page. This is what `page::table` does.
+     */
+    lru,
+
+    /** Evict the page which was brought into the cache first.
+     */
+    fifo,
+
+    /** Evict the least frequently used page, breaking ties by recency.
+     */
+    lfu,
+};
+
+/** Parse a policy name.
+
+    @param name One of "lru", "fifo", or "lfu".
+    @return The named policy.
+ */
+policy parse_policy(std::string_view name);
+
+/** The name of a policy.
+ */
+std::string_view policy_name(policy p);
+
+/** A cache configuration to simulate.
+ */
+struct config {
+    std::size_t page_size;
+    std::size_t page_cache_size;  // in pages
+    policy eviction;
+};
+
+/** The outcome of simulating a workload against a cache configuration.
+ */
+struct result {
+    config cache;
+
+    /** The number of page accesses, each access may touch many pages.
+     */
+    std::uint64_t page_accesses = 0;
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+
+    /** The number of dirty pages written back, including the final flush.
+     */
+    std::uint64_t writebacks = 0;
+
+    /** The number of requests made to the kv-store.
+     */
+    std::uint64_t requests() const {
+        return misses + writebacks;
+    }
+
+    /** The number of bytes moved to and from the kv-store.
+     */
+    std::uint64_t bytes_transferred() const {
+        return requests() * cache.page_size;
+    }
+
+    double hit_ratio() const {
+        return page_accesses ? static_cast<double>(hits) / page_accesses : 0;
+    }
+
+    /** Estimate the time spent waiting on the kv-store.
+
+        @param latency_s The latency of a single request in seconds.
+        @param bandwidth The bytes per second of a single request.
+        @return The estimated time in seconds.
+     */
+    double estimated_seconds(double latency_s, double bandwidth) const {
+        return requests() * latency_s + bytes_transferred() / bandwidth;
+    }
+};
+
+/** Simulate running a sequence of accesses through a page cache.
+
+    @param accesses The accesses, in the order they are made.
+    @param cache The cache configuration to simulate.
+    @return The cache hit, miss and writeback counts.
+ */
+result simulate(const std::vector<access>& accesses, const config& cache);
+}  // namespace h5s3::cache_sim
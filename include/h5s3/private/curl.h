@@ -1,14 +1,30 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "curl/curl.h"
 
+#include "h5s3/private/async.h"
+#include "h5s3/private/io.h"
 #include "h5s3/private/out_buffer.h"
+#include "h5s3/private/throttle.h"
 
 namespace h5s3::curl {
 
@@ -22,6 +38,13 @@ public:
     }
 };
 
+class curl_multi_deleter {
+public:
+    void operator()(CURLM* ptr) {
+        curl_multi_cleanup(ptr);
+    }
+};
+
 class curl_slist_deleter {
 public:
     void operator()(curl_slist* ptr) {
@@ -42,17 +65,172 @@ public:
         : error(message), code(code) {}
 };
 
+/** The addresses to connect to for each host, with requests spread over
+    them.
+
+    S3 and most gateways resolve to many addresses, but curl only connects to
+    one of them, so the throughput of one address limits every request to
+    the host. A request to a host with registered addresses is sent to the
+    healthy address with the fewest outstanding requests, keeping the url,
+    `Host` header and TLS server name of the host. An address which fails to
+    connect or transfer is skipped for a backoff which doubles with each
+    consecutive failure; when every address is backing off, the one which
+    recovers first is used.
+ */
+class endpoints {
+public:
+    /** The backoff after the first failure of an address.
+     */
+    static constexpr std::chrono::milliseconds initial_backoff{250};
+
+    /** The longest an address is skipped for.
+     */
+    static constexpr std::chrono::milliseconds max_backoff{30000};
+
+    /** An outstanding request to an address, which is counted until the lease
+        is destroyed.
+     */
+    class lease {
+    private:
+        endpoints* m_owner;
+        std::string m_host;
+        std::string m_address;
+        bool m_failed;
+
+    public:
+        lease(endpoints& owner, const std::string_view& host, std::string address)
+            : m_owner(&owner), m_host(host), m_address(std::move(address)),
+              m_failed(false) {}
+
+        lease(lease&& mvfrom) noexcept
+            : m_owner(mvfrom.m_owner), m_host(std::move(mvfrom.m_host)),
+              m_address(std::move(mvfrom.m_address)), m_failed(mvfrom.m_failed) {
+            mvfrom.m_owner = nullptr;
+        }
+
+        lease& operator=(lease&&) = delete;
+
+        ~lease() {
+            if (m_owner) {
+                m_owner->release(m_host, m_address, m_failed);
+            }
+        }
+
+        /** The address to connect to, `address[:port]`.
+         */
+        const std::string& address() const {
+            return m_address;
+        }
+
+        /** Record that the request failed to connect or transfer, so that the
+            address backs off once the lease is released.
+         */
+        void failed() {
+            m_failed = true;
+        }
+
+        /** The `CURLOPT_CONNECT_TO` entry which sends a connection to this
+            address. Without a port, the port of the url is kept.
+         */
+        std::string connect_to() const;
+    };
+
+    /** The state of one address of a host.
+     */
+    struct status {
+        std::string address;
+        std::size_t outstanding;
+        // the number of failures since the last success
+        std::size_t failures;
+        bool healthy;
+    };
+
+private:
+    struct address_state {
+        std::string address;
+        std::size_t outstanding = 0;
+        std::size_t failures = 0;
+        std::chrono::steady_clock::time_point retry_at{};
+    };
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::vector<address_state>> m_hosts;
+    // where to start looking, so that ties rotate between the addresses
+    std::size_t m_next = 0;
+
+    void release(const std::string& host, const std::string& address, bool failed);
+
+public:
+    endpoints() = default;
+    endpoints(const endpoints&) = delete;
+
+    /** The addresses used for every request made by the s3 driver.
+     */
+    static endpoints& global();
+
+    /** Add addresses to connect to for a host. Addresses which are already
+        registered are skipped.
+
+        @param host The host, as it appears in urls: `name[:port]`.
+        @param addresses The addresses, each `address[:port]`. IPv6
+               addresses may be written in brackets.
+     */
+    void add(const std::string_view& host, const std::vector<std::string>& addresses);
+
+    /** Choose the address for a request to a host.
+
+        @param host The host, as it appears in urls.
+        @return The lease on the address, or `std::nullopt` if the host has
+                no registered addresses and should be connected to directly.
+     */
+    std::optional<lease> choose(const std::string_view& host);
+
+    /** The state of each address registered for a host.
+     */
+    std::vector<status> addresses(const std::string_view& host);
+};
+
+/** Resolve every address of a host.
 
+    @param host The host, as it appears in urls: `name[:port]`. The port is
+           not part of the results, so connections keep the url's port.
+    @return The addresses, IPv6 ones in brackets.
+    @throws error if the host cannot be resolved.
+ */
+std::vector<std::string> resolve(const std::string_view& host);
+
+/** A curl handle which may be used for many requests. The handle keeps its
+    connections open between requests, so reusing a session to the same host
+    skips the TCP and TLS handshakes.
+ */
 class session {
 private:
     std::unique_ptr<CURL, curl_deleter> m_curl;
+    owned_header_list m_connect_to;
+    mutable bool m_failed;
+
+    /** Clear the options set by the previous request, keeping the open
+        connections.
+     */
+    void reset() const;
 
 public:
-    session() : m_curl(curl_easy_init()) {
-        if (!m_curl) {
-            throw error("Failed to initialize curl request.");
-        }
+    /** @param connect_to The `CURLOPT_CONNECT_TO` entry to connect with, or
+               empty to connect to the host of each url.
+     */
+    explicit session(const std::string& connect_to = "");
+
+    /** Did the last request fail to connect or transfer, as opposed to
+        getting an error response?
+     */
+    bool failed() const {
+        return m_failed;
     }
+
+    /** The outcome of the last request.
+     */
+    throttle::outcome outcome() const;
+
     /** Perform an HTTP GET request, returning the response as a `std::string`.
 
         @param url The url to GET.
@@ -73,8 +251,322 @@ public:
                     const std::vector<header>& headers,
                     utils::out_buffer& out) const;
 
+    /** Perform an HTTP GET request, writing the response into an out_buffer
+        and recording the response's `ETag` header.
+
+        A request with an `If-None-Match` header may be answered with 304 Not
+        Modified, which has no body and is not an error.
+
+        @param url The url to GET.
+        @param headers The headers to set in the request.
+        @param out The output buffer to write to.
+        @param etag Set to the `ETag` of the response, or cleared if the
+               response did not have one.
+        @return The number of bytes written to `out`, or `std::nullopt` if
+                the response was 304 Not Modified.
+     */
+    std::optional<std::size_t> get(const std::string_view& url,
+                                   const std::vector<header>& headers,
+                                   utils::out_buffer& out,
+                                   std::string& etag) const;
+
     std::string put(const std::string_view& url,
                     const std::vector<header>& headers,
                     const std::string_view& content) const;
 };
+
+/** Sessions kept open for reuse, grouped by host.
+
+    At most `max_per_host` sessions to a host exist at once; `acquire` waits
+    for one to be released once they are all in use. This bounds the number
+    of sockets however many files and threads make requests.
+
+    Requests to a host with addresses in `endpoints::global()` are spread over
+    them, and the limit applies to each address. With a `throttle::limiter`,
+    requests also wait for the limiter before they are given a session.
+ */
+class pool {
+private:
+    struct host_sessions {
+        std::vector<std::unique_ptr<session>> idle;
+        std::size_t created = 0;
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_released;
+    std::size_t m_max_per_host;
+    throttle::limiter* m_limiter;
+    std::unordered_map<std::string, host_sessions> m_hosts;
+
+    void release(const std::string& host, std::unique_ptr<session>&& s);
+
+public:
+    /** The limit used when `H5S3_MAX_HOST_CONNECTIONS` is not set.
+     */
+    static constexpr std::size_t default_max_per_host = 64;
+
+    /** A session borrowed from a pool, which is given back when the lease
+        is destroyed.
+     */
+    class lease {
+    private:
+        pool* m_pool;
+        std::string m_host;
+        std::unique_ptr<session> m_session;
+        std::optional<endpoints::lease> m_endpoint;
+        std::optional<throttle::limiter::ticket> m_ticket;
+
+    public:
+        lease(pool& p,
+              const std::string_view& host,
+              std::unique_ptr<session>&& s,
+              std::optional<endpoints::lease>&& endpoint = std::nullopt,
+              std::optional<throttle::limiter::ticket>&& ticket = std::nullopt)
+            : m_pool(&p), m_host(host), m_session(std::move(s)),
+              m_endpoint(std::move(endpoint)), m_ticket(std::move(ticket)) {}
+
+        lease(lease&&) noexcept = default;
+        lease& operator=(lease&&) = delete;
+
+        ~lease() {
+            if (m_session) {
+                if (m_endpoint && m_session->failed()) {
+                    m_endpoint->failed();
+                }
+                if (m_ticket) {
+                    m_ticket->finish(m_session->outcome());
+                }
+                m_pool->release(m_host, std::move(m_session));
+            }
+        }
+
+        const session* operator->() const {
+            return m_session.get();
+        }
+
+        const session& operator*() const {
+            return *m_session;
+        }
+    };
+
+    /** @param max_per_host The most sessions to one host, at least 1.
+        @param limiter The limiter to wait for before each request, if any.
+     */
+    explicit pool(std::size_t max_per_host, throttle::limiter* limiter = nullptr)
+        : m_max_per_host(std::max<std::size_t>(max_per_host, 1)), m_limiter(limiter) {}
+
+    pool(const pool&) = delete;
+
+    /** The pool used for every request made by the s3 driver. It allows
+        `H5S3_MAX_HOST_CONNECTIONS` sessions per host, or
+        `default_max_per_host` if that is not set, and waits for
+        `throttle::limiter::global()`.
+     */
+    static pool& global();
+
+    /** Borrow a session to `host`, reusing an idle one if there is one.
+
+        @param host The host which will be requested.
+        @return The lease on the session.
+     */
+    lease acquire(const std::string_view& host);
+
+    /** The number of sessions which have been made to `host`, not counting
+        the sessions to its addresses in `endpoints::global()`.
+     */
+    std::size_t sessions(const std::string_view& host);
+};
+
+/** The HTTP version to use for the transfers on an `event_loop`.
+ */
+enum class http_version {
+    // one request at a time on each connection
+    http1_1,
+    // negotiate HTTP/2 with ALPN on TLS connections, falling back to HTTP/1.1;
+    // plain http connections use HTTP/1.1
+    http2,
+    // HTTP/2 without negotiation, for servers known to speak it over plain
+    // http (h2c)
+    http2_prior_knowledge,
+};
+
+/** Parse the name of an HTTP version: "1.1", "2" or "2-prior-knowledge".
+
+    @param name The name to parse.
+    @return The version.
+    @throws std::invalid_argument if the name is not recognized.
+ */
+http_version parse_http_version(const std::string_view& name);
+
+/** The HTTP version a libcurl can actually use for a requested version.
+
+    Either HTTP/2 version falls back to HTTP/1.1 when libcurl was built
+    without HTTP/2. HTTP/2 with prior knowledge also falls back when libcurl
+    is older than 8.0: libcurl 7.88 fails every stream but the first on a
+    multiplexed h2c connection with `CURLE_HTTP2`, though it multiplexes
+    HTTP/2 negotiated over TLS.
+
+    @param requested The version asked for.
+    @param info The libcurl to check, `curl_version_info(CURLVERSION_NOW)`
+           for the linked one.
+    @return The version to use.
+ */
+http_version supported_http_version(http_version requested,
+                                    const curl_version_info_data& info);
+
+/** Runs many transfers at once on a single thread with
+    `curl_multi_socket_action`, waiting on the sockets with epoll.
+
+    Transfers share the connections of one multi handle, at most
+    `max_host_connections` to each host. At most `max_in_flight` transfers
+    are handed to curl at once; the rest wait in priority order, so demand
+    reads queued behind a burst of prefetches still start first. With a
+    `throttle::limiter`, a transfer also waits until the limiter lets it
+    start, and transfers to other endpoints may start ahead of it.
+ */
+class event_loop {
+public:
+    /** Called on the loop thread once a transfer has finished and its handle
+        has been removed from the loop. It must not block or throw.
+     */
+    using completion = std::function<void(CURLcode)>;
+
+private:
+    struct transfer {
+        CURL* handle;
+        completion done;
+        std::string key;
+    };
+
+    struct running_transfer {
+        completion done;
+        std::optional<throttle::limiter::ticket> ticket;
+    };
+
+    std::unique_ptr<CURLM, curl_multi_deleter> m_multi;
+    int m_epoll;
+    // written to wake the loop thread when transfers are started or the
+    // loop is stopped
+    int m_wake;
+    std::size_t m_max_in_flight;
+    http_version m_http_version;
+    throttle::limiter* m_limiter;
+    std::size_t m_watch_id;
+
+    std::mutex m_mutex;
+    std::deque<std::tuple<io::priority, transfer>> m_incoming;
+    bool m_stopping;
+
+    // only used on the loop thread
+    std::array<std::deque<transfer>, 3> m_waiting;
+    std::unordered_map<CURL*, running_transfer> m_running;
+    std::unordered_set<curl_socket_t> m_sockets;
+    std::optional<std::chrono::steady_clock::time_point> m_deadline;
+    // when a transfer held back by the limiter's rate may start
+    std::optional<std::chrono::steady_clock::time_point> m_retry_at;
+
+    std::thread m_thread;
+
+    static int on_socket(CURL*, curl_socket_t s, int what, void* loop, void*);
+    static int on_timer(CURLM*, long timeout_ms, void* loop);
+
+    void run();
+    void wake();
+    void admit();
+    void finish_done();
+
+public:
+    /** The limit on transfers handed to curl at once used when
+        `H5S3_MAX_IN_FLIGHT` is not set.
+     */
+    static constexpr std::size_t default_max_in_flight = 1024;
+
+    /** @param max_host_connections The most connections open to one host.
+        @param max_in_flight The most transfers handed to curl at once.
+        @param version The HTTP version to use. With either HTTP/2 version,
+               transfers to the same host are multiplexed over the open
+               connections, and wait for a connection to multiplex on rather
+               than opening a new one. HTTP/1.1 is used instead if the linked
+               libcurl cannot multiplex, see `supported_http_version`.
+        @param limiter The limiter to start transfers through, if any.
+     */
+    event_loop(std::size_t max_host_connections,
+               std::size_t max_in_flight,
+               http_version version = http_version::http1_1,
+               throttle::limiter* limiter = nullptr);
+
+    event_loop(const event_loop&) = delete;
+
+    /** Stop the loop. Transfers which have not finished complete with
+        `CURLE_ABORTED_BY_CALLBACK`.
+     */
+    ~event_loop();
+
+    /** The loop used for the asynchronous requests of the s3 driver. It
+        allows `H5S3_MAX_HOST_CONNECTIONS` connections per host and
+        `H5S3_MAX_IN_FLIGHT` transfers at once, uses the HTTP version
+        named by `H5S3_HTTP_VERSION`, or HTTP/1.1 if that is not set, and
+        starts transfers through `throttle::limiter::global()`.
+     */
+    static event_loop& global();
+
+    /** The HTTP version the loop's transfers use.
+     */
+    http_version version() const {
+        return m_http_version;
+    }
+
+    /** Start a transfer. This may be called from any thread, including from
+        a completion.
+
+        @param handle An easy handle with every option set except for the
+               HTTP version, which the loop sets. The handle, and everything
+               its options point at, must stay alive until `done` is called.
+        @param p The priority of the transfer while it waits to start.
+        @param done Called with the result of the transfer.
+        @param key The endpoint the limiter limits the transfer by.
+     */
+    void start(CURL* handle, io::priority p, completion done, std::string key = "");
+};
+
+/** The outcome of an asynchronous GET.
+ */
+struct get_result {
+    // the number of bytes written, or `std::nullopt` for 304 Not Modified
+    std::optional<std::size_t> size;
+    // the `ETag` of the response, or empty if it did not have one
+    std::string etag;
+};
+
+/** Perform an HTTP GET on `event_loop::global()`, writing the response into
+    an out_buffer.
+
+    @param url The url to GET.
+    @param headers The headers to set in the request. These are copied
+           before returning.
+    @param out The output buffer to write to. It must stay alive until the
+           returned future is ready.
+    @param p The priority of the request.
+    @return The outcome, which is set on the loop thread. A response other
+            than 200, 206 or 304 is reported as an `http_error`.
+ */
+async::future<get_result> async_get(const std::string_view& url,
+                                    const std::vector<header>& headers,
+                                    utils::out_buffer out,
+                                    io::priority p);
+
+/** Perform an HTTP PUT on `event_loop::global()`.
+
+    @param url The url to PUT.
+    @param headers The headers to set in the request. These are copied
+           before returning.
+    @param content The request body. It must stay alive until the returned
+           future is ready.
+    @param p The priority of the request.
+    @return The response body, which is set on the loop thread.
+ */
+async::future<std::string> async_put(const std::string_view& url,
+                                     const std::vector<header>& headers,
+                                     const std::string_view& content,
+                                     io::priority p);
 }  // namespace h5s3::curl
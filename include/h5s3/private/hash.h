@@ -1,6 +1,11 @@
+#pragma once
+
 #include "openssl/sha.h"
 #include "openssl/hmac.h"
 #include <array>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 
 namespace h5s3::hash {
 
@@ -51,6 +56,8 @@ sha256_hex hmac_sha256_hexdigest(Params&&... params){
     return to_hex(hmac_sha256(std::forward<Params>(params)...));
 }
 
+sha256 sha256_digest(const std::string_view& data);
+
 sha256_hex sha256_hexdigest(const std::string_view& data);
 
 }  // h5s3::hash
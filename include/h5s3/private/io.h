@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace h5s3::io {
+
+/** The priority of work submitted to the `service`. Lower values run first.
+ */
+enum class priority : std::uint8_t {
+    // reads which a caller is blocked on
+    demand = 0,
+    // reads of pages which have not been asked for yet
+    prefetch = 1,
+    // uploads of data which is already held in memory
+    write_behind = 2,
+};
+
+/** The process-wide pool of I/O worker threads shared by every open file.
+
+    Work is queued by priority: demand reads run before prefetches, and
+    prefetches run before write-behind uploads. Within a priority work runs
+    in the order it was submitted. The number of threads is fixed when the
+    service starts, so the thread count stays bounded however many files are
+    open.
+ */
+class service {
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::array<std::deque<std::function<void()>>, 3> m_queues;
+    std::vector<std::thread> m_workers;
+    bool m_stopping;
+
+    void work();
+
+public:
+    /** The number of worker threads used when `H5S3_IO_THREADS` is not set.
+     */
+    static constexpr std::size_t default_threads = 32;
+
+    /** @param threads The number of worker threads, at least 1.
+     */
+    explicit service(std::size_t threads);
+
+    service(const service&) = delete;
+
+    /** Finish the queued work and join the workers.
+     */
+    ~service();
+
+    /** The service used by every file opened with an h5s3 driver. It has
+        `H5S3_IO_THREADS` workers, or `default_threads` if that is not set.
+     */
+    static service& global();
+
+    /** Is the calling thread one of the workers of any service?
+     */
+    static bool on_worker();
+
+    /** The number of worker threads.
+     */
+    std::size_t threads() const {
+        return m_workers.size();
+    }
+
+    /** Queue a function to run on a worker.
+
+        @param p The priority of the work.
+        @param f The work to run. It must not throw.
+     */
+    void submit(priority p, std::function<void()> f);
+
+    /** Call `f(ix)` for every `ix` in `[0, count)`, using the calling thread
+        and up to `concurrency - 1` workers, and wait for every call to
+        return.
+
+        The calling thread always takes part, so the work makes progress even
+        when every worker is busy with lower priority work. Called from a
+        worker, every call is made on that worker so that nested work cannot
+        wait on itself.
+
+        @param p The priority of the work handed to workers.
+        @param count The number of calls to make.
+        @param concurrency The maximum number of calls to run at once.
+        @param f The function to call. If any call throws, the first
+               exception is rethrown once every call has returned.
+     */
+    void parallel(priority p,
+                  std::size_t count,
+                  std::size_t concurrency,
+                  const std::function<void(std::size_t)>& f);
+};
+}  // namespace h5s3::io
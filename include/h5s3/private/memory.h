@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace h5s3::memory {
+
+/** The page cache budget used when neither a page count nor a byte budget is
+    passed and there is no memory limit to derive one from.
+ */
+constexpr std::size_t fallback_cache_bytes = std::size_t(4) << 30;
+
+/** Read the memory limit of the cgroup this process runs in.
+
+    Both the cgroup v2 `memory.max` and the cgroup v1
+    `memory/memory.limit_in_bytes` files are checked.
+
+    @param root The mount point of the cgroup filesystem.
+    @return The limit in bytes, or `std::nullopt` if there is no limit or it
+            could not be read.
+ */
+std::optional<std::size_t>
+cgroup_memory_limit(const std::string& root = "/sys/fs/cgroup");
+
+/** The byte budget for the page cache of a newly opened file when the file
+    access property list does not set one.
+
+    This is the value of the `H5S3_PAGE_CACHE_BYTES` environment variable if it
+    is set. Otherwise it is a quarter of the cgroup memory limit, so that a
+    few open files fit in a container, capped at `fallback_cache_bytes`.
+ */
+std::size_t default_cache_bytes();
+
+/** Start watching for memory pressure with a pressure stall information
+    (PSI) trigger. Each time the trigger fires, `pressure_generation` is
+    incremented and open page tables drop up to half of their cached pages,
+    keeping the dirty ones.
+
+    The cgroup's `memory.pressure` file is used if it is available, otherwise
+    `/proc/pressure/memory`. The watch runs on a background thread until the
+    process exits. Calling this again while a watch is running does nothing.
+
+    @param stall_us The total time that some tasks must be stalled on memory
+           within one window for the trigger to fire, in microseconds.
+    @param window_us The length of the window in microseconds.
+    @return true if the watch is running, false if the kernel does not
+            support pressure triggers or they could not be opened.
+ */
+bool watch_pressure(std::uint64_t stall_us = 150000, std::uint64_t window_us = 2000000);
+
+namespace detail {
+extern std::atomic<std::uint64_t> pressure_generation;
+}  // namespace detail
+
+/** The number of memory pressure events seen so far.
+ */
+inline std::uint64_t pressure_generation() {
+    return detail::pressure_generation.load(std::memory_order_relaxed);
+}
+
+/** Record a memory pressure event as if the trigger fired.
+ */
+inline void signal_pressure() {
+    detail::pressure_generation.fetch_add(1, std::memory_order_relaxed);
+}
+}  // namespace h5s3::memory
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "h5s3/private/out_buffer.h"
+#include "h5s3/private/page.h"
+#include "h5s3/private/stats.h"
+
+namespace h5s3::memory_driver {
+
+/** A kv-store which holds every page in process memory.
+
+    This is not meant for storing real files, it exists to exercise
+    `page::table` without any network traffic, for example in benchmarks and
+    tests.
+ */
+class memory_kv_store {
+private:
+    std::size_t m_page_size;
+    std::size_t m_allocated_pages;
+    std::unordered_map<page::id, std::string> m_pages;
+    mutable stats::store_counters m_stats;
+
+public:
+    static constexpr const char* name = "h5s3-memory";
+
+    explicit memory_kv_store(std::size_t page_size)
+        : m_page_size(page_size), m_allocated_pages(0) {}
+
+    inline std::size_t page_size() const {
+        return m_page_size;
+    }
+
+    inline page::id max_page() const {
+        return m_allocated_pages - 1;
+    }
+
+    inline void max_page(page::id max_page) {
+        for (page::id page_id = max_page + 1; page_id < m_allocated_pages; ++page_id) {
+            m_pages.erase(page_id);
+        }
+        m_allocated_pages = max_page + 1;
+    }
+
+    inline std::size_t allocated_pages() const {
+        return m_allocated_pages;
+    }
+
+    inline const stats::store_counters& stats() const {
+        return m_stats;
+    }
+
+    inline void read(page::id page_id, utils::out_buffer& out) const {
+        m_stats.gets.add();
+        auto search = m_pages.find(page_id);
+        if (search == m_pages.end()) {
+            m_stats.not_found.add();
+            std::memset(out.data(), 0, m_page_size);
+            return;
+        }
+        std::memcpy(out.data(), search->second.data(), m_page_size);
+        m_stats.bytes_read.add(m_page_size);
+    }
+
+    inline void write(page::id page_id, const std::string_view& data) {
+        m_stats.puts.add();
+        m_stats.bytes_written.add(data.size());
+        m_pages[page_id].assign(data.data(), data.size());
+        m_allocated_pages = std::max(m_allocated_pages, page_id + 1);
+    }
+
+    inline void flush() {}
+};
+}  // namespace h5s3::memory_driver
@@ -1,14 +1,31 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <exception>
+#include <limits>
 #include <list>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <string_view>
 #include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "h5s3/private/arena.h"
+#include "h5s3/private/async.h"
+#include "h5s3/private/cache_manager.h"
+#include "h5s3/private/io.h"
+#include "h5s3/private/memory.h"
 #include "h5s3/private/out_buffer.h"
+#include "h5s3/private/stats.h"
+#include "h5s3/private/trace.h"
 
 namespace h5s3::page {
 
@@ -16,6 +33,215 @@ namespace h5s3::page {
  */
 using id = std::size_t;
 
+namespace detail {
+template<typename kv_store, typename = void>
+struct has_multi_page_read : std::false_type {};
+
+template<typename kv_store>
+struct has_multi_page_read<
+    kv_store,
+    std::void_t<decltype(std::declval<const kv_store&>().read(
+        id{}, std::declval<std::vector<utils::out_buffer>&>()))>> : std::true_type {};
+}  // namespace detail
+
+/** Does `kv_store` provide `read(id first, std::vector<utils::out_buffer>&)`
+    to read many consecutive pages at once?
+ */
+template<typename kv_store>
+constexpr bool has_multi_page_read_v = detail::has_multi_page_read<kv_store>::value;
+
+namespace detail {
+template<typename kv_store, typename = void>
+struct has_hot_pages : std::false_type {};
+
+template<typename kv_store>
+struct has_hot_pages<
+    kv_store,
+    std::void_t<decltype(std::declval<const kv_store&>().hot_pages()),
+                decltype(std::declval<kv_store&>().hot_pages(
+                    std::declval<std::vector<id>>()))>> : std::true_type {};
+}  // namespace detail
+
+/** Does `kv_store` persist a hot set of pages with `hot_pages()` and
+    `hot_pages(std::vector<id>)`?
+ */
+template<typename kv_store>
+constexpr bool has_hot_pages_v = detail::has_hot_pages<kv_store>::value;
+
+namespace detail {
+template<typename kv_store, typename = void>
+struct has_revalidate : std::false_type {};
+
+template<typename kv_store>
+struct has_revalidate<
+    kv_store,
+    std::void_t<decltype(std::declval<const kv_store&>().revalidate(
+                    id{}, std::declval<utils::out_buffer&>())),
+                decltype(std::declval<kv_store&>().refresh())>> : std::true_type {};
+}  // namespace detail
+
+/** Does `kv_store` provide `refresh()` and `bool revalidate(id,
+    utils::out_buffer&) const` to pick up changes made by another writer?
+ */
+template<typename kv_store>
+constexpr bool has_revalidate_v = detail::has_revalidate<kv_store>::value;
+
+namespace detail {
+template<typename kv_store, typename = void>
+struct has_cache_key : std::false_type {};
+
+template<typename kv_store>
+struct has_cache_key<
+    kv_store,
+    std::void_t<decltype(std::string(std::declval<const kv_store&>().cache_key()))>>
+    : std::true_type {};
+}  // namespace detail
+
+/** Does `kv_store` provide `std::string cache_key() const` naming the data it
+    reads, so that read-only opens of the same data may share a page table?
+ */
+template<typename kv_store>
+constexpr bool has_cache_key_v = detail::has_cache_key<kv_store>::value;
+
+namespace detail {
+template<typename kv_store, typename = void>
+struct has_batch_read : std::false_type {};
+}  // namespace detail
+
+namespace detail {
+template<typename kv_store, typename = void>
+struct has_range_write : std::false_type {};
+
+template<typename kv_store>
+struct has_range_write<
+    kv_store,
+    std::void_t<decltype(std::declval<kv_store&>().write(
+        id{}, std::string_view{}, std::size_t{}, std::size_t{}))>> : std::true_type {};
+}  // namespace detail
+
+/** Does `kv_store` provide `write(id, std::string_view page, std::size_t
+    begin, std::size_t end)` to write a page of which only the bytes in
+    `[begin, end)` changed?
+ */
+template<typename kv_store>
+constexpr bool has_range_write_v = detail::has_range_write<kv_store>::value;
+
+/** Consecutive pages to fill in one call to a kv_store's batch `read`.
+ */
+struct page_run {
+    id first;
+    std::vector<utils::out_buffer> buffers;
+    // set by the kv_store if the run could not be read
+    std::exception_ptr error;
+};
+
+namespace detail {
+template<typename kv_store>
+struct has_batch_read<
+    kv_store,
+    std::void_t<decltype(std::declval<const kv_store&>().read(
+        std::declval<std::vector<page_run>&>(), std::size_t{}, io::priority{}))>>
+    : std::true_type {};
+}  // namespace detail
+
+/** Does `kv_store` provide `read(std::vector<page_run>&, std::size_t
+    concurrency, io::priority) const` to read many runs of pages at once
+    without a thread per run?
+ */
+template<typename kv_store>
+constexpr bool has_batch_read_v = detail::has_batch_read<kv_store>::value;
+
+namespace detail {
+template<typename kv_store, typename = void>
+struct has_async_read : std::false_type {};
+
+template<typename kv_store>
+struct has_async_read<
+    kv_store,
+    std::void_t<decltype(std::declval<const kv_store&>().async_read(
+        id{}, std::declval<utils::out_buffer>(), io::priority{}))>> : std::true_type {};
+}  // namespace detail
+
+/** Does `kv_store` provide `async::future<void> async_read(id,
+    utils::out_buffer, io::priority) const` to start reading a page without
+    blocking?
+ */
+template<typename kv_store>
+constexpr bool has_async_read_v = detail::has_async_read<kv_store>::value;
+
+/** One read in a call to `table::read_vector`.
+ */
+struct vector_read {
+    std::size_t addr;
+    utils::out_buffer buffer;
+    std::uint8_t mem_type;
+};
+
+/** One write in a call to `table::write_vector`.
+ */
+struct vector_write {
+    std::size_t addr;
+    std::string_view data;
+    std::uint8_t mem_type;
+};
+
+/** Expand the arrays passed to an hdf5 vector I/O callback into one request
+    per entry.
+
+    A `sizes` entry of 0 or a `types` entry equal to `nolist` means that the
+    previous entry's value is used for the rest of the vector.
+
+    @param count The number of entries.
+    @param types The kind of hdf5 data of each entry.
+    @param nolist The type which ends the list of types, `H5FD_MEM_NOLIST`.
+    @param addrs The address of each entry.
+    @param sizes The size of each entry.
+    @param bufs The buffer of each entry.
+    @param make The function which builds a request from an address, size,
+           buffer and type.
+    @return One request per entry.
+ */
+template<typename request,
+         typename mem_type,
+         typename addr_type,
+         typename buffer_type,
+         typename F>
+std::vector<request> expand_vector(std::size_t count,
+                                   const mem_type types[],
+                                   mem_type nolist,
+                                   const addr_type addrs[],
+                                   const std::size_t sizes[],
+                                   buffer_type bufs[],
+                                   F&& make) {
+    std::vector<request> out;
+    out.reserve(count);
+
+    mem_type type{};
+    std::size_t size = 0;
+    bool fixed_type = false;
+    bool fixed_size = false;
+    for (std::size_t ix = 0; ix < count; ++ix) {
+        if (!fixed_type) {
+            if (types[ix] == nolist) {
+                fixed_type = true;
+            }
+            else {
+                type = types[ix];
+            }
+        }
+        if (!fixed_size) {
+            if (sizes[ix] == 0) {
+                fixed_size = true;
+            }
+            else {
+                size = sizes[ix];
+            }
+        }
+        out.push_back(make(addrs[ix], size, bufs[ix], type));
+    }
+    return out;
+}
+
 /** A page table adapts a `kv_store` to present the abstraction of a contiguous
     memory space. The page table implements caching to reduce the trips to the
     underlying `kv_store`.
@@ -23,126 +249,296 @@ using id = std::size_t;
     @tparam kv_store The underlying key-value store.
  */
 template<typename kv_store>
-class table {
+class table : public managed_table {
 private:
     class page;
 
     mutable kv_store m_kv_store;
 
-    const std::size_t m_page_cache_size;
+    std::size_t m_page_cache_size;
+    mutable buffer_arena m_arena;
+    // the memory pressure events which have been responded to
+    mutable std::uint64_t m_pressure_generation;
     using list_type = std::list<std::tuple<id, page>>;
     mutable list_type m_lru_order;
     mutable std::size_t m_allocated_pages;
     mutable std::unordered_map<id, typename list_type::iterator> m_page_cache;
+    mutable stats::table_counters m_stats;
+    std::unique_ptr<trace::writer> m_tracer;
+
+    // bit `n` is set if accesses with memory type `n` count towards the hot
+    // set
+    std::uint32_t m_hot_mem_types;
+    mutable std::unordered_map<id, std::uint64_t> m_access_counts;
 
+    // the shared budget this table is attached to, if any
+    cache_manager* m_manager;
+    // the manager's clock when the current operation started; pages used
+    // since then are not taken back to make room
+    mutable std::uint64_t m_operation_start;
+
+    /** A cached page. The buffer is owned by the table's arena.
+     */
     class page {
     private:
         bool m_dirty;
         bool m_zero_on_use;
-        std::unique_ptr<char[]> m_data;
+        char* m_data;
+        // a write left the page clean because the kv_store already held its
+        // bytes; the writeback it saved is counted when the page is next
+        // flushed or evicted
+        bool m_rewritten;
+        // the bytes written since the page was last clean
+        std::size_t m_dirty_begin;
+        std::size_t m_dirty_end;
+        // the manager's clock at the last use, and the number of uses; only
+        // kept when the table is attached to a `cache_manager`
+        std::uint64_t m_last_used;
+        std::uint32_t m_uses;
 
     public:
-        page(std::size_t page_size)
+        explicit page(char* data)
             : m_dirty(false),
               m_zero_on_use(false),
-              m_data(std::make_unique<char[]>(page_size)) {}
+              m_data(data),
+              m_rewritten(false),
+              m_dirty_begin(0),
+              m_dirty_end(0),
+              m_last_used(0),
+              m_uses(0) {}
 
         page(page&& mvfrom) noexcept
             : m_dirty(mvfrom.m_dirty),
-              m_data(std::move(mvfrom.m_data)) {}
+              m_zero_on_use(mvfrom.m_zero_on_use),
+              m_data(mvfrom.m_data),
+              m_rewritten(mvfrom.m_rewritten),
+              m_dirty_begin(mvfrom.m_dirty_begin),
+              m_dirty_end(mvfrom.m_dirty_end),
+              m_last_used(mvfrom.m_last_used),
+              m_uses(mvfrom.m_uses) {}
 
         page& operator=(page&& mvfrom) noexcept {
             m_dirty = mvfrom.m_dirty;
-            m_data = std::move(mvfrom.m_data);
+            m_zero_on_use = mvfrom.m_zero_on_use;
+            m_data = mvfrom.m_data;
+            m_rewritten = mvfrom.m_rewritten;
+            m_dirty_begin = mvfrom.m_dirty_begin;
+            m_dirty_end = mvfrom.m_dirty_end;
+            m_last_used = mvfrom.m_last_used;
+            m_uses = mvfrom.m_uses;
             return *this;
         }
 
         void reset() {
             m_zero_on_use = false;
             m_dirty = false;
+            m_rewritten = false;
+            m_last_used = 0;
+            m_uses = 0;
+        }
+
+        void touch() {
+            m_last_used = cache_manager::tick();
+            if (m_uses < std::numeric_limits<std::uint32_t>::max()) {
+                ++m_uses;
+            }
+        }
+
+        std::uint64_t last_used() const {
+            return m_last_used;
+        }
+
+        std::uint32_t uses() const {
+            return m_uses;
         }
 
         void invalidate() {
             m_zero_on_use = true;
             m_dirty = false;
+            m_rewritten = false;
+        }
+
+        /** Did a write leave the page clean since it was last written back?
+         */
+        bool rewritten() const {
+            return m_rewritten;
+        }
+
+        /** Mark a page as written back.
+         */
+        void written_back() {
+            m_dirty = false;
+            m_rewritten = false;
         }
 
         void read(std::size_t addr,
                   utils::out_buffer& buffer,
                   std::size_t page_size) {
             if (m_zero_on_use) {
-                std::memset(m_data.get(), 0, page_size);
+                std::memset(m_data, 0, page_size);
                 m_zero_on_use = false;
             }
 
             std::memcpy(buffer.data(), &m_data[addr], buffer.size());
         }
 
+        /** Write into the page.
+
+            @param addr The offset into the page.
+            @param data The bytes to write.
+            @param page_size The size of the page.
+            @param stored Does the kv_store hold the page's current bytes? A
+                   write which does not change them then leaves a clean page
+                   clean. Pages past the end of the store must be written
+                   even if they are unchanged.
+         */
         void write(std::size_t addr,
                    const std::string_view& data,
-                   std::size_t page_size) {
+                   std::size_t page_size,
+                   bool stored) {
+            if (stored && !m_dirty && !m_zero_on_use &&
+                std::memcmp(&m_data[addr], data.data(), data.size()) == 0) {
+                m_rewritten = true;
+                return;
+            }
+
+            std::size_t begin = addr;
+            std::size_t end = addr + data.size();
             if (m_zero_on_use) {
-                std::memset(m_data.get(), 0, addr);
-                std::memset(m_data.get() + data.size(),
+                begin = 0;
+                end = page_size;
+                // zero the parts of the page around the write
+                std::memset(m_data, 0, addr);
+                std::memset(m_data + addr + data.size(),
                             0,
-                            page_size - addr + data.size());
+                            page_size - addr - data.size());
                 m_zero_on_use = false;
             }
             std::memcpy(&m_data[addr], data.data(), data.size());
 
             // mark that this page is dirty
+            if (m_dirty) {
+                begin = std::min(begin, m_dirty_begin);
+                end = std::max(end, m_dirty_end);
+            }
             m_dirty = true;
+            m_dirty_begin = begin;
+            m_dirty_end = end;
         }
 
         const char* data() const {
-            return m_data.get();
+            return m_data;
         }
 
         char* data() {
-            return m_data.get();
-        }
-
-        void dirty(bool dirty) {
-            m_dirty = dirty;
+            return m_data;
         }
 
         bool dirty() const {
             return m_dirty;
         }
+
+        /** The first byte written since the page was last clean.
+         */
+        std::size_t dirty_begin() const {
+            return m_dirty_begin;
+        }
+
+        /** One past the last byte written since the page was last clean.
+         */
+        std::size_t dirty_end() const {
+            return m_dirty_end;
+        }
     };
 
     std::size_t page_size() const {
         return m_kv_store.page_size();
     }
 
-    /** Read a page by first looking in the cache, then falling back to
-        `m_kv_store`.
-
-        @param page_id The page id to read.
-        @return A reference to the given page.
+    /** Write a page back to the kv_store if it is dirty.
      */
-    page& read_page(id page_id) const {
-        auto search = m_page_cache.find(page_id);
-        if (search != m_page_cache.end()) {
-            if (search->second != m_lru_order.begin()) {
-                m_lru_order.splice(m_lru_order.begin(),
-                                   m_lru_order,
-                                   search->second,
-                                   std::next(search->second));
+    void write_back(id page_id, page& p) const {
+        if (p.dirty()) {
+            std::string_view data(p.data(), page_size());
+            if constexpr (has_range_write_v<kv_store>) {
+                m_kv_store.write(page_id, data, p.dirty_begin(), p.dirty_end());
             }
-            return std::get<1>(*search->second);
+            else {
+                m_kv_store.write(page_id, data);
+            }
+            m_stats.writebacks.add();
+        }
+        else if (p.rewritten()) {
+            m_stats.unchanged_writebacks.add();
+        }
+        // only once the write succeeded, so that a failed page is retried
+        p.written_back();
+    }
+
+    /** Evict the least recently used page, writing it back if it is dirty.
+        The page's node is left at the back of the lru order.
+
+        @return The evicted page.
+     */
+    page& evict_back() const {
+        auto& [to_evict, page] = m_lru_order.back();
+        write_back(to_evict, page);
+        m_stats.evictions.add();
+        // remove the page from the cache mapping
+        m_page_cache.erase(to_evict);
+        return std::get<1>(m_lru_order.back());
+    }
+
+    /** Give the least recently used page's buffer back to the arena.
+     */
+    void discard_back() const {
+        m_arena.release(evict_back().data());
+        m_lru_order.pop_back();
+        --m_allocated_pages;
+    }
+
+    /** Start a public operation: note the time so that pages used by the
+        operation are not taken back to make room for each other, and drop
+        half of the clean pages if there has been memory pressure since the
+        last check.
+     */
+    void begin_operation() const {
+        if (m_manager) {
+            m_operation_start = cache_manager::tick();
+        }
+
+        std::uint64_t generation = memory::pressure_generation();
+        if (generation != m_pressure_generation) {
+            m_pressure_generation = generation;
+            shrink(m_page_cache.size() / 2);
+        }
+    }
+
+    /** Take a page to hold `page_id`, which must not be in the cache. If the
+        cache is full, the least recently used page is evicted. If the table
+        is attached to a `cache_manager`, a new page is only allocated once
+        the manager has made room for it in the shared budget; when this
+        table holds the coldest page instead, that page is reused.
+
+        The page is left at the back of the lru order and is not added to
+        `m_page_cache`; call `insert_page` once it has been filled.
+
+        @param page_id The page id which will be held.
+        @return The page to fill.
+     */
+    page& take_page(id page_id) const {
+        bool full = m_page_cache.size() >= m_page_cache_size;
+        if (!full && m_manager && !m_manager->reserve(*this, m_arena.buffer_size())) {
+            // Only reuse our own page if this operation has not used it,
+            // otherwise go over the budget.
+            full = !m_lru_order.empty() &&
+                   std::get<1>(m_lru_order.back()).last_used() < m_operation_start;
         }
 
-        if (m_page_cache.size() == m_page_cache_size) {
+        if (full) {
             // The cache is full, we are going to steal the buffer used for
             // the least recently used page.
-            const auto& [to_evict, page] = m_lru_order.back();
-            if (page.dirty()) {
-                m_kv_store.write(to_evict,
-                                 std::string_view(page.data(), page_size()));
-            }
-            // remove the page from the cache mapping
-            m_page_cache.erase(to_evict);
+            evict_back();
 
             // reset the page and change the node's id to the new page id
             auto& [id, p] = m_lru_order.back();
@@ -153,18 +549,21 @@ private:
             // The cache is not yet full. Allocate a new page at the end of
             // the lru list. We allocate this at the end because the read may
             // fail and we want to reuse the page as early as possible.
-            m_lru_order.emplace_back(page_id, page_size());
+            m_lru_order.emplace_back(page_id, m_arena.allocate());
             ++m_allocated_pages;
         }
+        return std::get<1>(m_lru_order.back());
+    }
 
-        // Fill the page from the kv_store. Note: `m_kv_store.read` MAY throw
-        // an exception and fail. If that happens, we do not want to move the
-        // page node to the front of the lru order or add the entry to the
-        // cache.
-        page& p = std::get<1>(m_lru_order.back());
-        utils::out_buffer b{p.data(), page_size()};
-        m_kv_store.read(page_id, b);
+    /** Move the page at the back of the lru order to the front and add it to
+        the cache.
 
+        @param page_id The page id held by the page.
+     */
+    void insert_page(id page_id) const {
+        if (m_manager) {
+            std::get<1>(m_lru_order.back()).touch();
+        }
         if (m_allocated_pages > 1) {
             m_lru_order.splice(m_lru_order.begin(),
                                m_lru_order,
@@ -172,6 +571,428 @@ private:
                                m_lru_order.end());
         }
         m_page_cache.emplace(page_id, m_lru_order.begin());
+    }
+
+    /** Remove a page from the cache without writing it back. This is used to
+        discard pages which were inserted but could not be filled.
+
+        @param page_id The page to remove.
+     */
+    void drop_page(id page_id) const {
+        auto search = m_page_cache.find(page_id);
+        m_arena.release(std::get<1>(*search->second).data());
+        m_lru_order.erase(search->second);
+        m_page_cache.erase(search);
+        --m_allocated_pages;
+    }
+
+    /** Read a page by first looking in the cache, then falling back to
+        `m_kv_store`.
+
+        @param page_id The page id to read.
+        @return A reference to the given page.
+     */
+    page& read_page(id page_id) const {
+        auto search = m_page_cache.find(page_id);
+        if (search != m_page_cache.end()) {
+            if (search->second != m_lru_order.begin()) {
+                m_lru_order.splice(m_lru_order.begin(),
+                                   m_lru_order,
+                                   search->second,
+                                   std::next(search->second));
+            }
+            if (m_manager) {
+                std::get<1>(*search->second).touch();
+            }
+            m_stats.hits.add();
+            return std::get<1>(*search->second);
+        }
+        m_stats.misses.add();
+
+        // Fill the page from the kv_store. Note: `m_kv_store.read` MAY throw
+        // an exception and fail. If that happens, we do not want to move the
+        // page node to the front of the lru order or add the entry to the
+        // cache.
+        page& p = take_page(page_id);
+        utils::out_buffer b{p.data(), page_size()};
+        m_kv_store.read(page_id, b);
+        insert_page(page_id);
+        return p;
+    }
+
+    /** Load a run of consecutive pages which are not in the cache with a
+        single call to the kv_store.
+
+        The run starts at `first` and stops at the first cached page, at
+        `last`, or when it would fill the cache.
+
+        @param first The first page to load.
+        @param last The last page that may be loaded.
+        @return The number of pages loaded. This is 0 if the run would only
+                be a single page, which should be read with `read_page`.
+     */
+    std::size_t load_run(id first, id last) const {
+        std::size_t count = 0;
+        while (first + count <= last && count < m_page_cache_size &&
+               !m_page_cache.count(first + count)) {
+            ++count;
+        }
+        if (count < 2) {
+            return 0;
+        }
+
+        std::vector<utils::out_buffer> buffers;
+        buffers.reserve(count);
+        try {
+            for (id page_id = first; page_id < first + count; ++page_id) {
+                page& p = take_page(page_id);
+                insert_page(page_id);
+                buffers.emplace_back(p.data(), page_size());
+            }
+            m_kv_store.read(first, buffers);
+        }
+        catch (...) {
+            // drop the pages we failed to fill
+            for (id page_id = first; page_id < first + buffers.size(); ++page_id) {
+                drop_page(page_id);
+            }
+            throw;
+        }
+
+        m_stats.misses.add(count);
+        return count;
+    }
+
+    /** Load pages which are not in the cache, fetching them from the
+        kv_store in parallel. If the kv_store can read many pages at once,
+        consecutive pages are fetched together. If it can read many runs of
+        pages at once, they are all handed to it in one call. Otherwise, if
+        it can read pages asynchronously, each completed read starts the
+        next, and if it can do neither the runs are read on the I/O service.
+
+        @param pages The ids of the pages to load. These must be sorted,
+               unique, not cached, and there must be no more of them than
+               `page_cache_size`.
+        @param concurrency The maximum number of fetches to run at once.
+        @param level The priority of the fetches.
+        @return The number of pages loaded. If any fetch fails, the pages
+                which could not be loaded are removed from the cache and the
+                first error is rethrown.
+     */
+    std::size_t load_pages(const std::vector<id>& pages,
+                           std::size_t concurrency,
+                           io::priority level) const {
+        std::vector<page_run> runs;
+
+        // Taking pages may write back dirty pages, which happens on this
+        // thread before any fetches start.
+        std::size_t taken = 0;
+        try {
+            for (id page_id : pages) {
+                page& p = take_page(page_id);
+                insert_page(page_id);
+                ++taken;
+
+                utils::out_buffer b{p.data(), page_size()};
+                if (has_multi_page_read_v<kv_store> && !runs.empty() &&
+                    runs.back().first + runs.back().buffers.size() == page_id) {
+                    runs.back().buffers.push_back(b);
+                }
+                else {
+                    runs.push_back({page_id, {b}, nullptr});
+                }
+            }
+        }
+        catch (...) {
+            for (std::size_t ix = 0; ix < taken; ++ix) {
+                drop_page(pages[ix]);
+            }
+            throw;
+        }
+
+        if constexpr (has_batch_read_v<kv_store>) {
+            try {
+                m_kv_store.read(runs, concurrency, level);
+            }
+            catch (...) {
+                // we can't tell which runs were filled, drop them all
+                for (page_run& r : runs) {
+                    if (!r.error) {
+                        r.error = std::current_exception();
+                    }
+                }
+            }
+        }
+        else if constexpr (has_async_read_v<kv_store>) {
+            // one read per page, recording the errors by run
+            std::vector<std::pair<std::size_t, std::size_t>> reads;
+            for (std::size_t ix = 0; ix < runs.size(); ++ix) {
+                for (std::size_t offset = 0; offset < runs[ix].buffers.size(); ++offset) {
+                    reads.emplace_back(ix, offset);
+                }
+            }
+            std::mutex errors_mutex;
+            auto start = [&](std::size_t ix) {
+                auto [run_ix, offset] = reads[ix];
+                page_run& r = runs[run_ix];
+                async::future<void> read;
+                try {
+                    read =
+                        m_kv_store.async_read(r.first + offset, r.buffers[offset], level);
+                }
+                catch (...) {
+                    read = async::make_error<void>(std::current_exception());
+                }
+                return read.then([&r, &errors_mutex](async::future<void> f) {
+                    try {
+                        f.get();
+                    }
+                    catch (...) {
+                        std::lock_guard<std::mutex> lock(errors_mutex);
+                        if (!r.error) {
+                            r.error = std::current_exception();
+                        }
+                    }
+                });
+            };
+            async::for_each(reads.size(), concurrency, start).wait();
+        }
+        else {
+            auto read_run = [&](std::size_t ix) {
+                page_run& r = runs[ix];
+                try {
+                    if constexpr (has_multi_page_read_v<kv_store>) {
+                        if (r.buffers.size() > 1) {
+                            m_kv_store.read(r.first, r.buffers);
+                            return;
+                        }
+                    }
+                    m_kv_store.read(r.first, r.buffers.front());
+                }
+                catch (...) {
+                    r.error = std::current_exception();
+                }
+            };
+            io::service::global().parallel(level, runs.size(), concurrency, read_run);
+        }
+
+        std::size_t loaded = pages.size();
+        std::exception_ptr first_error;
+        for (std::size_t ix = 0; ix < runs.size(); ++ix) {
+            if (!runs[ix].error) {
+                continue;
+            }
+            if (!first_error) {
+                first_error = runs[ix].error;
+            }
+            for (std::size_t offset = 0; offset < runs[ix].buffers.size(); ++offset) {
+                drop_page(runs[ix].first + offset);
+                --loaded;
+            }
+        }
+        if (first_error) {
+            std::rethrow_exception(first_error);
+        }
+        return loaded;
+    }
+
+    /** Serve a batch of requests, first loading every missing page they
+        touch in parallel.
+
+        Requests are grouped so that the pages each group touches fit in the
+        cache together, and each group is loaded and then served in order.
+
+        @param requests The requests, each with an `addr` member.
+        @param concurrency The maximum number of fetches to run at once.
+        @param size A function returning the size of a request.
+        @param serve A function which performs a request given the set of
+               pages which were just loaded for it and not yet accessed.
+     */
+    template<typename request, typename size_function, typename serve_function>
+    void batched(std::vector<request>& requests,
+                 std::size_t concurrency,
+                 size_function&& size,
+                 serve_function&& serve) const {
+        std::size_t begin = 0;
+        while (begin < requests.size()) {
+            std::unordered_set<id> needed;
+            std::vector<id> missing;
+            std::size_t end = begin;
+            for (; end < requests.size(); ++end) {
+                std::size_t request_size = size(requests[end]);
+                if (!request_size) {
+                    continue;
+                }
+                std::size_t addr = requests[end].addr;
+                id first = addr / page_size();
+                id last = (addr + request_size - 1) / page_size();
+
+                std::size_t new_pages = 0;
+                for (id page_id = first; page_id <= last; ++page_id) {
+                    new_pages += !needed.count(page_id);
+                }
+                if (end > begin && needed.size() + new_pages > m_page_cache_size) {
+                    break;
+                }
+
+                for (id page_id = first; page_id <= last; ++page_id) {
+                    if (needed.insert(page_id).second && !m_page_cache.count(page_id)) {
+                        missing.push_back(page_id);
+                    }
+                }
+            }
+
+            // move the cached pages that are needed to the front so that
+            // loading the missing pages does not evict them
+            for (id page_id : needed) {
+                auto search = m_page_cache.find(page_id);
+                if (search == m_page_cache.end()) {
+                    continue;
+                }
+                if (search->second != m_lru_order.begin()) {
+                    m_lru_order.splice(m_lru_order.begin(),
+                                       m_lru_order,
+                                       search->second,
+                                       std::next(search->second));
+                }
+                if (m_manager) {
+                    std::get<1>(*search->second).touch();
+                }
+            }
+
+            std::sort(missing.begin(), missing.end());
+            if (missing.size() > m_page_cache_size) {
+                // a single request larger than the cache
+                missing.resize(m_page_cache_size);
+            }
+            m_stats.misses.add(load_pages(missing, concurrency, io::priority::demand));
+
+            std::unordered_set<id> fresh(missing.begin(), missing.end());
+            for (std::size_t ix = begin; ix < end; ++ix) {
+                serve(requests[ix], fresh);
+            }
+            begin = end;
+        }
+    }
+
+    void read_range(std::size_t addr,
+                    utils::out_buffer& buffer,
+                    std::uint8_t mem_type,
+                    std::unordered_set<id>* fresh) const {
+        if (!buffer.size()) {
+            return;
+        }
+
+        std::size_t min_page = addr / page_size();
+        std::size_t max_page = (addr + buffer.size() - 1) / page_size();
+
+        // the number of upcoming pages which were loaded by `load_run`
+        std::size_t loaded = 0;
+        for (id page_id = min_page; page_id <= max_page; ++page_id) {
+            std::size_t page_start = page_id * page_size();
+            std::size_t offset = page_id == min_page ? addr - page_start : 0;
+            std::size_t read_size =
+                std::min(page_size(), addr + buffer.size() - page_start) - offset;
+            auto sub_buffer = buffer.substr(page_start + offset - addr, read_size);
+
+            bool is_fresh = fresh && fresh->erase(page_id);
+            if constexpr (has_multi_page_read_v<kv_store>) {
+                if (!loaded && !is_fresh && page_id != max_page) {
+                    loaded = load_run(page_id, max_page);
+                }
+            }
+
+            access(trace::op::read,
+                   page_id,
+                   offset,
+                   read_size,
+                   mem_type,
+                   loaded > 0 || is_fresh)
+                .read(offset, sub_buffer, page_size());
+            if (loaded) {
+                --loaded;
+            }
+        }
+    }
+
+    void write_range(std::size_t addr,
+                     const std::string_view& data,
+                     std::uint8_t mem_type,
+                     std::unordered_set<id>* fresh) {
+        if (!data.size()) {
+            return;
+        }
+
+        std::size_t min_page = addr / page_size();
+        std::size_t max_page = (addr + data.size() - 1) / page_size();
+
+        for (id page_id = min_page; page_id <= max_page; ++page_id) {
+            std::size_t page_start = page_id * page_size();
+            std::size_t offset = page_id == min_page ? addr - page_start : 0;
+            std::size_t write_size =
+                std::min(page_size(), addr + data.size() - page_start) - offset;
+
+            bool is_fresh = fresh && fresh->erase(page_id);
+            page& p =
+                access(trace::op::write, page_id, offset, write_size, mem_type, is_fresh);
+            // hdf5 often rewrites metadata with the same bytes, which should
+            // not cost an upload
+            p.write(offset,
+                    data.substr(page_start + offset - addr, write_size),
+                    page_size(),
+                    page_id < m_kv_store.allocated_pages());
+        }
+    }
+
+    void count_access(id page_id, std::uint8_t mem_type) const {
+        if (mem_type < 32 && (m_hot_mem_types >> mem_type) & 1) {
+            ++m_access_counts[page_id];
+        }
+    }
+
+    /** Read a page in order to access part of it, recording the access if
+        tracing is enabled.
+
+        @param operation The kind of access.
+        @param page_id The page id to access.
+        @param offset The offset of the access into the page.
+        @param size The number of bytes being accessed.
+        @param mem_type The hdf5 memory type of the access.
+        @param loaded Was the page just loaded by `load_run` or
+               `load_pages`? Its miss has already been counted.
+        @return A reference to the given page.
+     */
+    page& access(trace::op operation,
+                 id page_id,
+                 std::size_t offset,
+                 std::size_t size,
+                 std::uint8_t mem_type,
+                 bool loaded = false) const {
+        auto get = [&]() -> page& {
+            if (loaded) {
+                auto search = m_page_cache.find(page_id);
+                if (search != m_page_cache.end()) {
+                    return std::get<1>(*search->second);
+                }
+            }
+            return read_page(page_id);
+        };
+
+        if (!m_tracer) {
+            count_access(page_id, mem_type);
+            return get();
+        }
+
+        count_access(page_id, mem_type);
+        bool hit = !loaded && m_page_cache.count(page_id);
+        page& p = get();
+        m_tracer->write({page_id,
+                         m_tracer->now(),
+                         static_cast<std::uint32_t>(offset),
+                         static_cast<std::uint32_t>(size),
+                         operation,
+                         hit,
+                         mem_type});
         return p;
     }
 
@@ -179,30 +1000,106 @@ public:
     table(const kv_store& store, std::size_t page_cache_size)
         : m_kv_store(store),
           m_page_cache_size(page_cache_size),
-          m_allocated_pages(0) {}
+          m_arena(m_kv_store.page_size(), page_cache_size),
+          m_pressure_generation(memory::pressure_generation()),
+          m_allocated_pages(0),
+          m_hot_mem_types(0),
+          m_manager(nullptr),
+          m_operation_start(0) {}
 
     table(kv_store&& store, std::size_t page_cache_size)
         : m_kv_store(std::move(store)),
           m_page_cache_size(page_cache_size),
-          m_allocated_pages(0) {}
+          m_arena(m_kv_store.page_size(), page_cache_size),
+          m_pressure_generation(memory::pressure_generation()),
+          m_allocated_pages(0),
+          m_hot_mem_types(0),
+          m_manager(nullptr),
+          m_operation_start(0) {}
 
     table(table&& mvfrom) noexcept
         : m_kv_store(std::move(mvfrom.m_kv_store)),
           m_page_cache_size(mvfrom.m_page_cache_size),
+          m_arena(std::move(mvfrom.m_arena)),
+          m_pressure_generation(mvfrom.m_pressure_generation),
           m_lru_order(std::move(mvfrom.m_lru_order)),
           m_allocated_pages(mvfrom.m_allocated_pages),
-          m_page_cache(std::move(mvfrom.m_page_cache)) {}
+          m_page_cache(std::move(mvfrom.m_page_cache)),
+          m_stats(mvfrom.m_stats),
+          m_tracer(std::move(mvfrom.m_tracer)),
+          m_hot_mem_types(mvfrom.m_hot_mem_types),
+          m_access_counts(std::move(mvfrom.m_access_counts)),
+          m_manager(nullptr),
+          m_operation_start(0) {
+        // the attachment is not moved, the manager holds the old address
+        mvfrom.detach();
+    }
 
     table& operator=(table&& mvfrom) noexcept {
         m_kv_store = std::move(m_kv_store);
         m_page_cache_size = mvfrom.m_page_cache_size;
+        m_arena = std::move(mvfrom.m_arena);
+        m_pressure_generation = mvfrom.m_pressure_generation;
         m_lru_order = std::move(mvfrom.m_lru_order);
         m_allocated_pages = mvfrom.m_allocated_pages;
         m_page_cache = std::move(mvfrom.m_page_cache);
+        m_stats = mvfrom.m_stats;
+        m_tracer = std::move(mvfrom.m_tracer);
+        m_hot_mem_types = mvfrom.m_hot_mem_types;
+        m_access_counts = std::move(mvfrom.m_access_counts);
+        detach();
+        mvfrom.detach();
 
         return *this;
     }
 
+    ~table() override {
+        detach();
+    }
+
+    /** Attach the table to a manager which enforces a budget shared with
+        other tables. The table must not be moved while it is attached.
+
+        @param manager The manager to attach to.
+     */
+    void attach(cache_manager& manager) {
+        detach();
+        manager.attach(*this);
+        m_manager = &manager;
+    }
+
+    /** Detach the table from its manager, if it is attached.
+     */
+    void detach() noexcept {
+        if (m_manager) {
+            m_manager->detach(*this);
+            m_manager = nullptr;
+        }
+    }
+
+    /** The manager the table is attached to, or `nullptr`.
+     */
+    cache_manager* manager() const {
+        return m_manager;
+    }
+
+    std::optional<coldness> coldest() const override {
+        if (m_page_cache.empty()) {
+            return std::nullopt;
+        }
+        const page& p = std::get<1>(m_lru_order.back());
+        return coldness{p.uses() > 1, p.last_used()};
+    }
+
+    std::size_t cached_bytes() const override {
+        return m_allocated_pages * m_arena.buffer_size();
+    }
+
+    void evict_coldest() override {
+        discard_back();
+        m_arena.trim();
+    }
+
     /** Access the kv_store that backs this table.
      */
     kv_store& store() {
@@ -215,86 +1112,299 @@ public:
         return m_kv_store;
     }
 
-    /** Read data from the page table.
+    /** The maximum number of pages held in memory.
+     */
+    std::size_t page_cache_size() const {
+        return m_page_cache_size;
+    }
 
-        @param addr The start address of the read.
-        @param buffer The output buffer to fill.
+    /** The number of pages currently held in memory.
      */
-    void read(std::size_t addr, utils::out_buffer& buffer) const {
-        std::size_t min_page = addr / page_size();
-        std::size_t max_page = (addr + buffer.size()) / page_size();
+    std::size_t cached_pages() const {
+        return m_page_cache.size();
+    }
+
+    /** Change the maximum number of pages held in memory. If the cache holds
+        more pages than the new size, the least recently used pages are
+        evicted, writing back the dirty ones, and their memory is given back
+        to the system.
+
+        @param page_cache_size The new maximum number of pages, at least 1.
+     */
+    void resize(std::size_t page_cache_size) {
+        m_page_cache_size = std::max<std::size_t>(page_cache_size, 1);
+        while (m_page_cache.size() > m_page_cache_size) {
+            discard_back();
+        }
+        m_arena.trim();
+    }
 
-        std::size_t min_page_start = min_page * page_size();
-        std::size_t min_page_offset = addr - min_page_start;
-        std::size_t read_size = std::min(page_size() - min_page_offset,
-                                         buffer.size());
+    /** Drop clean pages, starting from the least recently used, and give
+        their memory back to the system. Dirty pages are kept. This is how
+        the table responds to memory pressure reported by
+        `memory::watch_pressure`.
 
+        @param count The maximum number of pages to drop.
+        @return The number of pages dropped.
+     */
+    std::size_t shrink(std::size_t count) const {
+        std::size_t dropped = 0;
+        auto it = m_lru_order.end();
+        while (dropped < count && it != m_lru_order.begin()) {
+            --it;
+            auto& [page_id, p] = *it;
+            if (p.dirty()) {
+                continue;
+            }
+            m_page_cache.erase(page_id);
+            m_arena.release(p.data());
+            it = m_lru_order.erase(it);
+            --m_allocated_pages;
+            m_stats.evictions.add();
+            ++dropped;
+        }
+        if (dropped) {
+            m_arena.trim();
+        }
+        return dropped;
+    }
+
+    /** The cache counters for this table.
+     */
+    const stats::table_counters& stats() const {
+        return m_stats;
+    }
+
+    /** Record every page access to a trace file.
+
+        @param tracer The trace to write to, or `nullptr` to stop tracing.
+     */
+    void trace(std::unique_ptr<trace::writer>&& tracer) {
+        m_tracer = std::move(tracer);
+    }
+
+    /** The number of pages recorded as the hot set when the table is
+        flushed.
+     */
+    static constexpr std::size_t hot_set_size = 32;
 
-        auto sub_buffer = buffer.substr(0, read_size);
-        read_page(min_page).read(min_page_offset, sub_buffer, page_size());
+    /** Count accesses to pages so that the most used pages can be recorded
+        as a hot set.
+
+        @param mem_types A bitmask where bit `n` is set if accesses with
+               memory type `n` should be counted. Pass 0 to stop counting.
+     */
+    void track_hot_pages(std::uint32_t mem_types) {
+        m_hot_mem_types = mem_types;
+    }
 
-        if (min_page != max_page) {
-            std::size_t max_page_start = max_page * page_size();
-            std::size_t offset = max_page_start - addr;
-            std::size_t read_size = addr + buffer.size() - max_page_start;
-            auto sub_buffer = buffer.substr(offset, read_size);
-            read_page(max_page).read(0,sub_buffer, page_size());
+    /** The most frequently accessed pages, counting only accesses with the
+        memory types passed to `track_hot_pages`.
+
+        @param count The maximum number of pages to return.
+        @return The page ids, most accessed first.
+     */
+    std::vector<id> hot_pages(std::size_t count) const {
+        std::vector<std::pair<std::uint64_t, id>> ranked;
+        ranked.reserve(m_access_counts.size());
+        for (const auto& [page_id, accesses] : m_access_counts) {
+            ranked.emplace_back(accesses, page_id);
         }
 
-        for (id page_id = min_page + 1;
-             page_id < max_page;
-             ++page_id) {
-            std::size_t page_start = page_id * page_size();
-            std::size_t offset = page_start - addr;
-            auto sub_buffer = buffer.substr(offset, page_size());
-            read_page(page_id).read(0, sub_buffer, page_size());
+        count = std::min(count, ranked.size());
+        std::partial_sort(ranked.begin(),
+                          ranked.begin() + count,
+                          ranked.end(),
+                          [](const auto& a, const auto& b) {
+                              return a.first > b.first ||
+                                     (a.first == b.first && a.second < b.second);
+                          });
+
+        std::vector<id> out;
+        out.reserve(count);
+        for (std::size_t ix = 0; ix < count; ++ix) {
+            out.push_back(ranked[ix].second);
         }
+        return out;
+    }
+
+    /** Load pages into the cache before they are read, fetching them from
+        the kv_store in parallel.
+
+        Pages which are already cached are skipped, and at most
+        `page_cache_size` pages are loaded so that the prefetched pages do not
+        evict each other. If the kv_store can read many pages at once,
+        consecutive pages are fetched together.
+
+        @param pages The ids of the pages to load, in any order.
+        @param concurrency The maximum number of fetches to run at once.
+        @return The number of pages loaded.
+     */
+    std::size_t prefetch(std::vector<id> pages, std::size_t concurrency = 16) const {
+        begin_operation();
+        std::sort(pages.begin(), pages.end());
+        pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+        pages.erase(std::remove_if(pages.begin(),
+                                   pages.end(),
+                                   [&](id page_id) { return m_page_cache.count(page_id); }),
+                    pages.end());
+        if (pages.size() > m_page_cache_size) {
+            pages.resize(m_page_cache_size);
+        }
+        if (pages.empty()) {
+            return 0;
+        }
+
+        std::size_t loaded = load_pages(pages, concurrency, io::priority::prefetch);
+        m_stats.prefetches.add(loaded);
+        return loaded;
+    }
+
+    /** Read data from the page table.
+
+        @param addr The start address of the read.
+        @param buffer The output buffer to fill.
+        @param mem_type The hdf5 memory type of the read. This is only used
+               for tracing.
+     */
+    void read(std::size_t addr,
+              utils::out_buffer& buffer,
+              std::uint8_t mem_type = 0) const {
+        begin_operation();
+        read_range(addr, buffer, mem_type, nullptr);
     }
 
     /** Write data into the page table.
 
         @param addr The start address of the write.
         @param data The data to write into the table.
+        @param mem_type The hdf5 memory type of the write. This is only used
+               for tracing.
     */
-    void write(std::size_t addr, const std::string_view& data) {
-        std::size_t min_page = addr / page_size();
-        std::size_t max_page = (addr + data.size()) / page_size();
-
-        std::size_t min_page_start = min_page * page_size();
-        std::size_t min_page_offset = addr - min_page_start;
-        std::size_t write_size = std::min(page_size() - min_page_offset,
-                                          data.size());
-        read_page(min_page).write(min_page_offset,
-                                  data.substr(0, write_size),
-                                  page_size());
-
-        if (min_page != max_page) {
-            std::size_t max_page_start = max_page * page_size();
-            std::size_t write_size = addr + data.size() - max_page_start;
-            std::size_t offset = max_page_start - addr;
-            read_page(max_page).write(0,
-                                      data.substr(offset, write_size),
-                                      page_size());
-        }
-
-        for (id page_id = min_page + 1;
-             page_id < max_page;
-             ++page_id) {
-            std::size_t page_start = page_id * page_size();
-            std::size_t offset = page_start - addr;
-            read_page(page_id).write(0,
-                                     data.substr(offset, page_size()),
-                                     page_size());
+    void write(std::size_t addr,
+               const std::string_view& data,
+               std::uint8_t mem_type = 0) {
+        begin_operation();
+        write_range(addr, data, mem_type, nullptr);
+    }
+
+    /** Read many ranges at once.
+
+        The pages touched by the reads are deduplicated and every page which
+        is missing from the cache is fetched in parallel before any data is
+        copied out. If the reads touch more pages than fit in the cache, they
+        are served in batches which do.
+
+        @param reads The reads to perform.
+        @param concurrency The maximum number of fetches to run at once.
+     */
+    void read_vector(std::vector<vector_read>& reads,
+                     std::size_t concurrency = 16) const {
+        begin_operation();
+        batched(
+            reads,
+            concurrency,
+            [](vector_read& r) { return r.buffer.size(); },
+            [&](vector_read& r, std::unordered_set<id>& fresh) {
+                read_range(r.addr, r.buffer, r.mem_type, &fresh);
+            });
+    }
+
+    /** Write many ranges at once.
+
+        Like `read_vector`, every page which the writes touch and which is
+        missing from the cache is fetched in parallel before any data is
+        written.
+
+        @param writes The writes to perform, in order.
+        @param concurrency The maximum number of fetches to run at once.
+     */
+    void write_vector(std::vector<vector_write>& writes, std::size_t concurrency = 16) {
+        begin_operation();
+        batched(
+            writes,
+            concurrency,
+            [](vector_write& w) { return w.data.size(); },
+            [&](vector_write& w, std::unordered_set<id>& fresh) {
+                write_range(w.addr, w.data, w.mem_type, &fresh);
+            });
+    }
+
+    /** Pick up changes made to the kv_store by another writer without
+        discarding the cache.
+
+        The kv_store is refreshed, then every clean cached page is
+        revalidated in parallel and the pages which changed are reloaded in
+        place. Dirty pages are left alone. This requires a kv_store which
+        satisfies `has_revalidate_v`.
+
+        @param concurrency The maximum number of revalidations to run at
+               once.
+        @return The number of pages which changed and were reloaded. If any
+                revalidation fails, the pages which could not be revalidated
+                are removed from the cache and the first error is rethrown.
+     */
+    std::size_t refresh(std::size_t concurrency = 16) {
+        static_assert(has_revalidate_v<kv_store>,
+                      "the kv_store cannot revalidate pages");
+
+        m_kv_store.refresh();
+
+        std::vector<std::tuple<id, page*>> pages;
+        for (auto& [page_id, p] : m_lru_order) {
+            if (!p.dirty()) {
+                pages.emplace_back(page_id, &p);
+            }
+        }
+
+        std::vector<std::exception_ptr> errors(pages.size());
+        std::vector<char> changed(pages.size(), false);
+        io::service::global().parallel(
+            io::priority::demand, pages.size(), concurrency, [&](std::size_t ix) {
+                auto [page_id, p] = pages[ix];
+                try {
+                    utils::out_buffer b{p->data(), page_size()};
+                    changed[ix] = m_kv_store.revalidate(page_id, b);
+                }
+                catch (...) {
+                    errors[ix] = std::current_exception();
+                }
+            });
+
+        std::size_t reloaded = 0;
+        std::exception_ptr first_error;
+        for (std::size_t ix = 0; ix < pages.size(); ++ix) {
+            auto [page_id, p] = pages[ix];
+            if (errors[ix]) {
+                // the page may have been partially overwritten
+                drop_page(page_id);
+                if (!first_error) {
+                    first_error = errors[ix];
+                }
+            }
+            else if (changed[ix]) {
+                p->reset();
+                ++reloaded;
+            }
+        }
+        if (first_error) {
+            std::rethrow_exception(first_error);
         }
+        return reloaded;
     }
 
     /** Flush the internal caches back to `store()`.
      */
     void flush() {
+        if (m_tracer) {
+            m_tracer->flush();
+        }
         for (auto& [id, page] : m_lru_order) {
-            if (page.dirty()) {
-                m_kv_store.write(id, std::string_view(page.data(), page_size()));
-                page.dirty(false);
+            write_back(id, page);
+        }
+        if constexpr (has_hot_pages_v<kv_store>) {
+            if (m_hot_mem_types && !m_access_counts.empty()) {
+                m_kv_store.hot_pages(hot_pages(hot_set_size));
             }
         }
         m_kv_store.flush();
@@ -1,16 +1,92 @@
+#include <map>
+#include <mutex>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "h5s3/kv_driver.h"
 #include "h5s3/private/page.h"
 #include "h5s3/private/out_buffer.h"
+#include "h5s3/private/stats.h"
 #include "h5s3/s3.h"
 
 namespace h5s3::s3_driver {
 
 /** The kv-store implementation backed by Amazon S3.
+
+    Pages are stored in groups of `pages_per_object` consecutive pages, one
+    group per object. With more than one page per object, pages are read with
+    range GETs and adjacent pages in the same object are read with a single
+    request. Objects are always written whole, so written pages are held
+    until the rest of their object has been written or `flush` is called.
+
+    The entity tag of the object each page was read from is remembered so
+    that `revalidate` can ask s3 for the page only if it has changed.
+
+    Objects are named `path/<object id>` by default, so every object of a file
+    shares one key prefix and one bucket, and s3 limits the request rate of
+    that prefix. With `key_prefixes` set, each object's key starts with one of
+    that many hashed prefixes, `<prefix>/path/<object id>`, and with more than
+    one bucket, each object is stored in a hashed choice of them. The `.meta`
+    object always lives at `path/.meta` in the url's bucket.
+
+    `endpoints` lists the addresses to spread the requests to the host over,
+    see `curl::endpoints`. The addresses are shared by every store using the
+    host.
+
+    With `content_addressed` set, each object is instead named by the sha256
+    of its contents, `.h5s3/objects/<sha256>`, and `.meta` maps each object
+    id to the hash it holds. Identical objects are stored once across every
+    file in the same buckets, and an object which already exists is not
+    uploaded again. Objects are never deleted, since other files may share
+    them.
+
+    With `log_structured` set, a flush does not rewrite the objects of dirty
+    pages. Instead, the bytes of each page which changed are appended to a
+    few segment objects, `path/.log/<segment>`, and `.meta` maps each range
+    back to its page. Reading a page applies its ranges over the page's
+    object in order. Once the log holds more than `max_log_entries` ranges,
+    the next flush compacts it, rewriting the objects of the logged pages.
  */
 class s3_kv_store {
 private:
+    /** The pages written to an object which has not been uploaded yet.
+     */
+    struct pending_object {
+        std::string data;
+        std::vector<bool> written;
+        std::size_t written_count;
+    };
+
+    /** The maximum number of partially written objects to hold before
+        uploading one.
+     */
+    static constexpr std::size_t max_pending_objects = 8;
+
+    /** A range of a page held in a log segment.
+     */
+    struct log_entry {
+        std::size_t offset;
+        std::size_t size;
+        std::size_t segment;
+        std::size_t segment_offset;
+    };
+
+    /** The changed bytes of a page which have not been appended to the log.
+     */
+    struct log_write {
+        std::size_t offset;
+        std::string data;
+    };
+
+    /** The most bytes to put in one log segment.
+     */
+    static constexpr std::size_t max_segment_size = 16 << 20;
+
+    /** The number of ranges the log may hold before a flush compacts it.
+     */
+    static constexpr std::size_t max_log_entries = 4096;
+
     const std::string m_host;
     const bool m_use_tls;
     const std::string m_bucket;
@@ -18,7 +94,33 @@ private:
     s3::notary m_notary;
     std::size_t m_allocated_pages;
     std::size_t m_page_size;
+    std::size_t m_pages_per_object;
+    std::size_t m_key_prefixes;
+    // the buckets which hold the page objects; empty to use `m_bucket`
+    std::vector<std::string> m_buckets;
+    bool m_content_addressed;
     std::unordered_set<page::id> m_invalid_pages;
+    std::vector<page::id> m_hot_pages;
+    std::map<std::size_t, pending_object> m_pending;
+    mutable stats::store_counters m_stats;
+
+    // the entity tag of the object each cached page was read from; pages may
+    // be read from many threads at once
+    mutable std::mutex m_etags_mutex;
+    mutable std::unordered_map<page::id, std::string> m_etags;
+
+    // with `m_content_addressed`, the hash of the contents of each object
+    // which has been written; objects may be uploaded from many threads at
+    // once
+    mutable std::mutex m_contents_mutex;
+    mutable std::map<std::size_t, std::string> m_contents;
+
+    // with `m_log_structured`, the ranges of each page in the log, oldest
+    // first, and the writes which have not been appended yet
+    bool m_log_structured;
+    std::size_t m_log_segments;
+    std::map<page::id, std::vector<log_entry>> m_log;
+    std::map<page::id, log_write> m_log_pending;
 
     s3_kv_store(const std::string& m_host,
                 bool use_tls,
@@ -27,7 +129,171 @@ private:
                 const std::string& access_key,
                 const std::string& secret_key,
                 const std::string& region,
-                const std::size_t page_size);
+                const std::size_t page_size,
+                const std::size_t pages_per_object,
+                const std::size_t key_prefixes,
+                std::vector<std::string> buckets,
+                bool content_addressed,
+                bool log_structured);
+
+    /** The hash of an object of the file at `path` which chooses its key
+        prefix and bucket. This is part of the file format, so it must never
+        change.
+     */
+    std::uint64_t object_hash(const std::string& path, std::size_t object_id) const;
+
+    /** The key of an object of the file at `path`.
+     */
+    std::string object_key(const std::string& path, std::size_t object_id) const;
+
+    /** The key of an object of this file. With `m_content_addressed`, this
+        is the key of the contents the object holds, which must have been
+        written.
+     */
+    std::string object_key(std::size_t object_id) const;
+
+    /** The bucket which holds an object of the file at `path` in `bucket`.
+     */
+    const std::string& object_bucket(const std::string& bucket,
+                                     const std::string& path,
+                                     std::size_t object_id) const;
+
+    const std::string& object_bucket(std::size_t object_id) const;
+
+    /** The key of the content-addressed object with a hash.
+     */
+    std::string content_key(const std::string& digest) const;
+
+    /** The bucket which holds the content-addressed object with a hash.
+     */
+    const std::string& content_bucket(const std::string& digest) const;
+
+    /** Has an object been written? Objects which have not read as zeros.
+        Only content-addressed objects are tracked; others are assumed to
+        exist.
+     */
+    bool stored(std::size_t object_id) const;
+
+    /** Upload a whole object. Content-addressed objects which already exist
+        are not uploaded again.
+     */
+    void put_object(std::size_t object_id, const std::string_view& data) const;
+
+    /** Format the `.meta` object.
+     */
+    std::string metadata() const;
+
+    /** Write the `.meta` object.
+     */
+    void write_metadata() const;
+
+    /** The key of a log segment of the file at `path`.
+     */
+    std::string segment_key(const std::string& path, std::size_t segment) const;
+
+    /** Does a page have ranges in the log, flushed or not?
+     */
+    bool logged(page::id page_id) const {
+        return m_log.count(page_id) || m_log_pending.count(page_id);
+    }
+
+    /** Does the log hold every byte of a page, so that its object does not
+        need to be read?
+     */
+    bool log_covers(page::id page_id) const;
+
+    /** Apply a run of pages' ranges in the log over their contents.
+
+        The ranges are read together: ranges which are next to each other in
+        a segment share one GET, and the GETs are in flight at once, alongside
+        the read of the pages' object.
+
+        @param first The first page.
+        @param count The number of pages.
+        @param out The pages' contents. Pages without `log_covers` must hold
+               their contents in their object once `base` completes.
+        @param base The read of the pages' object into `out`, if any. It is
+               waited on before returning, even if a range fails.
+     */
+    void apply_log(page::id first,
+                   std::size_t count,
+                   utils::out_buffer& out,
+                   async::future<void> base) const;
+
+    /** Read a page with ranges in the log.
+     */
+    void read_logged(page::id page_id, utils::out_buffer& out) const;
+
+    /** Append the unflushed log writes to new segments, many at once.
+     */
+    void append_log();
+
+    /** Rewrite the objects of the pages in the log, many at once, and remove
+        their ranges from the log. `.meta` is not written.
+
+        @return The number of objects rewritten.
+     */
+    std::size_t fold_log(std::size_t concurrency);
+
+    /** Does a page have no data in s3, either because it was never written or
+        because it was truncated away?
+     */
+    bool unallocated(page::id page_id) const {
+        return page_id >= m_allocated_pages ||
+               m_invalid_pages.find(page_id) != m_invalid_pages.end();
+    }
+
+    /** Is a page held in `m_pending`?
+     */
+    bool pending(page::id page_id) const;
+
+    /** Read and parse the `.meta` object.
+     */
+    void read_metadata();
+
+    /** Read consecutive pages from a single object, unless the object has not
+        changed. Pages of objects which do not exist are filled with zeros.
+
+        @param first The id of the first page to read.
+        @param out The buffer to fill, this must be a multiple of the page
+               size and the pages must all be in the same object.
+        @param etag On entry, the entity tag of the copy of the object the
+               caller has, or empty to read unconditionally. On return, the
+               entity tag of the object, or empty if it does not exist.
+        @return false if the object still has the entity tag `etag` and
+                nothing was read, otherwise true.
+     */
+    bool fetch(page::id first, utils::out_buffer& out, std::string& etag) const;
+
+    /** Start reading consecutive pages from a single object on
+        `curl::event_loop::global()`. Pages of objects which do not exist are
+        filled with zeros, and the entity tag of the object is remembered.
+
+        @param first The id of the first page to read.
+        @param out The buffer to fill, this must be a multiple of the page
+               size and the pages must all be in the same object. It must stay
+               alive until the returned future is ready.
+        @param level The priority of the request.
+        @return A future which is ready once `out` is filled.
+     */
+    async::future<void>
+    fetch_async(page::id first, utils::out_buffer out, io::priority level) const;
+
+    /** Remember the entity tag of the object that consecutive pages were read
+        from.
+
+        @param first The first page.
+        @param count The number of pages.
+        @param etag The entity tag, or empty to forget the pages' tags.
+     */
+    void remember(page::id first, std::size_t count, const std::string& etag) const;
+
+    /** Upload a pending object, first reading any pages of it that were not
+        written from s3. The object is left in `m_pending`, and many objects
+        may be uploaded at once.
+     */
+    void upload(std::size_t object_id, pending_object& object) const;
+
 public:
     static const char* name;
 
@@ -38,7 +304,21 @@ public:
           m_path(std::move(mvfrom.m_path)),
           m_notary(std::move(mvfrom.m_notary)),
           m_allocated_pages(mvfrom.m_allocated_pages),
-          m_page_size(mvfrom.m_page_size) {}
+          m_page_size(mvfrom.m_page_size),
+          m_pages_per_object(mvfrom.m_pages_per_object),
+          m_key_prefixes(mvfrom.m_key_prefixes),
+          m_buckets(std::move(mvfrom.m_buckets)),
+          m_content_addressed(mvfrom.m_content_addressed),
+          m_invalid_pages(std::move(mvfrom.m_invalid_pages)),
+          m_hot_pages(std::move(mvfrom.m_hot_pages)),
+          m_pending(std::move(mvfrom.m_pending)),
+          m_stats(mvfrom.m_stats),
+          m_etags(std::move(mvfrom.m_etags)),
+          m_contents(std::move(mvfrom.m_contents)),
+          m_log_structured(mvfrom.m_log_structured),
+          m_log_segments(mvfrom.m_log_segments),
+          m_log(std::move(mvfrom.m_log)),
+          m_log_pending(std::move(mvfrom.m_log_pending)) {}
 
     static s3_kv_store from_params(const std::string_view& uri_view,
                                    unsigned int,  // TODO: Use this?
@@ -47,12 +327,54 @@ public:
                                    const char* secret_key,
                                    const char* region,
                                    const char* host,
-                                   bool use_tls);
+                                   bool use_tls,
+                                   std::size_t pages_per_object,
+                                   std::size_t key_prefixes,
+                                   const char* buckets,
+                                   const char* endpoints,
+                                   bool content_addressed,
+                                   bool log_structured);
 
     inline std::size_t page_size() const {
         return m_page_size;
     }
 
+    /** The number of pages stored in each s3 object.
+     */
+    inline std::size_t pages_per_object() const {
+        return m_pages_per_object;
+    }
+
+    /** The number of hashed key prefixes the objects are spread over, or 0
+        if every object is stored under `path/`.
+     */
+    inline std::size_t key_prefixes() const {
+        return m_key_prefixes;
+    }
+
+    /** The buckets the objects are spread over, or empty if they are all in
+        the url's bucket.
+     */
+    inline const std::vector<std::string>& buckets() const {
+        return m_buckets;
+    }
+
+    /** Are objects named by the hash of their contents?
+     */
+    inline bool content_addressed() const {
+        return m_content_addressed;
+    }
+
+    /** Are writes appended to a log instead of rewriting pages?
+     */
+    inline bool log_structured() const {
+        return m_log_structured;
+    }
+
+    /** The number of page ranges held in the log.
+     */
+    std::size_t log_entries() const;
+
     inline page::id max_page() const {
         return m_allocated_pages - 1;
     }
@@ -63,9 +385,154 @@ public:
         return m_allocated_pages;
     }
 
+    /** The hot set recorded in `.meta` the last time the file was flushed.
+     */
+    const std::vector<page::id>& hot_pages() const {
+        return m_hot_pages;
+    }
+
+    /** Set the hot set to record in `.meta` on the next flush.
+     */
+    void hot_pages(std::vector<page::id> pages) {
+        m_hot_pages = std::move(pages);
+    }
+
+    /** Name the object this store reads, so that read-only opens of the same
+        file may share a page table.
+     */
+    std::string cache_key() const {
+        return (m_use_tls ? "https://" : "http://") + m_host + '/' + m_bucket + '/' +
+               m_path;
+    }
+
+    /** The request counters for this store.
+     */
+    const stats::store_counters& stats() const {
+        return m_stats;
+    }
+
     void read(page::id page_id, utils::out_buffer& out) const;
-    void write(page::id page_id, const std::string_view& data);
+
+    /** Read consecutive pages, coalescing the pages that share an object
+        into a single request.
+
+        @param first The id of the first page to read.
+        @param pages The buffers to fill, one per page.
+     */
+    void read(page::id first, std::vector<utils::out_buffer>& pages) const;
+
+    /** Read many runs of consecutive pages at once. Every request is made
+        on `curl::event_loop::global()`, so there is no thread per request.
+        Pages which share an object are read with a single request.
+
+        @param runs The runs to read. Runs which fail have their `error`
+               set; the others are filled.
+        @param concurrency The maximum number of requests in flight at once.
+        @param level The priority of the requests.
+     */
+    void read(std::vector<page::page_run>& runs,
+              std::size_t concurrency,
+              io::priority level) const;
+
+    /** Start reading a page without blocking.
+
+        @param page_id The page to read.
+        @param out The buffer to fill. It must stay alive until the returned
+               future is ready.
+        @param level The priority of the request.
+        @return A future which is ready once `out` is filled.
+     */
+    async::future<void>
+    async_read(page::id page_id, utils::out_buffer out, io::priority level) const;
+
+    /** Check whether a page has changed in s3 since it was read, and read it
+        again if it has. Unchanged pages cost a conditional GET which is
+        answered without a body.
+
+        @param page_id The page to check.
+        @param out The buffer holding the page's current contents. This is
+               only written to if the page changed.
+        @return true if the page changed and `out` was refilled.
+     */
+    bool revalidate(page::id page_id, utils::out_buffer& out) const;
+
+    /** Read `.meta` again to pick up the pages allocated or truncated by
+        another writer since the file was opened.
+
+        This may only be used when there are no unflushed writes.
+     */
+    void refresh();
+
+    void write(page::id page_id, const std::string_view& data) {
+        write(page_id, data, 0, data.size());
+    }
+
+    /** Write a page of which only some bytes changed. With
+        `log_structured()`, only the changed bytes are written.
+
+        @param page_id The page to write.
+        @param data The page's contents.
+        @param begin The first byte which changed.
+        @param end One past the last byte which changed.
+     */
+    void write(page::id page_id,
+               const std::string_view& data,
+               std::size_t begin,
+               std::size_t end);
+
     void flush();
+
+    /** Fold the log into the pages' objects and write `.meta`. This is done
+        by `flush` once the log grows past `max_log_entries` ranges.
+
+        @param concurrency The maximum number of objects to rewrite at once.
+        @return The number of objects rewritten.
+     */
+    std::size_t compact(std::size_t concurrency);
+
+    /** Replace the store's pages with the contents of a whole file, uploading
+        many objects at once. Objects which are all zeros are not uploaded;
+        their pages are recorded as invalid, so they read as zeros without a
+        request. `.meta` is written last, so readers never see the new pages
+        before they exist.
+
+        This may only be used when there are no unflushed writes.
+
+        @param data The file's contents. Objects are uploaded straight from
+               this buffer, except a final partial object, which is padded.
+        @param concurrency The maximum number of uploads in flight at once.
+        @return The number of objects uploaded.
+     */
+    std::size_t import_file(const std::string_view& data, std::size_t concurrency);
+
+    /** Read every page which has data in s3, many objects at once.
+
+        @param out The buffer to fill, `allocated_pages() * page_size()` bytes.
+               Pages without data are not written to, so a sparse file mapped
+               as `out` stays sparse.
+        @param concurrency The maximum number of requests in flight at once.
+     */
+    void export_file(utils::out_buffer out, std::size_t concurrency) const;
+
+    /** Copy the file to another path on the same host. Each object is copied
+        within s3, many at once, so no page data passes through the client.
+        The copy has the same page size, pages per object, key prefixes and
+        buckets; without buckets of its own, its objects go in `bucket`.
+        `.meta` is written last, so the copy cannot be opened before its
+        pages exist. A content-addressed file shares its objects with the
+        copy, so only `.meta` is written unless the copy is in another
+        bucket. The segments of a log-structured file are copied too.
+
+        This may only be used when there are no unflushed writes.
+
+        @param bucket The bucket of the copy.
+        @param path The path of the copy.
+        @param concurrency The maximum number of copies in flight at once.
+        @return The number of objects and log segments copied.
+     */
+    std::size_t clone(const std::string& bucket,
+                      const std::string& path,
+                      std::size_t concurrency) const;
 };
 
 using s3_driver = driver::kv_driver<s3_kv_store>;
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace h5s3::stats {
+
+/** A monotonically increasing count which may be read from any thread.
+
+    Updates use relaxed atomics: they never take a lock and never order other
+    memory operations. Readers may observe a set of counters which were not
+    all updated by the same operation, which is fine for monitoring.
+ */
+class counter {
+private:
+    std::atomic<std::uint64_t> m_value;
+
+public:
+    counter() : m_value(0) {}
+
+    counter(const counter& cpfrom) : m_value(cpfrom.load()) {}
+
+    counter& operator=(const counter& cpfrom) {
+        m_value.store(cpfrom.load(), std::memory_order_relaxed);
+        return *this;
+    }
+
+    inline void add(std::uint64_t n = 1) {
+        m_value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    inline std::uint64_t load() const {
+        return m_value.load(std::memory_order_relaxed);
+    }
+};
+
+/** A log-linear latency histogram in the style of HdrHistogram.
+
+    Values are recorded in nanoseconds. Each power of two is split into
+    `sub_buckets` linear buckets, so the relative error of any reported value
+    is at most `1 / sub_buckets`.
+ */
+class histogram {
+public:
+    static constexpr std::size_t sub_bucket_bits = 3;
+    static constexpr std::size_t sub_buckets = 1 << sub_bucket_bits;
+    // 2 ** 40 ns is about 18 minutes; anything slower lands in the last bucket.
+    static constexpr std::size_t max_exponent = 40;
+    static constexpr std::size_t bucket_count =
+        (max_exponent - sub_bucket_bits + 2) * sub_buckets;
+
+    /** The index of the bucket which holds `value`.
+     */
+    static constexpr std::size_t bucket_index(std::uint64_t value) {
+        if (value < sub_buckets) {
+            return value;
+        }
+        std::size_t exponent = 63 - __builtin_clzll(value);
+        if (exponent > max_exponent) {
+            return bucket_count - 1;
+        }
+        std::size_t sub_bucket =
+            (value >> (exponent - sub_bucket_bits)) & (sub_buckets - 1);
+        return (exponent - sub_bucket_bits + 1) * sub_buckets + sub_bucket;
+    }
+
+    /** The smallest value which is recorded into the bucket at `ix`.
+     */
+    static constexpr std::uint64_t bucket_lower_bound(std::size_t ix) {
+        if (ix < sub_buckets) {
+            return ix;
+        }
+        std::size_t exponent = ix / sub_buckets + sub_bucket_bits - 1;
+        std::uint64_t sub_bucket = ix % sub_buckets;
+        return (sub_buckets + sub_bucket) << (exponent - sub_bucket_bits);
+    }
+
+    /** A point in time copy of a histogram.
+     */
+    class snapshot {
+    private:
+        std::array<std::uint64_t, bucket_count> m_counts;
+        std::uint64_t m_count;
+        std::uint64_t m_sum;
+
+        friend class histogram;
+
+    public:
+        snapshot() : m_counts{}, m_count(0), m_sum(0) {}
+
+        /** The number of recorded values.
+         */
+        std::uint64_t count() const {
+            return m_count;
+        }
+
+        /** The sum of all of the recorded values in nanoseconds.
+         */
+        std::uint64_t sum() const {
+            return m_sum;
+        }
+
+        /** The value at or below which `p` of the recorded values fall.
+
+            @param p The percentile in the range [0, 1].
+            @return The lower bound of the bucket which holds the percentile,
+                    or 0 if nothing has been recorded.
+         */
+        std::uint64_t percentile(double p) const {
+            if (!m_count) {
+                return 0;
+            }
+            std::uint64_t rank = static_cast<std::uint64_t>(p * (m_count - 1)) + 1;
+            std::uint64_t seen = 0;
+            for (std::size_t ix = 0; ix < bucket_count; ++ix) {
+                seen += m_counts[ix];
+                if (seen >= rank) {
+                    return bucket_lower_bound(ix);
+                }
+            }
+            return bucket_lower_bound(bucket_count - 1);
+        }
+
+        /** The non-empty buckets as pairs of (lower bound, count).
+         */
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> buckets() const {
+            std::vector<std::pair<std::uint64_t, std::uint64_t>> out;
+            for (std::size_t ix = 0; ix < bucket_count; ++ix) {
+                if (m_counts[ix]) {
+                    out.emplace_back(bucket_lower_bound(ix), m_counts[ix]);
+                }
+            }
+            return out;
+        }
+    };
+
+private:
+    std::array<counter, bucket_count> m_counts;
+    counter m_sum;
+
+public:
+    inline void record(std::uint64_t value) {
+        m_counts[bucket_index(value)].add();
+        m_sum.add(value);
+    }
+
+    inline void record(std::chrono::nanoseconds duration) {
+        record(static_cast<std::uint64_t>(duration.count()));
+    }
+
+    snapshot load() const {
+        snapshot out;
+        for (std::size_t ix = 0; ix < bucket_count; ++ix) {
+            out.m_counts[ix] = m_counts[ix].load();
+            out.m_count += out.m_counts[ix];
+        }
+        out.m_sum = m_sum.load();
+        return out;
+    }
+};
+
+/** Time a block of code into a histogram.
+
+    ## Usage
+
+    ```
+    {
+        stats::timer t(m_stats.get_latency);
+        do_request();
+    }
+    ```
+ */
+class timer {
+private:
+    histogram& m_histogram;
+    std::chrono::steady_clock::time_point m_start;
+
+public:
+    explicit timer(histogram& h)
+        : m_histogram(h), m_start(std::chrono::steady_clock::now()) {}
+
+    timer(const timer&) = delete;
+
+    ~timer() {
+        m_histogram.record(std::chrono::steady_clock::now() - m_start);
+    }
+};
+
+/** The counters maintained by a `page::table`.
+ */
+struct table_counters {
+    counter hits;
+    counter misses;
+    counter evictions;
+    counter writebacks;
+    // dirty pages which were not written back because their bytes had not
+    // changed
+    counter unchanged_writebacks;
+    counter prefetches;
+};
+
+/** The counters maintained by a kv-store.
+ */
+struct store_counters {
+    counter gets;
+    counter puts;
+    counter bytes_read;
+    counter bytes_written;
+    counter not_found;
+    counter not_modified;
+    histogram get_latency;
+    histogram put_latency;
+};
+
+/** A point in time copy of all of the counters for an open file.
+ */
+struct snapshot {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+    std::uint64_t writebacks = 0;
+    std::uint64_t unchanged_writebacks = 0;
+    std::uint64_t prefetches = 0;
+
+    std::uint64_t gets = 0;
+    std::uint64_t puts = 0;
+    std::uint64_t bytes_read = 0;
+    std::uint64_t bytes_written = 0;
+    std::uint64_t not_found = 0;
+    std::uint64_t not_modified = 0;
+    histogram::snapshot get_latency;
+    histogram::snapshot put_latency;
+
+    snapshot() = default;
+
+    snapshot(const table_counters& table, const store_counters& store)
+        : hits(table.hits.load()),
+          misses(table.misses.load()),
+          evictions(table.evictions.load()),
+          writebacks(table.writebacks.load()),
+          unchanged_writebacks(table.unchanged_writebacks.load()),
+          prefetches(table.prefetches.load()),
+          gets(store.gets.load()),
+          puts(store.puts.load()),
+          bytes_read(store.bytes_read.load()),
+          bytes_written(store.bytes_written.load()),
+          not_found(store.not_found.load()),
+          not_modified(store.not_modified.load()),
+          get_latency(store.get_latency.load()),
+          put_latency(store.put_latency.load()) {}
+};
+}  // namespace h5s3::stats
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace h5s3::throttle {
+
+using clock = std::chrono::steady_clock;
+
+/** The outcome of one request, as seen by the throttle.
+ */
+struct outcome {
+    // the HTTP status, or 0 if there was no response
+    long status = 0;
+    // the time from starting the request to the first byte of the response;
+    // this does not grow with the size of the response
+    std::optional<std::chrono::microseconds> first_byte;
+    // the bytes sent and received
+    std::size_t bytes = 0;
+
+    /** Was the request turned away because the server is overloaded?
+     */
+    bool throttled() const {
+        return status == 503 || status == 429;
+    }
+};
+
+/** An additive increase, multiplicative decrease limit on the requests in
+    flight to one endpoint.
+
+    The limit grows by one per response until the first sign of congestion,
+    doubling each round trip, and then by one per round trip. It is halved
+    when a request is throttled, and cut by a tenth when the smoothed time to
+    the first byte rises past `latency_tolerance` times its baseline. After
+    a cut, further signals are ignored for a round trip, so a burst of
+    throttled responses to requests which were already in flight counts
+    once.
+ */
+class aimd {
+private:
+    double m_limit;
+    double m_min;
+    double m_max;
+    double m_latency_tolerance;
+    bool m_slow_start;
+    // the smoothed time to first byte, and its slowly rising minimum
+    std::optional<double> m_smoothed_us;
+    std::optional<double> m_baseline_us;
+    clock::time_point m_hold_until;
+
+    void decrease(double factor, clock::time_point now);
+
+public:
+    /** @param initial The starting limit.
+        @param min The smallest limit, at least 1.
+        @param max The largest limit.
+        @param latency_tolerance How many times its baseline the smoothed
+               time to first byte may be before the limit is cut. 0 ignores
+               latency.
+     */
+    aimd(std::size_t initial,
+         std::size_t min,
+         std::size_t max,
+         double latency_tolerance);
+
+    /** The number of requests which may be in flight.
+     */
+    std::size_t limit() const {
+        return static_cast<std::size_t>(m_limit);
+    }
+
+    /** Update the limit with the outcome of a request.
+     */
+    void update(const outcome& o, clock::time_point now = clock::now());
+};
+
+/** Token buckets which cap the rate of requests and of bytes transferred.
+    Each bucket holds up to a second of its rate, so short bursts are not
+    held back.
+
+    The size of a response is not known until it is done, so bytes are
+    charged afterwards and the bucket may go into debt; no request starts
+    until the debt is paid off.
+ */
+class token_bucket {
+private:
+    double m_requests_per_second;
+    double m_bytes_per_second;
+    double m_request_tokens;
+    double m_byte_tokens;
+    clock::time_point m_last;
+
+    void refill(clock::time_point now);
+
+public:
+    /** @param requests_per_second The most requests to start per second, or
+               0 for no limit.
+        @param bytes_per_second The most bytes to transfer per second, or 0
+               for no limit.
+     */
+    token_bucket(double requests_per_second, double bytes_per_second);
+
+    /** Start a request if the buckets allow it.
+
+        @param now The current time.
+        @return `std::nullopt` if the request may start, in which case a
+                request token was taken, otherwise when to try again.
+     */
+    std::optional<clock::time_point> try_take(clock::time_point now = clock::now());
+
+    /** Charge the bytes a request transferred.
+     */
+    void charge(std::size_t bytes, clock::time_point now = clock::now());
+};
+
+/** The throttle in front of every request to s3: an `aimd` limit per
+    endpoint and a `token_bucket` shared by all of them.
+ */
+class limiter {
+public:
+    struct options {
+        // the `aimd` parameters of each endpoint; with `adaptive` off, the
+        // limit stays at `max_concurrency`
+        bool adaptive = true;
+        std::size_t initial_concurrency = 16;
+        std::size_t max_concurrency = 1024;
+        double latency_tolerance = 2.0;
+        // the `token_bucket` rates, 0 for no limit
+        double requests_per_second = 0;
+        double bytes_per_second = 0;
+    };
+
+    /** A request which has been allowed to start. Destroying a ticket which
+        has not been finished releases the request without updating the
+        limit.
+     */
+    class ticket {
+    private:
+        limiter* m_owner;
+        std::string m_key;
+
+    public:
+        ticket(limiter& owner, std::string key)
+            : m_owner(&owner), m_key(std::move(key)) {}
+
+        ticket(ticket&& mvfrom) noexcept
+            : m_owner(mvfrom.m_owner), m_key(std::move(mvfrom.m_key)) {
+            mvfrom.m_owner = nullptr;
+        }
+
+        ticket& operator=(ticket&&) = delete;
+
+        ~ticket() {
+            if (m_owner) {
+                m_owner->release(m_key, std::nullopt);
+            }
+        }
+
+        /** Release the request and update the limit with its outcome.
+         */
+        void finish(const outcome& o) {
+            if (m_owner) {
+                m_owner->release(m_key, o);
+                m_owner = nullptr;
+            }
+        }
+    };
+
+private:
+    struct endpoint {
+        aimd limit;
+        std::size_t in_flight = 0;
+    };
+
+    options m_options;
+    std::mutex m_mutex;
+    std::condition_variable m_released;
+    std::unordered_map<std::string, endpoint> m_endpoints;
+    token_bucket m_bucket;
+
+    std::mutex m_watchers_mutex;
+    std::vector<std::pair<std::size_t, std::function<void()>>> m_watchers;
+    std::size_t m_next_watcher = 0;
+
+    endpoint& lookup(const std::string& key);
+    void release(const std::string& key, const std::optional<outcome>& o);
+
+public:
+    explicit limiter(const options& opts);
+
+    limiter(const limiter&) = delete;
+
+    /** The limiter used for every request made by the s3 driver.
+        `H5S3_MAX_REQUESTS_PER_SECOND` and `H5S3_MAX_BYTES_PER_SECOND` set
+        the rates, `H5S3_MAX_IN_FLIGHT` sets the largest limit of an
+        endpoint, and setting `H5S3_ADAPTIVE_CONCURRENCY` to 0 turns off
+        adapting the limit.
+     */
+    static limiter& global();
+
+    /** Wait until a request to an endpoint may start.
+
+        @param key The endpoint.
+        @return The ticket to finish once the request is done.
+     */
+    ticket acquire(const std::string& key);
+
+    /** Start a request to an endpoint if it may start now.
+
+        @param key The endpoint.
+        @param retry_at If the request is held back by the rate, lowered to
+               when it may start. Requests held back by the limit may start
+               once another request is released.
+        @return The ticket, or `std::nullopt` if the request may not start.
+     */
+    std::optional<ticket> try_acquire(const std::string& key,
+                                      clock::time_point& retry_at);
+
+    /** Call `f` whenever a request is released, so that callers of
+        `try_acquire` can try again. `f` is called from the releasing thread
+        and must not block or call into the limiter.
+
+        @return The id to pass to `unwatch`.
+     */
+    std::size_t watch(std::function<void()> f);
+
+    /** Stop calling a function passed to `watch`.
+     */
+    void unwatch(std::size_t id);
+
+    /** The current limit of an endpoint.
+     */
+    std::size_t limit(const std::string& key);
+
+    /** The requests in flight to an endpoint.
+     */
+    std::size_t in_flight(const std::string& key);
+};
+}  // namespace h5s3::throttle
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace h5s3::trace {
+
+/** The kind of access made to a page.
+ */
+enum class op : std::uint8_t {
+    read = 0,
+    write = 1,
+};
+
+/** A single access to a page in a `page::table`.
+ */
+struct record {
+    /** The page that was accessed.
+     */
+    std::uint64_t page_id;
+
+    /** Nanoseconds since the trace was started.
+     */
+    std::uint64_t timestamp_ns;
+
+    /** The offset of the access into the page.
+     */
+    std::uint32_t offset;
+
+    /** The number of bytes accessed.
+     */
+    std::uint32_t size;
+
+    op operation;
+
+    /** Was the page in the cache when it was accessed?
+     */
+    bool hit;
+
+    /** The hdf5 `H5FD_mem_t` of the access, or 0 if unknown.
+     */
+    std::uint8_t mem_type;
+};
+
+/** The size of a record on disk.
+
+    Records are written as little-endian fields in declaration order, with
+    `operation` and `hit` packed into a single flags byte.
+ */
+constexpr std::size_t record_size = 8 + 8 + 4 + 4 + 1 + 1;
+
+/** The size of the file header: an 8 byte magic, a 4 byte version, and the
+    8 byte page size of the table that was traced.
+ */
+constexpr std::size_t header_size = 8 + 4 + 8;
+
+constexpr std::uint32_t version = 1;
+
+class error : public std::runtime_error {
+public:
+    explicit error(const std::string& message) : std::runtime_error(message) {}
+};
+
+class file_closer {
+public:
+    void operator()(std::FILE* f) {
+        std::fclose(f);
+    }
+};
+
+/** Writes records to a binary trace file.
+
+    Records are buffered in memory and written out in blocks; the buffer is
+    flushed when it fills and when the writer is destroyed.
+ */
+class writer {
+private:
+    std::unique_ptr<std::FILE, file_closer> m_file;
+    std::chrono::steady_clock::time_point m_start;
+    std::vector<char> m_buffer;
+
+    void flush_buffer();
+
+public:
+    /** Create a new trace file.
+
+        @param path The path to write the trace to. This will be truncated if
+               it exists.
+        @param page_size The page size of the table being traced.
+     */
+    writer(const std::string& path, std::size_t page_size);
+
+    ~writer();
+
+    /** The number of nanoseconds since the trace was started.
+     */
+    std::uint64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - m_start)
+            .count();
+    }
+
+    /** Add a record to the trace.
+     */
+    void write(const record& r);
+
+    /** Write all buffered records to the file.
+     */
+    void flush();
+};
+
+/** Reads records out of a binary trace file.
+ */
+class reader {
+private:
+    std::unique_ptr<std::FILE, file_closer> m_file;
+    std::size_t m_page_size;
+
+public:
+    explicit reader(const std::string& path);
+
+    /** The page size of the table that was traced.
+     */
+    std::size_t page_size() const {
+        return m_page_size;
+    }
+
+    /** Read the next record.
+
+        @param out The record to fill.
+        @return false if the end of the trace has been reached.
+     */
+    bool next(record& out);
+};
+}  // namespace h5s3::trace
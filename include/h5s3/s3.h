@@ -1,11 +1,14 @@
 #pragma once
 #include <ctime>
 #include <iomanip>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "h5s3/private/async.h"
 #include "h5s3/private/curl.h"
 #include "h5s3/private/hash.h"
+#include "h5s3/private/io.h"
 #include "h5s3/private/out_buffer.h"
 
 namespace h5s3::s3 {
@@ -65,10 +68,124 @@ std::size_t get_object(utils::out_buffer& out,
                        const std::string_view& = default_host,
                        bool use_tls = true);
 
+/** Read part of an object with a range GET.
+
+    @param out The buffer to fill, `out.size()` bytes are requested.
+    @param offset The offset into the object of the first byte to read.
+    @return The number of bytes written to `out`. This is less than
+            `out.size()` if the object ends before the requested range.
+ */
+std::size_t get_object_range(utils::out_buffer& out,
+                             std::size_t offset,
+                             const notary& signer,
+                             const std::string_view& bucket_name,
+                             const std::string_view& path,
+                             const std::string_view& host = default_host,
+                             bool use_tls = true);
+
+/** Read an object unless it has not changed since it was last read.
+
+    @param out The buffer to fill.
+    @param etag On entry, the entity tag of the copy of the object the caller
+           already has, or empty to read the object unconditionally. On
+           return, the entity tag of the object in s3.
+    @return The number of bytes written to `out`, or `std::nullopt` if the
+            object still has the entity tag `etag` and nothing was read.
+ */
+std::optional<std::size_t> get_object(utils::out_buffer& out,
+                                      std::string& etag,
+                                      const notary& signer,
+                                      const std::string_view& bucket_name,
+                                      const std::string_view& path,
+                                      const std::string_view& host = default_host,
+                                      bool use_tls = true);
+
+/** Read part of an object with a range GET unless the object has not changed
+    since it was last read.
+
+    @param out The buffer to fill, `out.size()` bytes are requested.
+    @param offset The offset into the object of the first byte to read.
+    @param etag On entry, the entity tag of the copy of the object the caller
+           already has, or empty to read the range unconditionally. On
+           return, the entity tag of the whole object in s3.
+    @return The number of bytes written to `out`, or `std::nullopt` if the
+            object still has the entity tag `etag` and nothing was read.
+ */
+std::optional<std::size_t> get_object_range(utils::out_buffer& out,
+                                            std::size_t offset,
+                                            std::string& etag,
+                                            const notary& signer,
+                                            const std::string_view& bucket_name,
+                                            const std::string_view& path,
+                                            const std::string_view& host = default_host,
+                                            bool use_tls = true);
+
 std::string set_object(const notary& signer,
                        const std::string_view& bucket_name,
                        const std::string_view& path,
                        const std::string_view& content,
                        const std::string_view& host = default_host,
                        bool use_tls = true);
+
+/** Copy an object within s3, without transferring its data through the
+    client.
+
+    @param source_bucket_name The bucket of the object to copy.
+    @param source_path The key of the object to copy.
+    @param bucket_name The bucket to copy the object to.
+    @param path The key to copy the object to.
+    @return The response body, which holds the new object's entity tag.
+ */
+std::string copy_object(const notary& signer,
+                        const std::string_view& source_bucket_name,
+                        const std::string_view& source_path,
+                        const std::string_view& bucket_name,
+                        const std::string_view& path,
+                        const std::string_view& host = default_host,
+                        bool use_tls = true);
+
+/** Start reading an object, or part of one, on `curl::event_loop::global()`.
+    The request is signed before this returns.
+
+    From a coroutine, `co_await` the result:
+
+    .. code-block:: c++
+
+       curl::get_result r = co_await s3::async_get_object(out, ...);
+
+    @param out The buffer to fill, `out.size()` bytes are requested when
+           reading a range. It must stay alive until the returned future is
+           ready.
+    @param offset The offset into the object of the first byte to read, or
+           `std::nullopt` to read the whole object.
+    @param etag The entity tag of the copy of the object the caller already
+           has, or empty to read unconditionally.
+    @param p The priority of the request.
+    @return The outcome, which is set on the event loop's thread.
+ */
+async::future<curl::get_result> async_get_object(utils::out_buffer out,
+                                                 std::optional<std::size_t> offset,
+                                                 const std::string_view& etag,
+                                                 const notary& signer,
+                                                 const std::string_view& bucket_name,
+                                                 const std::string_view& path,
+                                                 const std::string_view& host,
+                                                 bool use_tls,
+                                                 io::priority p);
+
+/** Start writing an object on `curl::event_loop::global()`. The request is
+    signed before this returns.
+
+    @param content The object's data. It must stay alive until the returned
+           future is ready.
+    @param p The priority of the request.
+    @return The response body, which is set on the event loop's thread.
+ */
+async::future<std::string> async_set_object(const notary& signer,
+                                            const std::string_view& bucket_name,
+                                            const std::string_view& path,
+                                            const std::string_view& content,
+                                            const std::string_view& host,
+                                            bool use_tls,
+                                            io::priority p);
 }  // namespace h5s3::s3
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+#include <sys/mman.h>
+
+#include "h5s3/private/arena.h"
+
+namespace h5s3::page {
+
+void buffer_arena::mapping_deleter::operator()(char* ptr) const {
+    munmap(ptr, size);
+}
+
+buffer_arena::buffer_arena(std::size_t buffer_size,
+                           std::size_t max_buffers,
+                           bool huge_pages)
+    : m_buffer_size((std::max<std::size_t>(buffer_size, 1) + alignment - 1) /
+                    alignment * alignment),
+      m_buffers_per_mapping(std::clamp<std::size_t>(mapping_size / m_buffer_size,
+                                                    1,
+                                                    std::max<std::size_t>(max_buffers,
+                                                                          1))),
+      m_huge_pages(huge_pages),
+      m_used(0),
+      m_trimmed(0) {}
+
+void buffer_arena::add_mapping() {
+    std::size_t size = m_buffers_per_mapping * m_buffer_size;
+
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+
+    // huge pages need a huge page aligned region, so over-allocate and trim
+    bool huge = m_huge_pages && size >= huge_page_size;
+    std::size_t slack = huge ? huge_page_size : 0;
+    void* raw = mmap(nullptr, size + slack, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (raw == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+    char* start = static_cast<char*>(raw);
+    if (huge) {
+        auto address = reinterpret_cast<std::uintptr_t>(start);
+        std::size_t head = (huge_page_size - address % huge_page_size) % huge_page_size;
+        if (head) {
+            munmap(start, head);
+        }
+        if (slack - head) {
+            munmap(start + head + size, slack - head);
+        }
+        start += head;
+#ifdef MADV_HUGEPAGE
+        // this is only advice, kernels without transparent huge pages refuse
+        madvise(start, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    m_mappings.emplace_back(start, mapping_deleter{size});
+    m_used = 0;
+}
+
+char* buffer_arena::allocate() {
+    if (!m_free.empty()) {
+        char* buffer = m_free.back();
+        m_free.pop_back();
+        m_trimmed = std::min(m_trimmed, m_free.size());
+        return buffer;
+    }
+
+    if (m_mappings.empty() || m_used == m_buffers_per_mapping) {
+        add_mapping();
+    }
+    return m_mappings.back().get() + m_buffer_size * m_used++;
+}
+
+void buffer_arena::release(char* buffer) {
+    m_free.push_back(buffer);
+}
+
+std::size_t buffer_arena::trim() {
+    std::size_t trimmed = m_free.size() - m_trimmed;
+    for (; m_trimmed < m_free.size(); ++m_trimmed) {
+        madvise(m_free[m_trimmed], m_buffer_size, MADV_DONTNEED);
+    }
+    return trimmed * m_buffer_size;
+}
+}  // namespace h5s3::page
@@ -0,0 +1,103 @@
+#include <algorithm>
+
+#include "h5s3/private/async.h"
+
+namespace h5s3::async {
+namespace {
+struct for_each_state {
+    std::function<future<void>(std::size_t)> start;
+    std::size_t count;
+    std::size_t concurrency;
+
+    std::mutex mutex;
+    std::size_t next = 0;
+    std::size_t running = 0;
+    std::size_t done = 0;
+    std::exception_ptr error;
+    // Operations which complete immediately would otherwise start the next
+    // one from inside `start`, recursing once per operation. Instead, one
+    // thread at a time starts operations, and completions on other threads
+    // ask it to go around again.
+    bool starting = false;
+    bool again = false;
+    promise<void> finished;
+};
+
+void start_more(const std::shared_ptr<for_each_state>& s);
+
+void on_complete(const std::shared_ptr<for_each_state>& s, const future<void>& f) {
+    std::exception_ptr error;
+    try {
+        f.get();
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+
+    bool finished;
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        if (error && !s->error) {
+            s->error = error;
+        }
+        --s->running;
+        finished = ++s->done == s->count;
+    }
+    if (finished) {
+        if (s->error) {
+            s->finished.set_error(s->error);
+        }
+        else {
+            s->finished.set_value();
+        }
+        return;
+    }
+    start_more(s);
+}
+
+void start_more(const std::shared_ptr<for_each_state>& s) {
+    std::unique_lock<std::mutex> lock(s->mutex);
+    if (s->starting) {
+        s->again = true;
+        return;
+    }
+    s->starting = true;
+    do {
+        s->again = false;
+        while (s->next < s->count && s->running < s->concurrency) {
+            std::size_t ix = s->next++;
+            ++s->running;
+            lock.unlock();
+
+            future<void> f;
+            try {
+                f = s->start(ix);
+            }
+            catch (...) {
+                f = make_error<void>(std::current_exception());
+            }
+            f.on_ready([s, f] { on_complete(s, f); });
+
+            lock.lock();
+        }
+    } while (s->again);
+    s->starting = false;
+}
+}  // namespace
+
+future<void> for_each(std::size_t count,
+                      std::size_t concurrency,
+                      std::function<future<void>(std::size_t)> start) {
+    if (!count) {
+        return make_ready();
+    }
+
+    auto s = std::make_shared<for_each_state>();
+    s->start = std::move(start);
+    s->count = count;
+    s->concurrency = std::max<std::size_t>(concurrency, 1);
+    future<void> out = s->finished.get_future();
+    start_more(s);
+    return out;
+}
+}  // namespace h5s3::async
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "h5s3/private/cache_manager.h"
+
+namespace h5s3::page {
+std::atomic<std::uint64_t> cache_manager::m_clock(0);
+
+cache_manager& cache_manager::global() {
+    static cache_manager manager([] {
+        const char* value = std::getenv("H5S3_SHARED_CACHE_BYTES");
+        if (!value || !*value) {
+            return std::size_t(0);
+        }
+        try {
+            return static_cast<std::size_t>(std::stoull(value));
+        }
+        catch (const std::exception&) {
+            throw std::invalid_argument(
+                std::string("H5S3_SHARED_CACHE_BYTES is not a number of bytes: ") +
+                value);
+        }
+    }());
+    return manager;
+}
+
+void cache_manager::budget(std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget = bytes;
+    if (!m_budget) {
+        return;
+    }
+
+    while (used_bytes() > m_budget) {
+        managed_table* victim = coldest_table();
+        if (!victim) {
+            break;
+        }
+        victim->evict_coldest();
+    }
+}
+
+std::size_t cache_manager::used_bytes() const {
+    std::size_t total = 0;
+    for (const managed_table* table : m_tables) {
+        total += table->cached_bytes();
+    }
+    return total;
+}
+
+managed_table* cache_manager::coldest_table() const {
+    managed_table* victim = nullptr;
+    std::optional<managed_table::coldness> victim_coldness;
+    for (managed_table* table : m_tables) {
+        auto c = table->coldest();
+        if (c && (!victim_coldness || *c < *victim_coldness)) {
+            victim = table;
+            victim_coldness = c;
+        }
+    }
+    return victim;
+}
+
+std::size_t cache_manager::cached_bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return used_bytes();
+}
+
+void cache_manager::attach(managed_table& table) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tables.push_back(&table);
+}
+
+void cache_manager::detach(managed_table& table) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tables.erase(std::remove(m_tables.begin(), m_tables.end(), &table),
+                   m_tables.end());
+}
+
+bool cache_manager::reserve(const managed_table& requester, std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_budget) {
+        return true;
+    }
+
+    std::size_t used = used_bytes();
+    while (used + bytes > m_budget) {
+        managed_table* victim = coldest_table();
+        if (!victim) {
+            // nothing is cached, the budget is smaller than one page
+            return true;
+        }
+        if (victim == &requester) {
+            return false;
+        }
+
+        std::size_t before = victim->cached_bytes();
+        try {
+            victim->evict_coldest();
+        }
+        catch (const std::exception&) {
+            // the page could not be written back; leave the other file alone
+            return false;
+        }
+        used -= before - victim->cached_bytes();
+    }
+    return true;
+}
+}  // namespace h5s3::page
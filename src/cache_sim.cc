@@ -0,0 +1,184 @@
+#include <list>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+#include "h5s3/private/cache_sim.h"
+
+namespace h5s3::cache_sim {
+namespace {
+using page_id = std::uint64_t;
+
+/** The recency-ordered caches: lru and fifo differ only in whether a hit
+    moves the page to the front.
+ */
+class ordered_cache {
+private:
+    struct entry {
+        page_id id;
+        bool dirty;
+    };
+
+    const std::size_t m_capacity;
+    const bool m_move_on_hit;
+    std::list<entry> m_order;
+    std::unordered_map<page_id, std::list<entry>::iterator> m_index;
+
+public:
+    ordered_cache(std::size_t capacity, bool move_on_hit)
+        : m_capacity(capacity), m_move_on_hit(move_on_hit) {}
+
+    void touch(page_id id, bool write, result& out) {
+        auto search = m_index.find(id);
+        if (search != m_index.end()) {
+            ++out.hits;
+            search->second->dirty |= write;
+            if (m_move_on_hit) {
+                m_order.splice(m_order.begin(), m_order, search->second);
+            }
+            return;
+        }
+
+        ++out.misses;
+        if (m_index.size() == m_capacity) {
+            const entry& victim = m_order.back();
+            out.writebacks += victim.dirty;
+            m_index.erase(victim.id);
+            m_order.pop_back();
+        }
+        m_order.push_front({id, write});
+        m_index.emplace(id, m_order.begin());
+    }
+
+    void flush(result& out) {
+        for (const entry& e : m_order) {
+            out.writebacks += e.dirty;
+        }
+    }
+};
+
+class lfu_cache {
+private:
+    struct entry {
+        std::uint64_t frequency;
+        std::uint64_t last_used;
+        bool dirty;
+    };
+
+    const std::size_t m_capacity;
+    std::uint64_t m_clock;
+    std::unordered_map<page_id, entry> m_entries;
+    // (frequency, last_used, id), the first element is the next to evict
+    std::set<std::tuple<std::uint64_t, std::uint64_t, page_id>> m_order;
+
+public:
+    explicit lfu_cache(std::size_t capacity) : m_capacity(capacity), m_clock(0) {}
+
+    void touch(page_id id, bool write, result& out) {
+        ++m_clock;
+        auto search = m_entries.find(id);
+        if (search != m_entries.end()) {
+            ++out.hits;
+            entry& e = search->second;
+            m_order.erase({e.frequency, e.last_used, id});
+            ++e.frequency;
+            e.last_used = m_clock;
+            e.dirty |= write;
+            m_order.emplace(e.frequency, e.last_used, id);
+            return;
+        }
+
+        ++out.misses;
+        if (m_entries.size() == m_capacity) {
+            auto victim = m_order.begin();
+            page_id victim_id = std::get<2>(*victim);
+            out.writebacks += m_entries[victim_id].dirty;
+            m_entries.erase(victim_id);
+            m_order.erase(victim);
+        }
+        m_entries.emplace(id, entry{1, m_clock, write});
+        m_order.emplace(1, m_clock, id);
+    }
+
+    void flush(result& out) {
+        for (const auto& [id, e] : m_entries) {
+            out.writebacks += e.dirty;
+        }
+    }
+};
+
+template<typename cache_type>
+void run(const std::vector<access>& accesses,
+         std::size_t page_size,
+         cache_type& cache,
+         result& out) {
+    for (const access& a : accesses) {
+        if (!a.size) {
+            continue;
+        }
+        page_id first = a.addr / page_size;
+        page_id last = (a.addr + a.size - 1) / page_size;
+        for (page_id id = first; id <= last; ++id) {
+            ++out.page_accesses;
+            cache.touch(id, a.write, out);
+        }
+    }
+    cache.flush(out);
+}
+}  // namespace
+
+policy parse_policy(std::string_view name) {
+    if (name == "lru") {
+        return policy::lru;
+    }
+    if (name == "fifo") {
+        return policy::fifo;
+    }
+    if (name == "lfu") {
+        return policy::lfu;
+    }
+    throw std::invalid_argument("unknown eviction policy: " + std::string(name));
+}
+
+std::string_view policy_name(policy p) {
+    switch (p) {
+    case policy::lru:
+        return "lru";
+    case policy::fifo:
+        return "fifo";
+    case policy::lfu:
+        return "lfu";
+    }
+    return "unknown";
+}
+
+result simulate(const std::vector<access>& accesses, const config& cache) {
+    if (!cache.page_size || !cache.page_cache_size) {
+        throw std::invalid_argument("page_size and page_cache_size must be non-zero");
+    }
+
+    result out;
+    out.cache = cache;
+
+    switch (cache.eviction) {
+    case policy::lru: {
+        ordered_cache c(cache.page_cache_size, true);
+        run(accesses, cache.page_size, c, out);
+        break;
+    }
+    case policy::fifo: {
+        ordered_cache c(cache.page_cache_size, false);
+        run(accesses, cache.page_size, c, out);
+        break;
+    }
+    case policy::lfu: {
+        lfu_cache c(cache.page_cache_size);
+        run(accesses, cache.page_size, c, out);
+        break;
+    }
+    }
+    return out;
+}
+}  // namespace h5s3::cache_sim
@@ -1,5 +1,14 @@
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
 #include "h5s3/private/curl.h"
 
 namespace h5s3::curl {
@@ -81,15 +90,47 @@ namespace {
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
     }
 
+    /** Record the value of the `ETag` response header into a `std::string`.
+     */
+    void set_etag_header_callback(CURL * curl, std::string& etag) {
+        etag.clear();
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &etag);
+
+        write_callback_type header_callback =
+            [](char* ptr, std::size_t size, std::size_t nmemb, void* closure) {
+                std::string_view line(ptr, size * nmemb);
+                std::string_view name("etag:");
+                if (line.size() > name.size() &&
+                    std::equal(name.begin(), name.end(), line.begin(), [](char a, char b) {
+                        return a == std::tolower(static_cast<unsigned char>(b));
+                    })) {
+                    line.remove_prefix(name.size());
+                    while (!line.empty() && std::isspace(static_cast<unsigned char>(
+                                                line.front()))) {
+                        line.remove_prefix(1);
+                    }
+                    while (!line.empty() && std::isspace(static_cast<unsigned char>(
+                                                line.back()))) {
+                        line.remove_suffix(1);
+                    }
+                    reinterpret_cast<std::string*>(closure)->assign(line);
+                }
+                return size * nmemb;
+            };
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
+    }
+
     long perform_request(CURL * curl,
                          const std::vector<header>& headers,
-                         const std::array<char, CURL_ERROR_SIZE>& error_message_buffer) {
+                         const std::array<char, CURL_ERROR_SIZE>& error_message_buffer,
+                         bool& failed) {
 
         owned_header_list headers_to_free(set_headers(curl, headers));
 
         CURLcode error_code = curl_easy_perform(curl);
 
         if (CURLE_OK != error_code) {
+            failed = true;
             // TODO: curl_easy_strerror
             throw error(error_message_buffer.data());
         }
@@ -103,8 +144,99 @@ namespace {
         return response_code;
     }
 
+    /** Read a size from an environment variable.
+
+        @param name The name of the variable.
+        @param fallback The value to use if the variable is not set.
+     */
+    std::size_t env_size(const char* name, std::size_t fallback) {
+        const char* value = std::getenv(name);
+        if (!value || !*value) {
+            return fallback;
+        }
+        try {
+            return static_cast<std::size_t>(std::stoull(value));
+        }
+        catch (const std::exception&) {
+            throw std::invalid_argument(std::string(name) + " is not a number: " + value);
+        }
+    }
+
+    /** Split `name[:port]` into the name and the port, which may be empty.
+        IPv6 addresses are returned in brackets.
+     */
+    std::pair<std::string, std::string> split_host(const std::string_view& host) {
+        if (!host.empty() && host.front() == '[') {
+            std::size_t end = host.find(']');
+            if (end == std::string_view::npos) {
+                throw std::invalid_argument("unterminated IPv6 address: " +
+                                            std::string(host));
+            }
+            std::string_view rest = host.substr(end + 1);
+            if (!rest.empty() && rest.front() == ':') {
+                rest.remove_prefix(1);
+            }
+            return {std::string(host.substr(0, end + 1)), std::string(rest)};
+        }
+
+        std::size_t colon = host.find(':');
+        if (colon == std::string_view::npos) {
+            return {std::string(host), ""};
+        }
+        if (host.find(':', colon + 1) != std::string_view::npos) {
+            // a bare IPv6 address
+            return {"[" + std::string(host) + "]", ""};
+        }
+        return {std::string(host.substr(0, colon)), std::string(host.substr(colon + 1))};
+    }
+
+    /** Read the outcome of a transfer for the throttle.
+
+        @param curl The handle of the transfer.
+        @param failed Did the transfer fail to connect or transfer?
+     */
+    throttle::outcome read_outcome(CURL * curl, bool failed) {
+        throttle::outcome o;
+        if (!failed) {
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &o.status);
+            curl_off_t first_byte;
+            if (curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &first_byte) ==
+                CURLE_OK) {
+                o.first_byte = std::chrono::microseconds(first_byte);
+            }
+        }
+        curl_off_t downloaded = 0;
+        curl_off_t uploaded = 0;
+        curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+        curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+        o.bytes = downloaded + uploaded;
+        return o;
+    }
+
+    /** The key which the pool and the throttle group requests to a host by.
+     */
+    std::string endpoint_key(const std::string_view& host,
+                             const std::optional<endpoints::lease>& endpoint) {
+        std::string key(host);
+        if (endpoint) {
+            key += '@' + endpoint->address();
+        }
+        return key;
+    }
+
+    /** The `name[:port]` part of a url.
+     */
+    std::string_view url_host(std::string_view url) {
+        std::size_t scheme = url.find("://");
+        if (scheme != std::string_view::npos) {
+            url.remove_prefix(scheme + 3);
+        }
+        return url.substr(0, url.find('/'));
+    }
+
     void throw_for_status(long code, const std::string_view& response_body) {
-        if (200 == code) {
+        // 206 is the response to a range request
+        if (200 == code || 206 == code) {
             return;
         }
 
@@ -114,16 +246,188 @@ namespace {
     }
 }  // namespace
 
+std::string endpoints::lease::connect_to() const {
+    auto [name, port] = split_host(m_address);
+    // an empty host and port match every url
+    return "::" + name + ':' + port;
+}
+
+endpoints& endpoints::global() {
+    static endpoints e;
+    return e;
+}
+
+void endpoints::add(const std::string_view& host,
+                    const std::vector<std::string>& addresses) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<address_state>& states = m_hosts[std::string(host)];
+    for (const std::string& address : addresses) {
+        auto search = std::find_if(states.begin(), states.end(), [&](const auto& s) {
+            return s.address == address;
+        });
+        if (search == states.end()) {
+            states.push_back(address_state{address});
+        }
+    }
+}
+
+std::optional<endpoints::lease> endpoints::choose(const std::string_view& host) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto search = m_hosts.find(std::string(host));
+    if (search == m_hosts.end() || search->second.empty()) {
+        return std::nullopt;
+    }
+    std::vector<address_state>& states = search->second;
+
+    auto now = std::chrono::steady_clock::now();
+    std::size_t best = states.size();
+    for (std::size_t offset = 0; offset < states.size(); ++offset) {
+        std::size_t ix = (m_next + offset) % states.size();
+        const address_state& candidate = states[ix];
+        if (best == states.size()) {
+            best = ix;
+            continue;
+        }
+
+        const address_state& current = states[best];
+        bool candidate_healthy = candidate.retry_at <= now;
+        bool current_healthy = current.retry_at <= now;
+        if (candidate_healthy != current_healthy) {
+            if (candidate_healthy) {
+                best = ix;
+            }
+        }
+        else if (candidate_healthy) {
+            if (candidate.outstanding < current.outstanding) {
+                best = ix;
+            }
+        }
+        else if (candidate.retry_at < current.retry_at) {
+            best = ix;
+        }
+    }
+
+    m_next = best + 1;
+    ++states[best].outstanding;
+    return std::optional<lease>(std::in_place, *this, host, states[best].address);
+}
+
+void endpoints::release(const std::string& host,
+                        const std::string& address,
+                        bool failed) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<address_state>& states = m_hosts[host];
+    auto search = std::find_if(states.begin(), states.end(), [&](const auto& s) {
+        return s.address == address;
+    });
+    if (search == states.end()) {
+        return;
+    }
+
+    --search->outstanding;
+    if (!failed) {
+        search->failures = 0;
+        search->retry_at = {};
+        return;
+    }
+    ++search->failures;
+    std::chrono::milliseconds backoff =
+        initial_backoff * (1L << std::min<std::size_t>(search->failures - 1, 10));
+    search->retry_at = std::chrono::steady_clock::now() + std::min(backoff, max_backoff);
+}
+
+std::vector<endpoints::status> endpoints::addresses(const std::string_view& host) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<status> out;
+    auto search = m_hosts.find(std::string(host));
+    if (search == m_hosts.end()) {
+        return out;
+    }
+    auto now = std::chrono::steady_clock::now();
+    for (const address_state& s : search->second) {
+        out.push_back(status{s.address, s.outstanding, s.failures, s.retry_at <= now});
+    }
+    return out;
+}
+
+std::vector<std::string> resolve(const std::string_view& host) {
+    std::string name = split_host(host).first;
+    if (!name.empty() && name.front() == '[') {
+        name = name.substr(1, name.size() - 2);
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* results;
+    if (int code = getaddrinfo(name.c_str(), nullptr, &hints, &results)) {
+        throw error("Failed to resolve " + name + ": " + gai_strerror(code));
+    }
+
+    std::vector<std::string> out;
+    for (addrinfo* ai = results; ai; ai = ai->ai_next) {
+        char buffer[INET6_ADDRSTRLEN];
+        std::string address;
+        if (ai->ai_family == AF_INET) {
+            auto* in = reinterpret_cast<sockaddr_in*>(ai->ai_addr);
+            address = inet_ntop(AF_INET, &in->sin_addr, buffer, sizeof(buffer));
+        }
+        else if (ai->ai_family == AF_INET6) {
+            auto* in = reinterpret_cast<sockaddr_in6*>(ai->ai_addr);
+            address = '[';
+            address += inet_ntop(AF_INET6, &in->sin6_addr, buffer, sizeof(buffer));
+            address += ']';
+        }
+        else {
+            continue;
+        }
+        if (std::find(out.begin(), out.end(), address) == out.end()) {
+            out.push_back(std::move(address));
+        }
+    }
+    freeaddrinfo(results);
+    return out;
+}
+
+session::session(const std::string& connect_to)
+    : m_curl(curl_easy_init()), m_failed(false) {
+    if (!m_curl) {
+        throw error("Failed to initialize curl request.");
+    }
+    if (!connect_to.empty()) {
+        m_connect_to.reset(curl_slist_append(nullptr, connect_to.c_str()));
+        if (!m_connect_to) {
+            throw error("Failed to construct the connect to list.");
+        }
+    }
+}
+
+void session::reset() const {
+    curl_easy_reset(m_curl.get());
+    // sessions are used from many threads; don't use signals for timeouts
+    curl_easy_setopt(m_curl.get(), CURLOPT_NOSIGNAL, 1L);
+    if (m_connect_to) {
+        curl_easy_setopt(m_curl.get(), CURLOPT_CONNECT_TO, m_connect_to.get());
+    }
+    m_failed = false;
+}
+
+throttle::outcome session::outcome() const {
+    return read_outcome(m_curl.get(), m_failed);
+}
+
 std::string session::get(const std::string_view& url,
                          const std::vector<header>& headers) const {
     std::string out;
     std::array<char, CURL_ERROR_SIZE> error_buffer;
 
+    reset();
+
     curl_easy_setopt(m_curl.get(), CURLOPT_HTTPGET, 1L);
 
     set_common_request_fields_str(m_curl.get(), url, out, error_buffer);
 
-    long code = perform_request(m_curl.get(), headers, error_buffer);
+    long code = perform_request(m_curl.get(), headers, error_buffer, m_failed);
     throw_for_status(code, out);
 
     return out;
@@ -134,13 +438,39 @@ std::size_t session::get(const std::string_view& url,
                          utils::out_buffer& out) const {
     std::array<char, CURL_ERROR_SIZE> error_buffer;
 
+    reset();
+
     curl_easy_setopt(m_curl.get(), CURLOPT_HTTPGET, 1L);
 
     utils::out_buffer copy(out);
 
     set_common_request_fields_out_buffer(m_curl.get(), url, copy, error_buffer);
 
-    long code = perform_request(m_curl.get(), headers, error_buffer);
+    long code = perform_request(m_curl.get(), headers, error_buffer, m_failed);
+    throw_for_status(code, {out.data(), out.size()});
+
+    return copy.data() - out.data();
+}
+
+std::optional<std::size_t> session::get(const std::string_view& url,
+                                        const std::vector<header>& headers,
+                                        utils::out_buffer& out,
+                                        std::string& etag) const {
+    std::array<char, CURL_ERROR_SIZE> error_buffer;
+
+    reset();
+
+    curl_easy_setopt(m_curl.get(), CURLOPT_HTTPGET, 1L);
+
+    utils::out_buffer copy(out);
+
+    set_common_request_fields_out_buffer(m_curl.get(), url, copy, error_buffer);
+    set_etag_header_callback(m_curl.get(), etag);
+
+    long code = perform_request(m_curl.get(), headers, error_buffer, m_failed);
+    if (304 == code) {
+        return std::nullopt;
+    }
     throw_for_status(code, {out.data(), out.size()});
 
     return copy.data() - out.data();
@@ -153,6 +483,8 @@ std::string session::put(const std::string_view& url,
     std::array<char, CURL_ERROR_SIZE> error_buffer;
     std::string_view body_copy = body;
 
+    reset();
+
     curl_easy_setopt(m_curl.get(), CURLOPT_UPLOAD, 1L);
     curl_easy_setopt(m_curl.get(), CURLOPT_READFUNCTION, &read_callback);
     curl_easy_setopt(m_curl.get(), CURLOPT_READDATA, &body_copy);
@@ -162,10 +494,532 @@ std::string session::put(const std::string_view& url,
 
     set_common_request_fields_str(m_curl.get(), url, out, error_buffer);
 
-    long code = perform_request(m_curl.get(), headers, error_buffer);
+    long code = perform_request(m_curl.get(), headers, error_buffer, m_failed);
     throw_for_status(code, out);
 
     return out;
 }
 
+pool& pool::global() {
+    static pool p(env_size("H5S3_MAX_HOST_CONNECTIONS", default_max_per_host),
+                  &throttle::limiter::global());
+    return p;
+}
+
+pool::lease pool::acquire(const std::string_view& host) {
+    // sessions keep their connections to one address, so they are pooled
+    // per address
+    std::optional<endpoints::lease> endpoint = endpoints::global().choose(host);
+    std::string key = endpoint_key(host, endpoint);
+
+    std::optional<throttle::limiter::ticket> ticket;
+    if (m_limiter) {
+        ticket.emplace(m_limiter->acquire(key));
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    host_sessions& sessions = m_hosts[key];
+    m_released.wait(lock, [&] {
+        return !sessions.idle.empty() || sessions.created < m_max_per_host;
+    });
+
+    if (!sessions.idle.empty()) {
+        std::unique_ptr<session> s = std::move(sessions.idle.back());
+        sessions.idle.pop_back();
+        return lease(*this, key, std::move(s), std::move(endpoint), std::move(ticket));
+    }
+
+    ++sessions.created;
+    lock.unlock();
+    try {
+        auto s = std::make_unique<session>(endpoint ? endpoint->connect_to() : "");
+        return lease(*this, key, std::move(s), std::move(endpoint), std::move(ticket));
+    }
+    catch (...) {
+        lock.lock();
+        --sessions.created;
+        m_released.notify_one();
+        throw;
+    }
+}
+
+void pool::release(const std::string& host, std::unique_ptr<session>&& s) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_hosts[host].idle.push_back(std::move(s));
+    }
+    // sessions are per host, so wake every waiter to find its own
+    m_released.notify_all();
+}
+
+std::size_t pool::sessions(const std::string_view& host) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto search = m_hosts.find(std::string(host));
+    return search == m_hosts.end() ? 0 : search->second.created;
+}
+
+http_version parse_http_version(const std::string_view& name) {
+    if (name == "1.1") {
+        return http_version::http1_1;
+    }
+    if (name == "2") {
+        return http_version::http2;
+    }
+    if (name == "2-prior-knowledge") {
+        return http_version::http2_prior_knowledge;
+    }
+    throw std::invalid_argument("unknown HTTP version: " + std::string(name));
+}
+
+http_version supported_http_version(http_version requested,
+                                    const curl_version_info_data& info) {
+    if (requested == http_version::http1_1) {
+        return requested;
+    }
+    if (!(info.features & CURL_VERSION_HTTP2) ||
+        (requested == http_version::http2_prior_knowledge &&
+         info.version_num < 0x080000)) {
+        return http_version::http1_1;
+    }
+    return requested;
+}
+
+event_loop::event_loop(std::size_t max_host_connections,
+                       std::size_t max_in_flight,
+                       http_version version,
+                       throttle::limiter* limiter)
+    : m_multi(curl_multi_init()),
+      m_epoll(-1),
+      m_wake(-1),
+      m_max_in_flight(std::max<std::size_t>(max_in_flight, 1)),
+      m_http_version(
+          supported_http_version(version, *curl_version_info(CURLVERSION_NOW))),
+      m_limiter(limiter),
+      m_stopping(false) {
+    if (!m_multi) {
+        throw error("Failed to initialize curl multi handle.");
+    }
+
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    epoll_event wake_event{};
+    wake_event.events = EPOLLIN;
+    wake_event.data.fd = m_wake;
+    if (m_epoll < 0 || m_wake < 0 ||
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &wake_event) < 0) {
+        std::string message = std::strerror(errno);
+        if (m_epoll >= 0) {
+            ::close(m_epoll);
+        }
+        if (m_wake >= 0) {
+            ::close(m_wake);
+        }
+        throw error("Failed to create the event loop: " + message);
+    }
+
+    curl_multi_setopt(m_multi.get(), CURLMOPT_SOCKETFUNCTION, on_socket);
+    curl_multi_setopt(m_multi.get(), CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(m_multi.get(), CURLMOPT_TIMERFUNCTION, on_timer);
+    curl_multi_setopt(m_multi.get(), CURLMOPT_TIMERDATA, this);
+    curl_multi_setopt(m_multi.get(),
+                      CURLMOPT_MAX_HOST_CONNECTIONS,
+                      static_cast<long>(std::max<std::size_t>(max_host_connections, 1)));
+    curl_multi_setopt(m_multi.get(),
+                      CURLMOPT_PIPELINING,
+                      m_http_version == http_version::http1_1 ? CURLPIPE_NOTHING
+                                                              : CURLPIPE_MULTIPLEX);
+
+    if (m_limiter) {
+        // transfers held back by the limit may start once any request to
+        // the endpoint, from this loop or not, is released
+        m_watch_id = m_limiter->watch([this] { wake(); });
+    }
+    m_thread = std::thread([this] { run(); });
+}
+
+void event_loop::wake() {
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto written = ::write(m_wake, &one, sizeof(one));
+}
+
+event_loop::~event_loop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    wake();
+    m_thread.join();
+    if (m_limiter) {
+        m_limiter->unwatch(m_watch_id);
+    }
+
+    for (auto& [handle, running] : m_running) {
+        curl_multi_remove_handle(m_multi.get(), handle);
+        running.ticket.reset();
+        running.done(CURLE_ABORTED_BY_CALLBACK);
+    }
+    for (auto& queue : m_waiting) {
+        for (transfer& t : queue) {
+            t.done(CURLE_ABORTED_BY_CALLBACK);
+        }
+    }
+    for (auto& [p, t] : m_incoming) {
+        t.done(CURLE_ABORTED_BY_CALLBACK);
+    }
+
+    ::close(m_epoll);
+    ::close(m_wake);
+}
+
+event_loop& event_loop::global() {
+    static event_loop loop(
+        env_size("H5S3_MAX_HOST_CONNECTIONS", pool::default_max_per_host),
+        env_size("H5S3_MAX_IN_FLIGHT", default_max_in_flight),
+        [] {
+            const char* value = std::getenv("H5S3_HTTP_VERSION");
+            return value && *value ? parse_http_version(value) : http_version::http1_1;
+        }(),
+        &throttle::limiter::global());
+    return loop;
+}
+
+int event_loop::on_socket(CURL*, curl_socket_t s, int what, void* userp, void*) {
+    auto& loop = *static_cast<event_loop*>(userp);
+    if (what == CURL_POLL_REMOVE) {
+        epoll_ctl(loop.m_epoll, EPOLL_CTL_DEL, s, nullptr);
+        loop.m_sockets.erase(s);
+        return 0;
+    }
+
+    epoll_event event{};
+    event.data.fd = s;
+    if (what & CURL_POLL_IN) {
+        event.events |= EPOLLIN;
+    }
+    if (what & CURL_POLL_OUT) {
+        event.events |= EPOLLOUT;
+    }
+    int op = loop.m_sockets.insert(s).second ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    return epoll_ctl(loop.m_epoll, op, s, &event) < 0 ? -1 : 0;
+}
+
+int event_loop::on_timer(CURLM*, long timeout_ms, void* userp) {
+    auto& loop = *static_cast<event_loop*>(userp);
+    if (timeout_ms < 0) {
+        loop.m_deadline.reset();
+    }
+    else {
+        loop.m_deadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    }
+    return 0;
+}
+
+void event_loop::start(CURL* handle, io::priority p, completion done, std::string key) {
+    switch (m_http_version) {
+    case http_version::http1_1:
+        curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+        break;
+    case http_version::http2:
+        curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+        curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+        break;
+    case http_version::http2_prior_knowledge:
+        curl_easy_setopt(
+            handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE);
+        curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+        break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_stopping) {
+            m_incoming.emplace_back(p,
+                                    transfer{handle, std::move(done), std::move(key)});
+            done = nullptr;
+        }
+    }
+    if (done) {
+        done(CURLE_ABORTED_BY_CALLBACK);
+        return;
+    }
+    wake();
+}
+
+void event_loop::admit() {
+    m_retry_at.reset();
+    auto retry_at = std::chrono::steady_clock::time_point::max();
+    for (auto& queue : m_waiting) {
+        auto it = queue.begin();
+        while (it != queue.end() && m_running.size() < m_max_in_flight) {
+            std::optional<throttle::limiter::ticket> ticket =
+                m_limiter ? m_limiter->try_acquire(it->key, retry_at) : std::nullopt;
+            if (m_limiter && !ticket) {
+                // later transfers may be to another endpoint
+                ++it;
+                continue;
+            }
+            transfer t = std::move(*it);
+            it = queue.erase(it);
+
+            if (curl_multi_add_handle(m_multi.get(), t.handle) != CURLM_OK) {
+                ticket.reset();
+                t.done(CURLE_FAILED_INIT);
+                continue;
+            }
+            m_running.emplace(t.handle,
+                              running_transfer{std::move(t.done), std::move(ticket)});
+        }
+    }
+    if (retry_at != std::chrono::steady_clock::time_point::max()) {
+        m_retry_at = retry_at;
+    }
+}
+
+void event_loop::finish_done() {
+    CURLMsg* message;
+    int left;
+    while ((message = curl_multi_info_read(m_multi.get(), &left))) {
+        if (message->msg != CURLMSG_DONE) {
+            continue;
+        }
+        CURL* handle = message->easy_handle;
+        CURLcode code = message->data.result;
+        curl_multi_remove_handle(m_multi.get(), handle);
+
+        auto search = m_running.find(handle);
+        completion done = std::move(search->second.done);
+        if (search->second.ticket) {
+            search->second.ticket->finish(read_outcome(handle, code != CURLE_OK));
+        }
+        m_running.erase(search);
+        done(code);
+    }
+}
+
+void event_loop::run() {
+    std::array<epoll_event, 64> events;
+    int running;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping) {
+                return;
+            }
+            for (auto& [p, t] : m_incoming) {
+                m_waiting[static_cast<std::size_t>(p)].push_back(std::move(t));
+            }
+            m_incoming.clear();
+        }
+        admit();
+
+        std::optional<std::chrono::steady_clock::time_point> wake_at = m_deadline;
+        if (m_retry_at && (!wake_at || *m_retry_at < *wake_at)) {
+            wake_at = m_retry_at;
+        }
+        int timeout = -1;
+        if (wake_at) {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+                *wake_at - std::chrono::steady_clock::now());
+            timeout = std::max<int>(remaining.count(), 0);
+        }
+
+        int count = epoll_wait(m_epoll, events.data(), events.size(), timeout);
+        for (int ix = 0; ix < count; ++ix) {
+            int fd = events[ix].data.fd;
+            if (fd == m_wake) {
+                std::uint64_t value;
+                [[maybe_unused]] auto drained = ::read(m_wake, &value, sizeof(value));
+                continue;
+            }
+
+            int flags = 0;
+            if (events[ix].events & EPOLLIN) {
+                flags |= CURL_CSELECT_IN;
+            }
+            if (events[ix].events & EPOLLOUT) {
+                flags |= CURL_CSELECT_OUT;
+            }
+            if (events[ix].events & (EPOLLERR | EPOLLHUP)) {
+                flags |= CURL_CSELECT_ERR;
+            }
+            curl_multi_socket_action(m_multi.get(), fd, flags, &running);
+        }
+
+        if (m_deadline && std::chrono::steady_clock::now() >= *m_deadline) {
+            // the timer callback may set a new deadline from inside
+            // `curl_multi_socket_action`
+            m_deadline.reset();
+            curl_multi_socket_action(m_multi.get(), CURL_SOCKET_TIMEOUT, 0, &running);
+        }
+        finish_done();
+    }
+}
+
+namespace {
+/** The state of an asynchronous request, which must outlive the transfer.
+ */
+struct async_request {
+    std::unique_ptr<CURL, curl_deleter> curl;
+    std::string url;
+    owned_header_list headers;
+    std::array<char, CURL_ERROR_SIZE> error_buffer{};
+    // the address the request is sent to, if its host has several
+    std::optional<endpoints::lease> endpoint;
+    owned_header_list connect_to;
+
+    async_request(const std::string_view& url, const std::vector<header>& headers)
+        : curl(curl_easy_init()), url(url),
+          endpoint(endpoints::global().choose(url_host(url))) {
+        if (!curl) {
+            throw error("Failed to initialize curl request.");
+        }
+        curl_easy_setopt(curl.get(), CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl.get(), CURLOPT_URL, this->url.c_str());
+        curl_easy_setopt(curl.get(), CURLOPT_ERRORBUFFER, error_buffer.data());
+        this->headers = set_headers(curl.get(), headers);
+
+        if (endpoint) {
+            connect_to.reset(curl_slist_append(nullptr, endpoint->connect_to().c_str()));
+            if (!connect_to) {
+                throw error("Failed to construct the connect to list.");
+            }
+            curl_easy_setopt(curl.get(), CURLOPT_CONNECT_TO, connect_to.get());
+        }
+    }
+
+    /** Start the transfer on `event_loop::global()`.
+     */
+    void start(io::priority p, event_loop::completion done) {
+        event_loop::global().start(curl.get(),
+                                   p,
+                                   std::move(done),
+                                   endpoint_key(url_host(url), endpoint));
+    }
+
+    /** Throw if the transfer failed, otherwise return the response code.
+     */
+    long response_code(CURLcode code) {
+        if (CURLE_OK != code) {
+            if (endpoint) {
+                endpoint->failed();
+            }
+            throw error(error_buffer[0] ? error_buffer.data() : curl_easy_strerror(code));
+        }
+        long response_code;
+        code = curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &response_code);
+        if (CURLE_OK != code) {
+            throw error(curl_easy_strerror(code));
+        }
+        return response_code;
+    }
+};
+}  // namespace
+
+async::future<get_result> async_get(const std::string_view& url,
+                                    const std::vector<header>& headers,
+                                    utils::out_buffer out,
+                                    io::priority p) {
+    struct get_request : async_request {
+        utils::out_buffer out;
+        utils::out_buffer cursor;
+        // the body of an error response, which is not written to `out`
+        std::string error_body;
+        std::string etag;
+
+        get_request(const std::string_view& url,
+                    const std::vector<header>& headers,
+                    utils::out_buffer out)
+            : async_request(url, headers), out(out), cursor(out) {}
+    };
+    auto request = std::make_shared<get_request>(url, headers, out);
+    CURL* curl = request->curl.get();
+
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, request.get());
+    write_callback_type write_callback =
+        [](char* ptr, std::size_t size, std::size_t nmemb, void* closure) {
+            auto& request = *reinterpret_cast<get_request*>(closure);
+            std::size_t write_size = size * nmemb;
+
+            long code = 0;
+            curl_easy_getinfo(request.curl.get(), CURLINFO_RESPONSE_CODE, &code);
+            if (200 != code && 206 != code) {
+                request.error_body.append(ptr, write_size);
+                return write_size;
+            }
+            if (write_size > request.cursor.size()) {
+                // fails the transfer with CURLE_WRITE_ERROR
+                return std::size_t(0);
+            }
+            std::memcpy(request.cursor.data(), ptr, write_size);
+            request.cursor.remove_prefix(write_size);
+            return write_size;
+        };
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    set_etag_header_callback(curl, request->etag);
+
+    async::promise<get_result> done;
+    request->start(p, [request, done](CURLcode code) {
+        get_result result;
+        try {
+            long response_code = request->response_code(code);
+            if (304 != response_code) {
+                throw_for_status(response_code, request->error_body);
+                result.size = request->cursor.data() - request->out.data();
+            }
+            result.etag = std::move(request->etag);
+        }
+        catch (...) {
+            done.set_error(std::current_exception());
+            return;
+        }
+        done.set_value(std::move(result));
+    });
+    return done.get_future();
+}
+
+async::future<std::string> async_put(const std::string_view& url,
+                                     const std::vector<header>& headers,
+                                     const std::string_view& content,
+                                     io::priority p) {
+    struct put_request : async_request {
+        std::string_view body;
+        std::string response;
+
+        put_request(const std::string_view& url,
+                    const std::vector<header>& headers,
+                    const std::string_view& body)
+            : async_request(url, headers), body(body) {}
+    };
+    auto request = std::make_shared<put_request>(url, headers, content);
+    CURL* curl = request->curl.get();
+
+    curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, &read_callback);
+    curl_easy_setopt(curl, CURLOPT_READDATA, &request->body);
+    curl_easy_setopt(curl,
+                     CURLOPT_INFILESIZE_LARGE,
+                     static_cast<curl_off_t>(content.size()));
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &request->response);
+    write_callback_type write_callback =
+        [](char* ptr, std::size_t size, std::size_t nmemb, void* closure) {
+            reinterpret_cast<std::string*>(closure)->append(ptr, size * nmemb);
+            return size * nmemb;
+        };
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+
+    async::promise<std::string> done;
+    request->start(p, [request, done](CURLcode code) {
+        try {
+            throw_for_status(request->response_code(code), request->response);
+        }
+        catch (...) {
+            done.set_error(std::current_exception());
+            return;
+        }
+        done.set_value(std::move(request->response));
+    });
+    return done.get_future();
+}
 }  // namespace h5s3::curl
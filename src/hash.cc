@@ -2,13 +2,19 @@
 
 namespace h5s3::hash {
 
-/* Generate a sha256 hexdigest of `data`.
+/* Generate a sha256 digest of `data`.
    See https://tools.ietf.org/html/rfc4634.
  */
-sha256_hex sha256_hexdigest(const std::string_view& data) {
+sha256 sha256_digest(const std::string_view& data) {
     sha256 hash;
     SHA256(reinterpret_cast<const unsigned char*>(data.data()), data.size(), hash.data());
-    return to_hex(hash);
+    return hash;
+}
+
+/* Generate a sha256 hexdigest of `data`.
+ */
+sha256_hex sha256_hexdigest(const std::string_view& data) {
+    return to_hex(sha256_digest(data));
 }
 
 #if OPENSSL_VERSION_NUMBER <= 0x010100000
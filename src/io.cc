@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#include "h5s3/private/io.h"
+
+namespace h5s3::io {
+namespace {
+thread_local bool is_worker = false;
+}  // namespace
+
+service::service(std::size_t threads) : m_stopping(false) {
+    threads = std::max<std::size_t>(threads, 1);
+    m_workers.reserve(threads);
+    for (std::size_t ix = 0; ix < threads; ++ix) {
+        m_workers.emplace_back([this] { work(); });
+    }
+}
+
+service::~service() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_ready.notify_all();
+    for (std::thread& t : m_workers) {
+        t.join();
+    }
+}
+
+service& service::global() {
+    static service io([] {
+        const char* value = std::getenv("H5S3_IO_THREADS");
+        if (!value || !*value) {
+            return default_threads;
+        }
+        try {
+            return static_cast<std::size_t>(std::stoull(value));
+        }
+        catch (const std::exception&) {
+            throw std::invalid_argument(
+                std::string("H5S3_IO_THREADS is not a number of threads: ") + value);
+        }
+    }());
+    return io;
+}
+
+bool service::on_worker() {
+    return is_worker;
+}
+
+void service::work() {
+    is_worker = true;
+    while (true) {
+        std::function<void()> f;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto queue = m_queues.end();
+            m_ready.wait(lock, [&] {
+                queue = std::find_if(m_queues.begin(), m_queues.end(), [](auto& q) {
+                    return !q.empty();
+                });
+                return m_stopping || queue != m_queues.end();
+            });
+            if (queue == m_queues.end()) {
+                // stopping with nothing left to do
+                return;
+            }
+            f = std::move(queue->front());
+            queue->pop_front();
+        }
+        f();
+    }
+}
+
+void service::submit(priority p, std::function<void()> f) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queues[static_cast<std::size_t>(p)].push_back(std::move(f));
+    }
+    m_ready.notify_one();
+}
+
+void service::parallel(priority p,
+                       std::size_t count,
+                       std::size_t concurrency,
+                       const std::function<void(std::size_t)>& f) {
+    // Helpers which start after every call has been claimed return without
+    // touching `f`, so the state outlives this frame but `f` need not.
+    struct state {
+        const std::function<void(std::size_t)>* f;
+        std::size_t count;
+        std::atomic<std::size_t> next;
+        std::mutex mutex;
+        std::condition_variable done_cv;
+        std::size_t done;
+        std::exception_ptr error;
+    };
+    auto s = std::make_shared<state>();
+    s->f = &f;
+    s->count = count;
+    s->next = 0;
+    s->done = 0;
+
+    auto run = [](state& s) {
+        std::size_t ix;
+        while ((ix = s.next++) < s.count) {
+            std::exception_ptr error;
+            try {
+                (*s.f)(ix);
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(s.mutex);
+            if (error && !s.error) {
+                s.error = error;
+            }
+            if (++s.done == s.count) {
+                s.done_cv.notify_all();
+            }
+        }
+    };
+
+    if (!on_worker()) {
+        std::size_t helpers =
+            std::min(std::max<std::size_t>(concurrency, 1), count) - (count > 0);
+        for (std::size_t ix = 0; ix < helpers; ++ix) {
+            submit(p, [s, run] { run(*s); });
+        }
+    }
+    run(*s);
+
+    std::unique_lock<std::mutex> lock(s->mutex);
+    s->done_cv.wait(lock, [&] { return s->done == s->count; });
+    if (s->error) {
+        std::rethrow_exception(s->error);
+    }
+}
+}  // namespace h5s3::io
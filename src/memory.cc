@@ -0,0 +1,146 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "h5s3/private/memory.h"
+
+namespace h5s3::memory {
+namespace detail {
+std::atomic<std::uint64_t> pressure_generation(0);
+}  // namespace detail
+
+namespace {
+/** The path of this process's cgroup relative to the cgroup v2 mount point,
+    or an empty string if it is not in a v2 cgroup.
+ */
+std::string cgroup_v2_path() {
+    std::ifstream f("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(f, line)) {
+        // the v2 hierarchy is listed as "0::<path>"
+        if (line.rfind("0::", 0) == 0) {
+            std::string path = line.substr(3);
+            return path == "/" ? "" : path;
+        }
+    }
+    return "";
+}
+
+/** Find a file in this process's cgroup, falling back to the root of the
+    cgroup filesystem, which is this process's cgroup inside a container.
+ */
+std::optional<std::string> cgroup_file(const std::string& root, const char* name) {
+    for (const std::string& dir : {root + cgroup_v2_path(), root}) {
+        std::string path = dir + '/' + name;
+        if (access(path.data(), R_OK) == 0) {
+            return path;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::size_t> read_limit(const std::string& path) {
+    std::ifstream f(path);
+    std::string value;
+    if (!(f >> value) || value == "max") {
+        return std::nullopt;
+    }
+    try {
+        std::size_t limit = std::stoull(value);
+        // cgroup v1 reports no limit as a huge page aligned maximum
+        if (limit >= (std::size_t(1) << 60)) {
+            return std::nullopt;
+        }
+        return limit;
+    }
+    catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+}  // namespace
+
+std::optional<std::size_t> cgroup_memory_limit(const std::string& root) {
+    if (auto path = cgroup_file(root, "memory.max")) {
+        return read_limit(*path);
+    }
+    if (auto path = cgroup_file(root, "memory/memory.limit_in_bytes")) {
+        return read_limit(*path);
+    }
+    return std::nullopt;
+}
+
+std::size_t default_cache_bytes() {
+    if (const char* value = std::getenv("H5S3_PAGE_CACHE_BYTES"); value && *value) {
+        try {
+            return std::stoull(value);
+        }
+        catch (const std::exception&) {
+            throw std::invalid_argument(
+                std::string("H5S3_PAGE_CACHE_BYTES is not a number of bytes: ") +
+                value);
+        }
+    }
+
+    if (auto limit = cgroup_memory_limit()) {
+        return std::min(*limit / 4, fallback_cache_bytes);
+    }
+    return fallback_cache_bytes;
+}
+
+bool watch_pressure(std::uint64_t stall_us, std::uint64_t window_us) {
+    static std::mutex mutex;
+    static bool watching = false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (watching) {
+        return true;
+    }
+
+    std::string path = cgroup_file("/sys/fs/cgroup", "memory.pressure")
+                           .value_or("/proc/pressure/memory");
+    int fd = open(path.data(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    // the trigger must be written with its terminating null byte
+    std::string trigger =
+        "some " + std::to_string(stall_us) + ' ' + std::to_string(window_us);
+    if (write(fd, trigger.data(), trigger.size() + 1) < 0) {
+        close(fd);
+        return false;
+    }
+
+    std::thread([fd] {
+        pollfd p{fd, POLLPRI, 0};
+        while (true) {
+            int ready = poll(&p, 1, -1);
+            if (ready < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            if (p.revents & POLLERR) {
+                // the cgroup went away
+                break;
+            }
+            if (p.revents & POLLPRI) {
+                signal_pressure();
+            }
+        }
+        close(fd);
+    }).detach();
+
+    watching = true;
+    return true;
+}
+}  // namespace h5s3::memory
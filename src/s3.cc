@@ -130,15 +130,22 @@ auto inner_get(const notary& signer,
                const std::string_view& path,
                const std::string_view& host,
                bool use_tls,
+               const std::string_view& range,
+               const std::string_view& if_none_match,
                F&& get) {
     hash::sha256_hex payload_hash = hash::sha256_hexdigest("");
 
     std::vector<query_param> query = {};
-    std::vector<header> headers = {
-        {"host", host},
-        {"x-amz-content-sha256", hash::as_string_view(payload_hash)},
-        {"x-amz-date", signer.signing_time()},
-    };
+    // the headers must be sorted by name to be signed
+    std::vector<header> headers = {{"host", host}};
+    if (!if_none_match.empty()) {
+        headers.emplace_back("if-none-match", if_none_match);
+    }
+    if (!range.empty()) {
+        headers.emplace_back("range", range);
+    }
+    headers.emplace_back("x-amz-content-sha256", hash::as_string_view(payload_hash));
+    headers.emplace_back("x-amz-date", signer.signing_time());
 
     std::string auth = signer.authorization_header(HTTPVerb::GET,
                                                    bucket_name,
@@ -166,12 +173,12 @@ std::string get_object(const notary& signer,
                        const std::string_view& path,
                        const std::string_view& host,
                        bool use_tls) {
-    auto get = [](const auto& url, const auto& headers) {
-        curl::session session;
-        return session.get(url, headers);
+    auto get = [&](const auto& url, const auto& headers) {
+        auto session = curl::pool::global().acquire(host);
+        return session->get(url, headers);
     };
 
-    return inner_get(signer, bucket_name, path, host, use_tls, get);
+    return inner_get(signer, bucket_name, path, host, use_tls, "", "", get);
 }
 
 std::size_t get_object(utils::out_buffer& out,
@@ -180,27 +187,96 @@ std::size_t get_object(utils::out_buffer& out,
                        const std::string_view& path,
                        const std::string_view& host,
                        bool use_tls) {
-    auto get = [&out](const auto& url, const auto& headers) {
-        curl::session session;
-        return session.get(url, headers, out);
+    auto get = [&](const auto& url, const auto& headers) {
+        auto session = curl::pool::global().acquire(host);
+        return session->get(url, headers, out);
     };
-    return inner_get(signer, bucket_name, path, host, use_tls, get);
+    return inner_get(signer, bucket_name, path, host, use_tls, "", "", get);
 }
 
-std::string set_object(const notary& signer,
-                       const std::string_view& bucket_name,
-                       const std::string_view& path,
-                       const std::string_view& content,
-                       const std::string_view& host,
-                       bool use_tls) {
+std::size_t get_object_range(utils::out_buffer& out,
+                             std::size_t offset,
+                             const notary& signer,
+                             const std::string_view& bucket_name,
+                             const std::string_view& path,
+                             const std::string_view& host,
+                             bool use_tls) {
+    if (!out.size()) {
+        return 0;
+    }
+
+    std::stringstream range;
+    range << "bytes=" << offset << '-' << offset + out.size() - 1;
+
+    auto get = [&](const auto& url, const auto& headers) {
+        auto session = curl::pool::global().acquire(host);
+        return session->get(url, headers, out);
+    };
+    return inner_get(signer, bucket_name, path, host, use_tls, range.str(), "", get);
+}
+
+std::optional<std::size_t> get_object(utils::out_buffer& out,
+                                      std::string& etag,
+                                      const notary& signer,
+                                      const std::string_view& bucket_name,
+                                      const std::string_view& path,
+                                      const std::string_view& host,
+                                      bool use_tls) {
+    // copy the tag to send, `etag` is overwritten with the response's tag
+    std::string if_none_match = etag;
+    auto get = [&](const auto& url, const auto& headers) {
+        auto session = curl::pool::global().acquire(host);
+        return session->get(url, headers, out, etag);
+    };
+    return inner_get(signer, bucket_name, path, host, use_tls, "", if_none_match, get);
+}
+
+std::optional<std::size_t> get_object_range(utils::out_buffer& out,
+                                            std::size_t offset,
+                                            std::string& etag,
+                                            const notary& signer,
+                                            const std::string_view& bucket_name,
+                                            const std::string_view& path,
+                                            const std::string_view& host,
+                                            bool use_tls) {
+    if (!out.size()) {
+        return 0;
+    }
+
+    std::stringstream range;
+    range << "bytes=" << offset << '-' << offset + out.size() - 1;
+
+    std::string if_none_match = etag;
+    auto get = [&](const auto& url, const auto& headers) {
+        auto session = curl::pool::global().acquire(host);
+        return session->get(url, headers, out, etag);
+    };
+    return inner_get(
+        signer, bucket_name, path, host, use_tls, range.str(), if_none_match, get);
+}
+
+namespace {
+template<typename F>
+auto inner_set(const notary& signer,
+               const std::string_view& bucket_name,
+               const std::string_view& path,
+               const std::string_view& content,
+               const std::string_view& copy_source,
+               const std::string_view& host,
+               bool use_tls,
+               F&& put) {
     hash::sha256_hex payload_hash = hash::sha256_hexdigest(content);
     const std::string& signing_time = signer.signing_time();
 
     std::vector<query_param> query = {};
+    // the headers must be sorted by name to be signed
     std::vector<header> headers = {{"host", host},
                                    {"x-amz-content-sha256",
-                                    hash::as_string_view(payload_hash)},
-                                   {"x-amz-date", signing_time}};
+                                    hash::as_string_view(payload_hash)}};
+    if (!copy_source.empty()) {
+        headers.emplace_back("x-amz-copy-source", copy_source);
+    }
+    headers.emplace_back("x-amz-date", signing_time);
 
     std::string auth = signer.authorization_header(HTTPVerb::PUT,
                                                    bucket_name,
@@ -217,8 +293,85 @@ std::string set_object(const notary& signer,
     }
     url_formatter << "://" << host << '/' << bucket_name << '/' << path;
 
-    curl::session session;
-    return session.put(url_formatter.str(), headers, content);
+    return put(url_formatter.str(), headers);
+}
+}  // namespace
+
+std::string set_object(const notary& signer,
+                       const std::string_view& bucket_name,
+                       const std::string_view& path,
+                       const std::string_view& content,
+                       const std::string_view& host,
+                       bool use_tls) {
+    auto put = [&](const auto& url, const auto& headers) {
+        auto session = curl::pool::global().acquire(host);
+        return session->put(url, headers, content);
+    };
+    return inner_set(signer, bucket_name, path, content, "", host, use_tls, put);
+}
+
+std::string copy_object(const notary& signer,
+                        const std::string_view& source_bucket_name,
+                        const std::string_view& source_path,
+                        const std::string_view& bucket_name,
+                        const std::string_view& path,
+                        const std::string_view& host,
+                        bool use_tls) {
+    std::stringstream copy_source;
+    copy_source << '/' << source_bucket_name << '/' << source_path;
+
+    auto put = [&](const auto& url, const auto& headers) {
+        auto session = curl::pool::global().acquire(host);
+        return session->put(url, headers, "");
+    };
+    std::string result =
+        inner_set(signer, bucket_name, path, "", copy_source.str(), host, use_tls, put);
+
+    // a copy which fails after s3 has started responding is reported in the
+    // body of a 200 response
+    if (result.find("<Error>") != std::string::npos) {
+        throw curl::http_error("copy of " + copy_source.str() + " failed: " + result,
+                               500);
+    }
+    return result;
+}
+
+async::future<curl::get_result> async_get_object(utils::out_buffer out,
+                                                 std::optional<std::size_t> offset,
+                                                 const std::string_view& etag,
+                                                 const notary& signer,
+                                                 const std::string_view& bucket_name,
+                                                 const std::string_view& path,
+                                                 const std::string_view& host,
+                                                 bool use_tls,
+                                                 io::priority p) {
+    std::string range;
+    if (offset) {
+        if (!out.size()) {
+            return async::make_ready(curl::get_result{0, std::string(etag)});
+        }
+        std::stringstream formatter;
+        formatter << "bytes=" << *offset << '-' << *offset + out.size() - 1;
+        range = formatter.str();
+    }
+
+    auto get = [&](const auto& url, const auto& headers) {
+        return curl::async_get(url, headers, out, p);
+    };
+    return inner_get(signer, bucket_name, path, host, use_tls, range, etag, get);
+}
+
+async::future<std::string> async_set_object(const notary& signer,
+                                            const std::string_view& bucket_name,
+                                            const std::string_view& path,
+                                            const std::string_view& content,
+                                            const std::string_view& host,
+                                            bool use_tls,
+                                            io::priority p) {
+    auto put = [&](const auto& url, const auto& headers) {
+        return curl::async_put(url, headers, content, p);
+    };
+    return inner_set(signer, bucket_name, path, content, "", host, use_tls, put);
 }
 
 }  // namespace h5s3::s3
@@ -1,9 +1,106 @@
 #include <cassert>
+#include <chrono>
+#include <cstring>
 #include <regex>
+#include <set>
+#include <tuple>
 
+#include "h5s3/private/io.h"
 #include "h5s3/private/s3_driver.h"
 
 namespace h5s3::s3_driver {
+namespace {
+/** Parse a comma separated list.
+
+    @param list The list.
+    @param what The name of an item, for error messages.
+ */
+std::vector<std::string> parse_list(const std::string_view& list, const char* what) {
+    std::vector<std::string> out;
+    std::size_t start = 0;
+    while (start < list.size()) {
+        std::size_t end = std::min(list.find(',', start), list.size());
+        if (end == start) {
+            throw std::runtime_error("empty " + std::string(what) + " in list: " +
+                                     std::string(list));
+        }
+        out.emplace_back(list.substr(start, end - start));
+        start = end + 1;
+    }
+    return out;
+}
+
+std::vector<std::string> parse_buckets(const std::string_view& list) {
+    return parse_list(list, "bucket name");
+}
+
+/** Is every byte of `data` zero?
+ */
+bool all_zeros(const std::string_view& data) {
+    // compare the data with itself shifted by one byte, which memcmp does
+    // far faster than a loop
+    return data.empty() ||
+           (data[0] == 0 && !std::memcmp(data.data(), data.data() + 1, data.size() - 1));
+}
+
+/** The hashed key prefix of an object, including the trailing slash. Every
+    prefix has as many hex digits as the largest one.
+
+    @param hash The object's hash.
+    @param key_prefixes The number of prefixes, at least 1.
+ */
+std::string key_prefix(std::uint64_t hash, std::size_t key_prefixes) {
+    std::size_t digits = 1;
+    while (digits < 16 && (key_prefixes - 1) >> (4 * digits)) {
+        ++digits;
+    }
+    std::size_t prefix = hash % key_prefixes;
+    std::string out(digits, '0');
+    for (std::size_t ix = 0; ix < digits; ++ix) {
+        out[digits - ix - 1] = "0123456789abcdef"[(prefix >> (4 * ix)) & 0xf];
+    }
+    out += '/';
+    return out;
+}
+
+/** The content-addressed objects known to exist, shared by every store so
+    that a process writing many files only checks for each object once.
+    Content-addressed objects are never deleted, so entries do not go stale.
+ */
+class known_contents {
+private:
+    std::mutex m_mutex;
+    std::unordered_set<std::string> m_keys;
+
+public:
+    static known_contents& global() {
+        static known_contents k;
+        return k;
+    }
+
+    bool contains(const std::string& bucket, const std::string& key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_keys.count(bucket + '/' + key);
+    }
+
+    void insert(const std::string& bucket, const std::string& key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_keys.insert(bucket + '/' + key);
+    }
+};
+
+std::string format_buckets(const std::vector<std::string>& buckets) {
+    std::string out;
+    for (const std::string& bucket : buckets) {
+        if (!out.empty()) {
+            out += ',';
+        }
+        out += bucket;
+    }
+    return out;
+}
+}  // namespace
+
 const char* s3_kv_store::name = "h5s3";
 
 s3_kv_store::s3_kv_store(const std::string& host,
@@ -13,62 +110,376 @@ s3_kv_store::s3_kv_store(const std::string& host,
                          const std::string& access_key,
                          const std::string& secret_key,
                          const std::string& region,
-                         const std::size_t page_size)
+                         const std::size_t page_size,
+                         const std::size_t pages_per_object,
+                         const std::size_t key_prefixes,
+                         std::vector<std::string> buckets,
+                         bool content_addressed,
+                         bool log_structured)
     : m_host(host),
       m_use_tls(use_tls),
       m_bucket(bucket),
       m_path(path),
       m_notary(region, access_key, secret_key),
       m_allocated_pages(0),
-      m_page_size(page_size) {
+      m_page_size(page_size),
+      m_pages_per_object(pages_per_object),
+      m_key_prefixes(key_prefixes),
+      m_buckets(std::move(buckets)),
+      m_content_addressed(content_addressed),
+      m_log_structured(log_structured),
+      m_log_segments(0) {
 
     try {
-        std::string result =
-            s3::get_object(m_notary, m_bucket, path + "/.meta", m_host, m_use_tls);
+        read_metadata();
+    }
+    catch (const curl::http_error& e) {
+        if (e.code != 404) {
+            throw;
+        }
+        m_stats.not_found.add();
+    }
 
-        std::regex metadata_regex("page_size=([0-9]+)\n"
-                                  "allocated_pages=([0-9]+)\n"
-                                  "invalid_pages=\\{(([0-9]+ )*[0-9]*)\\}\n");
-        std::smatch match;
+    if (m_pages_per_object == 0) {
+        m_pages_per_object = 1;
+    }
+}
 
-        if (!std::regex_match(result, match, metadata_regex)) {
-            std::stringstream s;
-            s << "failed to parse metadata from .meta file:\n" << result;
-            throw std::runtime_error(s.str());
-        }
+std::uint64_t s3_kv_store::object_hash(const std::string& path,
+                                       std::size_t object_id) const {
+    // FNV-1a of the path, so that the objects of different files do not all
+    // start on the same prefix
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for (char c : path) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+    }
+
+    // the splitmix64 finalizer spreads consecutive ids over every prefix
+    hash ^= object_id;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+    return hash ^ (hash >> 31);
+}
+
+std::string s3_kv_store::object_key(const std::string& path,
+                                    std::size_t object_id) const {
+    std::string key = path + "/" + std::to_string(object_id);
+    if (!m_key_prefixes) {
+        return key;
+    }
+    return key_prefix(object_hash(path, object_id), m_key_prefixes) + key;
+}
+
+std::string s3_kv_store::object_key(std::size_t object_id) const {
+    if (!m_content_addressed) {
+        return object_key(m_path, object_id);
+    }
+    std::lock_guard<std::mutex> lock(m_contents_mutex);
+    return content_key(m_contents.at(object_id));
+}
+
+const std::string& s3_kv_store::object_bucket(const std::string& bucket,
+                                              const std::string& path,
+                                              std::size_t object_id) const {
+    if (m_buckets.empty()) {
+        return bucket;
+    }
+    // the prefix uses the low bits of the hash, so choose with the high ones
+    return m_buckets[(object_hash(path, object_id) >> 32) % m_buckets.size()];
+}
 
+const std::string& s3_kv_store::object_bucket(std::size_t object_id) const {
+    if (!m_content_addressed) {
+        return object_bucket(m_bucket, m_path, object_id);
+    }
+    std::lock_guard<std::mutex> lock(m_contents_mutex);
+    return content_bucket(m_contents.at(object_id));
+}
+
+std::string s3_kv_store::content_key(const std::string& digest) const {
+    std::string key = ".h5s3/objects/" + digest;
+    if (!m_key_prefixes) {
+        return key;
+    }
+    // the digest is already uniformly distributed, so use its first bits
+    return key_prefix(std::stoull(digest.substr(0, 16), nullptr, 16), m_key_prefixes) +
+           key;
+}
+
+const std::string& s3_kv_store::content_bucket(const std::string& digest) const {
+    if (m_buckets.empty()) {
+        return m_bucket;
+    }
+    return m_buckets[std::stoull(digest.substr(16, 16), nullptr, 16) % m_buckets.size()];
+}
+
+bool s3_kv_store::stored(std::size_t object_id) const {
+    if (!m_content_addressed) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(m_contents_mutex);
+    return m_contents.count(object_id);
+}
+
+void s3_kv_store::put_object(std::size_t object_id, const std::string_view& data) const {
+    if (!m_content_addressed) {
+        m_stats.puts.add();
         {
-            std::size_t metadata_page_size;
-            std::stringstream s(match[1].str());
-            s >> metadata_page_size;
-            if (m_page_size != 0 && metadata_page_size != m_page_size) {
-                std::stringstream s;
-                s << "passed page size does not match existing page size: " << m_page_size
-                  << " != " << metadata_page_size;
-                throw std::runtime_error(s.str());
+            stats::timer t(m_stats.put_latency);
+            s3::set_object(m_notary,
+                           object_bucket(object_id),
+                           object_key(object_id),
+                           data,
+                           m_host,
+                           m_use_tls);
+        }
+        m_stats.bytes_written.add(data.size());
+        return;
+    }
+
+    std::string digest(hash::as_string_view(hash::sha256_hexdigest(data)));
+    const std::string& bucket = content_bucket(digest);
+    std::string key = content_key(digest);
+
+    bool exists = known_contents::global().contains(bucket, key);
+    if (!exists) {
+        // a one byte read is as cheap as a HEAD, and needs no new request type
+        char byte;
+        utils::out_buffer out(&byte, 1);
+        m_stats.gets.add();
+        try {
+            stats::timer t(m_stats.get_latency);
+            s3::get_object_range(out, 0, m_notary, bucket, key, m_host, m_use_tls);
+            exists = true;
+        }
+        catch (const curl::http_error& e) {
+            if (e.code != 404) {
+                throw;
             }
+            m_stats.not_found.add();
+        }
+    }
+    if (!exists) {
+        m_stats.puts.add();
+        {
+            stats::timer t(m_stats.put_latency);
+            s3::set_object(m_notary, bucket, key, data, m_host, m_use_tls);
+        }
+        m_stats.bytes_written.add(data.size());
+    }
+    known_contents::global().insert(bucket, key);
+
+    std::lock_guard<std::mutex> lock(m_contents_mutex);
+    m_contents[object_id] = std::move(digest);
+}
+
+void s3_kv_store::read_metadata() {
+    std::string result;
+    {
+        m_stats.gets.add();
+        stats::timer t(m_stats.get_latency);
+        result =
+            s3::get_object(m_notary, m_bucket, m_path + "/.meta", m_host, m_use_tls);
+    }
+    m_stats.bytes_read.add(result.size());
 
-            m_page_size = metadata_page_size;
+    // the object hashes of a content-addressed file and the log of a
+    // log-structured one are on the last lines, which may be far too long for
+    // std::regex, so they are split off first
+    auto split_last_line = [&](const std::string& name) {
+        std::optional<std::string> out;
+        std::string prefix = '\n' + name + "={";
+        std::size_t start = result.rfind(prefix);
+        if (start == std::string::npos || result.size() < 2 ||
+            result.find('\n', start + 1) != result.size() - 1 ||
+            result[result.size() - 2] != '}') {
+            return out;
         }
+        std::size_t begin = start + prefix.size();
+        out = result.substr(begin, result.size() - 2 - begin);
+        result.resize(start + 1);
+        return out;
+    };
+    std::optional<std::string> contents = split_last_line("contents");
+    std::optional<std::string> log = split_last_line("log");
 
-        {
+    // a sparse file may have thousands of invalid pages, and std::regex
+    // recurses once per repetition, so the page lists are also taken out and
+    // parsed by hand
+    auto take_page_list = [&](const std::string& name) {
+        std::optional<std::vector<page::id>> out;
+        std::string prefix = '\n' + name + "={";
+        std::size_t start = result.find(prefix);
+        if (start == std::string::npos) {
+            return out;
+        }
+        std::size_t begin = start + prefix.size();
+        std::size_t end = result.find("}\n", begin);
+        if (end == std::string::npos ||
+            result.find_first_not_of("0123456789 ", begin) != end) {
+            return out;
+        }
+        out.emplace();
+        std::stringstream s(result.substr(begin, end - begin));
+        page::id page_id;
+        while (s >> page_id) {
+            out->push_back(page_id);
+        }
+        result.erase(begin, end - begin);
+        return out;
+    };
+    std::optional<std::vector<page::id>> invalid_pages =
+        take_page_list("invalid_pages");
+    std::optional<std::vector<page::id>> hot_pages = take_page_list("hot_pages");
+
+    std::regex metadata_regex("page_size=([0-9]+)\n"
+                              "(?:pages_per_object=([0-9]+)\n)?"
+                              "(?:key_prefixes=([0-9]+)\n)?"
+                              "(?:buckets=([^\n]*)\n)?"
+                              "allocated_pages=([0-9]+)\n"
+                              "invalid_pages=\\{\\}\n"
+                              "(?:hot_pages=\\{\\}\n)?"
+                              "(?:log_segments=([0-9]+)\n)?");
+    std::smatch match;
+
+    if (!std::regex_match(result, match, metadata_regex)) {
+        std::stringstream s;
+        s << "failed to parse metadata from .meta file:\n" << result;
+        throw std::runtime_error(s.str());
+    }
+
+    {
+        std::size_t metadata_page_size;
+        std::stringstream s(match[1].str());
+        s >> metadata_page_size;
+        if (m_page_size != 0 && metadata_page_size != m_page_size) {
+            std::stringstream s;
+            s << "passed page size does not match existing page size: " << m_page_size
+              << " != " << metadata_page_size;
+            throw std::runtime_error(s.str());
+        }
+
+        m_page_size = metadata_page_size;
+    }
+
+    {
+        // files written before objects could hold many pages do not
+        // record this
+        std::size_t metadata_pages_per_object = 1;
+        if (match[2].matched) {
             std::stringstream s(match[2].str());
-            s >> m_allocated_pages;
+            s >> metadata_pages_per_object;
+        }
+        if (m_pages_per_object != 0 &&
+            metadata_pages_per_object != m_pages_per_object) {
+            std::stringstream s;
+            s << "passed pages per object does not match existing pages per "
+                 "object: "
+              << m_pages_per_object << " != " << metadata_pages_per_object;
+            throw std::runtime_error(s.str());
         }
 
-        {
+        m_pages_per_object = metadata_pages_per_object;
+    }
+
+    {
+        // files written before keys could be prefixed do not record this
+        std::size_t metadata_key_prefixes = 0;
+        if (match[3].matched) {
             std::stringstream s(match[3].str());
-            page::id page_id;
-            while (s >> page_id) {
-                m_invalid_pages.insert(page_id);
+            s >> metadata_key_prefixes;
+        }
+        if (m_key_prefixes != 0 && metadata_key_prefixes != m_key_prefixes) {
+            std::stringstream s;
+            s << "passed key prefixes do not match existing key prefixes: "
+              << m_key_prefixes << " != " << metadata_key_prefixes;
+            throw std::runtime_error(s.str());
+        }
+
+        m_key_prefixes = metadata_key_prefixes;
+    }
+
+    {
+        std::vector<std::string> metadata_buckets;
+        if (match[4].matched) {
+            metadata_buckets = parse_buckets(match[4].str());
+        }
+        if (!m_buckets.empty() && metadata_buckets != m_buckets) {
+            std::stringstream s;
+            s << "passed buckets do not match existing buckets: "
+              << format_buckets(m_buckets) << " != "
+              << format_buckets(metadata_buckets);
+            throw std::runtime_error(s.str());
+        }
+
+        m_buckets = std::move(metadata_buckets);
+    }
+
+    {
+        // files written before objects could be content-addressed do not
+        // record this
+        bool metadata_content_addressed = contents.has_value();
+        if (m_content_addressed && !metadata_content_addressed) {
+            throw std::runtime_error(
+                "passed content addressed but the existing file is not");
+        }
+        m_content_addressed = metadata_content_addressed;
+
+        std::lock_guard<std::mutex> lock(m_contents_mutex);
+        m_contents.clear();
+        std::stringstream s(contents ? *contents : "");
+        std::string entry;
+        while (s >> entry) {
+            std::size_t colon = entry.find(':');
+            if (colon == std::string::npos || colon + 65 != entry.size()) {
+                throw std::runtime_error("invalid object hash in .meta: " + entry);
             }
+            m_contents.emplace(std::stoull(entry.substr(0, colon)),
+                               entry.substr(colon + 1));
         }
     }
-    catch (const curl::http_error& e) {
-        if (e.code != 404) {
-            throw;
+
+    {
+        // files written before writes could be logged do not record this, and
+        // a file stays log-structured once it has been written that way
+        m_log_structured = m_log_structured || match[6].matched;
+        m_log_segments = 0;
+        if (match[6].matched) {
+            std::stringstream s(match[6].str());
+            s >> m_log_segments;
+        }
+
+        m_log.clear();
+        std::stringstream s(log ? *log : "");
+        std::string entry;
+        while (s >> entry) {
+            std::stringstream fields(entry);
+            page::id page_id;
+            log_entry e;
+            char separators[4] = {};
+            fields >> page_id >> separators[0] >> e.offset >> separators[1] >> e.size >>
+                separators[2] >> e.segment >> separators[3] >> e.segment_offset;
+            if (!fields || fields.peek() != EOF ||
+                std::string_view(separators, 4) != "::::" ||
+                e.offset + e.size > m_page_size || e.segment >= m_log_segments) {
+                throw std::runtime_error("invalid log entry in .meta: " + entry);
+            }
+            m_log[page_id].push_back(e);
         }
     }
+
+    {
+        std::stringstream s(match[5].str());
+        s >> m_allocated_pages;
+    }
+
+    m_invalid_pages.clear();
+    m_invalid_pages.insert(invalid_pages->begin(), invalid_pages->end());
+
+    m_hot_pages.clear();
+    if (hot_pages) {
+        m_hot_pages = std::move(*hot_pages);
+    }
 }
 
 s3_kv_store s3_kv_store::from_params(const std::string_view& uri_view,
@@ -78,7 +489,13 @@ s3_kv_store s3_kv_store::from_params(const std::string_view& uri_view,
                                      const char* secret_key,
                                      const char* region,
                                      const char* host,
-                                     bool use_tls) {
+                                     bool use_tls,
+                                     std::size_t pages_per_object,
+                                     std::size_t key_prefixes,
+                                     const char* buckets,
+                                     const char* endpoints,
+                                     bool content_addressed,
+                                     bool log_structured) {
     std::string uri(uri_view);
     std::regex url_regex("s3://(.+)/(.+)");
     std::smatch match;
@@ -119,70 +536,1085 @@ s3_kv_store s3_kv_store::from_params(const std::string_view& uri_view,
     else {
         host_string = host;
     }
-    return {host, use_tls, bucket, path, access_key, secret_key, region, page_size};
+
+    if (endpoints && *endpoints) {
+        std::vector<std::string> addresses;
+        if (std::string_view(endpoints) == "dns") {
+            addresses = curl::resolve(host_string);
+        }
+        else {
+            addresses = parse_list(endpoints, "endpoint");
+        }
+        curl::endpoints::global().add(host_string, addresses);
+    }
+
+    return {host_string,
+            use_tls,
+            bucket,
+            path,
+            access_key,
+            secret_key,
+            region,
+            page_size,
+            pages_per_object,
+            key_prefixes,
+            buckets ? parse_buckets(buckets) : std::vector<std::string>{},
+            content_addressed,
+            log_structured};
 }
 
 void s3_kv_store::max_page(page::id max_page) {
     for (page::id page_id = max_page + 1; page_id < m_allocated_pages; ++page_id) {
         m_invalid_pages.insert(page_id);
     }
+    if (max_page + 1 < m_allocated_pages) {
+        remember(max_page + 1, m_allocated_pages - max_page - 1, "");
+    }
 
     m_allocated_pages = max_page + 1;
+    m_log.erase(m_log.upper_bound(max_page), m_log.end());
+    m_log_pending.erase(m_log_pending.upper_bound(max_page), m_log_pending.end());
+
+    // forget the contents of objects which are now past the end
+    std::lock_guard<std::mutex> lock(m_contents_mutex);
+    m_contents.erase(
+        m_contents.lower_bound((m_allocated_pages + m_pages_per_object - 1) /
+                               m_pages_per_object),
+        m_contents.end());
 }
 
-void s3_kv_store::read(page::id page_id, utils::out_buffer& out) const {
-    assert(out.size() == m_page_size);
+std::string s3_kv_store::segment_key(const std::string& path,
+                                     std::size_t segment) const {
+    return path + "/.log/" + std::to_string(segment);
+}
 
-    if (page_id > max_page() || m_invalid_pages.find(page_id) != m_invalid_pages.end()) {
-        std::memset(out.data(), 0, m_page_size);
+std::size_t s3_kv_store::log_entries() const {
+    std::size_t count = 0;
+    for (const auto& [page_id, entries] : m_log) {
+        count += entries.size();
+    }
+    return count;
+}
+
+bool s3_kv_store::log_covers(page::id page_id) const {
+    auto whole = [&](std::size_t offset, std::size_t size) {
+        return offset == 0 && size == m_page_size;
+    };
+    auto pending = m_log_pending.find(page_id);
+    if (pending != m_log_pending.end() &&
+        whole(pending->second.offset, pending->second.data.size())) {
+        return true;
     }
+    auto search = m_log.find(page_id);
+    return search != m_log.end() &&
+           std::any_of(search->second.begin(),
+                       search->second.end(),
+                       [&](const log_entry& e) { return whole(e.offset, e.size); });
+}
 
-    std::string keyname(m_path + "/" + std::to_string(page_id));
+void s3_kv_store::apply_log(page::id first,
+                            std::size_t count,
+                            utils::out_buffer& out,
+                            async::future<void> base) const {
+    struct visible_entry {
+        const log_entry* entry;
+        std::size_t page_offset;
+        std::size_t read;
+    };
+    std::vector<visible_entry> visible;
+    for (page::id page_id = first; page_id < first + count; ++page_id) {
+        auto pending = m_log_pending.find(page_id);
+        bool pending_whole = pending != m_log_pending.end() &&
+                             pending->second.data.size() == m_page_size;
+        auto search = m_log.find(page_id);
+        if (search == m_log.end() || pending_whole) {
+            continue;
+        }
+        const std::vector<log_entry>& entries = search->second;
+        // ranges before the last write of the whole page are hidden by it
+        std::size_t ix = entries.size();
+        while (ix > 0 && !(entries[ix - 1].offset == 0 &&
+                           entries[ix - 1].size == m_page_size)) {
+            --ix;
+        }
+        for (ix = ix ? ix - 1 : 0; ix < entries.size(); ++ix) {
+            visible.push_back({&entries[ix], (page_id - first) * m_page_size, 0});
+        }
+    }
+
+    // ranges which are next to each other in a segment are read with one GET
+    struct segment_read {
+        std::size_t segment;
+        std::size_t offset;
+        std::string data;
+    };
+    std::vector<visible_entry*> by_position;
+    for (visible_entry& v : visible) {
+        by_position.push_back(&v);
+    }
+    std::sort(by_position.begin(),
+              by_position.end(),
+              [](const visible_entry* a, const visible_entry* b) {
+                  return std::tie(a->entry->segment, a->entry->segment_offset) <
+                         std::tie(b->entry->segment, b->entry->segment_offset);
+              });
+    std::vector<segment_read> reads;
+    for (visible_entry* v : by_position) {
+        const log_entry& e = *v->entry;
+        if (reads.empty() || reads.back().segment != e.segment ||
+            e.segment_offset > reads.back().offset + reads.back().data.size()) {
+            reads.push_back({e.segment, e.segment_offset, ""});
+        }
+        segment_read& r = reads.back();
+        r.data.resize(std::max(r.data.size(), e.segment_offset + e.size - r.offset));
+        v->read = reads.size() - 1;
+    }
+
+    // every GET, and the read of the page's object, is in flight at once
+    auto start = [&](std::size_t ix) {
+        segment_read& r = reads[ix];
+        m_stats.gets.add();
+        auto started = std::chrono::steady_clock::now();
+        async::future<curl::get_result> fetched;
+        try {
+            utils::out_buffer out(r.data.data(), r.data.size());
+            fetched = s3::async_get_object(out,
+                                           r.offset,
+                                           "",
+                                           m_notary,
+                                           m_bucket,
+                                           segment_key(m_path, r.segment),
+                                           m_host,
+                                           m_use_tls,
+                                           io::priority::demand);
+        }
+        catch (...) {
+            fetched = async::make_error<curl::get_result>(std::current_exception());
+        }
+        std::size_t size = r.data.size();
+        return fetched.then([this, started, size](async::future<curl::get_result> f) {
+            m_stats.get_latency.record(std::chrono::steady_clock::now() - started);
+            curl::get_result result = f.get();
+            if (!result.size) {
+                throw std::runtime_error("unconditional read was not modified");
+            }
+            m_stats.bytes_read.add(*result.size);
+            if (*result.size != size) {
+                throw std::runtime_error("log segment was smaller than its ranges");
+            }
+        });
+    };
+    async::future<void> segments =
+        async::for_each(reads.size(), max_pending_objects + 1, start);
+    std::exception_ptr error;
+    for (const async::future<void>& f : {base, segments}) {
+        try {
+            f.get();
+        }
+        catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    for (const visible_entry& v : visible) {
+        const log_entry& e = *v.entry;
+        const segment_read& r = reads[v.read];
+        std::memcpy(out.data() + v.page_offset + e.offset,
+                    r.data.data() + (e.segment_offset - r.offset),
+                    e.size);
+    }
+    for (page::id page_id = first; page_id < first + count; ++page_id) {
+        auto pending = m_log_pending.find(page_id);
+        if (pending != m_log_pending.end()) {
+            std::memcpy(out.data() + (page_id - first) * m_page_size +
+                            pending->second.offset,
+                        pending->second.data.data(),
+                        pending->second.data.size());
+        }
+    }
+}
+
+void s3_kv_store::read_logged(page::id page_id, utils::out_buffer& out) const {
+    async::future<void> base = async::make_ready();
+    if (!log_covers(page_id)) {
+        base = fetch_async(page_id, out, io::priority::demand);
+    }
+    apply_log(page_id, 1, out, std::move(base));
+    // the page no longer matches any one object
+    remember(page_id, 1, "");
+}
+
+bool s3_kv_store::pending(page::id page_id) const {
+    auto search = m_pending.find(page_id / m_pages_per_object);
+    return search != m_pending.end() &&
+           search->second.written[page_id % m_pages_per_object];
+}
+
+bool s3_kv_store::fetch(page::id first,
+                        utils::out_buffer& out,
+                        std::string& etag) const {
+    std::size_t object_id = first / m_pages_per_object;
+    if (!stored(object_id)) {
+        etag.clear();
+        std::memset(out.data(), 0, out.size());
+        return true;
+    }
     try {
-        std::size_t size =
-            s3::get_object(out, m_notary, m_bucket, keyname, m_host, m_use_tls);
-        if (size != m_page_size) {
-            throw std::runtime_error("page was smaller than the page_size");
+        m_stats.gets.add();
+        std::optional<std::size_t> size;
+        {
+            stats::timer t(m_stats.get_latency);
+            if (m_pages_per_object > 1) {
+                size = s3::get_object_range(out,
+                                            (first % m_pages_per_object) * m_page_size,
+                                            etag,
+                                            m_notary,
+                                            object_bucket(object_id),
+                                            object_key(object_id),
+                                            m_host,
+                                            m_use_tls);
+            }
+            else {
+                size = s3::get_object(out,
+                                      etag,
+                                      m_notary,
+                                      object_bucket(object_id),
+                                      object_key(object_id),
+                                      m_host,
+                                      m_use_tls);
+            }
+        }
+        if (!size) {
+            m_stats.not_modified.add();
+            return false;
+        }
+        m_stats.bytes_read.add(*size);
+        if (*size != out.size()) {
+            throw std::runtime_error("object was smaller than its pages");
         }
 
-        return;
+        return true;
     }
     catch (const curl::http_error& e) {
         if (e.code != 404) {
             throw;
         }
+        m_stats.not_found.add();
+    }
+
+    etag.clear();
+    std::memset(out.data(), 0, out.size());
+    return true;
+}
+
+void s3_kv_store::remember(page::id first,
+                           std::size_t count,
+                           const std::string& etag) const {
+    std::lock_guard<std::mutex> lock(m_etags_mutex);
+    for (page::id page_id = first; page_id < first + count; ++page_id) {
+        if (etag.empty()) {
+            m_etags.erase(page_id);
+        }
+        else {
+            m_etags[page_id] = etag;
+        }
+    }
+}
+
+void s3_kv_store::read(page::id page_id, utils::out_buffer& out) const {
+    assert(out.size() == m_page_size);
+
+    if (unallocated(page_id)) {
+        std::memset(out.data(), 0, m_page_size);
+        return;
+    }
+
+    if (logged(page_id)) {
+        read_logged(page_id, out);
+        return;
+    }
+
+    if (m_pages_per_object > 1) {
+        auto search = m_pending.find(page_id / m_pages_per_object);
+        std::size_t index = page_id % m_pages_per_object;
+        if (search != m_pending.end() && search->second.written[index]) {
+            std::memcpy(out.data(),
+                        search->second.data.data() + index * m_page_size,
+                        m_page_size);
+            return;
+        }
+    }
+
+    std::string etag;
+    fetch(page_id, out, etag);
+    remember(page_id, 1, etag);
+}
+
+void s3_kv_store::read(page::id first, std::vector<utils::out_buffer>& pages) const {
+    auto fetchable = [&](page::id page_id) {
+        return !unallocated(page_id) && !pending(page_id) && !logged(page_id);
+    };
+
+    std::size_t ix = 0;
+    while (ix < pages.size()) {
+        page::id page_id = first + ix;
+        std::size_t count = 1;
+        if (m_pages_per_object > 1 && fetchable(page_id)) {
+            // extend the run to the end of the object, stopping early at any
+            // page which does not need to be fetched
+            while (ix + count < pages.size() &&
+                   (page_id + count) % m_pages_per_object != 0 &&
+                   fetchable(page_id + count)) {
+                ++count;
+            }
+        }
+
+        if (count == 1) {
+            read(page_id, pages[ix]);
+            ++ix;
+            continue;
+        }
+
+        std::unique_ptr<char[]> buffer(new char[count * m_page_size]);
+        utils::out_buffer run(buffer.get(), count * m_page_size);
+        std::string etag;
+        fetch(page_id, run, etag);
+        remember(page_id, count, etag);
+        for (std::size_t offset = 0; offset < count; ++offset) {
+            std::memcpy(pages[ix + offset].data(),
+                        buffer.get() + offset * m_page_size,
+                        m_page_size);
+        }
+        ix += count;
+    }
+}
+
+async::future<void> s3_kv_store::fetch_async(page::id first,
+                                             utils::out_buffer out,
+                                             io::priority level) const {
+    std::size_t object_id = first / m_pages_per_object;
+    if (!stored(object_id)) {
+        std::memset(out.data(), 0, out.size());
+        remember(first, out.size() / m_page_size, "");
+        return async::make_ready();
+    }
+    std::optional<std::size_t> offset;
+    if (m_pages_per_object > 1) {
+        offset = (first % m_pages_per_object) * m_page_size;
+    }
+
+    m_stats.gets.add();
+    auto start = std::chrono::steady_clock::now();
+    return s3::async_get_object(out,
+                                offset,
+                                "",
+                                m_notary,
+                                object_bucket(object_id),
+                                object_key(object_id),
+                                m_host,
+                                m_use_tls,
+                                level)
+        .then([this, first, out, start](async::future<curl::get_result> f) mutable {
+            m_stats.get_latency.record(std::chrono::steady_clock::now() - start);
+            std::size_t count = out.size() / m_page_size;
+            try {
+                curl::get_result result = f.get();
+                if (!result.size) {
+                    throw std::runtime_error("unconditional read was not modified");
+                }
+                m_stats.bytes_read.add(*result.size);
+                if (*result.size != out.size()) {
+                    throw std::runtime_error("object was smaller than its pages");
+                }
+                remember(first, count, result.etag);
+            }
+            catch (const curl::http_error& e) {
+                if (e.code != 404) {
+                    throw;
+                }
+                m_stats.not_found.add();
+                std::memset(out.data(), 0, out.size());
+                remember(first, count, "");
+            }
+        });
+}
+
+void s3_kv_store::read(std::vector<page::page_run>& runs,
+                       std::size_t concurrency,
+                       io::priority level) const {
+    // one GET of consecutive pages in the same object
+    struct request {
+        std::size_t run;
+        // the index of the first page in the run's buffers
+        std::size_t offset;
+        std::size_t count;
+        // runs of many pages whose buffers are not laid out back to back are
+        // fetched here and copied into the pages; this is only allocated
+        // while the request is in flight
+        bool bounce;
+        std::unique_ptr<char[]> buffer;
+        utils::out_buffer out;
+    };
+    std::vector<request> requests;
+
+    for (std::size_t run_ix = 0; run_ix < runs.size(); ++run_ix) {
+        page::page_run& run = runs[run_ix];
+        std::size_t ix = 0;
+        while (ix < run.buffers.size()) {
+            page::id page_id = run.first + ix;
+            if (unallocated(page_id) || pending(page_id) || logged(page_id)) {
+                // these are served from memory, or need more than one request
+                read(page_id, run.buffers[ix]);
+                ++ix;
+                continue;
+            }
+
+            std::size_t count = 1;
+            if (m_pages_per_object > 1) {
+                while (ix + count < run.buffers.size() &&
+                       (page_id + count) % m_pages_per_object != 0 &&
+                       !unallocated(page_id + count) && !pending(page_id + count) &&
+                       !logged(page_id + count)) {
+                    ++count;
+                }
+            }
+
+            bool contiguous = true;
+            for (std::size_t offset = 1; offset < count; ++offset) {
+                contiguous &= run.buffers[ix + offset].data() ==
+                              run.buffers[ix].data() + offset * m_page_size;
+            }
+            request r{run_ix, ix, count, !contiguous, nullptr, run.buffers[ix]};
+            if (count > 1 && contiguous) {
+                r.out = utils::out_buffer(run.buffers[ix].data(), count * m_page_size);
+            }
+            requests.push_back(std::move(r));
+            ix += count;
+        }
+    }
+
+    // Each completion starts the next request on the event loop's thread,
+    // so at most `concurrency` are in flight and none of them hold a thread.
+    std::mutex errors_mutex;
+    auto start = [&](std::size_t ix) {
+        request& r = requests[ix];
+        async::future<void> fetched;
+        try {
+            if (r.bounce) {
+                r.buffer.reset(new char[r.count * m_page_size]);
+                r.out = utils::out_buffer(r.buffer.get(), r.count * m_page_size);
+            }
+            fetched = fetch_async(runs[r.run].first + r.offset, r.out, level);
+        }
+        catch (...) {
+            fetched = async::make_error<void>(std::current_exception());
+        }
+        return fetched.then([&, ix](async::future<void> f) {
+            request& r = requests[ix];
+            page::page_run& run = runs[r.run];
+            try {
+                f.get();
+            }
+            catch (...) {
+                r.buffer.reset();
+                std::lock_guard<std::mutex> lock(errors_mutex);
+                if (!run.error) {
+                    run.error = std::current_exception();
+                }
+                return;
+            }
+            if (r.buffer) {
+                for (std::size_t offset = 0; offset < r.count; ++offset) {
+                    std::memcpy(run.buffers[r.offset + offset].data(),
+                                r.buffer.get() + offset * m_page_size,
+                                m_page_size);
+                }
+                r.buffer.reset();
+            }
+        });
+    };
+    async::for_each(requests.size(), concurrency, start).wait();
+}
+
+async::future<void> s3_kv_store::async_read(page::id page_id,
+                                            utils::out_buffer out,
+                                            io::priority level) const {
+    assert(out.size() == m_page_size);
+    if (unallocated(page_id) || pending(page_id) || logged(page_id)) {
+        read(page_id, out);
+        return async::make_ready();
+    }
+    return fetch_async(page_id, out, level);
+}
+
+bool s3_kv_store::revalidate(page::id page_id, utils::out_buffer& out) const {
+    assert(out.size() == m_page_size);
+
+    std::string etag;
+    {
+        std::lock_guard<std::mutex> lock(m_etags_mutex);
+        auto search = m_etags.find(page_id);
+        if (search != m_etags.end()) {
+            etag = search->second;
+        }
+    }
+
+    if (unallocated(page_id)) {
+        if (etag.empty()) {
+            // the page was, and still is, all zeros
+            return false;
+        }
+        remember(page_id, 1, "");
+        std::memset(out.data(), 0, m_page_size);
+        return true;
+    }
+    if (pending(page_id)) {
+        return false;
+    }
+    if (logged(page_id)) {
+        // the page is not one object with an entity tag, so read it again
+        read_logged(page_id, out);
+        return true;
+    }
+
+    bool changed = fetch(page_id, out, etag);
+    remember(page_id, 1, etag);
+    return changed;
+}
+
+void s3_kv_store::refresh() {
+    if (!m_pending.empty() || !m_log_pending.empty()) {
+        throw std::logic_error("cannot refresh a store with unflushed writes");
+    }
+    read_metadata();
+}
+
+void s3_kv_store::upload(std::size_t object_id, pending_object& object) const {
+    page::id first = object_id * m_pages_per_object;
+
+    bool fill = false;
+    for (std::size_t ix = 0; ix < m_pages_per_object; ++ix) {
+        fill |= !object.written[ix] && !unallocated(first + ix);
+    }
+    if (fill) {
+        // read-modify-write the pages of the object that we don't have
+        std::string existing(object.data.size(), '\0');
+        utils::out_buffer out(existing.data(), existing.size());
+        std::string etag;
+        fetch(first, out, etag);
+        for (std::size_t ix = 0; ix < m_pages_per_object; ++ix) {
+            if (!object.written[ix] && !unallocated(first + ix)) {
+                std::memcpy(object.data.data() + ix * m_page_size,
+                            existing.data() + ix * m_page_size,
+                            m_page_size);
+            }
+        }
     }
 
-    std::memset(out.data(), 0, m_page_size);
+    put_object(object_id, object.data);
+    remember(first, m_pages_per_object, "");
 }
 
-void s3_kv_store::write(page::id page_id, const std::string_view& data) {
-    std::string keyname(m_path + "/" + std::to_string(page_id));
-    s3::set_object(m_notary, m_bucket, keyname, data, m_host, m_use_tls);
+void s3_kv_store::write(page::id page_id,
+                        const std::string_view& data,
+                        std::size_t begin,
+                        std::size_t end) {
+    if (unallocated(page_id)) {
+        // the page's object may hold stale bytes, so all of it is written
+        begin = 0;
+        end = data.size();
+    }
     m_allocated_pages = std::max(m_allocated_pages, page_id + 1);
     m_invalid_pages.erase(page_id);
+
+    if (m_log_structured) {
+        auto [it, inserted] = m_log_pending.try_emplace(page_id);
+        log_write& w = it->second;
+        if (!inserted) {
+            begin = std::min(begin, w.offset);
+            end = std::max(end, w.offset + w.data.size());
+        }
+        w.offset = begin;
+        w.data.assign(data.substr(begin, end - begin));
+        remember(page_id, 1, "");
+        return;
+    }
+
+    if (m_pages_per_object > 1) {
+        auto it = m_pending.find(page_id / m_pages_per_object);
+        if (it == m_pending.end()) {
+            pending_object object{std::string(m_pages_per_object * m_page_size, '\0'),
+                                  std::vector<bool>(m_pages_per_object),
+                                  0};
+            it = m_pending.emplace(page_id / m_pages_per_object, std::move(object))
+                     .first;
+        }
+
+        pending_object& object = it->second;
+        std::size_t index = page_id % m_pages_per_object;
+        std::memcpy(object.data.data() + index * m_page_size, data.data(), data.size());
+        if (!object.written[index]) {
+            object.written[index] = true;
+            ++object.written_count;
+        }
+
+        if (object.written_count == m_pages_per_object) {
+            upload(it->first, object);
+            m_pending.erase(it);
+        }
+        else if (m_pending.size() > max_pending_objects) {
+            upload(m_pending.begin()->first, m_pending.begin()->second);
+            m_pending.erase(m_pending.begin());
+        }
+        return;
+    }
+
+    put_object(page_id, data);
+    remember(page_id, 1, "");
 }
 
-void s3_kv_store::flush() {
+std::string s3_kv_store::metadata() const {
     std::stringstream formatter;
-    formatter << "page_size=" << m_page_size << '\n'
-              << "allocated_pages" << m_allocated_pages << '\n'
+    formatter << "page_size=" << m_page_size << '\n';
+    if (m_pages_per_object != 1) {
+        formatter << "pages_per_object=" << m_pages_per_object << '\n';
+    }
+    if (m_key_prefixes) {
+        formatter << "key_prefixes=" << m_key_prefixes << '\n';
+    }
+    if (!m_buckets.empty()) {
+        formatter << "buckets=" << format_buckets(m_buckets) << '\n';
+    }
+    formatter << "allocated_pages=" << m_allocated_pages << '\n'
               << "invalid_pages={";
+    bool first = true;
     for (page::id page_id : m_invalid_pages) {
-        formatter << page_id << ',';
-    }
-    if (m_invalid_pages.size()) {
-        // consume the trailing comma
-        formatter.get();
+        if (!first) {
+            formatter << ' ';
+        }
+        formatter << page_id;
+        first = false;
     }
     formatter << "}\n";
 
-    s3::set_object(m_notary,
-                   m_bucket,
-                   m_path + "/.meta",
-                   formatter.str(),
-                   m_host,
-                   m_use_tls);
+    if (!m_hot_pages.empty()) {
+        formatter << "hot_pages={";
+        first = true;
+        for (page::id page_id : m_hot_pages) {
+            if (!first) {
+                formatter << ' ';
+            }
+            formatter << page_id;
+            first = false;
+        }
+        formatter << "}\n";
+    }
+
+    if (m_log_structured) {
+        formatter << "log_segments=" << m_log_segments << '\n';
+
+        // this goes after the other lines, see `read_metadata`
+        formatter << "log={";
+        first = true;
+        for (const auto& [page_id, entries] : m_log) {
+            for (const log_entry& e : entries) {
+                if (!first) {
+                    formatter << ' ';
+                }
+                formatter << page_id << ':' << e.offset << ':' << e.size << ':'
+                          << e.segment << ':' << e.segment_offset;
+                first = false;
+            }
+        }
+        formatter << "}\n";
+    }
+
+    if (m_content_addressed) {
+        // this goes last, see `read_metadata`
+        std::lock_guard<std::mutex> lock(m_contents_mutex);
+        formatter << "contents={";
+        first = true;
+        for (const auto& [object_id, digest] : m_contents) {
+            if (!first) {
+                formatter << ' ';
+            }
+            formatter << object_id << ':' << digest;
+            first = false;
+        }
+        formatter << "}\n";
+    }
+
+    return formatter.str();
+}
+
+void s3_kv_store::flush() {
+    // the objects are independent, so upload them all at once
+    std::vector<std::map<std::size_t, pending_object>::iterator> objects;
+    for (auto it = m_pending.begin(); it != m_pending.end(); ++it) {
+        objects.push_back(it);
+    }
+    std::vector<char> uploaded(objects.size(), false);
+    try {
+        io::service::global().parallel(io::priority::write_behind,
+                                       objects.size(),
+                                       max_pending_objects + 1,
+                                       [&](std::size_t ix) {
+                                           upload(objects[ix]->first,
+                                                  objects[ix]->second);
+                                           uploaded[ix] = true;
+                                       });
+    }
+    catch (...) {
+        // keep the objects which failed so that they are retried
+        for (std::size_t ix = 0; ix < objects.size(); ++ix) {
+            if (uploaded[ix]) {
+                m_pending.erase(objects[ix]);
+            }
+        }
+        throw;
+    }
+    m_pending.clear();
+
+    append_log();
+    if (log_entries() > max_log_entries) {
+        fold_log(max_pending_objects + 1);
+    }
+    write_metadata();
+}
+
+void s3_kv_store::write_metadata() const {
+    std::string metadata = this->metadata();
+    m_stats.puts.add();
+    {
+        stats::timer t(m_stats.put_latency);
+        s3::set_object(
+            m_notary, m_bucket, m_path + "/.meta", metadata, m_host, m_use_tls);
+    }
+    m_stats.bytes_written.add(metadata.size());
+}
+
+void s3_kv_store::append_log() {
+    if (m_log_pending.empty()) {
+        return;
+    }
+
+    struct segment {
+        std::string data;
+        std::vector<std::pair<page::id, log_entry>> entries;
+    };
+    std::vector<segment> segments(1);
+    for (const auto& [page_id, w] : m_log_pending) {
+        if (!segments.back().data.empty() &&
+            segments.back().data.size() + w.data.size() > max_segment_size) {
+            segments.emplace_back();
+        }
+        segment& s = segments.back();
+        s.entries.emplace_back(page_id,
+                               log_entry{w.offset,
+                                         w.data.size(),
+                                         m_log_segments + segments.size() - 1,
+                                         s.data.size()});
+        s.data += w.data;
+    }
+
+    // if any segment fails, the writes are kept and appended to new
+    // segments by the next flush
+    io::service::global().parallel(
+        io::priority::write_behind,
+        segments.size(),
+        max_pending_objects + 1,
+        [&](std::size_t ix) {
+            m_stats.puts.add();
+            {
+                stats::timer t(m_stats.put_latency);
+                s3::set_object(m_notary,
+                               m_bucket,
+                               segment_key(m_path, m_log_segments + ix),
+                               segments[ix].data,
+                               m_host,
+                               m_use_tls);
+            }
+            m_stats.bytes_written.add(segments[ix].data.size());
+        });
+
+    m_log_segments += segments.size();
+    for (const segment& s : segments) {
+        for (const auto& [page_id, entry] : s.entries) {
+            // drop the ranges this one overwrites
+            std::vector<log_entry>& entries = m_log[page_id];
+            entries.erase(std::remove_if(entries.begin(),
+                                         entries.end(),
+                                         [&](const log_entry& e) {
+                                             return e.offset >= entry.offset &&
+                                                    e.offset + e.size <=
+                                                        entry.offset + entry.size;
+                                         }),
+                          entries.end());
+            entries.push_back(entry);
+        }
+    }
+    m_log_pending.clear();
+}
+
+std::size_t s3_kv_store::fold_log(std::size_t concurrency) {
+    std::vector<std::size_t> objects;
+    for (const auto& [page_id, entries] : m_log) {
+        std::size_t object_id = page_id / m_pages_per_object;
+        if (objects.empty() || objects.back() != object_id) {
+            objects.push_back(object_id);
+        }
+    }
+
+    std::vector<char> folded(objects.size(), false);
+    auto fold = [&](std::size_t ix) {
+        page::id first = objects[ix] * m_pages_per_object;
+        page::id last = first + m_pages_per_object;
+        std::string data(m_pages_per_object * m_page_size, '\0');
+
+        bool read_object = false;
+        for (page::id page_id = first; page_id < last; ++page_id) {
+            read_object |= !unallocated(page_id) && !log_covers(page_id);
+        }
+        utils::out_buffer out(data.data(), data.size());
+        async::future<void> base = async::make_ready();
+        if (read_object) {
+            base = fetch_async(first, out, io::priority::demand);
+        }
+        apply_log(first, m_pages_per_object, out, std::move(base));
+        for (page::id page_id = first; page_id < last; ++page_id) {
+            if (unallocated(page_id)) {
+                std::memset(data.data() + (page_id - first) * m_page_size,
+                            0,
+                            m_page_size);
+            }
+        }
+
+        put_object(objects[ix], data);
+        remember(first, m_pages_per_object, "");
+        folded[ix] = true;
+    };
+
+    // the segments are left in place, since readers which opened the file
+    // before the fold may still read them
+    auto forget = [&] {
+        for (std::size_t ix = 0; ix < objects.size(); ++ix) {
+            if (folded[ix]) {
+                page::id first = objects[ix] * m_pages_per_object;
+                m_log.erase(m_log.lower_bound(first),
+                            m_log.lower_bound(first + m_pages_per_object));
+            }
+        }
+    };
+    try {
+        io::service::global().parallel(io::priority::write_behind,
+                                       objects.size(),
+                                       concurrency,
+                                       fold);
+    }
+    catch (...) {
+        forget();
+        throw;
+    }
+    forget();
+    return objects.size();
+}
+
+std::size_t s3_kv_store::compact(std::size_t concurrency) {
+    append_log();
+    std::size_t folded = fold_log(concurrency);
+    write_metadata();
+    return folded;
+}
+
+std::size_t s3_kv_store::import_file(const std::string_view& data,
+                                     std::size_t concurrency) {
+    if (!m_pending.empty() || !m_log_pending.empty()) {
+        throw std::logic_error("cannot import into a store with unflushed writes");
+    }
+
+    std::size_t object_size = m_pages_per_object * m_page_size;
+    std::size_t pages = (data.size() + m_page_size - 1) / m_page_size;
+    std::size_t objects = (pages + m_pages_per_object - 1) / m_pages_per_object;
+
+    // objects are always whole, so the last one is padded with zeros
+    std::string last;
+    if (data.size() % object_size) {
+        last = data.substr((objects - 1) * object_size);
+        last.resize(object_size, '\0');
+    }
+    auto content = [&](std::size_t object_id) {
+        if (object_id == objects - 1 && !last.empty()) {
+            return std::string_view(last);
+        }
+        return data.substr(object_id * object_size, object_size);
+    };
+
+    std::vector<char> uploaded(objects, false);
+    auto upload_object = [&](std::size_t object_id) {
+        std::string_view object = content(object_id);
+        if (all_zeros(object)) {
+            return;
+        }
+        put_object(object_id, object);
+        uploaded[object_id] = true;
+    };
+    io::service::global().parallel(io::priority::write_behind,
+                                   objects,
+                                   concurrency,
+                                   upload_object);
+
+    // objects left over from a larger file are past the new allocated pages
+    // and are never read
+    m_allocated_pages = pages;
+    m_invalid_pages.clear();
+    m_log.clear();
+    std::size_t count = 0;
+    for (std::size_t object_id = 0; object_id < objects; ++object_id) {
+        if (uploaded[object_id]) {
+            ++count;
+            continue;
+        }
+        page::id first = object_id * m_pages_per_object;
+        for (page::id page_id = first;
+             page_id < std::min(first + m_pages_per_object, pages);
+             ++page_id) {
+            m_invalid_pages.insert(page_id);
+        }
+    }
+    m_hot_pages.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_etags_mutex);
+        m_etags.clear();
+    }
+    {
+        // objects which were not uploaded read as zeros
+        std::lock_guard<std::mutex> lock(m_contents_mutex);
+        for (std::size_t object_id = 0; object_id < objects; ++object_id) {
+            if (!uploaded[object_id]) {
+                m_contents.erase(object_id);
+            }
+        }
+        m_contents.erase(m_contents.lower_bound(objects), m_contents.end());
+    }
+
+    flush();
+    return count;
+}
+
+void s3_kv_store::export_file(utils::out_buffer out, std::size_t concurrency) const {
+    assert(out.size() == m_allocated_pages * m_page_size);
+
+    std::vector<page::page_run> runs;
+    for (page::id page_id = 0; page_id < m_allocated_pages; ++page_id) {
+        if (unallocated(page_id)) {
+            continue;
+        }
+        if (runs.empty() || runs.back().first + runs.back().buffers.size() != page_id) {
+            runs.push_back({page_id, {}, nullptr});
+        }
+        runs.back().buffers.push_back(out.substr(page_id * m_page_size, m_page_size));
+    }
+
+    read(runs, concurrency, io::priority::demand);
+    for (const page::page_run& run : runs) {
+        if (run.error) {
+            std::rethrow_exception(run.error);
+        }
+    }
+}
+
+std::size_t s3_kv_store::clone(const std::string& bucket,
+                               const std::string& path,
+                               std::size_t concurrency) const {
+    if (!m_pending.empty() || !m_log_pending.empty()) {
+        throw std::logic_error("cannot clone a store with unflushed writes");
+    }
+
+    // content-addressed objects are shared with the copy, unless it keeps
+    // its objects in a bucket of its own
+    bool shared = m_content_addressed && (!m_buckets.empty() || bucket == m_bucket);
+
+    std::size_t objects = (m_allocated_pages + m_pages_per_object - 1) /
+                          m_pages_per_object;
+    std::vector<char> copied(objects, false);
+    auto copy = [&](std::size_t object_id) {
+        page::id first = object_id * m_pages_per_object;
+        bool allocated = false;
+        for (page::id page_id = first; page_id < first + m_pages_per_object;
+             ++page_id) {
+            allocated |= !unallocated(page_id);
+        }
+        if (shared || !allocated || !stored(object_id)) {
+            return;
+        }
+
+        std::string key = object_key(object_id);
+        m_stats.puts.add();
+        try {
+            stats::timer t(m_stats.put_latency);
+            s3::copy_object(m_notary,
+                            object_bucket(object_id),
+                            key,
+                            m_content_addressed ? bucket
+                                                : object_bucket(bucket, path, object_id),
+                            m_content_addressed ? key : object_key(path, object_id),
+                            m_host,
+                            m_use_tls);
+        }
+        catch (const curl::http_error& e) {
+            if (e.code != 404) {
+                throw;
+            }
+            // the object was never written, so it reads as zeros in the copy
+            // too
+            m_stats.not_found.add();
+            return;
+        }
+        copied[object_id] = true;
+    };
+    io::service::global().parallel(io::priority::write_behind,
+                                   objects,
+                                   concurrency,
+                                   copy);
+
+    // the log segments are named by the file's path, so they are always
+    // copied
+    std::set<std::size_t> segment_set;
+    for (const auto& [page_id, entries] : m_log) {
+        for (const log_entry& e : entries) {
+            segment_set.insert(e.segment);
+        }
+    }
+    std::vector<std::size_t> segments(segment_set.begin(), segment_set.end());
+    io::service::global().parallel(
+        io::priority::write_behind,
+        segments.size(),
+        concurrency,
+        [&](std::size_t ix) {
+            m_stats.puts.add();
+            stats::timer t(m_stats.put_latency);
+            s3::copy_object(m_notary,
+                            m_bucket,
+                            segment_key(m_path, segments[ix]),
+                            bucket,
+                            segment_key(path, segments[ix]),
+                            m_host,
+                            m_use_tls);
+        });
+
+    std::string metadata = this->metadata();
+    m_stats.puts.add();
+    {
+        stats::timer t(m_stats.put_latency);
+        s3::set_object(m_notary, bucket, path + "/.meta", metadata, m_host, m_use_tls);
+    }
+    m_stats.bytes_written.add(metadata.size());
+    return std::count(copied.begin(), copied.end(), true) + segments.size();
 }
 }  // namespace h5s3::s3_driver
 
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "h5s3/private/throttle.h"
+
+namespace h5s3::throttle {
+namespace {
+/** Read a number from an environment variable.
+
+    @param name The name of the variable.
+    @param fallback The value to use if the variable is not set.
+ */
+double env_double(const char* name, double fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) {
+        return fallback;
+    }
+    try {
+        return std::stod(value);
+    }
+    catch (const std::exception&) {
+        throw std::invalid_argument(std::string(name) + " is not a number: " + value);
+    }
+}
+}  // namespace
+
+aimd::aimd(std::size_t initial,
+           std::size_t min,
+           std::size_t max,
+           double latency_tolerance)
+    : m_min(std::max<std::size_t>(min, 1)),
+      m_max(std::max<double>(max, m_min)),
+      m_latency_tolerance(latency_tolerance),
+      m_slow_start(true),
+      m_hold_until() {
+    m_limit = std::clamp<double>(initial, m_min, m_max);
+}
+
+void aimd::decrease(double factor, clock::time_point now) {
+    m_slow_start = false;
+    if (now < m_hold_until) {
+        return;
+    }
+    m_limit = std::max(m_limit * factor, m_min);
+
+    // the requests already in flight were sent before the cut, so ignore
+    // their signals for a round trip
+    double round_trip_us = m_smoothed_us ? *m_smoothed_us : 0;
+    m_hold_until =
+        now + std::chrono::microseconds(static_cast<std::int64_t>(round_trip_us));
+}
+
+void aimd::update(const outcome& o, clock::time_point now) {
+    if (o.throttled()) {
+        decrease(0.5, now);
+        return;
+    }
+    if (!o.first_byte || o.status == 0) {
+        // a failed request says nothing about the load on the server
+        return;
+    }
+
+    double sample = o.first_byte->count();
+    m_smoothed_us =
+        m_smoothed_us ? *m_smoothed_us + (sample - *m_smoothed_us) / 8 : sample;
+    // drops at once and rises slowly, so that the baseline follows a server
+    // which has become slower for good
+    m_baseline_us = m_baseline_us && *m_baseline_us < sample
+                        ? *m_baseline_us + (sample - *m_baseline_us) / 256
+                        : sample;
+
+    // jitter of a millisecond is noise, even when the baseline is lower
+    if (m_latency_tolerance > 0 &&
+        *m_smoothed_us > m_latency_tolerance * std::max(*m_baseline_us, 1000.0)) {
+        decrease(0.9, now);
+        return;
+    }
+
+    m_limit = std::min(m_limit + (m_slow_start ? 1 : 1 / m_limit), m_max);
+}
+
+token_bucket::token_bucket(double requests_per_second, double bytes_per_second)
+    : m_requests_per_second(requests_per_second),
+      m_bytes_per_second(bytes_per_second),
+      m_request_tokens(std::max(requests_per_second, 1.0)),
+      m_byte_tokens(bytes_per_second),
+      m_last(clock::now()) {}
+
+void token_bucket::refill(clock::time_point now) {
+    if (now <= m_last) {
+        return;
+    }
+    double seconds = std::chrono::duration<double>(now - m_last).count();
+    m_last = now;
+    m_request_tokens = std::min(m_request_tokens + seconds * m_requests_per_second,
+                                std::max(m_requests_per_second, 1.0));
+    m_byte_tokens =
+        std::min(m_byte_tokens + seconds * m_bytes_per_second, m_bytes_per_second);
+}
+
+std::optional<clock::time_point> token_bucket::try_take(clock::time_point now) {
+    refill(now);
+
+    double wait_seconds = 0;
+    if (m_requests_per_second > 0 && m_request_tokens < 1) {
+        wait_seconds = (1 - m_request_tokens) / m_requests_per_second;
+    }
+    if (m_bytes_per_second > 0 && m_byte_tokens < 0) {
+        wait_seconds = std::max(wait_seconds, -m_byte_tokens / m_bytes_per_second);
+    }
+    if (wait_seconds > 0) {
+        return now + std::chrono::duration_cast<clock::duration>(
+                         std::chrono::duration<double>(wait_seconds));
+    }
+
+    if (m_requests_per_second > 0) {
+        m_request_tokens -= 1;
+    }
+    return std::nullopt;
+}
+
+void token_bucket::charge(std::size_t bytes, clock::time_point now) {
+    if (m_bytes_per_second > 0) {
+        refill(now);
+        m_byte_tokens -= bytes;
+    }
+}
+
+limiter::limiter(const options& opts)
+    : m_options(opts), m_bucket(opts.requests_per_second, opts.bytes_per_second) {}
+
+limiter& limiter::global() {
+    static limiter l([] {
+        options opts;
+        opts.adaptive = env_double("H5S3_ADAPTIVE_CONCURRENCY", 1) != 0;
+        opts.max_concurrency = static_cast<std::size_t>(
+            env_double("H5S3_MAX_IN_FLIGHT", static_cast<double>(opts.max_concurrency)));
+        opts.requests_per_second = env_double("H5S3_MAX_REQUESTS_PER_SECOND", 0);
+        opts.bytes_per_second = env_double("H5S3_MAX_BYTES_PER_SECOND", 0);
+        return opts;
+    }());
+    return l;
+}
+
+limiter::endpoint& limiter::lookup(const std::string& key) {
+    auto search = m_endpoints.find(key);
+    if (search == m_endpoints.end()) {
+        std::size_t initial = m_options.adaptive ? m_options.initial_concurrency
+                                                 : m_options.max_concurrency;
+        search = m_endpoints
+                     .emplace(key,
+                              endpoint{aimd(initial,
+                                            1,
+                                            m_options.max_concurrency,
+                                            m_options.latency_tolerance)})
+                     .first;
+    }
+    return search->second;
+}
+
+limiter::ticket limiter::acquire(const std::string& key) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        endpoint& e = lookup(key);
+        if (e.in_flight < e.limit.limit()) {
+            std::optional<clock::time_point> retry_at = m_bucket.try_take();
+            if (!retry_at) {
+                ++e.in_flight;
+                return ticket(*this, key);
+            }
+            m_released.wait_until(lock, *retry_at);
+        }
+        else {
+            m_released.wait(lock);
+        }
+    }
+}
+
+std::optional<limiter::ticket> limiter::try_acquire(const std::string& key,
+                                                    clock::time_point& retry_at) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    endpoint& e = lookup(key);
+    if (e.in_flight >= e.limit.limit()) {
+        return std::nullopt;
+    }
+    if (std::optional<clock::time_point> at = m_bucket.try_take()) {
+        retry_at = std::min(retry_at, *at);
+        return std::nullopt;
+    }
+    ++e.in_flight;
+    return std::optional<ticket>(std::in_place, *this, key);
+}
+
+void limiter::release(const std::string& key, const std::optional<outcome>& o) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        endpoint& e = lookup(key);
+        --e.in_flight;
+        if (o) {
+            if (m_options.adaptive) {
+                e.limit.update(*o);
+            }
+            m_bucket.charge(o->bytes);
+        }
+    }
+    m_released.notify_all();
+
+    std::lock_guard<std::mutex> lock(m_watchers_mutex);
+    for (auto& [id, f] : m_watchers) {
+        f();
+    }
+}
+
+std::size_t limiter::watch(std::function<void()> f) {
+    std::lock_guard<std::mutex> lock(m_watchers_mutex);
+    std::size_t id = m_next_watcher++;
+    m_watchers.emplace_back(id, std::move(f));
+    return id;
+}
+
+void limiter::unwatch(std::size_t id) {
+    std::lock_guard<std::mutex> lock(m_watchers_mutex);
+    m_watchers.erase(std::remove_if(m_watchers.begin(),
+                                    m_watchers.end(),
+                                    [&](const auto& w) { return w.first == id; }),
+                     m_watchers.end());
+}
+
+std::size_t limiter::limit(const std::string& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return lookup(key).limit.limit();
+}
+
+std::size_t limiter::in_flight(const std::string& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return lookup(key).in_flight;
+}
+}  // namespace h5s3::throttle
@@ -0,0 +1,143 @@
+#include <cerrno>
+#include <cstring>
+
+#include "h5s3/private/trace.h"
+
+namespace h5s3::trace {
+namespace {
+constexpr char magic[8] = {'h', '5', 's', '3', 't', 'r', 'c', '\0'};
+
+constexpr std::uint8_t write_flag = 1 << 0;
+constexpr std::uint8_t hit_flag = 1 << 1;
+
+template<typename T>
+char* encode(char* out, T value) {
+    for (std::size_t ix = 0; ix < sizeof(T); ++ix) {
+        *out++ = static_cast<char>((value >> (8 * ix)) & 0xff);
+    }
+    return out;
+}
+
+template<typename T>
+const char* decode(const char* in, T& value) {
+    value = 0;
+    for (std::size_t ix = 0; ix < sizeof(T); ++ix) {
+        value |= static_cast<T>(static_cast<unsigned char>(*in++)) << (8 * ix);
+    }
+    return in;
+}
+
+std::FILE* open_or_throw(const std::string& path, const char* mode) {
+    std::FILE* f = std::fopen(path.data(), mode);
+    if (!f) {
+        throw error("failed to open trace file " + path + ": " + std::strerror(errno));
+    }
+    return f;
+}
+}  // namespace
+
+writer::writer(const std::string& path, std::size_t page_size)
+    : m_file(open_or_throw(path, "wb")), m_start(std::chrono::steady_clock::now()) {
+    char header[header_size];
+    char* out = header;
+    std::memcpy(out, magic, sizeof(magic));
+    out = encode(out + sizeof(magic), version);
+    encode<std::uint64_t>(out, page_size);
+
+    if (std::fwrite(header, 1, sizeof(header), m_file.get()) != sizeof(header)) {
+        throw error("failed to write trace header");
+    }
+
+    m_buffer.reserve(4096 * record_size);
+}
+
+writer::~writer() {
+    try {
+        flush();
+    }
+    catch (const error&) {
+        // nothing we can do about this in a destructor
+    }
+}
+
+void writer::flush_buffer() {
+    if (std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file.get()) !=
+        m_buffer.size()) {
+        m_buffer.clear();
+        throw error("failed to write trace records");
+    }
+    m_buffer.clear();
+}
+
+void writer::write(const record& r) {
+    char encoded[record_size];
+    char* out = encoded;
+    out = encode(out, r.page_id);
+    out = encode(out, r.timestamp_ns);
+    out = encode(out, r.offset);
+    out = encode(out, r.size);
+
+    std::uint8_t flags = 0;
+    if (r.operation == op::write) {
+        flags |= write_flag;
+    }
+    if (r.hit) {
+        flags |= hit_flag;
+    }
+    out = encode(out, flags);
+    encode(out, r.mem_type);
+
+    m_buffer.insert(m_buffer.end(), encoded, encoded + record_size);
+    if (m_buffer.size() == m_buffer.capacity()) {
+        flush_buffer();
+    }
+}
+
+void writer::flush() {
+    flush_buffer();
+    std::fflush(m_file.get());
+}
+
+reader::reader(const std::string& path) : m_file(open_or_throw(path, "rb")) {
+    char header[header_size];
+    if (std::fread(header, 1, sizeof(header), m_file.get()) != sizeof(header) ||
+        std::memcmp(header, magic, sizeof(magic))) {
+        throw error(path + " is not an h5s3 trace file");
+    }
+
+    std::uint32_t file_version;
+    const char* in = decode(header + sizeof(magic), file_version);
+    if (file_version != version) {
+        throw error("unsupported trace version: " + std::to_string(file_version));
+    }
+
+    std::uint64_t page_size;
+    decode(in, page_size);
+    m_page_size = page_size;
+}
+
+bool reader::next(record& out) {
+    char encoded[record_size];
+    std::size_t read = std::fread(encoded, 1, sizeof(encoded), m_file.get());
+    if (read == 0) {
+        return false;
+    }
+    if (read != sizeof(encoded)) {
+        throw error("truncated trace record");
+    }
+
+    const char* in = encoded;
+    in = decode(in, out.page_id);
+    in = decode(in, out.timestamp_ns);
+    in = decode(in, out.offset);
+    in = decode(in, out.size);
+
+    std::uint8_t flags;
+    in = decode(in, flags);
+    decode(in, out.mem_type);
+
+    out.operation = (flags & write_flag) ? op::write : op::read;
+    out.hit = flags & hit_flag;
+    return true;
+}
+}  // namespace h5s3::trace
@@ -0,0 +1,343 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+namespace h5s3::testing {
+
+/** A stand-in HTTP/2 server on the loopback interface which speaks h2c with
+    prior knowledge, or HTTP/2 negotiated with ALPN over TLS with a
+    self-signed certificate. Every GET is answered with the same body.
+
+    Requests are answered in batches: the server collects requests until the
+    client has nothing more to send, so requests which are multiplexed on a
+    connection are outstanding together and counted by `max_streams`.
+ */
+class http2_server {
+private:
+    std::string m_body;
+    int m_listen;
+    int m_port;
+    std::atomic<std::size_t> m_connections;
+    std::atomic<std::size_t> m_requests;
+    std::atomic<std::size_t> m_max_streams;
+    std::mutex m_mutex;
+    std::vector<int> m_sockets;
+    std::vector<std::thread> m_threads;
+    std::thread m_accept;
+    SSL_CTX* m_tls;
+
+    /** One accepted connection, which may be wrapped in TLS.
+     */
+    struct connection {
+        int fd;
+        SSL* ssl;
+
+        ssize_t recv(char* data, std::size_t size) {
+            if (ssl) {
+                return SSL_read(ssl, data, size);
+            }
+            return ::recv(fd, data, size, 0);
+        }
+
+        ssize_t send(const char* data, std::size_t size) {
+            if (ssl) {
+                return SSL_write(ssl, data, size);
+            }
+            return ::send(fd, data, size, MSG_NOSIGNAL);
+        }
+
+        /** Wait for data to read.
+
+            @param timeout_ms How long to wait, or -1 to wait forever.
+            @return Is there data to read?
+         */
+        bool wait(int timeout_ms) {
+            if (ssl && SSL_pending(ssl)) {
+                return true;
+            }
+            pollfd p{fd, POLLIN, 0};
+            return ::poll(&p, 1, timeout_ms) != 0;
+        }
+    };
+
+    enum frame_type : std::uint8_t {
+        data = 0,
+        headers = 1,
+        settings = 4,
+        ping = 6,
+        goaway = 7,
+    };
+
+    static constexpr std::uint8_t end_stream = 0x1;
+    static constexpr std::uint8_t ack = 0x1;
+    static constexpr std::uint8_t end_headers = 0x4;
+
+    static bool read_exact(connection& c, std::string& out, std::size_t size) {
+        out.resize(size);
+        std::size_t got = 0;
+        while (got < size) {
+            ssize_t n = c.recv(out.data() + got, size - got);
+            if (n <= 0) {
+                return false;
+            }
+            got += n;
+        }
+        return true;
+    }
+
+    static void send_frame(connection& c,
+                           frame_type type,
+                           std::uint8_t flags,
+                           std::uint32_t stream,
+                           const std::string& payload) {
+        std::string frame;
+        frame += static_cast<char>(payload.size() >> 16);
+        frame += static_cast<char>(payload.size() >> 8);
+        frame += static_cast<char>(payload.size());
+        frame += static_cast<char>(type);
+        frame += static_cast<char>(flags);
+        frame += static_cast<char>(stream >> 24);
+        frame += static_cast<char>(stream >> 16);
+        frame += static_cast<char>(stream >> 8);
+        frame += static_cast<char>(stream);
+        frame += payload;
+
+        std::size_t sent = 0;
+        while (sent < frame.size()) {
+            ssize_t n = c.send(frame.data() + sent, frame.size() - sent);
+            if (n <= 0) {
+                return;
+            }
+            sent += n;
+        }
+    }
+
+    void respond(connection& c, std::uint32_t stream) {
+        // HPACK: `:status: 200` from the static table, then `content-length`
+        // as a literal with an indexed name and a plain string value
+        std::string length = std::to_string(m_body.size());
+        std::string block = "\x88\x0f\x0d";
+        block += static_cast<char>(length.size());
+        block += length;
+        send_frame(c, headers, end_headers, stream, block);
+        send_frame(c, data, end_stream, stream, m_body);
+        ++m_requests;
+    }
+
+    void serve(int fd) {
+        connection c{fd, nullptr};
+        if (m_tls) {
+            c.ssl = SSL_new(m_tls);
+            SSL_set_fd(c.ssl, fd);
+            if (SSL_accept(c.ssl) <= 0) {
+                SSL_free(c.ssl);
+                return;
+            }
+        }
+        serve(c);
+        if (c.ssl) {
+            SSL_free(c.ssl);
+        }
+    }
+
+    void serve(connection& c) {
+        std::string preface;
+        std::string_view expected = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+        if (!read_exact(c, preface, expected.size()) || preface != expected) {
+            return;
+        }
+        send_frame(c, settings, 0, 0, "");
+
+        std::vector<std::uint32_t> pending;
+        std::string header;
+        std::string payload;
+        while (true) {
+            if (!c.wait(pending.empty() ? -1 : 20)) {
+                // the client is waiting on every outstanding request
+                m_max_streams = std::max<std::size_t>(m_max_streams, pending.size());
+                for (std::uint32_t stream : pending) {
+                    respond(c, stream);
+                }
+                pending.clear();
+                continue;
+            }
+
+            if (!read_exact(c, header, 9)) {
+                return;
+            }
+            auto byte = [&](std::size_t ix) {
+                return static_cast<std::uint32_t>(static_cast<unsigned char>(header[ix]));
+            };
+            std::size_t size = byte(0) << 16 | byte(1) << 8 | byte(2);
+            auto type = static_cast<frame_type>(byte(3));
+            std::uint8_t flags = byte(4);
+            std::uint32_t stream =
+                (byte(5) << 24 | byte(6) << 16 | byte(7) << 8 | byte(8)) & 0x7fffffff;
+            if (!read_exact(c, payload, size)) {
+                return;
+            }
+
+            if (type == settings && !(flags & ack)) {
+                send_frame(c, settings, ack, 0, "");
+            }
+            else if (type == ping && !(flags & ack)) {
+                send_frame(c, ping, ack, 0, payload);
+            }
+            else if (type == headers && (flags & end_stream)) {
+                pending.push_back(stream);
+            }
+            else if (type == goaway) {
+                return;
+            }
+        }
+    }
+
+    /** Pick h2 from the protocols the client offers.
+     */
+    static int select_h2(SSL*,
+                         const unsigned char** out,
+                         unsigned char* out_size,
+                         const unsigned char* in,
+                         unsigned int in_size,
+                         void*) {
+        for (unsigned int ix = 0; ix < in_size; ix += in[ix] + 1) {
+            if (std::string_view(reinterpret_cast<const char*>(in + ix + 1), in[ix]) ==
+                "h2") {
+                *out = in + ix + 1;
+                *out_size = in[ix];
+                return SSL_TLSEXT_ERR_OK;
+            }
+        }
+        return SSL_TLSEXT_ERR_ALERT_FATAL;
+    }
+
+    /** Make a TLS context with a fresh self-signed certificate.
+     */
+    static SSL_CTX* make_tls_context() {
+        SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+        EVP_PKEY* key = nullptr;
+        EVP_PKEY_CTX* key_ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+        X509* cert = X509_new();
+        bool ok = ctx && key_ctx && cert && EVP_PKEY_keygen_init(key_ctx) > 0 &&
+                  EVP_PKEY_CTX_set_ec_paramgen_curve_nid(key_ctx, NID_X9_62_prime256v1) >
+                      0 &&
+                  EVP_PKEY_keygen(key_ctx, &key) > 0;
+        if (ok) {
+            ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+            X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+            X509_gmtime_adj(X509_getm_notAfter(cert), 60 * 60);
+            X509_NAME* name = X509_get_subject_name(cert);
+            auto localhost = reinterpret_cast<const unsigned char*>("localhost");
+            X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, localhost, -1, -1, 0);
+            ok = X509_set_issuer_name(cert, name) && X509_set_pubkey(cert, key) &&
+                 X509_sign(cert, key, EVP_sha256()) &&
+                 SSL_CTX_use_certificate(ctx, cert) > 0 &&
+                 SSL_CTX_use_PrivateKey(ctx, key) > 0;
+        }
+        X509_free(cert);
+        EVP_PKEY_free(key);
+        EVP_PKEY_CTX_free(key_ctx);
+        if (!ok) {
+            SSL_CTX_free(ctx);
+            throw std::runtime_error("failed to make the test server's certificate");
+        }
+        SSL_CTX_set_alpn_select_cb(ctx, select_h2, nullptr);
+        return ctx;
+    }
+
+public:
+    /** @param body The body of every response.
+        @param tls Speak TLS instead of h2c. Clients must not verify the
+               certificate.
+     */
+    explicit http2_server(std::string body, bool tls = false)
+        : m_body(std::move(body)), m_listen(::socket(AF_INET, SOCK_STREAM, 0)),
+          m_connections(0), m_requests(0), m_max_streams(0),
+          m_tls(tls ? make_tls_context() : nullptr) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t size = sizeof(addr);
+        if (m_listen < 0 ||
+            ::bind(m_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+            ::listen(m_listen, 128) < 0 ||
+            ::getsockname(m_listen, reinterpret_cast<sockaddr*>(&addr), &size) < 0) {
+            SSL_CTX_free(m_tls);
+            throw std::runtime_error("failed to start the test http/2 server");
+        }
+        m_port = ntohs(addr.sin_port);
+
+        m_accept = std::thread([this] {
+            int fd;
+            while ((fd = ::accept(m_listen, nullptr, nullptr)) >= 0) {
+                ++m_connections;
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_sockets.push_back(fd);
+                m_threads.emplace_back([this, fd] { serve(fd); });
+            }
+        });
+    }
+
+    http2_server(const http2_server&) = delete;
+
+    ~http2_server() {
+        ::shutdown(m_listen, SHUT_RDWR);
+        ::close(m_listen);
+        m_accept.join();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (int fd : m_sockets) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+        for (std::thread& t : m_threads) {
+            t.join();
+        }
+        for (int fd : m_sockets) {
+            ::close(fd);
+        }
+        SSL_CTX_free(m_tls);
+    }
+
+    /** The `host:port` to connect to.
+     */
+    std::string address() const {
+        return "127.0.0.1:" + std::to_string(m_port);
+    }
+
+    /** The number of connections accepted so far.
+     */
+    std::size_t connections() const {
+        return m_connections;
+    }
+
+    /** The number of requests answered so far.
+     */
+    std::size_t requests() const {
+        return m_requests;
+    }
+
+    /** The most requests which were outstanding at once on one connection.
+     */
+    std::size_t max_streams() const {
+        return m_max_streams;
+    }
+};
+}  // namespace h5s3::testing
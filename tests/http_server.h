@@ -0,0 +1,191 @@
+#pragma once
+
+#include <atomic>
+#include <cctype>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace h5s3::testing {
+
+/** A minimal HTTP/1.1 server on the loopback interface for testing the curl
+    layer without s3. Each connection is served on its own thread and kept
+    alive between requests.
+ */
+class http_server {
+public:
+    struct request {
+        std::string method;
+        std::string path;
+        // header names are lowercase
+        std::map<std::string, std::string> headers;
+        std::string body;
+    };
+
+    struct response {
+        int status = 200;
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;
+    };
+
+    using handler = std::function<response(const request&)>;
+
+private:
+    handler m_handler;
+    int m_listen;
+    int m_port;
+    std::atomic<std::size_t> m_connections;
+    std::mutex m_mutex;
+    std::vector<int> m_sockets;
+    std::vector<std::thread> m_threads;
+    std::thread m_accept;
+
+    static bool read_line(int fd, std::string& buffer, std::string& line) {
+        std::size_t end;
+        while ((end = buffer.find("\r\n")) == std::string::npos) {
+            char chunk[4096];
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                return false;
+            }
+            buffer.append(chunk, n);
+        }
+        line = buffer.substr(0, end);
+        buffer.erase(0, end + 2);
+        return true;
+    }
+
+    static bool read_body(int fd, std::string& buffer, std::size_t size, std::string& out) {
+        while (buffer.size() < size) {
+            char chunk[4096];
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                return false;
+            }
+            buffer.append(chunk, n);
+        }
+        out = buffer.substr(0, size);
+        buffer.erase(0, size);
+        return true;
+    }
+
+    static void send_all(int fd, const std::string& data) {
+        std::size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return;
+            }
+            sent += n;
+        }
+    }
+
+    void serve(int fd) {
+        std::string buffer;
+        std::string line;
+        while (read_line(fd, buffer, line)) {
+            request req;
+            auto first_space = line.find(' ');
+            auto second_space = line.find(' ', first_space + 1);
+            req.method = line.substr(0, first_space);
+            req.path = line.substr(first_space + 1, second_space - first_space - 1);
+
+            while (read_line(fd, buffer, line) && !line.empty()) {
+                auto colon = line.find(':');
+                std::string name = line.substr(0, colon);
+                for (char& c : name) {
+                    c = std::tolower(static_cast<unsigned char>(c));
+                }
+                std::size_t value_start = line.find_first_not_of(' ', colon + 1);
+                req.headers[name] =
+                    value_start == std::string::npos ? "" : line.substr(value_start);
+            }
+
+            if (req.headers.count("expect")) {
+                send_all(fd, "HTTP/1.1 100 Continue\r\n\r\n");
+            }
+            auto length = req.headers.find("content-length");
+            if (length != req.headers.end() &&
+                !read_body(fd, buffer, std::stoul(length->second), req.body)) {
+                break;
+            }
+
+            response res = m_handler(req);
+            std::string out = "HTTP/1.1 " + std::to_string(res.status) + " X\r\n";
+            for (const auto& [name, value] : res.headers) {
+                out += name + ": " + value + "\r\n";
+            }
+            out += "Content-Length: " + std::to_string(res.body.size()) + "\r\n\r\n";
+            out += res.body;
+            send_all(fd, out);
+        }
+    }
+
+public:
+    explicit http_server(handler h)
+        : m_handler(std::move(h)), m_listen(::socket(AF_INET, SOCK_STREAM, 0)),
+          m_connections(0) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t size = sizeof(addr);
+        if (m_listen < 0 ||
+            ::bind(m_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+            ::listen(m_listen, 128) < 0 ||
+            ::getsockname(m_listen, reinterpret_cast<sockaddr*>(&addr), &size) < 0) {
+            throw std::runtime_error("failed to start the test http server");
+        }
+        m_port = ntohs(addr.sin_port);
+
+        m_accept = std::thread([this] {
+            int fd;
+            while ((fd = ::accept(m_listen, nullptr, nullptr)) >= 0) {
+                ++m_connections;
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_sockets.push_back(fd);
+                m_threads.emplace_back([this, fd] { serve(fd); });
+            }
+        });
+    }
+
+    http_server(const http_server&) = delete;
+
+    ~http_server() {
+        ::shutdown(m_listen, SHUT_RDWR);
+        ::close(m_listen);
+        m_accept.join();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (int fd : m_sockets) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+        for (std::thread& t : m_threads) {
+            t.join();
+        }
+        for (int fd : m_sockets) {
+            ::close(fd);
+        }
+    }
+
+    /** The `host:port` to connect to.
+     */
+    std::string address() const {
+        return "127.0.0.1:" + std::to_string(m_port);
+    }
+
+    /** The number of connections accepted so far.
+     */
+    std::size_t connections() const {
+        return m_connections;
+    }
+};
+}  // namespace h5s3::testing
@@ -0,0 +1,39 @@
+#include <cstdint>
+#include <cstring>
+#include <set>
+
+#include "gtest/gtest.h"
+
+#include "h5s3/private/arena.h"
+
+using buffer_arena = h5s3::page::buffer_arena;
+
+TEST(buffer_arena, alignment) {
+    buffer_arena arena(1000, 8);
+    EXPECT_EQ(arena.buffer_size(), buffer_arena::alignment);
+
+    std::set<char*> buffers;
+    for (int ix = 0; ix < 20; ++ix) {
+        char* buffer = arena.allocate();
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(buffer) % buffer_arena::alignment,
+                  0ul);
+        // the whole buffer is writable
+        std::memset(buffer, 'a', arena.buffer_size());
+        buffers.insert(buffer);
+    }
+    EXPECT_EQ(buffers.size(), 20ul);
+
+    // the mappings are sized for `max_buffers`, more are mapped on demand
+    EXPECT_EQ(arena.mapped_bytes(), 24 * buffer_arena::alignment);
+}
+
+TEST(buffer_arena, reuse) {
+    buffer_arena arena(2 << 20, 4);
+    char* a = arena.allocate();
+    char* b = arena.allocate();
+    EXPECT_NE(a, b);
+
+    arena.release(a);
+    EXPECT_EQ(arena.allocate(), a);
+    EXPECT_EQ(arena.mapped_bytes(), 4ul * (2 << 20));
+}
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "h5s3/private/async.h"
+#include "h5s3/private/memory_kv_store.h"
+#include "h5s3/private/page.h"
+
+namespace async = h5s3::async;
+using h5s3::io::priority;
+
+TEST(async, future) {
+    async::promise<int> p;
+    async::future<int> f = p.get_future();
+    EXPECT_FALSE(f.ready());
+
+    std::thread producer([&] { p.set_value(42); });
+    EXPECT_EQ(f.get(), 42);
+    producer.join();
+    EXPECT_TRUE(f.ready());
+
+    async::future<void> failed =
+        async::make_error<void>(std::make_exception_ptr(std::runtime_error("failed")));
+    EXPECT_THROW(failed.get(), std::runtime_error);
+}
+
+TEST(async, then) {
+    async::promise<int> p;
+    async::future<std::string> chained =
+        p.get_future()
+            .then([](async::future<int> f) { return f.get() + 1; })
+            .then([](async::future<int> f) { return std::to_string(f.get()); });
+    EXPECT_FALSE(chained.ready());
+    p.set_value(1);
+    EXPECT_EQ(chained.get(), "2");
+
+    // continuations of ready futures run immediately
+    bool ran = false;
+    async::make_ready().then([&](async::future<void>) { ran = true; });
+    EXPECT_TRUE(ran);
+
+    // errors pass through continuations which get the result
+    auto failed = async::make_error<int>(std::make_exception_ptr(std::runtime_error("")))
+                      .then([](async::future<int> f) { return f.get() + 1; });
+    EXPECT_THROW(failed.get(), std::runtime_error);
+}
+
+TEST(async, for_each) {
+    std::mutex mutex;
+    std::vector<async::promise<void>> outstanding;
+    std::size_t most_outstanding = 0;
+    auto start = [&](std::size_t) {
+        std::lock_guard<std::mutex> lock(mutex);
+        outstanding.emplace_back();
+        most_outstanding = std::max(most_outstanding, outstanding.size());
+        return outstanding.back().get_future();
+    };
+
+    async::future<void> done = async::for_each(10, 3, start);
+    std::size_t completed = 0;
+    while (!done.ready()) {
+        async::promise<void> next;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ASSERT_FALSE(outstanding.empty());
+            next = outstanding.front();
+            outstanding.erase(outstanding.begin());
+        }
+        // completing one starts the next from this thread
+        next.set_value();
+        ++completed;
+    }
+    done.get();
+    EXPECT_EQ(completed, 10ul);
+    EXPECT_EQ(most_outstanding, 3ul);
+
+    // every operation runs, and the first error is reported
+    std::atomic<std::size_t> started(0);
+    async::future<void> failed = async::for_each(10, 4, [&](std::size_t ix) {
+        ++started;
+        if (ix == 3) {
+            throw std::runtime_error("failed");
+        }
+        return async::make_ready();
+    });
+    EXPECT_THROW(failed.get(), std::runtime_error);
+    EXPECT_EQ(started.load(), 10ul);
+
+    // operations which complete immediately do not recurse
+    async::for_each(100000, 1, [](std::size_t) { return async::make_ready(); }).get();
+}
+
+namespace {
+std::atomic<std::size_t> outstanding_reads(0);
+std::atomic<std::size_t> most_outstanding_reads(0);
+
+/** A memory kv_store which completes reads on the I/O service.
+ */
+class async_memory_kv_store : public h5s3::memory_driver::memory_kv_store {
+public:
+    using memory_kv_store::memory_kv_store;
+
+    async::future<void> async_read(h5s3::page::id page_id,
+                                   h5s3::utils::out_buffer out,
+                                   priority level) const {
+        std::size_t now = ++outstanding_reads;
+        std::size_t most = most_outstanding_reads;
+        while (now > most && !most_outstanding_reads.compare_exchange_weak(most, now)) {
+        }
+
+        async::promise<void> done;
+        h5s3::io::service::global().submit(level, [this, page_id, out, done]() mutable {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            read(page_id, out);
+            --outstanding_reads;
+            done.set_value();
+        });
+        return done.get_future();
+    }
+};
+}  // namespace
+
+TEST(async, kv_store) {
+    using table = h5s3::page::table<async_memory_kv_store>;
+    static_assert(h5s3::page::has_async_read_v<async_memory_kv_store>);
+    static_assert(!h5s3::page::has_async_read_v<h5s3::memory_driver::memory_kv_store>);
+
+    async_memory_kv_store store(16);
+    std::string data;
+    for (std::size_t ix = 0; ix < 16; ++ix) {
+        std::string page(16, 'a' + ix);
+        store.write(ix, page);
+        data += page;
+    }
+    table t(std::move(store), 32);
+
+    std::vector<h5s3::page::id> pages(16);
+    for (std::size_t ix = 0; ix < pages.size(); ++ix) {
+        pages[ix] = ix;
+    }
+    EXPECT_EQ(t.prefetch(pages, 4), 16ul);
+    EXPECT_LE(most_outstanding_reads.load(), 4ul);
+
+    std::string out(data.size(), '\0');
+    h5s3::utils::out_buffer buffer(out.data(), out.size());
+    t.read(0, buffer);
+    EXPECT_EQ(out, data);
+    EXPECT_EQ(t.stats().misses.load(), 0ul);
+}
+
+#if H5S3_HAS_COROUTINES
+namespace {
+async::future<int> add(async::future<int> a, async::future<int> b) {
+    int left = co_await a;
+    int right = co_await b;
+    co_return left + right;
+}
+
+async::future<void> fail(async::future<int> a) {
+    co_await a;
+    throw std::runtime_error("failed");
+}
+
+async::future<bool> on_worker() {
+    co_await async::schedule(h5s3::io::service::global(), priority::demand);
+    co_return h5s3::io::service::on_worker();
+}
+}  // namespace
+
+TEST(async, coroutines) {
+    async::promise<int> a;
+    async::promise<int> b;
+    async::future<int> sum = add(a.get_future(), b.get_future());
+    EXPECT_FALSE(sum.ready());
+    a.set_value(1);
+    EXPECT_FALSE(sum.ready());
+    std::thread producer([&] { b.set_value(2); });
+    EXPECT_EQ(sum.get(), 3);
+    producer.join();
+
+    EXPECT_THROW(fail(async::make_ready(1)).get(), std::runtime_error);
+    EXPECT_TRUE(on_worker().get());
+}
+#endif
@@ -0,0 +1,134 @@
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "h5s3/private/cache_manager.h"
+#include "h5s3/private/memory_kv_store.h"
+#include "h5s3/private/page.h"
+
+using memory_kv_store = h5s3::memory_driver::memory_kv_store;
+using table = h5s3::page::table<memory_kv_store>;
+using h5s3::page::cache_manager;
+
+namespace {
+// small pages are still backed by one aligned buffer each
+constexpr std::size_t buffer_size = h5s3::page::buffer_arena::alignment;
+
+std::string read(const table& t, std::size_t addr, std::size_t size) {
+    std::string out(size, '\0');
+    h5s3::utils::out_buffer buffer(out.data(), out.size());
+    t.read(addr, buffer);
+    return out;
+}
+}  // namespace
+
+TEST(cache_manager, evicts_across_tables) {
+    cache_manager manager(4 * buffer_size);
+    table a(memory_kv_store(16), 8);
+    table b(memory_kv_store(16), 8);
+    a.attach(manager);
+    b.attach(manager);
+
+    a.write(0, std::string(16, 'a'));
+    for (std::size_t addr = 16; addr < 64; addr += 16) {
+        read(a, addr, 16);
+    }
+    EXPECT_EQ(manager.cached_bytes(), 4 * buffer_size);
+
+    // the other table's least recently used page makes room, and it is
+    // written back because it is dirty
+    read(b, 0, 16);
+    EXPECT_EQ(a.cached_pages(), 3ul);
+    EXPECT_EQ(b.cached_pages(), 1ul);
+    EXPECT_EQ(manager.cached_bytes(), 4 * buffer_size);
+    EXPECT_EQ(a.stats().writebacks.load(), 1ul);
+    EXPECT_EQ(read(a, 0, 16), std::string(16, 'a'));
+}
+
+TEST(cache_manager, reused_pages_are_warmer) {
+    cache_manager manager(2 * buffer_size);
+    table a(memory_kv_store(16), 8);
+    table b(memory_kv_store(16), 8);
+    table c(memory_kv_store(16), 8);
+    a.attach(manager);
+    b.attach(manager);
+    c.attach(manager);
+
+    read(a, 0, 16);
+    read(a, 0, 16);
+    read(b, 0, 16);
+
+    // b's page was used more recently, but only once
+    read(c, 0, 16);
+    EXPECT_EQ(a.cached_pages(), 1ul);
+    EXPECT_EQ(b.cached_pages(), 0ul);
+    EXPECT_EQ(c.cached_pages(), 1ul);
+}
+
+TEST(cache_manager, requester_reuses_its_own_pages) {
+    cache_manager manager(2 * buffer_size);
+    table a(memory_kv_store(16), 8);
+    a.attach(manager);
+
+    for (std::size_t addr = 0; addr < 64; addr += 16) {
+        read(a, addr, 16);
+    }
+    EXPECT_EQ(a.cached_pages(), 2ul);
+    EXPECT_EQ(a.stats().evictions.load(), 2ul);
+
+    // a single operation does not evict pages it has already used, so it
+    // may go over the budget
+    read(a, 0, 64);
+    EXPECT_EQ(a.cached_pages(), 4ul);
+}
+
+TEST(cache_manager, budget) {
+    cache_manager manager(4 * buffer_size);
+    table a(memory_kv_store(16), 8);
+    table b(memory_kv_store(16), 8);
+    a.attach(manager);
+    b.attach(manager);
+
+    read(a, 0, 16);
+    read(a, 16, 16);
+    read(b, 0, 16);
+    read(b, 16, 16);
+
+    manager.budget(buffer_size);
+    EXPECT_EQ(manager.cached_bytes(), buffer_size);
+    EXPECT_EQ(a.cached_pages(), 0ul);
+    EXPECT_EQ(b.cached_pages(), 1ul);
+
+    // detached tables are not counted
+    b.detach();
+    EXPECT_EQ(manager.cached_bytes(), 0ul);
+    read(a, 0, 16);
+    EXPECT_EQ(b.cached_pages(), 1ul);
+}
+
+TEST(cache_manager, shared) {
+    cache_manager manager;
+    std::size_t made = 0;
+    std::function<std::shared_ptr<int>()> make = [&] {
+        return std::make_shared<int>(made++);
+    };
+
+    auto [first, first_created] = manager.shared<int>("key", make);
+    EXPECT_TRUE(first_created);
+
+    auto [second, second_created] = manager.shared<int>("key", make);
+    EXPECT_FALSE(second_created);
+    EXPECT_EQ(first, second);
+
+    auto [other, other_created] = manager.shared<int>("other", make);
+    EXPECT_TRUE(other_created);
+    EXPECT_NE(first, other);
+
+    // once every user is gone, the next lookup makes a new object
+    first.reset();
+    second.reset();
+    auto [third, third_created] = manager.shared<int>("key", make);
+    EXPECT_TRUE(third_created);
+    EXPECT_EQ(*third, 2);
+}
@@ -0,0 +1,62 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "h5s3/private/cache_sim.h"
+
+namespace cache_sim = h5s3::cache_sim;
+
+namespace {
+std::vector<cache_sim::access> page_reads(const std::vector<std::uint64_t>& pages,
+                                          std::size_t page_size) {
+    std::vector<cache_sim::access> out;
+    for (std::uint64_t page : pages) {
+        out.push_back({page * page_size, 1, false});
+    }
+    return out;
+}
+}  // namespace
+
+TEST(cache_sim, spans_pages) {
+    // one access which covers the tail of page 0, all of page 1 and the head
+    // of page 2
+    std::vector<cache_sim::access> accesses = {{15, 18, false}};
+    auto r = cache_sim::simulate(accesses, {16, 4, cache_sim::policy::lru});
+    EXPECT_EQ(r.page_accesses, 3ul);
+    EXPECT_EQ(r.misses, 3ul);
+    EXPECT_EQ(r.hits, 0ul);
+    EXPECT_EQ(r.requests(), 3ul);
+    EXPECT_EQ(r.bytes_transferred(), 48ul);
+}
+
+TEST(cache_sim, policies) {
+    // with room for two pages: lru keeps 0 because it was just used, fifo
+    // evicts it because it was loaded first, and lfu keeps it because it was
+    // used twice
+    auto accesses = page_reads({0, 1, 0, 2, 0}, 16);
+
+    auto lru = cache_sim::simulate(accesses, {16, 2, cache_sim::policy::lru});
+    EXPECT_EQ(lru.hits, 2ul);
+    EXPECT_EQ(lru.misses, 3ul);
+
+    auto fifo = cache_sim::simulate(accesses, {16, 2, cache_sim::policy::fifo});
+    EXPECT_EQ(fifo.hits, 1ul);
+    EXPECT_EQ(fifo.misses, 4ul);
+
+    auto lfu = cache_sim::simulate(accesses, {16, 2, cache_sim::policy::lfu});
+    EXPECT_EQ(lfu.hits, 2ul);
+    EXPECT_EQ(lfu.misses, 3ul);
+}
+
+TEST(cache_sim, writebacks) {
+    std::vector<cache_sim::access> accesses = {
+        {0, 1, true},
+        {16, 1, false},
+        {32, 1, true},  // evicts dirty page 0
+        {16, 1, false},
+    };
+    auto r = cache_sim::simulate(accesses, {16, 2, cache_sim::policy::lru});
+    // page 0 on eviction, page 2 on the final flush
+    EXPECT_EQ(r.writebacks, 2ul);
+    EXPECT_EQ(r.requests(), 5ul);
+}
@@ -0,0 +1,185 @@
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "h5s3/private/curl.h"
+
+#include "http_server.h"
+
+using h5s3::io::priority;
+using h5s3::testing::http_server;
+namespace curl = h5s3::curl;
+
+namespace {
+/** A loopback address which refuses connections.
+ */
+std::string closed_address() {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(addr);
+    ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &size);
+    ::close(fd);
+    return "127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+}
+
+http_server::response echo_path(const http_server::request& req) {
+    return http_server::response{200, {}, req.path};
+}
+}  // namespace
+
+TEST(endpoints, unregistered) {
+    curl::endpoints e;
+    EXPECT_FALSE(e.choose("host"));
+    EXPECT_TRUE(e.addresses("host").empty());
+}
+
+TEST(endpoints, least_outstanding) {
+    curl::endpoints e;
+    e.add("host", {"a", "b", "c"});
+    // addresses which are already registered are skipped
+    e.add("host", {"b"});
+    EXPECT_EQ(e.addresses("host").size(), 3ul);
+
+    std::vector<std::optional<curl::endpoints::lease>> leases;
+    std::set<std::string> chosen;
+    for (int ix = 0; ix < 3; ++ix) {
+        leases.push_back(e.choose("host"));
+        chosen.insert(leases.back()->address());
+    }
+    EXPECT_EQ(chosen, (std::set<std::string>{"a", "b", "c"}));
+
+    // the address with the fewest outstanding requests is chosen
+    leases.push_back(e.choose("host"));
+    std::string doubled = leases.back()->address();
+    for (auto& lease : leases) {
+        if (lease->address() != doubled) {
+            lease.reset();
+            break;
+        }
+    }
+    std::string released;
+    for (const auto& status : e.addresses("host")) {
+        if (status.outstanding == 0) {
+            released = status.address;
+        }
+    }
+    ASSERT_FALSE(released.empty());
+    EXPECT_EQ(e.choose("host")->address(), released);
+}
+
+TEST(endpoints, backoff) {
+    curl::endpoints e;
+    e.add("host", {"a", "b"});
+
+    {
+        auto lease = e.choose("host");
+        ASSERT_TRUE(lease);
+        ASSERT_EQ(lease->address(), "a");
+        lease->failed();
+    }
+    auto status = e.addresses("host");
+    EXPECT_FALSE(status[0].healthy);
+    EXPECT_EQ(status[0].failures, 1ul);
+
+    // failing addresses are skipped, even with more outstanding requests on
+    // the healthy ones
+    std::vector<curl::endpoints::lease> leases;
+    for (int ix = 0; ix < 4; ++ix) {
+        leases.push_back(*e.choose("host"));
+        EXPECT_EQ(leases.back().address(), "b");
+    }
+    leases.clear();
+
+    // when every address is failing, the one which recovers first is used
+    {
+        auto lease = e.choose("host");
+        lease->failed();
+    }
+    EXPECT_EQ(e.choose("host")->address(), "a");
+}
+
+TEST(endpoints, connect_to) {
+    curl::endpoints e;
+    e.add("host", {"10.0.0.1:9000", "10.0.0.2", "[::1]:80", "::2"});
+    std::vector<std::string> entries;
+    std::vector<curl::endpoints::lease> leases;
+    for (int ix = 0; ix < 4; ++ix) {
+        leases.push_back(*e.choose("host"));
+        entries.push_back(leases.back().connect_to());
+    }
+    EXPECT_EQ(entries,
+              (std::vector<std::string>{
+                  "::10.0.0.1:9000", "::10.0.0.2:", "::[::1]:80", "::[::2]:"}));
+}
+
+TEST(endpoints, resolve) {
+    auto addresses = curl::resolve("127.0.0.1:9000");
+    EXPECT_EQ(addresses, std::vector<std::string>{"127.0.0.1"});
+    EXPECT_THROW(curl::resolve("invalid..name"), curl::error);
+}
+
+TEST(endpoints, spread_requests) {
+    http_server a(echo_path);
+    http_server b(echo_path);
+    const std::string host = "spread.h5s3.test";
+    curl::endpoints::global().add(host, {a.address(), b.address()});
+
+    // requests keep the url's host and go to the registered addresses
+    for (int ix = 0; ix < 8; ++ix) {
+        auto session = curl::pool::global().acquire(host);
+        EXPECT_EQ(session->get("http://" + host + "/sync", {}), "/sync");
+    }
+
+    std::vector<std::string> bodies(32, std::string(6, '\0'));
+    std::vector<h5s3::async::future<curl::get_result>> results;
+    for (std::string& body : bodies) {
+        results.push_back(
+            curl::async_get("http://" + host + "/async",
+                            {},
+                            h5s3::utils::out_buffer(body.data(), body.size()),
+                            priority::demand));
+    }
+    for (std::size_t ix = 0; ix < results.size(); ++ix) {
+        EXPECT_EQ(results[ix].get().size, 6ul);
+        EXPECT_EQ(bodies[ix], "/async");
+    }
+
+    EXPECT_GT(a.connections(), 0ul);
+    EXPECT_GT(b.connections(), 0ul);
+}
+
+TEST(endpoints, failover) {
+    http_server live(echo_path);
+    const std::string host = "failover.h5s3.test";
+    std::string dead = closed_address();
+    curl::endpoints::global().add(host, {dead, live.address()});
+
+    std::size_t failures = 0;
+    for (int ix = 0; ix < 8; ++ix) {
+        try {
+            auto session = curl::pool::global().acquire(host);
+            EXPECT_EQ(session->get("http://" + host + "/x", {}), "/x");
+        }
+        catch (const curl::error&) {
+            ++failures;
+        }
+    }
+    // the dead address is skipped once it has failed; it is only retried if
+    // its backoff runs out during the loop
+    EXPECT_GE(failures, 1ul);
+    EXPECT_LE(failures, 2ul);
+    for (const auto& status : curl::endpoints::global().addresses(host)) {
+        EXPECT_EQ(status.failures > 0, status.address == dead);
+        EXPECT_EQ(status.outstanding, 0ul);
+    }
+}
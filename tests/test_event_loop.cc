@@ -0,0 +1,322 @@
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "h5s3/private/curl.h"
+
+#include "http2_server.h"
+#include "http_server.h"
+
+using h5s3::io::priority;
+using h5s3::testing::http2_server;
+using h5s3::testing::http_server;
+namespace curl = h5s3::curl;
+
+namespace {
+h5s3::async::future<curl::get_result>
+get(const std::string& url, const std::vector<curl::header>& headers, std::string& out) {
+    return curl::async_get(url,
+                           headers,
+                           h5s3::utils::out_buffer(out.data(), out.size()),
+                           priority::demand);
+}
+
+int http_code(const h5s3::async::future<curl::get_result>& result) {
+    try {
+        result.get();
+    }
+    catch (const curl::http_error& e) {
+        return e.code;
+    }
+    catch (...) {
+        return -1;
+    }
+    return 0;
+}
+}  // namespace
+
+TEST(event_loop, concurrent_gets) {
+    http_server server([](const http_server::request& req) {
+        return http_server::response{200, {{"ETag", "\"" + req.path + "\""}}, req.path};
+    });
+
+    constexpr std::size_t count = 256;
+    std::vector<std::string> bodies(count, std::string(16, '\0'));
+    std::vector<h5s3::async::future<curl::get_result>> results;
+    for (std::size_t ix = 0; ix < count; ++ix) {
+        std::string url = "http://" + server.address() + "/" + std::to_string(ix);
+        results.push_back(curl::async_get(
+            url,
+            {},
+            h5s3::utils::out_buffer(bodies[ix].data(), bodies[ix].size()),
+            priority::prefetch));
+    }
+
+    for (std::size_t ix = 0; ix < count; ++ix) {
+        std::string expected = "/" + std::to_string(ix);
+        curl::get_result result = results[ix].get();
+        ASSERT_EQ(result.size, expected.size());
+        EXPECT_EQ(bodies[ix].substr(0, expected.size()), expected);
+        EXPECT_EQ(result.etag, "\"" + expected + "\"");
+    }
+    // connections are limited per host and shared between requests
+    EXPECT_LT(server.connections(), count);
+}
+
+TEST(event_loop, errors) {
+    http_server server([](const http_server::request& req) {
+        if (req.path == "/missing") {
+            return http_server::response{404, {}, "<Error>NoSuchKey</Error>"};
+        }
+        if (req.headers.count("if-none-match") &&
+            req.headers.at("if-none-match") == "\"tag\"") {
+            return http_server::response{304, {{"ETag", "\"tag\""}}, ""};
+        }
+        return http_server::response{200, {{"ETag", "\"tag\""}}, "too long for the buffer"};
+    });
+    std::string base = "http://" + server.address();
+    std::string out(4, '\0');
+
+    EXPECT_EQ(http_code(get(base + "/missing", {}, out)), 404);
+    // the error body is not written into the output
+    EXPECT_EQ(out, std::string(4, '\0'));
+
+    curl::get_result unchanged =
+        get(base + "/object", {{"If-None-Match", "\"tag\""}}, out).get();
+    EXPECT_FALSE(unchanged.size);
+    EXPECT_EQ(unchanged.etag, "\"tag\"");
+
+    EXPECT_THROW(get(base + "/object", {}, out).get(), curl::error);
+
+    // a connection which cannot be made fails without a response
+    EXPECT_THROW(get("http://127.0.0.1:1/object", {}, out).get(), curl::error);
+}
+
+TEST(event_loop, put) {
+    std::mutex mutex;
+    std::string received;
+    http_server server([&](const http_server::request& req) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received = req.method + " " + req.body;
+        return http_server::response{200, {}, "<Done/>"};
+    });
+
+    std::string content = "page contents";
+    auto response = curl::async_put(
+        "http://" + server.address() + "/object", {}, content, priority::write_behind);
+    EXPECT_EQ(response.get(), "<Done/>");
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(received, "PUT page contents");
+}
+
+TEST(event_loop, priority_order) {
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> started;
+    http_server server([&](const http_server::request& req) {
+        if (req.path == "/hold") {
+            started.set_value();
+            released.wait();
+        }
+        return http_server::response{};
+    });
+    std::string base = "http://" + server.address();
+
+    // one transfer at a time, so the rest wait in priority order
+    curl::event_loop loop(1, 1);
+    std::mutex mutex;
+    std::vector<std::string> order;
+    std::promise<void> all_done;
+
+    std::vector<std::string> paths = {"/hold", "/write", "/prefetch", "/demand"};
+    std::vector<priority> levels = {priority::demand,
+                                    priority::write_behind,
+                                    priority::prefetch,
+                                    priority::demand};
+    std::vector<std::unique_ptr<CURL, curl::curl_deleter>> handles;
+    for (const std::string& path : paths) {
+        handles.emplace_back(curl_easy_init());
+        curl_easy_setopt(handles.back().get(), CURLOPT_URL, (base + path).c_str());
+        curl_easy_setopt(handles.back().get(), CURLOPT_NOSIGNAL, 1L);
+    }
+
+    for (std::size_t ix = 0; ix < paths.size(); ++ix) {
+        loop.start(handles[ix].get(), levels[ix], [&, ix](CURLcode) {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(paths[ix]);
+            if (order.size() == paths.size()) {
+                all_done.set_value();
+            }
+        });
+        if (ix == 0) {
+            started.get_future().wait();
+        }
+    }
+
+    release.set_value();
+    all_done.get_future().wait();
+    EXPECT_EQ(order,
+              (std::vector<std::string>{"/hold", "/demand", "/prefetch", "/write"}));
+}
+
+TEST(event_loop, supported_http_version) {
+    curl_version_info_data info{};
+    info.features = CURL_VERSION_HTTP2;
+    info.version_num = 0x080000;
+    for (auto version : {curl::http_version::http1_1,
+                         curl::http_version::http2,
+                         curl::http_version::http2_prior_knowledge}) {
+        EXPECT_EQ(curl::supported_http_version(version, info), version);
+    }
+
+    // libcurl 7.88 fails every multiplexed h2c stream after the first, but
+    // multiplexes HTTP/2 negotiated over TLS
+    info.version_num = 0x075801;
+    EXPECT_EQ(curl::supported_http_version(curl::http_version::http2, info),
+              curl::http_version::http2);
+    EXPECT_EQ(
+        curl::supported_http_version(curl::http_version::http2_prior_knowledge, info),
+        curl::http_version::http1_1);
+
+    info.version_num = 0x080000;
+    info.features = 0;
+    for (auto version :
+         {curl::http_version::http2, curl::http_version::http2_prior_knowledge}) {
+        EXPECT_EQ(curl::supported_http_version(version, info),
+                  curl::http_version::http1_1);
+    }
+}
+
+namespace {
+bool can_multiplex_h2c() {
+    return curl::supported_http_version(curl::http_version::http2_prior_knowledge,
+                                        *curl_version_info(CURLVERSION_NOW)) ==
+           curl::http_version::http2_prior_knowledge;
+}
+
+/** Run `count` GETs of `url` on `loop` at once, without verifying the
+    certificate of an https url.
+
+    @return The result code of each transfer, the body of each transfer, and
+            the HTTP version used by the first.
+ */
+std::tuple<std::vector<CURLcode>, std::vector<std::string>, long>
+get_all(curl::event_loop& loop, const std::string& url, std::size_t count) {
+    std::vector<std::unique_ptr<CURL, curl::curl_deleter>> handles;
+    std::vector<std::string> bodies(count);
+    for (std::size_t ix = 0; ix < count; ++ix) {
+        handles.emplace_back(curl_easy_init());
+        CURL* handle = handles.back().get();
+        curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(handle, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(handle, CURLOPT_SSL_VERIFYHOST, 0L);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, &bodies[ix]);
+        curl_easy_setopt(handle,
+                         CURLOPT_WRITEFUNCTION,
+                         +[](char* ptr, std::size_t size, std::size_t nmemb, void* body) {
+                             static_cast<std::string*>(body)->append(ptr, size * nmemb);
+                             return size * nmemb;
+                         });
+    }
+
+    std::mutex mutex;
+    std::vector<CURLcode> codes;
+    std::promise<void> all_done;
+    for (auto& handle : handles) {
+        loop.start(handle.get(), priority::demand, [&](CURLcode code) {
+            std::lock_guard<std::mutex> lock(mutex);
+            codes.push_back(code);
+            if (codes.size() == count) {
+                all_done.set_value();
+            }
+        });
+    }
+    all_done.get_future().wait();
+
+    long version = 0;
+    curl_easy_getinfo(handles.front().get(), CURLINFO_HTTP_VERSION, &version);
+    return {std::move(codes), std::move(bodies), version};
+}
+}  // namespace
+
+TEST(event_loop, http2_multiplexing) {
+    if (!(curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP2)) {
+        GTEST_SKIP() << "libcurl was built without HTTP/2";
+    }
+
+    http2_server server(std::string(100, 'x'), true);
+    std::string url = "https://" + server.address() + "/object";
+
+    // HTTP/2 is negotiated with ALPN, and a single connection carries every
+    // request at once
+    curl::event_loop loop(1, 64, curl::http_version::http2);
+    EXPECT_EQ(loop.version(), curl::http_version::http2);
+    constexpr std::size_t count = 32;
+    auto [codes, bodies, version] = get_all(loop, url, count);
+    EXPECT_EQ(codes, std::vector<CURLcode>(count, CURLE_OK));
+    EXPECT_EQ(bodies, std::vector<std::string>(count, std::string(100, 'x')));
+    EXPECT_EQ(version, CURL_HTTP_VERSION_2_0);
+    EXPECT_EQ(server.connections(), 1ul);
+    EXPECT_EQ(server.requests(), count);
+    EXPECT_GT(server.max_streams(), 1ul);
+}
+
+TEST(event_loop, http2_prior_knowledge_multiplexing) {
+    if (!can_multiplex_h2c()) {
+        GTEST_SKIP() << "libcurl " << curl_version_info(CURLVERSION_NOW)->version
+                     << " cannot multiplex h2c";
+    }
+
+    http2_server server(std::string(100, 'x'));
+    std::string url = "http://" + server.address() + "/object";
+
+    // a single connection carries every request at once
+    curl::event_loop loop(1, 64, curl::http_version::http2_prior_knowledge);
+    EXPECT_EQ(loop.version(), curl::http_version::http2_prior_knowledge);
+    constexpr std::size_t count = 32;
+    auto [codes, bodies, version] = get_all(loop, url, count);
+    EXPECT_EQ(codes, std::vector<CURLcode>(count, CURLE_OK));
+    EXPECT_EQ(bodies, std::vector<std::string>(count, std::string(100, 'x')));
+    EXPECT_EQ(version, CURL_HTTP_VERSION_2_0);
+    EXPECT_EQ(server.connections(), 1ul);
+    EXPECT_EQ(server.requests(), count);
+    EXPECT_GT(server.max_streams(), 1ul);
+}
+
+TEST(event_loop, http2_prior_knowledge_fallback) {
+    if (can_multiplex_h2c()) {
+        GTEST_SKIP() << "libcurl " << curl_version_info(CURLVERSION_NOW)->version
+                     << " multiplexes h2c";
+    }
+
+    http_server server([](const http_server::request&) {
+        return http_server::response{200, {}, std::string(100, 'x')};
+    });
+    std::string url = "http://" + server.address() + "/object";
+
+    // the transfers speak HTTP/1.1 rather than failing
+    curl::event_loop loop(1, 64, curl::http_version::http2_prior_knowledge);
+    EXPECT_EQ(loop.version(), curl::http_version::http1_1);
+    constexpr std::size_t count = 32;
+    auto [codes, bodies, version] = get_all(loop, url, count);
+    EXPECT_EQ(codes, std::vector<CURLcode>(count, CURLE_OK));
+    EXPECT_EQ(bodies, std::vector<std::string>(count, std::string(100, 'x')));
+    EXPECT_EQ(version, CURL_HTTP_VERSION_1_1);
+}
+
+TEST(event_loop, parse_http_version) {
+    EXPECT_EQ(curl::parse_http_version("1.1"), curl::http_version::http1_1);
+    EXPECT_EQ(curl::parse_http_version("2"), curl::http_version::http2);
+    EXPECT_EQ(curl::parse_http_version("2-prior-knowledge"),
+              curl::http_version::http2_prior_knowledge);
+    EXPECT_THROW(curl::parse_http_version("3"), std::invalid_argument);
+}
@@ -0,0 +1,145 @@
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "h5s3/private/curl.h"
+#include "h5s3/private/io.h"
+
+using h5s3::io::priority;
+using h5s3::io::service;
+
+TEST(io_service, priority_order) {
+    service io(1);
+
+    // hold the only worker while work is queued
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> started;
+    io.submit(priority::demand, [&] {
+        started.set_value();
+        released.wait();
+    });
+    started.get_future().wait();
+
+    std::mutex mutex;
+    std::vector<int> order;
+    std::promise<void> done;
+    auto record = [&](int value) {
+        return [&, value] {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(value);
+            if (order.size() == 4) {
+                done.set_value();
+            }
+        };
+    };
+    io.submit(priority::write_behind, record(3));
+    io.submit(priority::prefetch, record(2));
+    io.submit(priority::demand, record(0));
+    io.submit(priority::demand, record(1));
+
+    release.set_value();
+    done.get_future().wait();
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 2, 3}));
+}
+
+TEST(io_service, parallel) {
+    service io(4);
+
+    std::vector<std::atomic<int>> calls(100);
+    io.parallel(priority::demand, calls.size(), 8, [&](std::size_t ix) { ++calls[ix]; });
+    for (const auto& count : calls) {
+        EXPECT_EQ(count.load(), 1);
+    }
+
+    // every call runs before the first error is rethrown
+    std::atomic<std::size_t> ran(0);
+    EXPECT_THROW(io.parallel(priority::demand,
+                             10,
+                             4,
+                             [&](std::size_t ix) {
+                                 ++ran;
+                                 if (ix == 3) {
+                                     throw std::runtime_error("failed");
+                                 }
+                             }),
+                 std::runtime_error);
+    EXPECT_EQ(ran.load(), 10ul);
+
+    io.parallel(priority::demand, 0, 4, [](std::size_t) { FAIL(); });
+}
+
+TEST(io_service, caller_makes_progress) {
+    service io(1);
+
+    // the only worker is busy, but the calling thread runs the work itself
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    io.submit(priority::write_behind, [released] { released.wait(); });
+
+    std::atomic<std::size_t> ran(0);
+    io.parallel(priority::demand, 10, 4, [&](std::size_t) { ++ran; });
+    EXPECT_EQ(ran.load(), 10ul);
+    release.set_value();
+}
+
+TEST(io_service, nested) {
+    service io(1);
+
+    // work on a worker which waits for more work must not deadlock
+    std::promise<std::size_t> result;
+    io.submit(priority::demand, [&] {
+        std::atomic<std::size_t> ran(0);
+        io.parallel(priority::demand, 10, 4, [&](std::size_t) { ++ran; });
+        result.set_value(ran);
+    });
+    EXPECT_EQ(result.get_future().get(), 10ul);
+}
+
+TEST(curl_pool, reuse) {
+    h5s3::curl::pool pool(2);
+
+    const h5s3::curl::session* first;
+    {
+        auto lease = pool.acquire("a");
+        first = &*lease;
+    }
+    {
+        auto lease = pool.acquire("a");
+        EXPECT_EQ(&*lease, first);
+    }
+    EXPECT_EQ(pool.sessions("a"), 1ul);
+
+    // hosts do not share sessions
+    {
+        auto lease = pool.acquire("b");
+        EXPECT_NE(&*lease, first);
+    }
+    EXPECT_EQ(pool.sessions("b"), 1ul);
+}
+
+TEST(curl_pool, bounded) {
+    h5s3::curl::pool pool(2);
+
+    auto a = std::make_unique<h5s3::curl::pool::lease>(pool.acquire("host"));
+    auto b = pool.acquire("host");
+    EXPECT_EQ(pool.sessions("host"), 2ul);
+
+    // a third lease waits for one to be released
+    auto third = std::async(std::launch::async, [&] {
+        auto c = pool.acquire("host");
+        return &*c;
+    });
+    EXPECT_EQ(third.wait_for(std::chrono::milliseconds(50)),
+              std::future_status::timeout);
+
+    const h5s3::curl::session* released = &**a;
+    a.reset();
+    EXPECT_EQ(third.get(), released);
+    EXPECT_EQ(pool.sessions("host"), 2ul);
+}
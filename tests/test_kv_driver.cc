@@ -0,0 +1,87 @@
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "hdf5.h"
+
+#include "h5s3/kv_driver.h"
+#include "h5s3/private/memory_kv_store.h"
+
+namespace {
+/** A memory kv-store which can be opened through hdf5.
+ */
+class driver_kv_store : public h5s3::memory_driver::memory_kv_store {
+public:
+    static constexpr const char* name = "h5s3-test-memory";
+
+    using memory_kv_store::memory_kv_store;
+
+    static driver_kv_store
+    from_params(const std::string_view&, unsigned int, std::size_t page_size) {
+        return driver_kv_store(page_size);
+    }
+};
+
+using driver = h5s3::driver::kv_driver<driver_kv_store>;
+}  // namespace
+
+template<>
+H5FD_class_t driver::m_class{};
+
+class KVDriverTest : public ::testing::Test {
+protected:
+    hid_t fapl;
+    H5FD_t* file;
+
+    KVDriverTest() : fapl(H5Pcreate(H5P_FILE_ACCESS)), file(nullptr) {
+        if (driver::set_fapl(fapl, 16, 4) >= 0) {
+            file = H5FDopen("test", H5F_ACC_RDWR | H5F_ACC_CREAT, fapl, HADDR_UNDEF);
+        }
+    }
+
+    ~KVDriverTest() {
+        if (file) {
+            H5FDclose(file);
+        }
+        H5Pclose(fapl);
+    }
+};
+
+TEST_F(KVDriverTest, read_write) {
+    ASSERT_NE(file, nullptr);
+    ASSERT_GE(H5FDset_eoa(file, H5FD_MEM_DRAW, 64), 0);
+
+    std::string in = "across a page";
+    ASSERT_GE(H5FDwrite(file, H5FD_MEM_DRAW, H5P_DEFAULT, 10, in.size(), in.data()),
+              0);
+
+    std::string out(in.size(), '\0');
+    ASSERT_GE(H5FDread(file, H5FD_MEM_DRAW, H5P_DEFAULT, 10, out.size(), out.data()),
+              0);
+    EXPECT_EQ(out, in);
+}
+
+#if H5_VERSION_GE(1, 14, 0)
+TEST_F(KVDriverTest, vector) {
+    ASSERT_NE(file, nullptr);
+    ASSERT_GE(H5FDset_eoa(file, H5FD_MEM_DRAW, 64), 0);
+
+    // the second and third writes reuse the first write's type and size
+    H5FD_mem_t types[] = {H5FD_MEM_DRAW, H5FD_MEM_NOLIST, H5FD_MEM_OHDR};
+    haddr_t addrs[] = {4, 14, 40};
+    size_t sizes[] = {4, 0, 8};
+    const void* in[] = {"ayy!", "lmao", "zoinks!?"};
+    ASSERT_GE(H5FDwrite_vector(file, H5P_DEFAULT, 3, types, addrs, sizes, in), 0);
+
+    std::string out(12, '\0');
+    void* bufs[] = {out.data(), out.data() + 4, out.data() + 8};
+    ASSERT_GE(H5FDread_vector(file, H5P_DEFAULT, 3, types, addrs, sizes, bufs), 0);
+    EXPECT_EQ(out, "ayy!lmaozoin");
+
+    std::string whole(4, '\0');
+    ASSERT_GE(
+        H5FDread(file, H5FD_MEM_DRAW, H5P_DEFAULT, 44, whole.size(), whole.data()),
+        0);
+    EXPECT_EQ(whole, std::string(4, '\0'));
+}
+#endif
@@ -0,0 +1,64 @@
+#include <cstdlib>
+#include <experimental/filesystem>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "h5s3/private/memory.h"
+
+namespace fs = std::experimental::filesystem;
+namespace memory = h5s3::memory;
+
+class MemoryTest : public ::testing::Test {
+protected:
+    fs::path root;
+
+    MemoryTest()
+        : root(fs::temp_directory_path() /
+               ("h5s3-cgroup-" + std::to_string(getpid()))) {
+        fs::create_directories(root / "memory");
+    }
+
+    ~MemoryTest() {
+        fs::remove_all(root);
+        unsetenv("H5S3_PAGE_CACHE_BYTES");
+    }
+
+    void write(const fs::path& path, const std::string& content) {
+        std::ofstream f(root / path);
+        f << content;
+    }
+};
+
+TEST_F(MemoryTest, cgroup_v2) {
+    EXPECT_FALSE(memory::cgroup_memory_limit(root));
+
+    write("memory.max", "max\n");
+    EXPECT_FALSE(memory::cgroup_memory_limit(root));
+
+    write("memory.max", "1073741824\n");
+    EXPECT_EQ(memory::cgroup_memory_limit(root), 1073741824ul);
+}
+
+TEST_F(MemoryTest, cgroup_v1) {
+    // no limit is reported as a huge number
+    write("memory/memory.limit_in_bytes", "9223372036854771712\n");
+    EXPECT_FALSE(memory::cgroup_memory_limit(root));
+
+    write("memory/memory.limit_in_bytes", "536870912\n");
+    EXPECT_EQ(memory::cgroup_memory_limit(root), 536870912ul);
+}
+
+TEST_F(MemoryTest, default_cache_bytes) {
+    setenv("H5S3_PAGE_CACHE_BYTES", "12345", 1);
+    EXPECT_EQ(memory::default_cache_bytes(), 12345ul);
+
+    setenv("H5S3_PAGE_CACHE_BYTES", "lots", 1);
+    EXPECT_THROW(memory::default_cache_bytes(), std::invalid_argument);
+
+    unsetenv("H5S3_PAGE_CACHE_BYTES");
+    EXPECT_LE(memory::default_cache_bytes(), memory::fallback_cache_bytes);
+}
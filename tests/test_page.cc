@@ -0,0 +1,549 @@
+#include <algorithm>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "h5s3/private/memory_kv_store.h"
+#include "h5s3/private/page.h"
+
+using memory_kv_store = h5s3::memory_driver::memory_kv_store;
+using table = h5s3::page::table<memory_kv_store>;
+
+namespace {
+std::string read(const table& t, std::size_t addr, std::size_t size) {
+    std::string out(size, '\0');
+    h5s3::utils::out_buffer buffer(out.data(), out.size());
+    t.read(addr, buffer);
+    return out;
+}
+}  // namespace
+
+TEST(page_table, read_write) {
+    table t(memory_kv_store(16), 4);
+
+    // unwritten memory reads as zeros
+    EXPECT_EQ(read(t, 0, 8), std::string(8, '\0'));
+
+    // write across a page boundary
+    t.write(12, "abcdefgh");
+    EXPECT_EQ(read(t, 12, 8), "abcdefgh");
+    EXPECT_EQ(read(t, 10, 4), std::string("\0\0ab", 4));
+
+    // write across many pages
+    std::string big(100, 'x');
+    t.write(30, big);
+    EXPECT_EQ(read(t, 30, 100), big);
+    EXPECT_EQ(read(t, 12, 8), "abcdefgh");
+}
+
+TEST(page_table, flush) {
+    table t(memory_kv_store(16), 2);
+    t.write(0, "ayy");
+    t.write(40, "lmao");
+    EXPECT_EQ(t.store().allocated_pages(), 0ul);
+
+    t.flush();
+    EXPECT_EQ(t.store().allocated_pages(), 3ul);
+
+    t.write(41, "y");
+    t.flush();
+    EXPECT_EQ(read(t, 40, 4), "lyao");
+}
+
+TEST(page_table, truncate) {
+    table t(memory_kv_store(16), 4);
+    t.write(0, std::string(48, 'a'));
+    t.flush();
+
+    // page 2 is cut off, writing into it again leaves the rest of it zeroed
+    t.truncate(31);
+    t.write(36, "bb");
+    EXPECT_EQ(read(t, 0, 48),
+              std::string(32, 'a') + std::string(4, '\0') + "bb" +
+                  std::string(10, '\0'));
+}
+
+TEST(page_table, stats) {
+    table t(memory_kv_store(16), 2);
+    const auto& s = t.stats();
+
+    read(t, 0, 4);
+    EXPECT_EQ(s.misses.load(), 1ul);
+    EXPECT_EQ(s.hits.load(), 0ul);
+
+    read(t, 4, 4);
+    EXPECT_EQ(s.misses.load(), 1ul);
+    EXPECT_EQ(s.hits.load(), 1ul);
+
+    // dirty the first page, then read two more pages to push it out
+    t.write(0, "ayy");
+    read(t, 16, 4);
+    EXPECT_EQ(s.evictions.load(), 0ul);
+    read(t, 32, 4);
+    EXPECT_EQ(s.evictions.load(), 1ul);
+    EXPECT_EQ(s.writebacks.load(), 1ul);
+    EXPECT_EQ(t.store().stats().puts.load(), 1ul);
+
+    // the first page is read back from the store
+    EXPECT_EQ(read(t, 0, 3), "ayy");
+    EXPECT_EQ(s.misses.load(), 4ul);
+    EXPECT_EQ(t.store().stats().gets.load(), 4ul);
+    EXPECT_EQ(t.store().stats().not_found.load(), 3ul);
+}
+
+TEST(page_table, unchanged_writeback) {
+    table t(memory_kv_store(16), 2);
+    const auto& s = t.stats();
+    t.write(0, std::string(32, 'a'));
+    t.flush();
+    EXPECT_EQ(t.store().stats().puts.load(), 2ul);
+
+    // rewriting the same bytes does not upload the page
+    t.write(4, "aaaa");
+    t.flush();
+    EXPECT_EQ(s.writebacks.load(), 2ul);
+    EXPECT_EQ(s.unchanged_writebacks.load(), 1ul);
+    EXPECT_EQ(t.store().stats().puts.load(), 2ul);
+
+    // a write is only compared with the stored bytes while its page is
+    // clean, so a page which is changed and then changed back is uploaded
+    t.write(16, "b");
+    t.write(16, "a");
+    t.write(8, "c");
+    t.flush();
+    EXPECT_EQ(s.unchanged_writebacks.load(), 1ul);
+    EXPECT_EQ(t.store().stats().puts.load(), 4ul);
+
+    // an unchanged write does not hide a later change to the page
+    t.write(20, "aa");
+    t.write(24, "d");
+    t.flush();
+    EXPECT_EQ(s.unchanged_writebacks.load(), 1ul);
+    EXPECT_EQ(t.store().stats().puts.load(), 5ul);
+    t.write(24, "a");
+    t.flush();
+
+    // the same holds for pages read back from the store and then evicted
+    read(t, 32, 4);
+    read(t, 48, 4);
+    t.write(0, "aaaa");
+    read(t, 32, 4);
+    read(t, 48, 4);
+    EXPECT_EQ(s.unchanged_writebacks.load(), 2ul);
+    EXPECT_EQ(t.store().stats().puts.load(), 6ul);
+    EXPECT_EQ(read(t, 0, 32), "aaaaaaaacaaaaaaa" + std::string(16, 'a'));
+
+    // pages past the end of the store are written even if they are zeros
+    t.write(64, std::string(16, '\0'));
+    t.flush();
+    EXPECT_EQ(t.store().allocated_pages(), 5ul);
+}
+
+namespace {
+/** A memory kv-store which records the range of each page which changed.
+ */
+class range_write_kv_store : public memory_kv_store {
+public:
+    std::vector<std::tuple<h5s3::page::id, std::size_t, std::size_t>> ranges;
+
+    using memory_kv_store::memory_kv_store;
+    using memory_kv_store::write;
+
+    void write(h5s3::page::id page_id,
+               const std::string_view& data,
+               std::size_t begin,
+               std::size_t end) {
+        ranges.emplace_back(page_id, begin, end);
+        write(page_id, data);
+    }
+};
+}  // namespace
+
+TEST(page_table, range_writes) {
+    static_assert(h5s3::page::has_range_write_v<range_write_kv_store>);
+    static_assert(!h5s3::page::has_range_write_v<memory_kv_store>);
+
+    h5s3::page::table<range_write_kv_store> t(range_write_kv_store(16), 4);
+    t.write(0, std::string(48, 'a'));
+    t.flush();
+    t.store().ranges.clear();
+
+    // the writes to a page are merged into one range
+    t.write(2, "bb");
+    t.write(6, "c");
+    t.write(14, "dddd");
+    t.flush();
+    auto& ranges = t.store().ranges;
+    std::sort(ranges.begin(), ranges.end());
+    using range = std::tuple<h5s3::page::id, std::size_t, std::size_t>;
+    EXPECT_EQ(ranges, (std::vector<range>{{0, 2, 16}, {1, 0, 2}}));
+    ranges.clear();
+
+    // a page which was cut off is written whole
+    t.truncate(16);
+    t.write(40, "e");
+    t.flush();
+    EXPECT_EQ(ranges, (std::vector<range>{{2, 0, 16}}));
+}
+
+namespace {
+/** A memory kv-store which can read many pages at once, recording each run
+    of pages it was asked for.
+ */
+class multi_read_kv_store : public memory_kv_store {
+public:
+    mutable std::vector<std::pair<h5s3::page::id, std::size_t>> runs;
+
+    using memory_kv_store::memory_kv_store;
+    using memory_kv_store::read;
+
+    void read(h5s3::page::id first, std::vector<h5s3::utils::out_buffer>& pages) const {
+        runs.emplace_back(first, pages.size());
+        for (std::size_t ix = 0; ix < pages.size(); ++ix) {
+            read(first + ix, pages[ix]);
+        }
+    }
+};
+}  // namespace
+
+TEST(page_table, coalesced_reads) {
+    static_assert(h5s3::page::has_multi_page_read_v<multi_read_kv_store>);
+    static_assert(!h5s3::page::has_multi_page_read_v<memory_kv_store>);
+
+    std::string data;
+    for (std::size_t ix = 0; ix < 160; ++ix) {
+        data.push_back('a' + ix % 26);
+    }
+    multi_read_kv_store store(16);
+    for (std::size_t page = 0; page < 10; ++page) {
+        store.write(page, std::string_view(data).substr(page * 16, 16));
+    }
+
+    h5s3::page::table<multi_read_kv_store> t(std::move(store), 4);
+    const auto& runs = t.store().runs;
+    const auto& s = t.stats();
+
+    // pages 0, 1, and 2 are missing and read together
+    std::string out(40, '\0');
+    h5s3::utils::out_buffer buffer(out.data(), out.size());
+    t.read(8, buffer);
+    EXPECT_EQ(out, data.substr(8, 40));
+    ASSERT_EQ(runs.size(), 1ul);
+    EXPECT_EQ(runs[0], std::make_pair(0ul, 3ul));
+    EXPECT_EQ(s.misses.load(), 3ul);
+    EXPECT_EQ(s.hits.load(), 0ul);
+
+    // pages 0 through 2 are cached, and 3 is read on its own
+    out.assign(64, '\0');
+    buffer = h5s3::utils::out_buffer(out.data(), out.size());
+    t.read(0, buffer);
+    EXPECT_EQ(out, data.substr(0, 64));
+    EXPECT_EQ(runs.size(), 1ul);
+    EXPECT_EQ(s.misses.load(), 4ul);
+    EXPECT_EQ(s.hits.load(), 3ul);
+
+    // runs are capped at the size of the cache
+    out.assign(96, '\0');
+    buffer = h5s3::utils::out_buffer(out.data(), out.size());
+    t.read(64, buffer);
+    EXPECT_EQ(out, data.substr(64, 96));
+    ASSERT_EQ(runs.size(), 3ul);
+    EXPECT_EQ(runs[1], std::make_pair(4ul, 4ul));
+    EXPECT_EQ(runs[2], std::make_pair(8ul, 2ul));
+    EXPECT_EQ(s.misses.load(), 10ul);
+    EXPECT_EQ(s.hits.load(), 3ul);
+}
+
+TEST(page_table, prefetch) {
+    memory_kv_store store(16);
+    for (std::size_t page = 0; page < 8; ++page) {
+        store.write(page, std::string(16, 'a' + page));
+    }
+
+    table t(std::move(store), 4);
+    const auto& s = t.stats();
+
+    // page 1 is already cached, and duplicates are ignored
+    read(t, 16, 1);
+    EXPECT_EQ(t.prefetch({6, 1, 3, 6}), 2ul);
+    EXPECT_EQ(s.prefetches.load(), 2ul);
+    EXPECT_EQ(s.misses.load(), 1ul);
+
+    EXPECT_EQ(read(t, 48, 16), std::string(16, 'd'));
+    EXPECT_EQ(read(t, 96, 16), std::string(16, 'g'));
+    EXPECT_EQ(s.misses.load(), 1ul);
+    EXPECT_EQ(s.hits.load(), 2ul);
+
+    // no more than the cache size is loaded
+    EXPECT_EQ(t.prefetch({0, 2, 4, 5, 7}), 4ul);
+    EXPECT_EQ(read(t, 0, 16), std::string(16, 'a'));
+    EXPECT_EQ(s.misses.load(), 1ul);
+}
+
+TEST(page_table, read_vector) {
+    memory_kv_store store(16);
+    for (std::size_t page = 0; page < 8; ++page) {
+        store.write(page, std::string(16, 'a' + page));
+    }
+
+    table t(std::move(store), 4);
+    const auto& s = t.stats();
+    read(t, 16, 1);
+
+    // pages 0, 1 (cached), and 3, with page 3 read twice
+    std::string out(24, '\0');
+    std::vector<h5s3::page::vector_read> reads = {
+        {8, {out.data(), 16}, 0},
+        {50, {out.data() + 16, 4}, 0},
+        {60, {out.data() + 20, 4}, 0},
+    };
+    t.read_vector(reads);
+    EXPECT_EQ(out, std::string(8, 'a') + std::string(8, 'b') + "dddddddd");
+    EXPECT_EQ(s.misses.load(), 3ul);
+    EXPECT_EQ(s.hits.load(), 2ul);
+    EXPECT_EQ(t.store().stats().gets.load(), 3ul);
+
+    // more pages than fit in the cache are read in batches
+    out.assign(8 * 16, '\0');
+    reads.clear();
+    for (std::size_t page = 0; page < 8; ++page) {
+        reads.push_back({page * 16, {out.data() + page * 16, 16}, 0});
+    }
+    t.read_vector(reads);
+    std::string expected;
+    for (std::size_t page = 0; page < 8; ++page) {
+        expected += std::string(16, 'a' + page);
+    }
+    EXPECT_EQ(out, expected);
+}
+
+TEST(page_table, write_vector) {
+    table t(memory_kv_store(16), 4);
+    std::vector<h5s3::page::vector_write> writes = {
+        {4, "ayy", 0},
+        {14, "lmao", 0},
+        {5, "Y", 0},
+    };
+    t.write_vector(writes);
+    EXPECT_EQ(read(t, 4, 14), std::string("aYy\0\0\0\0\0\0\0lmao", 14));
+    EXPECT_EQ(t.stats().misses.load(), 2ul);
+
+    t.flush();
+    EXPECT_EQ(t.store().allocated_pages(), 2ul);
+}
+
+TEST(page_table, expand_vector) {
+    using request = std::tuple<std::size_t, std::size_t, char*, int>;
+    auto make = [](std::size_t addr, std::size_t size, char* buf, int type) {
+        return request{addr, size, buf, type};
+    };
+    char bufs[4][1];
+    char* ptrs[] = {bufs[0], bufs[1], bufs[2], bufs[3]};
+    std::size_t addrs[] = {0, 8, 16, 24};
+    constexpr int nolist = -1;
+
+    // every entry given
+    int types[] = {3, 1, 6, 3};
+    std::size_t sizes[] = {8, 4, 2, 1};
+    EXPECT_EQ(h5s3::page::expand_vector<request>(
+                  4, types, nolist, addrs, sizes, ptrs, make),
+              (std::vector<request>{{0, 8, bufs[0], 3},
+                                    {8, 4, bufs[1], 1},
+                                    {16, 2, bufs[2], 6},
+                                    {24, 1, bufs[3], 3}}));
+
+    // a 0 size and a nolist type repeat the previous entry for the rest of the
+    // vector, even if later entries are set
+    int short_types[] = {3, 1, nolist, 6};
+    std::size_t short_sizes[] = {8, 0, 2, 0};
+    EXPECT_EQ(h5s3::page::expand_vector<request>(
+                  4, short_types, nolist, addrs, short_sizes, ptrs, make),
+              (std::vector<request>{{0, 8, bufs[0], 3},
+                                    {8, 8, bufs[1], 1},
+                                    {16, 8, bufs[2], 1},
+                                    {24, 8, bufs[3], 1}}));
+
+    // a single entry may end both lists
+    int one_type[] = {2};
+    std::size_t one_size[] = {16};
+    int no_types[] = {2, nolist};
+    std::size_t no_sizes[] = {16, 0};
+    auto expected = h5s3::page::expand_vector<request>(
+        1, one_type, nolist, addrs, one_size, ptrs, make);
+    auto out = h5s3::page::expand_vector<request>(
+        2, no_types, nolist, addrs, no_sizes, ptrs, make);
+    ASSERT_EQ(out.size(), 2ul);
+    EXPECT_EQ(out[0], expected[0]);
+    EXPECT_EQ(out[1], (request{8, 16, bufs[1], 2}));
+}
+
+namespace {
+/** A memory kv-store which keeps a hot set.
+ */
+class hot_kv_store : public memory_kv_store {
+private:
+    std::vector<h5s3::page::id> m_hot_pages;
+
+public:
+    using memory_kv_store::memory_kv_store;
+
+    const std::vector<h5s3::page::id>& hot_pages() const {
+        return m_hot_pages;
+    }
+
+    void hot_pages(std::vector<h5s3::page::id> pages) {
+        m_hot_pages = std::move(pages);
+    }
+};
+}  // namespace
+
+TEST(page_table, hot_pages) {
+    static_assert(h5s3::page::has_hot_pages_v<hot_kv_store>);
+    static_assert(!h5s3::page::has_hot_pages_v<memory_kv_store>);
+
+    h5s3::page::table<hot_kv_store> t(hot_kv_store(16), 4);
+    // only count memory types 1 and 2
+    t.track_hot_pages(1 << 1 | 1 << 2);
+
+    std::string out(4, '\0');
+    h5s3::utils::out_buffer buffer(out.data(), out.size());
+    auto access = [&](std::size_t page, std::uint8_t mem_type, int times) {
+        for (int ix = 0; ix < times; ++ix) {
+            t.read(page * 16, buffer, mem_type);
+        }
+    };
+    access(0, 1, 2);
+    access(3, 2, 5);
+    access(5, 1, 2);
+    access(7, 3, 10);  // not counted
+
+    EXPECT_EQ(t.hot_pages(10), (std::vector<h5s3::page::id>{3, 0, 5}));
+    EXPECT_EQ(t.hot_pages(1), (std::vector<h5s3::page::id>{3}));
+
+    EXPECT_TRUE(t.store().hot_pages().empty());
+    t.flush();
+    EXPECT_EQ(t.store().hot_pages(), (std::vector<h5s3::page::id>{3, 0, 5}));
+}
+
+namespace {
+/** A memory kv-store which counts the writes to each page, so that pages
+    changed behind the table's back can be revalidated.
+ */
+class versioned_kv_store : public memory_kv_store {
+private:
+    std::unordered_map<h5s3::page::id, std::size_t> m_versions;
+    mutable std::unordered_map<h5s3::page::id, std::size_t> m_read_versions;
+
+    std::size_t version(h5s3::page::id page_id) const {
+        auto search = m_versions.find(page_id);
+        return search == m_versions.end() ? 0 : search->second;
+    }
+
+public:
+    std::size_t refreshes = 0;
+
+    using memory_kv_store::memory_kv_store;
+
+    void read(h5s3::page::id page_id, h5s3::utils::out_buffer& out) const {
+        m_read_versions[page_id] = version(page_id);
+        memory_kv_store::read(page_id, out);
+    }
+
+    void write(h5s3::page::id page_id, const std::string_view& data) {
+        external_write(page_id, data);
+        m_read_versions[page_id] = version(page_id);
+    }
+
+    /** Write a page as another writer would.
+     */
+    void external_write(h5s3::page::id page_id, const std::string_view& data) {
+        ++m_versions[page_id];
+        memory_kv_store::write(page_id, data);
+    }
+
+    bool revalidate(h5s3::page::id page_id, h5s3::utils::out_buffer& out) const {
+        if (m_read_versions[page_id] == version(page_id)) {
+            return false;
+        }
+        read(page_id, out);
+        return true;
+    }
+
+    void refresh() {
+        ++refreshes;
+    }
+};
+}  // namespace
+
+TEST(page_table, refresh) {
+    static_assert(h5s3::page::has_revalidate_v<versioned_kv_store>);
+    static_assert(!h5s3::page::has_revalidate_v<memory_kv_store>);
+
+    h5s3::page::table<versioned_kv_store> t(versioned_kv_store(16), 4);
+    t.write(0, std::string(64, 'a'));
+    t.flush();
+    t.write(16, "dirty");
+
+    // another writer changes pages 0 and 2
+    t.store().external_write(0, std::string(16, 'b'));
+    t.store().external_write(2, std::string(16, 'c'));
+
+    std::string out(48, '\0');
+    h5s3::utils::out_buffer buffer(out.data(), out.size());
+    t.read(0, buffer);
+    EXPECT_EQ(out.substr(0, 16), std::string(16, 'a'));
+
+    // page 1 is dirty and is left alone
+    EXPECT_EQ(t.refresh(1), 2ul);
+    EXPECT_EQ(t.store().refreshes, 1ul);
+    t.read(0, buffer);
+    EXPECT_EQ(out,
+              std::string(16, 'b') + "dirty" + std::string(11, 'a') +
+                  std::string(16, 'c'));
+
+    // nothing changed since the last refresh
+    EXPECT_EQ(t.refresh(1), 0ul);
+}
+
+TEST(page_table, resize) {
+    table t(memory_kv_store(16), 4);
+    t.write(0, std::string(64, 'a'));
+    EXPECT_EQ(t.cached_pages(), 4ul);
+
+    // the dirty pages which do not fit are written back
+    t.resize(1);
+    EXPECT_EQ(t.page_cache_size(), 1ul);
+    EXPECT_EQ(t.cached_pages(), 1ul);
+    EXPECT_EQ(t.stats().writebacks.load(), 3ul);
+    EXPECT_EQ(t.store().allocated_pages(), 3ul);
+    EXPECT_EQ(read(t, 0, 64), std::string(64, 'a'));
+
+    t.resize(8);
+    read(t, 0, 64);
+    EXPECT_EQ(t.cached_pages(), 4ul);
+}
+
+TEST(page_table, memory_pressure) {
+    table t(memory_kv_store(16), 4);
+    t.write(0, std::string(16, 'a'));
+    t.flush();
+    read(t, 16, 48);
+    t.write(16, "b");
+    EXPECT_EQ(t.cached_pages(), 4ul);
+
+    // dirty pages are kept
+    EXPECT_EQ(t.shrink(4), 3ul);
+    EXPECT_EQ(t.cached_pages(), 1ul);
+
+    read(t, 0, 64);
+    EXPECT_EQ(t.cached_pages(), 4ul);
+
+    // half of the pages are dropped on the next access after pressure
+    h5s3::memory::signal_pressure();
+    read(t, 16, 1);
+    EXPECT_EQ(t.cached_pages(), 2ul);
+    EXPECT_EQ(read(t, 0, 17), std::string(16, 'a') + "b");
+}
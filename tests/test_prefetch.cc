@@ -0,0 +1,97 @@
+#include <experimental/filesystem>
+#include <string>
+
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "hdf5.h"
+
+#include "h5s3/kv_driver.h"
+
+namespace fs = std::experimental::filesystem;
+using h5s3::driver::detail::selected_extents;
+
+class PrefetchTest : public ::testing::Test {
+protected:
+    std::string path;
+    hid_t file;
+
+    PrefetchTest()
+        : path(fs::temp_directory_path() /
+               ("h5s3-prefetch-" + std::to_string(getpid()) + ".h5")),
+          file(H5Fcreate(path.data(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT)) {}
+
+    ~PrefetchTest() {
+        H5Fclose(file);
+        fs::remove(path);
+    }
+
+    /** Create a 64x64 dataset of ints, chunked if `chunk` is non-zero.
+     */
+    hid_t create_dataset(const char* name, hsize_t chunk) {
+        hsize_t dims[] = {64, 64};
+        hid_t space = H5Screate_simple(2, dims, nullptr);
+        hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+        if (chunk) {
+            hsize_t chunks[] = {chunk, chunk};
+            H5Pset_chunk(dcpl, 2, chunks);
+        }
+        H5Pset_alloc_time(dcpl, H5D_ALLOC_TIME_EARLY);
+        hid_t dataset = H5Dcreate2(
+            file, name, H5T_NATIVE_INT, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+        H5Pclose(dcpl);
+        H5Sclose(space);
+        return dataset;
+    }
+};
+
+TEST_F(PrefetchTest, chunked) {
+    hid_t dataset = create_dataset("chunked", 16);
+    ASSERT_GE(dataset, 0);
+
+    auto all = selected_extents(dataset, H5S_ALL, 1000);
+    EXPECT_EQ(all.size(), 16ul);
+    for (const auto& [addr, size] : all) {
+        EXPECT_NE(addr, HADDR_UNDEF);
+        EXPECT_EQ(size, 16ul * 16 * sizeof(int));
+    }
+
+    // rows 0 and 32, columns 20 through 39: chunk rows 0 and 2, chunk
+    // columns 1 and 2
+    hid_t space = H5Dget_space(dataset);
+    hsize_t start[] = {0, 20};
+    hsize_t stride[] = {32, 1};
+    hsize_t count[] = {2, 20};
+    H5Sselect_hyperslab(space, H5S_SELECT_SET, start, stride, count, nullptr);
+    auto selected = selected_extents(dataset, space, 1000);
+#if H5_VERSION_GE(1, 10, 7)
+    EXPECT_EQ(selected.size(), 4ul);
+#else
+    // without H5Sselect_intersect_block, every chunk in the bounding box
+    EXPECT_EQ(selected.size(), 6ul);
+#endif
+
+    EXPECT_EQ(selected_extents(dataset, space, 2).size(), 2ul);
+
+    H5Sclose(space);
+    H5Dclose(dataset);
+}
+
+TEST_F(PrefetchTest, contiguous) {
+    hid_t dataset = create_dataset("contiguous", 0);
+    ASSERT_GE(dataset, 0);
+    haddr_t base = H5Dget_offset(dataset);
+
+    // row 2, columns 3 through 5
+    hid_t space = H5Dget_space(dataset);
+    hsize_t start[] = {2, 3};
+    hsize_t count[] = {1, 3};
+    H5Sselect_hyperslab(space, H5S_SELECT_SET, start, nullptr, count, nullptr);
+    auto selected = selected_extents(dataset, space, 1000);
+    ASSERT_EQ(selected.size(), 1ul);
+    EXPECT_EQ(selected[0].first, base + (2 * 64 + 3) * sizeof(int));
+    EXPECT_EQ(selected[0].second, 3 * sizeof(int));
+
+    H5Sclose(space);
+    H5Dclose(dataset);
+}
@@ -288,3 +288,375 @@ PYTHON_TEST(simple_group, R"(
 
     np.testing.assert_array_equal(group['lmao'][:], data)
 )")
+
+PYTHON_TEST(stats, R"(
+    import h5py
+    import numpy as np
+
+    import h5s3
+
+    h5s3.register()
+
+    file = h5py.File(
+        's3://{bucket}/{test_name}'.format(bucket=bucket, test_name=test_name),
+        'w',
+        driver='h5s3',
+        aws_access_key=access_key,
+        aws_secret_key=secret_key,
+        aws_region=region,
+        host=address,
+        use_tls=False,
+    )
+
+    file['dataset'] = np.arange(15)
+    file.flush()
+
+    stats = h5s3.stats(file)
+    assert stats['misses'] > 0, stats
+    assert stats['puts'] > 0, stats
+    assert stats['bytes_written'] > 0, stats
+    assert stats['put_latency']['count'] == stats['puts'], stats
+
+    # reading the data back is served from the page cache
+    misses = stats['misses']
+    np.testing.assert_array_equal(file['dataset'][:], np.arange(15))
+    stats = h5s3.stats(file)
+    assert stats['misses'] == misses, stats
+    assert stats['hits'] > 0, stats
+)")
+
+PYTHON_TEST(pages_per_object, R"(
+    import h5py
+    import numpy as np
+
+    import h5s3
+
+    h5s3.register()
+
+    path = 's3://{bucket}/{test_name}'.format(bucket=bucket, test_name=test_name)
+    kwargs = dict(
+        driver='h5s3',
+        aws_access_key=access_key,
+        aws_secret_key=secret_key,
+        aws_region=region,
+        host=address,
+        use_tls=False,
+        page_size=4096,
+    )
+
+    data = np.arange(100000)
+    with h5py.File(path, 'w', pages_per_object=8, **kwargs) as file:
+        file['dataset'] = data
+
+    # the layout is read back from the file
+    with h5py.File(path, 'r', **kwargs) as file:
+        np.testing.assert_array_equal(file['dataset'][:], data)
+
+        # adjacent pages are read with a single request
+        stats = h5s3.stats(file)
+        assert stats['gets'] < stats['misses'], stats
+)")
+
+PYTHON_TEST(key_prefixes, R"(
+    import h5py
+    import numpy as np
+
+    import h5s3
+
+    h5s3.register()
+
+    path = 's3://{bucket}/{test_name}'.format(bucket=bucket, test_name=test_name)
+    kwargs = dict(
+        driver='h5s3',
+        aws_access_key=access_key,
+        aws_secret_key=secret_key,
+        aws_region=region,
+        host=address,
+        use_tls=False,
+        page_size=4096,
+    )
+
+    data = np.arange(100000)
+    with h5py.File(path, 'w', key_prefixes=16, buckets=[bucket], **kwargs) as file:
+        file['dataset'] = data
+
+    # the key scheme is read back from the file
+    with h5py.File(path, 'r', **kwargs) as file:
+        np.testing.assert_array_equal(file['dataset'][:], data)
+
+    # a different key scheme cannot be used to open the file
+    try:
+        h5py.File(path, 'r', key_prefixes=4, **kwargs)
+    except OSError:
+        pass
+    else:
+        raise AssertionError('opened a file with the wrong key prefixes')
+)")
+
+PYTHON_TEST(content_addressed, R"(
+    import h5py
+    import numpy as np
+
+    import h5s3
+
+    h5s3.register()
+
+    kwargs = dict(
+        driver='h5s3',
+        aws_access_key=access_key,
+        aws_secret_key=secret_key,
+        aws_region=region,
+        host=address,
+        use_tls=False,
+        page_size=4096,
+    )
+
+    data = np.arange(100000)
+    paths = [
+        's3://{bucket}/{test_name}-{ix}'.format(
+            bucket=bucket,
+            test_name=test_name,
+            ix=ix,
+        )
+        for ix in range(2)
+    ]
+    for path in paths:
+        with h5py.File(path, 'w', content_addressed=True, **kwargs) as file:
+            file['dataset'] = data
+
+    # the layout is read back from the file
+    for path in paths:
+        with h5py.File(path, 'r', **kwargs) as file:
+            np.testing.assert_array_equal(file['dataset'][:], data)
+)")
+
+PYTHON_TEST(log_structured, R"(
+    import h5py
+    import numpy as np
+
+    import h5s3
+
+    h5s3.register()
+
+    path = 's3://{bucket}/{test_name}'.format(bucket=bucket, test_name=test_name)
+    kwargs = dict(
+        driver='h5s3',
+        aws_access_key=access_key,
+        aws_secret_key=secret_key,
+        aws_region=region,
+        host=address,
+        use_tls=False,
+        page_size=4096,
+    )
+
+    data = np.arange(100000)
+    with h5py.File(path, 'w', log_structured=True, **kwargs) as file:
+        file['dataset'] = data
+
+    # small updates are read back through the log
+    for ix in range(5):
+        with h5py.File(path, 'a', **kwargs) as file:
+            file['dataset'][ix * 1000] = -ix
+            data[ix * 1000] = -ix
+
+    with h5py.File(path, 'r', **kwargs) as file:
+        np.testing.assert_array_equal(file['dataset'][:], data)
+)")
+
+PYTHON_TEST(prefetch, R"(
+    import h5py
+    import numpy as np
+
+    import h5s3
+
+    h5s3.register()
+
+    path = 's3://{bucket}/{test_name}'.format(bucket=bucket, test_name=test_name)
+    kwargs = dict(
+        driver='h5s3',
+        aws_access_key=access_key,
+        aws_secret_key=secret_key,
+        aws_region=region,
+        host=address,
+        use_tls=False,
+        page_size=4096,
+    )
+
+    data = np.arange(256 * 256).reshape(256, 256)
+    with h5py.File(path, 'w', **kwargs) as file:
+        file.create_dataset('dataset', data=data, chunks=(16, 16))
+
+    with h5py.File(path, 'r', **kwargs) as file:
+        dataset = file['dataset']
+        selection = np.s_[::64, 100:200]
+
+        loaded = h5s3.prefetch(dataset, selection)
+        assert loaded > 0, loaded
+        stats = h5s3.stats(file)
+        assert stats['prefetches'] == loaded, stats
+
+        # the selection is now served from the cache
+        misses = stats['misses']
+        np.testing.assert_array_equal(dataset[selection], data[selection])
+        stats = h5s3.stats(file)
+        assert stats['misses'] == misses, stats
+
+        # prefetching again loads nothing new
+        assert h5s3.prefetch(dataset, selection) == 0
+)")
+
+PYTHON_TEST(warm_start, R"(
+    import h5py
+    import numpy as np
+
+    import h5s3
+
+    h5s3.register()
+
+    path = 's3://{bucket}/{test_name}'.format(bucket=bucket, test_name=test_name)
+    kwargs = dict(
+        driver='h5s3',
+        aws_access_key=access_key,
+        aws_secret_key=secret_key,
+        aws_region=region,
+        host=address,
+        use_tls=False,
+        page_size=4096,
+    )
+
+    with h5py.File(path, 'w', **kwargs) as file:
+        for n in range(10):
+            file.create_group('group-%d' % n).attrs['n'] = n
+
+    # the metadata pages used while writing are fetched when the file opens
+    with h5py.File(path, 'r', **kwargs) as file:
+        stats = h5s3.stats(file)
+        assert stats['prefetches'] > 0, stats
+        assert file['group-3'].attrs['n'] == 3
+)")
+
+PYTHON_TEST(refresh, R"(
+    import h5py
+    import numpy as np
+
+    import h5s3
+
+    h5s3.register()
+
+    path = 's3://{bucket}/{test_name}'.format(bucket=bucket, test_name=test_name)
+    kwargs = dict(
+        driver='h5s3',
+        aws_access_key=access_key,
+        aws_secret_key=secret_key,
+        aws_region=region,
+        host=address,
+        use_tls=False,
+        page_size=4096,
+    )
+
+    data = np.arange(100000)
+    with h5py.File(path, 'w', **kwargs) as file:
+        file['dataset'] = data
+
+    with h5py.File(path, 'r', **kwargs) as reader:
+        np.testing.assert_array_equal(reader['dataset'][:], data)
+
+        # another writer changes a small part of the dataset
+        with h5py.File(path, 'r+', **kwargs) as writer:
+            writer['dataset'][:10] = -1
+        data[:10] = -1
+
+        reloaded = h5s3.refresh(reader)
+        assert reloaded > 0, reloaded
+
+        # the unchanged pages are not read again
+        stats = h5s3.stats(reader)
+        assert stats['not_modified'] > reloaded, stats
+
+        reader['dataset'].refresh()
+        np.testing.assert_array_equal(reader['dataset'][:], data)
+)")
+
+PYTHON_TEST(page_cache_bytes, R"(
+    import h5py
+    import numpy as np
+
+    import h5s3
+
+    h5s3.register()
+
+    path = 's3://{bucket}/{test_name}'.format(bucket=bucket, test_name=test_name)
+    kwargs = dict(
+        driver='h5s3',
+        aws_access_key=access_key,
+        aws_secret_key=secret_key,
+        aws_region=region,
+        host=address,
+        use_tls=False,
+        page_size=4096,
+    )
+
+    data = np.arange(100000)
+    with h5py.File(path, 'w', **kwargs) as file:
+        file['dataset'] = data
+
+    # a budget of 4 pages evicts while reading the dataset
+    with h5py.File(path, 'r', page_cache_bytes=4 * 4096, **kwargs) as file:
+        np.testing.assert_array_equal(file['dataset'][:], data)
+        assert h5s3.stats(file)['evictions'] > 0
+
+        # after growing the cache, a second read is served from memory
+        h5s3.resize_cache(file, 1 << 20)
+        file['dataset'][:]
+        before = h5s3.stats(file)
+        np.testing.assert_array_equal(file['dataset'][:], data)
+        after = h5s3.stats(file)
+        assert after['misses'] == before['misses'], (before, after)
+)")
+
+PYTHON_TEST(shared_cache, R"(
+    import h5py
+    import numpy as np
+
+    import h5s3
+
+    h5s3.register()
+
+    path = 's3://{bucket}/{test_name}'.format(bucket=bucket, test_name=test_name)
+    kwargs = dict(
+        driver='h5s3',
+        aws_access_key=access_key,
+        aws_secret_key=secret_key,
+        aws_region=region,
+        host=address,
+        use_tls=False,
+        page_size=4096,
+    )
+
+    data = np.arange(100000)
+    with h5py.File(path, 'w', **kwargs) as file:
+        file['dataset'] = data
+    with h5py.File(path + '-other', 'w', **kwargs) as file:
+        file['dataset'] = data
+
+    budget = 64 * 4096
+    h5s3.set_shared_cache_bytes(budget)
+    try:
+        with h5py.File(path, 'r', **kwargs) as a, h5py.File(path, 'r', **kwargs) as b:
+            np.testing.assert_array_equal(a['dataset'][:], data)
+
+            # both readers share one page table, so the pages are already
+            # cached for the second
+            before = h5s3.stats(b)
+            np.testing.assert_array_equal(b['dataset'][:], data)
+            after = h5s3.stats(b)
+            assert after['misses'] == before['misses'], (before, after)
+
+            # reading another file evicts from the first to stay in budget
+            with h5py.File(path + '-other', 'r', **kwargs) as other:
+                np.testing.assert_array_equal(other['dataset'][:], data)
+                assert h5s3.shared_cache_bytes() <= budget, h5s3.shared_cache_bytes()
+                assert h5s3.stats(a)['evictions'] > 0
+    finally:
+        h5s3.set_shared_cache_bytes(0)
+)")
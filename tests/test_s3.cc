@@ -3,6 +3,7 @@
 #include "gtest/gtest.h"
 
 #include "h5s3/private/curl.h"
+#include "h5s3/private/s3_driver.h"
 #include "h5s3/s3.h"
 #include "minio.h"
 
@@ -125,3 +126,395 @@ TEST_F(S3Test, get_nonexistent) {
         { s3::get_object(notary, MINIO->bucket(), key, MINIO->address(), false); },
         h5s3::curl::http_error);
 }
+
+TEST_F(S3Test, get_range) {
+    std::string content;
+    for (int ix = 0; ix < 1024; ++ix) {
+        content.push_back('a' + ix % 26);
+    }
+
+    auto key = "get_range";
+    s3::set_object(notary, MINIO->bucket(), key, content, MINIO->address(), false);
+
+    std::array<char, 100> outbuf_memory = {0};
+    h5s3::utils::out_buffer outbuf(outbuf_memory.data(), outbuf_memory.size());
+
+    std::size_t bytes_read = s3::get_object_range(
+        outbuf, 500, notary, MINIO->bucket(), key, MINIO->address(), false);
+    ASSERT_EQ(bytes_read, outbuf_memory.size());
+    EXPECT_EQ(std::string_view(outbuf_memory.data(), outbuf_memory.size()),
+              std::string_view(content).substr(500, 100));
+}
+
+TEST_F(S3Test, get_if_changed) {
+    std::string content(100, 'a');
+    auto key = "get_if_changed";
+    s3::set_object(notary, MINIO->bucket(), key, content, MINIO->address(), false);
+
+    std::array<char, 100> outbuf_memory = {0};
+    h5s3::utils::out_buffer outbuf(outbuf_memory.data(), outbuf_memory.size());
+
+    // an empty tag reads unconditionally and returns the object's tag
+    std::string etag;
+    auto bytes_read = s3::get_object(
+        outbuf, etag, notary, MINIO->bucket(), key, MINIO->address(), false);
+    ASSERT_TRUE(bytes_read);
+    EXPECT_EQ(*bytes_read, content.size());
+    ASSERT_FALSE(etag.empty());
+
+    // the object has not changed
+    std::string unchanged_etag = etag;
+    EXPECT_FALSE(s3::get_object(
+        outbuf, etag, notary, MINIO->bucket(), key, MINIO->address(), false));
+    EXPECT_FALSE(s3::get_object_range(
+        outbuf, 0, etag, notary, MINIO->bucket(), key, MINIO->address(), false));
+    EXPECT_EQ(etag, unchanged_etag);
+
+    content.assign(100, 'b');
+    s3::set_object(notary, MINIO->bucket(), key, content, MINIO->address(), false);
+    bytes_read = s3::get_object_range(
+        outbuf, 0, etag, notary, MINIO->bucket(), key, MINIO->address(), false);
+    ASSERT_TRUE(bytes_read);
+    EXPECT_EQ(std::string_view(outbuf_memory.data(), outbuf_memory.size()), content);
+    EXPECT_NE(etag, unchanged_etag);
+}
+
+TEST_F(S3Test, copy_object) {
+    s3::set_object(
+        notary, MINIO->bucket(), "copy/source", "content", MINIO->address(), false);
+    s3::copy_object(notary,
+                    MINIO->bucket(),
+                    "copy/source",
+                    MINIO->bucket(),
+                    "copy/dest",
+                    MINIO->address(),
+                    false);
+    EXPECT_EQ(
+        s3::get_object(notary, MINIO->bucket(), "copy/dest", MINIO->address(), false),
+        "content");
+
+    try {
+        s3::copy_object(notary,
+                        MINIO->bucket(),
+                        "copy/nonexistent",
+                        MINIO->bucket(),
+                        "copy/dest",
+                        MINIO->address(),
+                        false);
+        FAIL() << "copied a nonexistent object";
+    }
+    catch (const h5s3::curl::http_error& e) {
+        EXPECT_EQ(e.code, 404);
+    }
+}
+
+TEST_F(S3Test, import_export) {
+    using h5s3::s3_driver::s3_kv_store;
+    auto open = [&] {
+        return s3_kv_store::from_params("s3://" + MINIO->bucket() + "/import_export",
+                                        0,
+                                        64,
+                                        MINIO->access_key().data(),
+                                        MINIO->secret_key().data(),
+                                        MINIO->region().data(),
+                                        MINIO->address().data(),
+                                        false,
+                                        2,
+                                        0,
+                                        static_cast<const char*>(nullptr),
+                                        static_cast<const char*>(nullptr),
+                                        false,
+                                        false);
+    };
+
+    // 5 and a half pages in 3 objects, the second of which is all zeros
+    std::string content(64 * 5 + 32, '\0');
+    for (std::size_t ix = 0; ix < content.size(); ++ix) {
+        if (ix < 128 || ix >= 256) {
+            content[ix] = 'a' + ix % 26;
+        }
+    }
+
+    {
+        s3_kv_store store = open();
+        EXPECT_EQ(store.import_file(content, 4), 2ul);
+        // two objects and the .meta
+        EXPECT_EQ(store.stats().puts.load(), 3ul);
+    }
+
+    s3_kv_store store = open();
+    ASSERT_EQ(store.allocated_pages(), 6ul);
+    std::string out(store.allocated_pages() * store.page_size(), 'x');
+    store.export_file(h5s3::utils::out_buffer(out.data(), out.size()), 4);
+
+    // the zero pages are not read, so they keep what was in the buffer
+    EXPECT_EQ(store.stats().gets.load(), 3ul);
+    EXPECT_EQ(out.substr(0, 128), content.substr(0, 128));
+    EXPECT_EQ(out.substr(128, 128), std::string(128, 'x'));
+    EXPECT_EQ(out.substr(256, content.size() - 256), content.substr(256));
+    EXPECT_EQ(out.substr(content.size()), std::string(32, '\0'));
+}
+
+TEST_F(S3Test, import_sparse) {
+    using h5s3::s3_driver::s3_kv_store;
+    auto open = [&] {
+        return s3_kv_store::from_params("s3://" + MINIO->bucket() + "/import_sparse",
+                                        0,
+                                        64,
+                                        MINIO->access_key().data(),
+                                        MINIO->secret_key().data(),
+                                        MINIO->region().data(),
+                                        MINIO->address().data(),
+                                        false,
+                                        1,
+                                        0,
+                                        static_cast<const char*>(nullptr),
+                                        static_cast<const char*>(nullptr),
+                                        false,
+                                        false);
+    };
+
+    // every page but the first and last is zeros, so the .meta lists tens of
+    // thousands of invalid pages
+    constexpr std::size_t pages = 50000;
+    std::string content(64 * pages, '\0');
+    std::fill(content.begin(), content.begin() + 64, 'a');
+    std::fill(content.end() - 64, content.end(), 'b');
+    {
+        s3_kv_store store = open();
+        EXPECT_EQ(store.import_file(content, 16), 2ul);
+    }
+
+    s3_kv_store store = open();
+    ASSERT_EQ(store.allocated_pages(), pages);
+    std::string out(content.size(), '\0');
+    store.export_file(h5s3::utils::out_buffer(out.data(), out.size()), 16);
+    EXPECT_EQ(out, content);
+    EXPECT_EQ(store.stats().gets.load(), 3ul);
+}
+
+TEST_F(S3Test, clone) {
+    using h5s3::s3_driver::s3_kv_store;
+    auto open = [&](const std::string& path, std::size_t key_prefixes) {
+        return s3_kv_store::from_params("s3://" + MINIO->bucket() + "/" + path,
+                                        0,
+                                        64,
+                                        MINIO->access_key().data(),
+                                        MINIO->secret_key().data(),
+                                        MINIO->region().data(),
+                                        MINIO->address().data(),
+                                        false,
+                                        1,
+                                        key_prefixes,
+                                        static_cast<const char*>(nullptr),
+                                        static_cast<const char*>(nullptr),
+                                        false,
+                                        false);
+    };
+
+    std::string content(64 * 4, 'a');
+    std::fill(content.begin() + 64, content.begin() + 128, '\0');
+    {
+        s3_kv_store store = open("clone_source", 4);
+        store.import_file(content, 4);
+        // the zero page is not copied
+        EXPECT_EQ(store.clone(MINIO->bucket(), "clone_dest", 4), 3ul);
+        EXPECT_EQ(store.stats().bytes_read.load(), 0ul);
+    }
+
+    // the copy keeps the key scheme of the source
+    s3_kv_store copy = open("clone_dest", 0);
+    EXPECT_EQ(copy.key_prefixes(), 4ul);
+    std::string out(content.size(), '\0');
+    copy.export_file(h5s3::utils::out_buffer(out.data(), out.size()), 4);
+    EXPECT_EQ(out, content);
+}
+
+TEST_F(S3Test, content_addressed) {
+    using h5s3::s3_driver::s3_kv_store;
+    auto open = [&](const std::string& path, bool content_addressed) {
+        return s3_kv_store::from_params("s3://" + MINIO->bucket() + "/" + path,
+                                        0,
+                                        64,
+                                        MINIO->access_key().data(),
+                                        MINIO->secret_key().data(),
+                                        MINIO->region().data(),
+                                        MINIO->address().data(),
+                                        false,
+                                        2,
+                                        0,
+                                        static_cast<const char*>(nullptr),
+                                        static_cast<const char*>(nullptr),
+                                        content_addressed,
+                                        false);
+    };
+
+    std::string content(64 * 6, '\0');
+    for (std::size_t ix = 0; ix < content.size(); ++ix) {
+        content[ix] = 'a' + ix % 26;
+    }
+    {
+        s3_kv_store store = open("cas_a", true);
+        store.import_file(content, 4);
+        // three objects and the .meta
+        EXPECT_EQ(store.stats().puts.load(), 4ul);
+    }
+
+    // a file with the same contents only writes its .meta
+    {
+        s3_kv_store store = open("cas_b", true);
+        store.import_file(content, 4);
+        EXPECT_EQ(store.stats().puts.load(), 1ul);
+
+        // so does a clone, which shares the objects
+        EXPECT_EQ(store.clone(MINIO->bucket(), "cas_c", 4), 0ul);
+        EXPECT_EQ(store.stats().puts.load(), 2ul);
+    }
+
+    // the layout is read back from .meta, and writes only change the object
+    // they write to
+    s3_kv_store store = open("cas_c", false);
+    EXPECT_TRUE(store.content_addressed());
+    std::string page(64, 'z');
+    store.write(3, page);
+    store.flush();
+
+    for (const char* path : {"cas_a", "cas_c"}) {
+        s3_kv_store reader = open(path, false);
+        std::string out(content.size(), '\0');
+        reader.export_file(h5s3::utils::out_buffer(out.data(), out.size()), 4);
+        std::string expected = content;
+        if (path == std::string("cas_c")) {
+            expected.replace(3 * 64, 64, page);
+        }
+        EXPECT_EQ(out, expected) << path;
+    }
+
+    // a file which is not content-addressed cannot be opened as one
+    open("cas_plain", false).import_file(content, 4);
+    EXPECT_THROW(open("cas_plain", true), std::runtime_error);
+}
+
+TEST_F(S3Test, log_structured) {
+    using h5s3::s3_driver::s3_kv_store;
+    auto open = [&](bool log_structured) {
+        return s3_kv_store::from_params("s3://" + MINIO->bucket() + "/log_structured",
+                                        0,
+                                        64,
+                                        MINIO->access_key().data(),
+                                        MINIO->secret_key().data(),
+                                        MINIO->region().data(),
+                                        MINIO->address().data(),
+                                        false,
+                                        2,
+                                        0,
+                                        static_cast<const char*>(nullptr),
+                                        static_cast<const char*>(nullptr),
+                                        false,
+                                        log_structured);
+    };
+    auto read = [&](const s3_kv_store& store) {
+        std::string out(store.allocated_pages() * 64, '\0');
+        for (h5s3::page::id page_id = 0; page_id < store.allocated_pages(); ++page_id) {
+            h5s3::utils::out_buffer page(out.data() + page_id * 64, 64);
+            store.read(page_id, page);
+        }
+        return out;
+    };
+
+    std::string expected(64 * 4, 'a');
+    s3_kv_store store = open(true);
+    for (h5s3::page::id page_id = 0; page_id < 4; ++page_id) {
+        store.write(page_id, std::string_view(expected).substr(page_id * 64, 64));
+    }
+    store.flush();
+    // one segment and the .meta
+    EXPECT_EQ(store.stats().puts.load(), 2ul);
+
+    // only the changed bytes are appended to the log
+    for (h5s3::page::id page_id : {0, 3}) {
+        expected.replace(page_id * 64 + 10, 5, "bbbbb");
+        store.write(page_id,
+                    std::string_view(expected).substr(page_id * 64, 64),
+                    10,
+                    15);
+    }
+    store.flush();
+    EXPECT_EQ(store.stats().puts.load(), 4ul);
+    EXPECT_EQ(store.log_entries(), 6ul);
+
+    {
+        s3_kv_store reader = open(false);
+        EXPECT_TRUE(reader.log_structured());
+        EXPECT_EQ(reader.log_entries(), 6ul);
+        EXPECT_EQ(read(reader), expected);
+    }
+
+    // compacting rewrites both objects and empties the log
+    EXPECT_EQ(store.compact(4), 2ul);
+    EXPECT_EQ(store.log_entries(), 0ul);
+    s3_kv_store reader = open(false);
+    EXPECT_EQ(reader.log_entries(), 0ul);
+    EXPECT_EQ(read(reader), expected);
+}
+
+TEST_F(S3Test, log_structured_many_entries) {
+    using h5s3::s3_driver::s3_kv_store;
+    auto open = [&](bool log_structured) {
+        return s3_kv_store::from_params("s3://" + MINIO->bucket() + "/log_many",
+                                        0,
+                                        64,
+                                        MINIO->access_key().data(),
+                                        MINIO->secret_key().data(),
+                                        MINIO->region().data(),
+                                        MINIO->address().data(),
+                                        false,
+                                        4,
+                                        0,
+                                        static_cast<const char*>(nullptr),
+                                        static_cast<const char*>(nullptr),
+                                        false,
+                                        log_structured);
+    };
+
+    std::string expected(64 * 4, 'a');
+    s3_kv_store store = open(true);
+    for (h5s3::page::id page_id = 0; page_id < 4; ++page_id) {
+        store.write(page_id, std::string_view(expected).substr(page_id * 64, 64));
+    }
+    store.flush();
+    // every flush changes one byte of each page, so each page has a range in
+    // every segment, next to the other pages' ranges
+    std::size_t flushes = 32;
+    for (std::size_t ix = 0; ix < flushes; ++ix) {
+        for (h5s3::page::id page_id = 0; page_id < 4; ++page_id) {
+            expected[page_id * 64 + ix] = 'b';
+            store.write(page_id,
+                        std::string_view(expected).substr(page_id * 64, 64),
+                        ix,
+                        ix + 1);
+        }
+        store.flush();
+    }
+    EXPECT_EQ(store.log_entries(), 4 * (flushes + 1));
+
+    {
+        s3_kv_store reader = open(false);
+        std::string out(64, '\0');
+        h5s3::utils::out_buffer page(out.data(), out.size());
+        std::size_t gets = reader.stats().gets.load();
+        reader.read(2, page);
+        EXPECT_EQ(out, expected.substr(2 * 64, 64));
+        // one GET for each segment, and not the page's object
+        EXPECT_EQ(reader.stats().gets.load() - gets, flushes + 1);
+    }
+
+    // folding reads the four pages' ranges in a segment with one GET
+    std::size_t gets = store.stats().gets.load();
+    EXPECT_EQ(store.compact(4), 1ul);
+    EXPECT_EQ(store.stats().gets.load() - gets, flushes + 1);
+    s3_kv_store reader = open(false);
+    std::string out(64 * 4, '\0');
+    reader.export_file(h5s3::utils::out_buffer(out.data(), out.size()), 4);
+    EXPECT_EQ(out, expected);
+}
@@ -0,0 +1,71 @@
+#include "gtest/gtest.h"
+
+#include "h5s3/private/stats.h"
+
+namespace stats = h5s3::stats;
+
+TEST(stats, counter) {
+    stats::counter c;
+    EXPECT_EQ(c.load(), 0ul);
+
+    c.add();
+    c.add(41);
+    EXPECT_EQ(c.load(), 42ul);
+
+    stats::counter copy(c);
+    EXPECT_EQ(copy.load(), 42ul);
+}
+
+TEST(stats, histogram_buckets) {
+    using histogram = stats::histogram;
+
+    // small values get their own bucket
+    for (std::uint64_t value = 0; value < histogram::sub_buckets; ++value) {
+        EXPECT_EQ(histogram::bucket_lower_bound(histogram::bucket_index(value)), value);
+    }
+
+    // every value falls into a bucket whose lower bound is within 1 /
+    // sub_buckets of the value
+    for (std::uint64_t value : {8ul, 9ul, 17ul, 1000ul, 123456789ul, 1ul << 39}) {
+        std::uint64_t lower = histogram::bucket_lower_bound(histogram::bucket_index(value));
+        EXPECT_LE(lower, value);
+        EXPECT_GE(lower, value - value / histogram::sub_buckets);
+    }
+
+    // the bucket lower bounds are strictly increasing
+    for (std::size_t ix = 1; ix < histogram::bucket_count; ++ix) {
+        EXPECT_LT(histogram::bucket_lower_bound(ix - 1), histogram::bucket_lower_bound(ix));
+    }
+
+    // huge values are clamped into the last bucket
+    EXPECT_EQ(histogram::bucket_index(~0ul), histogram::bucket_count - 1);
+}
+
+TEST(stats, histogram_percentile) {
+    stats::histogram h;
+    EXPECT_EQ(h.load().percentile(0.5), 0ul);
+
+    for (std::uint64_t value = 1; value <= 100; ++value) {
+        h.record(value * 1000);
+    }
+
+    auto snapshot = h.load();
+    EXPECT_EQ(snapshot.count(), 100ul);
+    EXPECT_EQ(snapshot.sum(), 5050ul * 1000);
+
+    auto within = [](std::uint64_t actual, std::uint64_t expected) {
+        return actual <= expected &&
+               actual >= expected - expected / stats::histogram::sub_buckets;
+    };
+    EXPECT_PRED2(within, snapshot.percentile(0.5), 50000ul);
+    EXPECT_PRED2(within, snapshot.percentile(0.99), 99000ul);
+    EXPECT_PRED2(within, snapshot.percentile(1), 100000ul);
+    EXPECT_PRED2(within, snapshot.percentile(0), 1000ul);
+
+    std::uint64_t total = 0;
+    for (auto [lower, count] : snapshot.buckets()) {
+        EXPECT_GT(count, 0ul);
+        total += count;
+    }
+    EXPECT_EQ(total, 100ul);
+}
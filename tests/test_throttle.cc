@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "h5s3/private/curl.h"
+#include "h5s3/private/throttle.h"
+
+#include "http_server.h"
+
+using h5s3::io::priority;
+using h5s3::testing::http_server;
+namespace curl = h5s3::curl;
+namespace throttle = h5s3::throttle;
+using namespace std::chrono_literals;
+
+namespace {
+throttle::outcome response(long status, std::chrono::microseconds first_byte) {
+    return throttle::outcome{status, first_byte, 0};
+}
+}  // namespace
+
+TEST(throttle, slow_start) {
+    throttle::aimd limit(4, 1, 64, 0);
+    auto now = throttle::clock::now();
+    for (int ix = 0; ix < 4; ++ix) {
+        limit.update(response(200, 10ms), now);
+    }
+    EXPECT_EQ(limit.limit(), 8ul);
+
+    // the limit never passes the max
+    for (int ix = 0; ix < 100; ++ix) {
+        limit.update(response(200, 10ms), now);
+    }
+    EXPECT_EQ(limit.limit(), 64ul);
+}
+
+TEST(throttle, throttled_halves) {
+    throttle::aimd limit(32, 1, 64, 0);
+    auto now = throttle::clock::now();
+    limit.update(response(200, 10ms), now);
+    limit.update(response(503, 10ms), now);
+    EXPECT_EQ(limit.limit(), 16ul);
+
+    // the other requests which were in flight are ignored for a round trip
+    limit.update(response(429, 10ms), now + 1ms);
+    limit.update(response(503, 10ms), now + 2ms);
+    EXPECT_EQ(limit.limit(), 16ul);
+
+    limit.update(response(503, 10ms), now + 20ms);
+    EXPECT_EQ(limit.limit(), 8ul);
+
+    // after a cut the limit grows by about one per round trip
+    for (int ix = 0; ix < 8; ++ix) {
+        limit.update(response(200, 10ms), now + 40ms);
+    }
+    EXPECT_EQ(limit.limit(), 9ul);
+
+    // nor does it drop below the min
+    for (int ix = 0; ix < 10; ++ix) {
+        limit.update(response(503, 10ms), now + std::chrono::seconds(ix + 1));
+    }
+    EXPECT_EQ(limit.limit(), 1ul);
+}
+
+TEST(throttle, failures_ignored) {
+    throttle::aimd limit(8, 1, 64, 2.0);
+    limit.update(throttle::outcome{});
+    limit.update(throttle::outcome{0, 10ms, 0});
+    EXPECT_EQ(limit.limit(), 8ul);
+}
+
+TEST(throttle, latency) {
+    throttle::aimd limit(10, 1, 64, 2.0);
+    auto now = throttle::clock::now();
+    for (int ix = 0; ix < 10; ++ix) {
+        limit.update(response(200, 2ms), now);
+    }
+    EXPECT_EQ(limit.limit(), 20ul);
+
+    // latency within the tolerance grows the limit
+    limit.update(response(200, 3ms), now);
+    EXPECT_EQ(limit.limit(), 21ul);
+
+    // once the smoothed latency passes twice the baseline, the limit is cut
+    // once per round trip
+    for (int ix = 0; ix < 20; ++ix) {
+        limit.update(response(200, 20ms), now);
+    }
+    EXPECT_EQ(limit.limit(), 18ul);
+}
+
+TEST(throttle, request_rate) {
+    throttle::token_bucket bucket(10, 0);
+    auto now = throttle::clock::now();
+    for (int ix = 0; ix < 10; ++ix) {
+        EXPECT_FALSE(bucket.try_take(now));
+    }
+    auto retry_at = bucket.try_take(now);
+    ASSERT_TRUE(retry_at);
+    EXPECT_NEAR(std::chrono::duration<double>(*retry_at - now).count(), 0.1, 1e-3);
+    EXPECT_FALSE(bucket.try_take(*retry_at + 1ms));
+    EXPECT_TRUE(bucket.try_take(*retry_at + 1ms));
+}
+
+TEST(throttle, byte_debt) {
+    throttle::token_bucket bucket(0, 1000);
+    auto now = throttle::clock::now();
+    EXPECT_FALSE(bucket.try_take(now));
+    bucket.charge(3000, now);
+
+    // the debt of 2000 bytes takes two seconds to pay off
+    auto retry_at = bucket.try_take(now);
+    ASSERT_TRUE(retry_at);
+    EXPECT_NEAR(std::chrono::duration<double>(*retry_at - now).count(), 2.0, 1e-3);
+    EXPECT_FALSE(bucket.try_take(*retry_at + 1ms));
+}
+
+TEST(throttle, limiter_concurrency) {
+    throttle::limiter::options opts;
+    opts.adaptive = false;
+    opts.max_concurrency = 2;
+    throttle::limiter limiter(opts);
+
+    std::atomic<int> released = 0;
+    std::size_t id = limiter.watch([&] { ++released; });
+
+    auto never = throttle::clock::time_point::max();
+    auto retry_at = never;
+    auto a = limiter.try_acquire("host", retry_at);
+    auto b = limiter.try_acquire("host", retry_at);
+    ASSERT_TRUE(a && b);
+    EXPECT_EQ(limiter.in_flight("host"), 2ul);
+    EXPECT_FALSE(limiter.try_acquire("host", retry_at));
+    // requests held back by the limit wait for a release, not a time
+    EXPECT_EQ(retry_at, never);
+
+    // endpoints are limited separately
+    EXPECT_TRUE(limiter.try_acquire("other", retry_at));
+
+    a->finish(response(200, 1ms));
+    EXPECT_EQ(limiter.in_flight("host"), 1ul);
+    EXPECT_TRUE(limiter.try_acquire("host", retry_at));
+    // every release calls the watchers, including the two tickets dropped above
+    EXPECT_EQ(released, 3);
+
+    limiter.unwatch(id);
+    b.reset();
+    EXPECT_EQ(released, 3);
+    EXPECT_EQ(limiter.in_flight("host"), 0ul);
+}
+
+TEST(throttle, limiter_adapts) {
+    throttle::limiter::options opts;
+    opts.initial_concurrency = 8;
+    throttle::limiter limiter(opts);
+    EXPECT_EQ(limiter.limit("host"), 8ul);
+
+    limiter.acquire("host").finish(response(503, 1ms));
+    EXPECT_EQ(limiter.limit("host"), 4ul);
+    EXPECT_EQ(limiter.limit("other"), 8ul);
+}
+
+TEST(throttle, limiter_rate) {
+    throttle::limiter::options opts;
+    opts.requests_per_second = 20;
+    throttle::limiter limiter(opts);
+
+    auto start = throttle::clock::now();
+    for (int ix = 0; ix < 30; ++ix) {
+        limiter.acquire("host");
+    }
+    // the first second's worth start at once, and the rest at 20 per second
+    EXPECT_GE(throttle::clock::now() - start, 450ms);
+
+    auto retry_at = throttle::clock::time_point::max();
+    EXPECT_FALSE(limiter.try_acquire("host", retry_at));
+    EXPECT_LT(retry_at, throttle::clock::now() + 100ms);
+}
+
+TEST(throttle, event_loop_concurrency) {
+    std::mutex mutex;
+    std::size_t running = 0;
+    std::size_t most_running = 0;
+    http_server server([&](const http_server::request&) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            most_running = std::max(most_running, ++running);
+        }
+        std::this_thread::sleep_for(5ms);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --running;
+        }
+        return http_server::response{};
+    });
+
+    throttle::limiter::options opts;
+    opts.adaptive = false;
+    opts.max_concurrency = 3;
+    throttle::limiter limiter(opts);
+    curl::event_loop loop(64, 64, curl::http_version::http1_1, &limiter);
+
+    const std::size_t count = 24;
+    std::vector<std::unique_ptr<CURL, curl::curl_deleter>> handles;
+    std::atomic<std::size_t> succeeded = 0;
+    std::atomic<std::size_t> done = 0;
+    std::promise<void> all_done;
+    for (std::size_t ix = 0; ix < count; ++ix) {
+        handles.emplace_back(curl_easy_init());
+        curl_easy_setopt(handles.back().get(),
+                         CURLOPT_URL,
+                         ("http://" + server.address() + "/x").c_str());
+        curl_easy_setopt(handles.back().get(), CURLOPT_NOSIGNAL, 1L);
+        loop.start(
+            handles.back().get(),
+            priority::demand,
+            [&](CURLcode code) {
+                if (code == CURLE_OK) {
+                    ++succeeded;
+                }
+                if (++done == count) {
+                    all_done.set_value();
+                }
+            },
+            server.address());
+    }
+    all_done.get_future().wait();
+
+    EXPECT_EQ(succeeded, count);
+    EXPECT_GT(most_running, 0ul);
+    EXPECT_LE(most_running, 3ul);
+    EXPECT_EQ(limiter.in_flight(server.address()), 0ul);
+}
+
+TEST(throttle, event_loop_backs_off) {
+    http_server server(
+        [&](const http_server::request&) { return http_server::response{503, {}, {}}; });
+
+    throttle::limiter::options opts;
+    opts.initial_concurrency = 8;
+    throttle::limiter limiter(opts);
+    curl::event_loop loop(8, 8, curl::http_version::http1_1, &limiter);
+
+    std::unique_ptr<CURL, curl::curl_deleter> handle(curl_easy_init());
+    curl_easy_setopt(handle.get(), CURLOPT_URL, ("http://" + server.address()).c_str());
+    curl_easy_setopt(handle.get(), CURLOPT_NOSIGNAL, 1L);
+    std::promise<CURLcode> result;
+    loop.start(
+        handle.get(),
+        priority::demand,
+        [&](CURLcode code) { result.set_value(code); },
+        server.address());
+    EXPECT_EQ(result.get_future().get(), CURLE_OK);
+    EXPECT_EQ(limiter.limit(server.address()), 4ul);
+}
@@ -0,0 +1,131 @@
+#include <experimental/filesystem>
+#include <string>
+
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "h5s3/private/memory_kv_store.h"
+#include "h5s3/private/page.h"
+#include "h5s3/private/trace.h"
+
+namespace fs = std::experimental::filesystem;
+namespace trace = h5s3::trace;
+
+class TraceTest : public ::testing::Test {
+protected:
+    std::string path;
+
+    TraceTest()
+        : path(fs::temp_directory_path() /
+               ("h5s3-trace-" + std::to_string(getpid()) + ".trace")) {}
+
+    ~TraceTest() {
+        fs::remove(path);
+    }
+};
+
+TEST_F(TraceTest, round_trip) {
+    std::vector<trace::record> expected = {
+        {0, 1, 2, 3, trace::op::read, false, 1},
+        {1ul << 40, 1ul << 50, 1u << 31, 4096, trace::op::write, true, 6},
+        {7, 8, 0, 1, trace::op::read, true, 3},
+    };
+
+    {
+        trace::writer w(path, 1234);
+        for (const auto& r : expected) {
+            w.write(r);
+        }
+    }
+
+    trace::reader r(path);
+    EXPECT_EQ(r.page_size(), 1234ul);
+
+    trace::record actual;
+    for (const auto& e : expected) {
+        ASSERT_TRUE(r.next(actual));
+        EXPECT_EQ(actual.page_id, e.page_id);
+        EXPECT_EQ(actual.timestamp_ns, e.timestamp_ns);
+        EXPECT_EQ(actual.offset, e.offset);
+        EXPECT_EQ(actual.size, e.size);
+        EXPECT_EQ(actual.operation, e.operation);
+        EXPECT_EQ(actual.hit, e.hit);
+        EXPECT_EQ(actual.mem_type, e.mem_type);
+    }
+    EXPECT_FALSE(r.next(actual));
+}
+
+TEST_F(TraceTest, not_a_trace) {
+    {
+        trace::writer w(path, 1234);
+    }
+    // corrupt the magic
+    std::FILE* f = std::fopen(path.data(), "r+b");
+    std::fputc('X', f);
+    std::fclose(f);
+
+    EXPECT_THROW(trace::reader r(path), trace::error);
+}
+
+TEST_F(TraceTest, page_table) {
+    using memory_kv_store = h5s3::memory_driver::memory_kv_store;
+    h5s3::page::table<memory_kv_store> t(memory_kv_store(16), 4);
+    t.trace(std::make_unique<trace::writer>(path, 16));
+
+    t.write(12, "abcdefgh", 6);
+    std::string out(4, '\0');
+    h5s3::utils::out_buffer buffer(out.data(), out.size());
+    t.read(16, buffer, 3);
+
+    // stop tracing, which flushes the trace
+    t.trace(nullptr);
+
+    trace::reader r(path);
+    EXPECT_EQ(r.page_size(), 16ul);
+
+    trace::record actual;
+    ASSERT_TRUE(r.next(actual));
+    EXPECT_EQ(actual.page_id, 0ul);
+    EXPECT_EQ(actual.offset, 12u);
+    EXPECT_EQ(actual.size, 4u);
+    EXPECT_EQ(actual.operation, trace::op::write);
+    EXPECT_FALSE(actual.hit);
+    EXPECT_EQ(actual.mem_type, 6);
+
+    ASSERT_TRUE(r.next(actual));
+    EXPECT_EQ(actual.page_id, 1ul);
+    EXPECT_EQ(actual.offset, 0u);
+    EXPECT_EQ(actual.size, 4u);
+    EXPECT_EQ(actual.operation, trace::op::write);
+    EXPECT_FALSE(actual.hit);
+
+    ASSERT_TRUE(r.next(actual));
+    EXPECT_EQ(actual.page_id, 1ul);
+    EXPECT_EQ(actual.size, 4u);
+    EXPECT_EQ(actual.operation, trace::op::read);
+    EXPECT_TRUE(actual.hit);
+    EXPECT_EQ(actual.mem_type, 3);
+
+    EXPECT_FALSE(r.next(actual));
+}
+
+TEST_F(TraceTest, hot_pages) {
+    using memory_kv_store = h5s3::memory_driver::memory_kv_store;
+    h5s3::page::table<memory_kv_store> t(memory_kv_store(16), 4);
+    t.track_hot_pages(1 << 1);
+
+    std::string out(4, '\0');
+    h5s3::utils::out_buffer buffer(out.data(), out.size());
+    for (int ix = 0; ix < 3; ++ix) {
+        t.read(0, buffer, 1);
+    }
+    // tracing must not change how often an access is counted
+    t.trace(std::make_unique<trace::writer>(path, 16));
+    for (int ix = 0; ix < 2; ++ix) {
+        t.read(16, buffer, 1);
+    }
+    t.trace(nullptr);
+
+    EXPECT_EQ(t.hot_pages(2), (std::vector<h5s3::page::id>{0, 1}));
+}
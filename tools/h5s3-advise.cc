@@ -0,0 +1,457 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hdf5.h"
+
+#include "h5s3/private/cache_sim.h"
+#include "h5s3/private/s3_driver.h"
+#include "h5s3/private/trace.h"
+#include "h5s3/private/utils.h"
+
+namespace {
+using namespace h5s3::utils;
+namespace cache_sim = h5s3::cache_sim;
+
+const char* usage = R"(usage: h5s3-advise [options] (TRACE... | --hdf5 FILE)
+
+Simulate a page cache over a grid of page sizes, cache sizes and eviction
+policies, and recommend the configuration with the lowest estimated time
+spent waiting on the kv-store.
+
+The accesses to simulate are either read from traces recorded with
+H5S3_TRACE_DIR, or derived from the chunk layout of an existing hdf5 file by
+reading every chunk of every dataset.
+
+options:
+  --hdf5 FILE              Derive accesses from the chunk layout of FILE,
+                           either a local path or an s3 uri like
+                           s3://bucket/path.h5s3.
+  --pattern PATTERN        How the chunks of --hdf5 are read: 'scan' (in
+                           file order, the default) or 'random'.
+  --passes N               The number of times the chunks of --hdf5 are read.
+                           Defaults to 2.
+  --page-sizes SIZES       A comma separated list of page sizes to try.
+                           Defaults to 256K,512K,1M,2M,4M,8M,16M.
+  --cache-sizes SIZES      A comma separated list of cache sizes in bytes to
+                           try. Defaults to 64M,256M,1G,4G.
+  --policies POLICIES      A comma separated list of eviction policies to try
+                           from lru, fifo and lfu. Defaults to lru,fifo,lfu.
+  --memory-budget SIZE     Only recommend configurations whose cache fits in
+                           SIZE bytes.
+  --latency-ms MS          The latency of one request, used to estimate the
+                           time of a configuration. Defaults to 30.
+  --bandwidth-mbps MBPS    The bandwidth of one request in megabytes per
+                           second. Defaults to 100.
+  --top N                  The number of configurations to print. Defaults to
+                           10.
+  --host HOST              The s3 host to use for --hdf5 s3 uris.
+  --no-tls                 Connect to s3 without TLS.
+
+Sizes may have a K, M or G suffix. The s3 credentials are read from
+AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY, and AWS_DEFAULT_REGION.
+)";
+
+struct options {
+    std::vector<std::string> traces;
+    std::string hdf5_path;
+    bool random = false;
+    std::size_t passes = 2;
+    std::vector<std::size_t> page_sizes = {256_KB, 512_KB, 1_MB, 2_MB, 4_MB, 8_MB, 16_MB};
+    std::vector<std::size_t> cache_sizes = {64_MB, 256_MB, 1_GB, 4_GB};
+    std::vector<cache_sim::policy> policies = {cache_sim::policy::lru,
+                                               cache_sim::policy::fifo,
+                                               cache_sim::policy::lfu};
+    std::size_t memory_budget = 0;
+    double latency_s = 0.030;
+    double bandwidth = 100.0 * 1_MB;
+    std::size_t top = 10;
+    const char* host = nullptr;
+    bool use_tls = true;
+};
+
+std::size_t parse_size(std::string_view text) {
+    if (text.empty()) {
+        throw std::invalid_argument("empty size");
+    }
+    std::size_t multiplier = 1;
+    switch (text.back()) {
+    case 'K':
+    case 'k':
+        multiplier = 1_KB;
+        break;
+    case 'M':
+    case 'm':
+        multiplier = 1_MB;
+        break;
+    case 'G':
+    case 'g':
+        multiplier = 1_GB;
+        break;
+    }
+    if (multiplier != 1) {
+        text.remove_suffix(1);
+    }
+
+    std::size_t consumed;
+    std::string digits(text);
+    std::size_t n = std::stoull(digits, &consumed);
+    if (consumed != digits.size() || !n) {
+        throw std::invalid_argument("invalid size: " + digits);
+    }
+    return n * multiplier;
+}
+
+template<typename F>
+auto parse_list(std::string_view text, F parse_item) {
+    std::vector<decltype(parse_item(text))> out;
+    while (!text.empty()) {
+        std::size_t end = text.find(',');
+        out.push_back(parse_item(text.substr(0, end)));
+        if (end == std::string_view::npos) {
+            break;
+        }
+        text.remove_prefix(end + 1);
+    }
+    if (out.empty()) {
+        throw std::invalid_argument("empty list");
+    }
+    return out;
+}
+
+options parse_args(int argc, char** argv) {
+    options opts;
+    auto value = [&](int& ix) -> const char* {
+        if (ix + 1 >= argc) {
+            throw std::invalid_argument(std::string(argv[ix]) + " requires a value");
+        }
+        return argv[++ix];
+    };
+
+    for (int ix = 1; ix < argc; ++ix) {
+        std::string_view arg(argv[ix]);
+        if (arg == "--hdf5") {
+            opts.hdf5_path = value(ix);
+        }
+        else if (arg == "--pattern") {
+            std::string_view pattern = value(ix);
+            if (pattern != "scan" && pattern != "random") {
+                throw std::invalid_argument("unknown pattern: " + std::string(pattern));
+            }
+            opts.random = pattern == "random";
+        }
+        else if (arg == "--passes") {
+            opts.passes = std::stoull(value(ix));
+        }
+        else if (arg == "--page-sizes") {
+            opts.page_sizes = parse_list(value(ix), parse_size);
+        }
+        else if (arg == "--cache-sizes") {
+            opts.cache_sizes = parse_list(value(ix), parse_size);
+        }
+        else if (arg == "--policies") {
+            opts.policies = parse_list(value(ix), cache_sim::parse_policy);
+        }
+        else if (arg == "--memory-budget") {
+            opts.memory_budget = parse_size(value(ix));
+        }
+        else if (arg == "--latency-ms") {
+            opts.latency_s = std::stod(value(ix)) / 1000;
+        }
+        else if (arg == "--bandwidth-mbps") {
+            opts.bandwidth = std::stod(value(ix)) * 1_MB;
+        }
+        else if (arg == "--top") {
+            opts.top = std::stoull(value(ix));
+        }
+        else if (arg == "--host") {
+            opts.host = value(ix);
+        }
+        else if (arg == "--no-tls") {
+            opts.use_tls = false;
+        }
+        else if (arg == "-h" || arg == "--help") {
+            std::cout << usage;
+            std::exit(0);
+        }
+        else if (!arg.empty() && arg[0] != '-') {
+            opts.traces.emplace_back(arg);
+        }
+        else {
+            throw std::invalid_argument("unknown argument: " + std::string(arg));
+        }
+    }
+
+    if (opts.traces.empty() == opts.hdf5_path.empty()) {
+        throw std::invalid_argument("pass either trace files or --hdf5");
+    }
+    if (opts.bandwidth <= 0) {
+        throw std::invalid_argument("--bandwidth-mbps must be positive");
+    }
+    return opts;
+}
+
+void read_trace(const std::string& path, std::vector<cache_sim::access>& out) {
+    h5s3::trace::reader reader(path);
+    h5s3::trace::record r;
+    while (reader.next(r)) {
+        out.push_back({r.page_id * reader.page_size() + r.offset,
+                       r.size,
+                       r.operation == h5s3::trace::op::write});
+    }
+}
+
+/** The on-disk extent of a chunk, or of a contiguous dataset.
+ */
+struct extent {
+    std::uint64_t addr;
+    std::uint64_t size;
+};
+
+void dataset_extents(hid_t dataset, std::vector<extent>& out) {
+    hid_t dcpl = H5Dget_create_plist(dataset);
+    if (dcpl < 0) {
+        throw std::runtime_error("failed to get dataset creation property list");
+    }
+    H5D_layout_t layout = H5Pget_layout(dcpl);
+    H5Pclose(dcpl);
+
+    if (layout == H5D_CONTIGUOUS) {
+        haddr_t addr = H5Dget_offset(dataset);
+        if (addr != HADDR_UNDEF) {
+            out.push_back({addr, H5Dget_storage_size(dataset)});
+        }
+    }
+    else if (layout == H5D_CHUNKED) {
+#if H5_VERSION_GE(1, 10, 5)
+        hid_t space = H5Dget_space(dataset);
+        int rank = H5Sget_simple_extent_ndims(space);
+        std::vector<hsize_t> offset(std::max(rank, 1));
+        hsize_t chunks = 0;
+        if (H5Dget_num_chunks(dataset, space, &chunks) < 0) {
+            H5Sclose(space);
+            throw std::runtime_error("failed to get the number of chunks");
+        }
+        for (hsize_t ix = 0; ix < chunks; ++ix) {
+            unsigned filter_mask;
+            haddr_t addr;
+            hsize_t size;
+            if (H5Dget_chunk_info(dataset,
+                                  space,
+                                  ix,
+                                  offset.data(),
+                                  &filter_mask,
+                                  &addr,
+                                  &size) < 0) {
+                H5Sclose(space);
+                throw std::runtime_error("failed to get chunk info");
+            }
+            if (addr != HADDR_UNDEF) {
+                out.push_back({addr, size});
+            }
+        }
+        H5Sclose(space);
+#else
+        throw std::runtime_error("scanning chunked datasets requires hdf5 >= 1.10.5");
+#endif
+    }
+    // compact datasets live in the object header, which we don't model
+}
+
+herr_t visit_link(hid_t group, const char* name, const H5L_info_t*, void* data) {
+    auto& out = *static_cast<std::vector<extent>*>(data);
+    if (H5Oexists_by_name(group, name, H5P_DEFAULT) <= 0) {
+        // dangling soft or external link
+        return 0;
+    }
+    hid_t obj = H5Oopen(group, name, H5P_DEFAULT);
+    if (obj < 0) {
+        return -1;
+    }
+    try {
+        if (H5Iget_type(obj) == H5I_DATASET) {
+            dataset_extents(obj, out);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "h5s3-advise: " << name << ": " << e.what() << '\n';
+        H5Oclose(obj);
+        return -1;
+    }
+    H5Oclose(obj);
+    return 0;
+}
+
+void read_hdf5(const options& opts, std::vector<cache_sim::access>& out) {
+    hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+    if (fapl < 0) {
+        throw std::runtime_error("failed to create file access property list");
+    }
+    if (opts.hdf5_path.rfind("s3://", 0) == 0 &&
+        h5s3::s3_driver::s3_driver::set_fapl(fapl,
+                                             0,
+                                             1,
+                                             std::getenv("AWS_ACCESS_KEY_ID"),
+                                             std::getenv("AWS_SECRET_ACCESS_KEY"),
+                                             std::getenv("AWS_DEFAULT_REGION"),
+                                             opts.host,
+                                             opts.use_tls,
+                                             0,
+                                             0,
+                                             static_cast<const char*>(nullptr),
+                                             static_cast<const char*>(nullptr),
+                                             false,
+                                             false) < 0) {
+        H5Pclose(fapl);
+        throw std::runtime_error("failed to set the s3 driver");
+    }
+
+    hid_t file = H5Fopen(opts.hdf5_path.data(), H5F_ACC_RDONLY, fapl);
+    H5Pclose(fapl);
+    if (file < 0) {
+        throw std::runtime_error("failed to open " + opts.hdf5_path);
+    }
+
+    std::vector<extent> extents;
+    herr_t status = H5Lvisit(file, H5_INDEX_NAME, H5_ITER_INC, visit_link, &extents);
+    H5Fclose(file);
+    if (status < 0) {
+        throw std::runtime_error("failed to scan " + opts.hdf5_path);
+    }
+
+    std::sort(extents.begin(), extents.end(), [](const extent& a, const extent& b) {
+        return a.addr < b.addr;
+    });
+
+    std::mt19937_64 rng(0);
+    for (std::size_t pass = 0; pass < opts.passes; ++pass) {
+        if (opts.random) {
+            std::shuffle(extents.begin(), extents.end(), rng);
+        }
+        for (const extent& e : extents) {
+            out.push_back({e.addr, e.size, false});
+        }
+    }
+}
+
+std::string format_size(std::size_t n) {
+    if (n >= 1_GB && n % 1_GB == 0) {
+        return std::to_string(n / 1_GB) + "G";
+    }
+    if (n >= 1_MB && n % 1_MB == 0) {
+        return std::to_string(n / 1_MB) + "M";
+    }
+    if (n >= 1_KB && n % 1_KB == 0) {
+        return std::to_string(n / 1_KB) + "K";
+    }
+    return std::to_string(n);
+}
+
+void print_result(const cache_sim::result& r, const options& opts) {
+    std::cout << std::setw(10) << format_size(r.cache.page_size) << std::setw(12)
+              << r.cache.page_cache_size << std::setw(10)
+              << format_size(r.cache.page_size * r.cache.page_cache_size)
+              << std::setw(6) << cache_sim::policy_name(r.cache.eviction)
+              << std::setw(10) << std::fixed << std::setprecision(4) << r.hit_ratio()
+              << std::setw(12) << r.requests() << std::setw(16) << r.bytes_transferred()
+              << std::setw(12) << std::setprecision(2)
+              << r.estimated_seconds(opts.latency_s, opts.bandwidth) << '\n';
+}
+
+void print_recommendation(const char* label, const cache_sim::result& r) {
+    std::cout << label << "page_size=" << r.cache.page_size
+              << " page_cache_size=" << r.cache.page_cache_size << " ("
+              << format_size(r.cache.page_size * r.cache.page_cache_size)
+              << " of cache) policy=" << cache_sim::policy_name(r.cache.eviction)
+              << '\n';
+}
+
+int advise(const options& opts) {
+    std::vector<cache_sim::access> accesses;
+    if (opts.hdf5_path.empty()) {
+        for (const std::string& path : opts.traces) {
+            read_trace(path, accesses);
+        }
+    }
+    else {
+        read_hdf5(opts, accesses);
+    }
+    if (accesses.empty()) {
+        std::cerr << "h5s3-advise: no accesses to simulate\n";
+        return 1;
+    }
+
+    std::vector<cache_sim::result> results;
+    for (std::size_t page_size : opts.page_sizes) {
+        for (std::size_t cache_size : opts.cache_sizes) {
+            if (opts.memory_budget && cache_size > opts.memory_budget) {
+                continue;
+            }
+            std::size_t page_cache_size = std::max<std::size_t>(cache_size / page_size, 1);
+            for (cache_sim::policy p : opts.policies) {
+                results.push_back(cache_sim::simulate(accesses,
+                                                      {page_size, page_cache_size, p}));
+            }
+        }
+    }
+    if (results.empty()) {
+        std::cerr << "h5s3-advise: no cache size fits in the memory budget\n";
+        return 1;
+    }
+
+    // prefer the fastest configuration, then the one using the least memory
+    auto cost = [&](const cache_sim::result& r) {
+        return std::make_tuple(r.estimated_seconds(opts.latency_s, opts.bandwidth),
+                               r.cache.page_size * r.cache.page_cache_size,
+                               r.cache.eviction != cache_sim::policy::lru);
+    };
+    std::sort(results.begin(),
+              results.end(),
+              [&](const cache_sim::result& a, const cache_sim::result& b) {
+                  return cost(a) < cost(b);
+              });
+
+    std::cout << "accesses: " << accesses.size() << "\n\n"
+              << std::setw(10) << "page_size" << std::setw(12) << "pages"
+              << std::setw(10) << "cache" << std::setw(6) << "evict" << std::setw(10)
+              << "hit_ratio" << std::setw(12) << "requests" << std::setw(16) << "bytes"
+              << std::setw(12) << "est_s" << '\n';
+    for (std::size_t ix = 0; ix < std::min(opts.top, results.size()); ++ix) {
+        print_result(results[ix], opts);
+    }
+    std::cout << '\n';
+
+    print_recommendation("recommended: ", results.front());
+    if (results.front().cache.eviction != cache_sim::policy::lru) {
+        // the page table only implements lru, so also give the best
+        // configuration that can be used today
+        auto lru = std::find_if(results.begin(),
+                                results.end(),
+                                [](const cache_sim::result& r) {
+                                    return r.cache.eviction == cache_sim::policy::lru;
+                                });
+        if (lru != results.end()) {
+            print_recommendation("best lru:    ", *lru);
+        }
+    }
+    return 0;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    try {
+        return advise(parse_args(argc, argv));
+    }
+    catch (const std::invalid_argument& e) {
+        std::cerr << "h5s3-advise: " << e.what() << "\n\n" << usage;
+        return 2;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "h5s3-advise: " << e.what() << '\n';
+        return 1;
+    }
+}
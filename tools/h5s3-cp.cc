@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <regex>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "h5s3/private/s3_driver.h"
+#include "h5s3/private/utils.h"
+
+namespace {
+const char* usage = R"(usage: h5s3-cp [options] SOURCE DEST
+
+Copy a local hdf5 file into the h5s3 page layout, an h5s3 file back to a
+local file, or an h5s3 file to another path in s3. s3 paths are uris like
+s3://bucket/path.h5s3.
+
+Uploads read the local file through a memory map and send each object
+straight from it. Objects which are all zeros are not uploaded and read back
+as zeros. Downloads write into a sparse local file, skipping the pages with
+no data in s3. The downloaded file is padded with zeros to a whole number of
+pages. Copies within s3 are made by s3 without transferring the data, and
+keep the layout of the source. `.meta` is written last, so readers of the s3
+file never see pages which have not been written.
+
+options:
+  --concurrency N          The number of objects to transfer at once.
+                           Defaults to 64.
+  --page-size BYTES        The page size of a new s3 file. Defaults to the
+                           page size of an existing file, or 2MB.
+  --pages-per-object N     The number of pages to store in each s3 object.
+  --key-prefixes N         The number of hashed key prefixes to spread the s3
+                           objects over.
+  --buckets BUCKETS        A comma separated list of buckets to spread the s3
+                           objects over.
+  --endpoints ADDRESSES    A comma separated list of addresses to spread the
+                           s3 requests over, or 'dns' for every address the
+                           host resolves to.
+  --content-addressed      Name the s3 objects by the hash of their contents,
+                           so identical objects are stored once.
+  --host HOST              The s3 host to use.
+  --no-tls                 Connect to s3 without TLS.
+
+The s3 credentials are read from AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY, and
+AWS_DEFAULT_REGION.
+)";
+
+struct options {
+    std::string source;
+    std::string dest;
+    std::size_t concurrency = 64;
+    std::size_t page_size = 0;
+    std::size_t pages_per_object = 0;
+    std::size_t key_prefixes = 0;
+    const char* buckets = nullptr;
+    const char* endpoints = nullptr;
+    bool content_addressed = false;
+    const char* host = nullptr;
+    bool use_tls = true;
+};
+
+bool is_s3(const std::string& path) {
+    return path.rfind("s3://", 0) == 0;
+}
+
+options parse_args(int argc, char** argv) {
+    options opts;
+    auto value = [&](int& ix) -> const char* {
+        if (ix + 1 >= argc) {
+            throw std::invalid_argument(std::string(argv[ix]) + " requires a value");
+        }
+        return argv[++ix];
+    };
+
+    for (int ix = 1; ix < argc; ++ix) {
+        std::string_view arg(argv[ix]);
+        if (arg == "--concurrency") {
+            opts.concurrency = std::stoull(value(ix));
+        }
+        else if (arg == "--page-size") {
+            opts.page_size = std::stoull(value(ix));
+        }
+        else if (arg == "--pages-per-object") {
+            opts.pages_per_object = std::stoull(value(ix));
+        }
+        else if (arg == "--key-prefixes") {
+            opts.key_prefixes = std::stoull(value(ix));
+        }
+        else if (arg == "--buckets") {
+            opts.buckets = value(ix);
+        }
+        else if (arg == "--endpoints") {
+            opts.endpoints = value(ix);
+        }
+        else if (arg == "--content-addressed") {
+            opts.content_addressed = true;
+        }
+        else if (arg == "--host") {
+            opts.host = value(ix);
+        }
+        else if (arg == "--no-tls") {
+            opts.use_tls = false;
+        }
+        else if (arg == "-h" || arg == "--help") {
+            std::cout << usage;
+            std::exit(0);
+        }
+        else if (!arg.empty() && arg[0] != '-' && opts.source.empty()) {
+            opts.source = arg;
+        }
+        else if (!arg.empty() && arg[0] != '-' && opts.dest.empty()) {
+            opts.dest = arg;
+        }
+        else {
+            throw std::invalid_argument("unknown argument: " + std::string(arg));
+        }
+    }
+
+    if (opts.dest.empty()) {
+        throw std::invalid_argument("pass a source and a destination");
+    }
+    if (!is_s3(opts.source) && !is_s3(opts.dest)) {
+        throw std::invalid_argument("the source or destination must be an s3 uri");
+    }
+    if (!opts.concurrency) {
+        throw std::invalid_argument("--concurrency must be positive");
+    }
+    return opts;
+}
+
+h5s3::s3_driver::s3_kv_store open_store(const options& opts, const std::string& uri) {
+    return h5s3::s3_driver::s3_kv_store::from_params(uri,
+                                                     0,
+                                                     opts.page_size,
+                                                     std::getenv("AWS_ACCESS_KEY_ID"),
+                                                     std::getenv("AWS_SECRET_ACCESS_KEY"),
+                                                     std::getenv("AWS_DEFAULT_REGION"),
+                                                     opts.host,
+                                                     opts.use_tls,
+                                                     opts.pages_per_object,
+                                                     opts.key_prefixes,
+                                                     opts.buckets,
+                                                     opts.endpoints,
+                                                     opts.content_addressed,
+                                                     false);
+}
+
+std::runtime_error system_error(const std::string& what, const std::string& path) {
+    return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+/** A file mapped into memory, unmapped and closed on destruction.
+ */
+class mapped_file {
+private:
+    int m_fd;
+    char* m_data;
+    std::size_t m_size;
+
+public:
+    /** Map an existing file to read, or create a sparse file of `size` bytes
+        to write.
+     */
+    mapped_file(const std::string& path, bool write, std::size_t size = 0)
+        : m_fd(-1), m_data(nullptr), m_size(size) {
+        m_fd = write ? ::open(path.data(), O_RDWR | O_CREAT | O_TRUNC, 0666)
+                     : ::open(path.data(), O_RDONLY);
+        if (m_fd < 0) {
+            throw system_error("failed to open", path);
+        }
+        if (write) {
+            // the pages are written out of order, so leave holes for the rest
+            if (::ftruncate(m_fd, m_size) < 0) {
+                ::close(m_fd);
+                throw system_error("failed to size", path);
+            }
+        }
+        else {
+            struct stat st;
+            if (::fstat(m_fd, &st) < 0) {
+                ::close(m_fd);
+                throw system_error("failed to stat", path);
+            }
+            m_size = st.st_size;
+        }
+        if (!m_size) {
+            return;
+        }
+
+        void* data = ::mmap(nullptr,
+                            m_size,
+                            write ? PROT_READ | PROT_WRITE : PROT_READ,
+                            write ? MAP_SHARED : MAP_PRIVATE,
+                            m_fd,
+                            0);
+        if (data == MAP_FAILED) {
+            ::close(m_fd);
+            throw system_error("failed to map", path);
+        }
+        m_data = static_cast<char*>(data);
+        if (!write) {
+            ::madvise(m_data, m_size, MADV_SEQUENTIAL);
+        }
+    }
+
+    mapped_file(const mapped_file&) = delete;
+
+    ~mapped_file() {
+        if (m_data) {
+            ::munmap(m_data, m_size);
+        }
+        ::close(m_fd);
+    }
+
+    char* data() {
+        return m_data;
+    }
+
+    std::size_t size() const {
+        return m_size;
+    }
+};
+
+void report(const char* verb,
+            std::size_t bytes,
+            std::size_t requests,
+            std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << verb << ' ' << bytes << " bytes with " << requests << " requests in "
+              << elapsed.count() << "s ("
+              << bytes / std::max(elapsed.count(), 1e-9) / (1 << 20) << " MB/s)\n";
+}
+
+void upload(const options& opts) {
+    auto start = std::chrono::steady_clock::now();
+    mapped_file file(opts.source, false);
+    auto store = open_store(opts, opts.dest);
+    store.import_file(std::string_view(file.data(), file.size()), opts.concurrency);
+    report("uploaded",
+           store.stats().bytes_written.load(),
+           store.stats().puts.load(),
+           start);
+}
+
+void download(const options& opts) {
+    auto start = std::chrono::steady_clock::now();
+    auto store = open_store(opts, opts.source);
+    if (!store.allocated_pages()) {
+        throw std::runtime_error("no such h5s3 file: " + opts.source);
+    }
+    std::size_t size = store.allocated_pages() * store.page_size();
+    mapped_file file(opts.dest, true, size);
+    store.export_file(h5s3::utils::out_buffer(file.data(), size), opts.concurrency);
+    report("downloaded",
+           store.stats().bytes_read.load(),
+           store.stats().gets.load(),
+           start);
+}
+
+void clone(const options& opts) {
+    auto start = std::chrono::steady_clock::now();
+    // split the uri the way `s3_kv_store::from_params` does, so that the copy
+    // opens with the bucket and path it was written with
+    std::regex url_regex("s3://(.+)/(.+)");
+    std::smatch match;
+    if (!std::regex_match(opts.dest, match, url_regex)) {
+        throw std::invalid_argument("invalid s3 uri: " + opts.dest);
+    }
+    std::string bucket = match[1].str();
+    std::string path = match[2].str();
+    while (path.back() == '/') {
+        path.pop_back();
+    }
+
+    auto store = open_store(opts, opts.source);
+    if (!store.allocated_pages()) {
+        throw std::runtime_error("no such h5s3 file: " + opts.source);
+    }
+    std::size_t objects = store.clone(bucket, path, opts.concurrency);
+    report("copied",
+           objects * store.pages_per_object() * store.page_size(),
+           store.stats().puts.load(),
+           start);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    try {
+        options opts = parse_args(argc, argv);
+        // uploads run on the I/O threads, so give them one thread per object
+        // unless the pool is sized explicitly
+        ::setenv("H5S3_IO_THREADS", std::to_string(opts.concurrency).data(), 0);
+
+        if (is_s3(opts.source) && is_s3(opts.dest)) {
+            clone(opts);
+        }
+        else if (is_s3(opts.dest)) {
+            upload(opts);
+        }
+        else {
+            download(opts);
+        }
+    }
+    catch (const std::invalid_argument& e) {
+        std::cerr << "h5s3-cp: " << e.what() << "\n\n" << usage;
+        return 2;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "h5s3-cp: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,226 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "h5s3/private/memory_kv_store.h"
+#include "h5s3/private/page.h"
+#include "h5s3/private/s3_driver.h"
+#include "h5s3/private/trace.h"
+#include "h5s3/private/utils.h"
+
+namespace {
+const char* usage = R"(usage: h5s3-replay [options] TRACE
+
+Replay a page access trace recorded with H5S3_TRACE_DIR against a kv-store
+with a chosen cache configuration, then print the page cache and request
+statistics.
+
+options:
+  --page-size BYTES        The page size to replay with. Defaults to the page
+                           size of the traced table.
+  --page-cache-size PAGES  The number of pages to cache. Defaults to 4GB worth
+                           of pages.
+  --store STORE            Either 'memory' (the default) or an s3 uri like
+                           s3://bucket/path. Writes in the trace are applied
+                           to the store.
+  --host HOST              The s3 host to use.
+  --no-tls                 Connect to s3 without TLS.
+  --pages-per-object N     The number of pages to store in each s3 object.
+  --key-prefixes N         The number of hashed key prefixes to spread the s3
+                           objects over.
+  --buckets BUCKETS        A comma separated list of buckets to spread the s3
+                           objects over.
+  --endpoints ADDRESSES    A comma separated list of addresses to spread the
+                           s3 requests over, or 'dns' for every address the
+                           host resolves to.
+  --content-addressed      Name the s3 objects by the hash of their contents,
+                           so identical objects are stored once.
+  --log-structured         Append the changed bytes of pages to a log instead
+                           of rewriting the pages' s3 objects.
+  --realtime               Sleep between accesses to reproduce the timing of
+                           the trace.
+
+The s3 credentials are read from AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY, and
+AWS_DEFAULT_REGION.
+)";
+
+struct options {
+    std::string trace_path;
+    std::size_t page_size = 0;
+    std::size_t page_cache_size = 0;
+    std::string store = "memory";
+    const char* host = nullptr;
+    bool use_tls = true;
+    std::size_t pages_per_object = 0;
+    std::size_t key_prefixes = 0;
+    const char* buckets = nullptr;
+    const char* endpoints = nullptr;
+    bool content_addressed = false;
+    bool log_structured = false;
+    bool realtime = false;
+};
+
+options parse_args(int argc, char** argv) {
+    options opts;
+    auto value = [&](int& ix) -> const char* {
+        if (ix + 1 >= argc) {
+            throw std::invalid_argument(std::string(argv[ix]) + " requires a value");
+        }
+        return argv[++ix];
+    };
+
+    for (int ix = 1; ix < argc; ++ix) {
+        std::string_view arg(argv[ix]);
+        if (arg == "--page-size") {
+            opts.page_size = std::stoull(value(ix));
+        }
+        else if (arg == "--page-cache-size") {
+            opts.page_cache_size = std::stoull(value(ix));
+        }
+        else if (arg == "--store") {
+            opts.store = value(ix);
+        }
+        else if (arg == "--host") {
+            opts.host = value(ix);
+        }
+        else if (arg == "--no-tls") {
+            opts.use_tls = false;
+        }
+        else if (arg == "--pages-per-object") {
+            opts.pages_per_object = std::stoull(value(ix));
+        }
+        else if (arg == "--key-prefixes") {
+            opts.key_prefixes = std::stoull(value(ix));
+        }
+        else if (arg == "--buckets") {
+            opts.buckets = value(ix);
+        }
+        else if (arg == "--endpoints") {
+            opts.endpoints = value(ix);
+        }
+        else if (arg == "--content-addressed") {
+            opts.content_addressed = true;
+        }
+        else if (arg == "--log-structured") {
+            opts.log_structured = true;
+        }
+        else if (arg == "--realtime") {
+            opts.realtime = true;
+        }
+        else if (arg == "-h" || arg == "--help") {
+            std::cout << usage;
+            std::exit(0);
+        }
+        else if (opts.trace_path.empty() && !arg.empty() && arg[0] != '-') {
+            opts.trace_path = arg;
+        }
+        else {
+            throw std::invalid_argument("unknown argument: " + std::string(arg));
+        }
+    }
+
+    if (opts.trace_path.empty()) {
+        throw std::invalid_argument("no trace file given");
+    }
+    return opts;
+}
+
+template<typename kv_store>
+void replay(const options& opts, h5s3::trace::reader& reader, kv_store&& store) {
+    std::size_t page_cache_size = opts.page_cache_size;
+    if (!page_cache_size) {
+        using h5s3::utils::operator""_GB;
+        page_cache_size = 4_GB / store.page_size();
+    }
+    h5s3::page::table<kv_store> table(std::move(store), page_cache_size);
+
+    std::vector<char> buffer;
+    std::size_t records = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    h5s3::trace::record r;
+    while (reader.next(r)) {
+        ++records;
+        if (opts.realtime) {
+            auto offset = std::chrono::nanoseconds(r.timestamp_ns);
+            std::this_thread::sleep_until(start + offset);
+        }
+
+        std::size_t addr = r.page_id * reader.page_size() + r.offset;
+        if (buffer.size() < r.size) {
+            buffer.resize(r.size);
+        }
+        if (r.operation == h5s3::trace::op::read) {
+            h5s3::utils::out_buffer out(buffer.data(), r.size);
+            table.read(addr, out, r.mem_type);
+        }
+        else {
+            table.write(addr, std::string_view(buffer.data(), r.size), r.mem_type);
+        }
+    }
+    table.flush();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    h5s3::stats::snapshot s(table.stats(), table.store().stats());
+
+    std::cout << "records:         " << records << '\n'
+              << "elapsed_s:       " << elapsed.count() << '\n'
+              << "page_size:       " << table.store().page_size() << '\n'
+              << "page_cache_size: " << page_cache_size << '\n'
+              << "hits:            " << s.hits << '\n'
+              << "misses:          " << s.misses << '\n'
+              << "evictions:       " << s.evictions << '\n'
+              << "writebacks:      " << s.writebacks << '\n'
+              << "unchanged:       " << s.unchanged_writebacks << '\n'
+              << "gets:            " << s.gets << '\n'
+              << "puts:            " << s.puts << '\n'
+              << "bytes_read:      " << s.bytes_read << '\n'
+              << "bytes_written:   " << s.bytes_written << '\n'
+              << "get_p50_ns:      " << s.get_latency.percentile(0.5) << '\n'
+              << "get_p99_ns:      " << s.get_latency.percentile(0.99) << '\n';
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    try {
+        options opts = parse_args(argc, argv);
+        h5s3::trace::reader reader(opts.trace_path);
+        std::size_t page_size = opts.page_size ? opts.page_size : reader.page_size();
+
+        if (opts.store == "memory") {
+            replay(opts, reader, h5s3::memory_driver::memory_kv_store(page_size));
+        }
+        else {
+            const char* region = std::getenv("AWS_DEFAULT_REGION");
+            using h5s3::s3_driver::s3_kv_store;
+            auto store = s3_kv_store::from_params(opts.store,
+                                                  0,
+                                                  page_size,
+                                                  std::getenv("AWS_ACCESS_KEY_ID"),
+                                                  std::getenv("AWS_SECRET_ACCESS_KEY"),
+                                                  region,
+                                                  opts.host,
+                                                  opts.use_tls,
+                                                  opts.pages_per_object,
+                                                  opts.key_prefixes,
+                                                  opts.buckets,
+                                                  opts.endpoints,
+                                                  opts.content_addressed,
+                                                  opts.log_structured);
+            replay(opts, reader, std::move(store));
+        }
+    }
+    catch (const std::invalid_argument& e) {
+        std::cerr << "h5s3-replay: " << e.what() << "\n\n" << usage;
+        return 2;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "h5s3-replay: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}